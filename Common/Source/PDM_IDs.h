@@ -61,6 +61,10 @@ extern "C" {
 #define PDM_ID_OTA_DATA             0xA
 #define PDM_ID_APP_LIGHT_CALIB		0xB
 #define PDM_ID_APP_COMPUTE_WHITE	0xC
+#define PDM_ID_APP_LIGHT_SETTINGS	0xD
+#define PDM_ID_APP_LIGHT_CURVES		0xE
+#define PDM_ID_APP_COLOUR_MATRIX	0xF
+#define PDM_ID_APP_CHANNEL_CURRENT	0x10
 
 #else
 
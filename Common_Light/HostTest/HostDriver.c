@@ -0,0 +1,140 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          HostDriver.c
+ *
+ * DESCRIPTION:        Host build: recording bulb driver - Implementation
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Bulb driver which only records what it is given, for testing the modules
+ * above the drivers without any output hardware model */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <jendefs.h>
+#include "DriverBulb.h"
+#include "HostDriver.h"
+
+/****************************************************************************/
+/*          Exported Variables                                              */
+/****************************************************************************/
+
+PUBLIC tsHostBulb asHostBulb[NUM_BULBS];
+PUBLIC uint32 u32HostFrames;
+PUBLIC uint32 u32HostRefreshes;
+PUBLIC bool_t bHostDitherActive;
+PUBLIC uint16 au16HostChannelPWM[NUM_CHANNELS];
+PUBLIC uint32 u32HostDriverErrors;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+PUBLIC void DriverBulb_vInit(void)
+{
+}
+
+PUBLIC void DriverBulb_vOn(uint8 u8Bulb)
+{
+	asHostBulb[u8Bulb].bOn = TRUE;
+}
+
+PUBLIC void DriverBulb_vOff(uint8 u8Bulb)
+{
+	asHostBulb[u8Bulb].bOn = FALSE;
+}
+
+PUBLIC bool_t DriverBulb_bOn(uint8 u8Bulb)
+{
+	return asHostBulb[u8Bulb].bOn;
+}
+
+PUBLIC void DriverBulb_vSetLevel(uint8 u8Bulb, uint32 u32Level)
+{
+	asHostBulb[u8Bulb].u32Level = u32Level;
+}
+
+PUBLIC void DriverBulb_vSetOnOff(uint8 u8Bulb, bool_t bOn)
+{
+	asHostBulb[u8Bulb].bOn = bOn;
+}
+
+PUBLIC void DriverBulb_vSetColour(uint8 u8Bulb, uint32 u32Red, uint32 u32Green, uint32 u32Blue)
+{
+	asHostBulb[u8Bulb].u32Red = u32Red;
+	asHostBulb[u8Bulb].u32Green = u32Green;
+	asHostBulb[u8Bulb].u32Blue = u32Blue;
+}
+
+PUBLIC void DriverBulb_vOutput(uint8 u8Bulb)
+{
+}
+
+PUBLIC void DriverBulb_vDither(void)
+{
+}
+
+PUBLIC bool_t DriverBulb_bDitherActive(void)
+{
+	return bHostDitherActive;
+}
+
+PUBLIC void DriverBulb_vBeginFrame(void)
+{
+}
+
+PUBLIC void DriverBulb_vCommitFrame(void)
+{
+	u32HostFrames++;
+}
+
+PUBLIC void DriverBulb_vRefresh(void)
+{
+	u32HostRefreshes++;
+}
+
+PUBLIC uint16 DriverBulb_u16GetChannelPWM(uint8 u8Channel)
+{
+	return au16HostChannelPWM[u8Channel];
+}
+
+PUBLIC uint32 DriverBulb_u32GetErrors(void)
+{
+	return u32HostDriverErrors;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,82 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          HostDriver.h
+ *
+ * DESCRIPTION:        Host build: recording bulb driver - Interface
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+#ifndef HOST_DRIVER_H
+#define HOST_DRIVER_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <jendefs.h>
+#include "DriverBulb.h"
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/* What HostDriver.c was last given for a bulb */
+typedef struct
+{
+	bool_t bOn;
+	uint32 u32Level;
+	uint32 u32Red;
+	uint32 u32Green;
+	uint32 u32Blue;
+} tsHostBulb;
+
+/****************************************************************************/
+/***        External Variables                                            ***/
+/****************************************************************************/
+
+extern tsHostBulb asHostBulb[NUM_BULBS];
+/* Number of DriverBulb_vCommitFrame calls */
+extern uint32 u32HostFrames;
+/* Number of DriverBulb_vRefresh calls */
+extern uint32 u32HostRefreshes;
+/* Returned by DriverBulb_bDitherActive */
+extern bool_t bHostDitherActive;
+/* Returned by DriverBulb_u16GetChannelPWM and DriverBulb_u32GetErrors */
+extern uint16 au16HostChannelPWM[NUM_CHANNELS];
+extern uint32 u32HostDriverErrors;
+
+#endif /* HOST_DRIVER_H */
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
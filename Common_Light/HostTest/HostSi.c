@@ -0,0 +1,309 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          HostSi.c
+ *
+ * DESCRIPTION:        Host build: SI master and PCA9685 model - Implementation
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Model of the JN5168 SI master with a PCA9685 on the bus, for testing
+ * DriverBulb_PCA9685.c. A byte started with bAHI_SiMasterSetCmdReg is sent
+ * when the test calls bHostSi_Byte or u32HostSi_Run, or at once if the
+ * driver polls for it, or at once when it is started outside the SI
+ * interrupt if bHostSiInstant is set. The PCA9685 latches its outputs at
+ * each STOP, so the model checks there that every LED channel written in
+ * the transfer had all four of its registers written. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <string.h>
+#include <jendefs.h>
+#include <AppHardwareApi.h>
+#include "os_gen.h"
+#include "HostSi.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define PCA9685_ADDRESS			(0x40)
+#define PCA9685_LED0			(0x06)
+#define PCA9685_CHANNELS		(16)
+#define PCA9685_STRIDE			(4)
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+PUBLIC tsHostSi sHostSi;
+PUBLIC uint8 au8HostPcaRegisters[256];
+PUBLIC uint8 au8HostPcaOutputs[256];
+PUBLIC uint32 u32HostSiNacks;
+PUBLIC bool_t bHostSiBusy;
+PUBLIC bool_t bHostSiInterrupt;
+PUBLIC bool_t bHostSiInstant;
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+PRIVATE bool_t bInterruptEnabled;
+PRIVATE bool_t bInInterrupt;
+/* Byte last loaded into the transmit register, and what its command was */
+PRIVATE uint8 u8Tx;
+PRIVATE bool_t bTxStart;
+PRIVATE bool_t bTxStop;
+/* Between a START and a STOP, and waiting for the register number */
+PRIVATE bool_t bInTransfer;
+PRIVATE bool_t bWantRegister;
+PRIVATE uint8 u8Pointer;
+PRIVATE bool_t bLastNack;
+/* Registers written since the last STOP */
+PRIVATE bool_t abWritten[256];
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: bHostSi_Byte
+ *
+ * DESCRIPTION:
+ * Finishes sending the byte in progress, if there is one. The PCA9685
+ * takes it, and the SI interrupt is raised if it is enabled.
+ *
+ * RETURNS:
+ * TRUE if a byte was sent
+ ****************************************************************************/
+PUBLIC bool_t bHostSi_Byte(void)
+{
+	uint8 u8Channel;
+	uint8 u8Count;
+	uint8 i;
+
+	if (!bHostSiBusy)
+	{
+		return FALSE;
+	}
+	bHostSiBusy = FALSE;
+	sHostSi.u32Bytes++;
+
+	bLastNack = (u32HostSiNacks > 0);
+	if (bLastNack)
+	{
+		u32HostSiNacks--;
+	}
+
+	if (bTxStart)
+	{
+		/* Address byte */
+	}
+	else if (bWantRegister)
+	{
+		u8Pointer = u8Tx;
+		bWantRegister = FALSE;
+	}
+	else
+	{
+		/* Register auto-increment is on */
+		au8HostPcaRegisters[u8Pointer] = u8Tx;
+		abWritten[u8Pointer] = TRUE;
+		u8Pointer++;
+	}
+
+	if (bTxStop)
+	{
+		sHostSi.u32Transfers++;
+		bInTransfer = FALSE;
+		for (u8Channel = 0; u8Channel < PCA9685_CHANNELS; u8Channel++)
+		{
+			u8Count = 0;
+			for (i = 0; i < PCA9685_STRIDE; i++)
+			{
+				u8Count += abWritten[PCA9685_LED0 + u8Channel * PCA9685_STRIDE + i];
+			}
+			if ((u8Count != 0) && (u8Count != PCA9685_STRIDE))
+			{
+				sHostSi.u32TornChannels++;
+			}
+		}
+		memset(abWritten, 0, sizeof(abWritten));
+		memcpy(au8HostPcaOutputs, au8HostPcaRegisters, sizeof(au8HostPcaOutputs));
+	}
+
+	if (bInterruptEnabled)
+	{
+		bHostSiInterrupt = TRUE;
+	}
+	return TRUE;
+}
+
+/****************************************************************************
+ * NAME: u32HostSi_Run
+ *
+ * DESCRIPTION:
+ * Lets the bus run for up to u32MaxBytes bytes, taking the SI interrupt
+ * after each of them as the device would. A pending interrupt is taken
+ * even if u32MaxBytes is 0.
+ *
+ * RETURNS:
+ * Number of bytes sent
+ ****************************************************************************/
+PUBLIC uint32 u32HostSi_Run(uint32 u32MaxBytes)
+{
+	uint32 u32Sent = 0;
+
+	for (;;)
+	{
+		if (bHostSiInterrupt)
+		{
+			bInInterrupt = TRUE;
+			os_vAPP_isrI2C();
+			bInInterrupt = FALSE;
+			if (bHostSiInterrupt)
+			{
+				/* The ISR must clear the interrupt */
+				sHostSi.u32Violations++;
+				bHostSiInterrupt = FALSE;
+			}
+		}
+		if (!bHostSiBusy || (u32Sent == u32MaxBytes))
+		{
+			break;
+		}
+		bHostSi_Byte();
+		u32Sent++;
+	}
+	return u32Sent;
+}
+
+/****************************************************************************
+ * NAME: u64HostSi_BusNs
+ *
+ * DESCRIPTION:
+ * Time the bus has been busy since the statistics in psFrom were taken
+ ****************************************************************************/
+PUBLIC uint64 u64HostSi_BusNs(const tsHostSi *psFrom)
+{
+	uint64 u64Bits;
+
+	u64Bits  = (uint64)(sHostSi.u32Bytes - psFrom->u32Bytes) * 9;
+	u64Bits += sHostSi.u32Starts - psFrom->u32Starts;
+	u64Bits += sHostSi.u32Transfers - psFrom->u32Transfers;
+	return u64Bits * HOST_SI_BIT_NS;
+}
+
+/* The SI master calls from AppHardwareApi.h */
+
+PUBLIC void vAHI_SiMasterConfigure(bool_t bPulseSuppressionEnable, bool_t bInterruptEnable,
+                                   uint16 u16PreScaler)
+{
+	bInterruptEnabled = bInterruptEnable;
+}
+
+PUBLIC void vAHI_SiMasterWriteSlaveAddr(uint8 u8SlaveAddress, bool_t bReadNotWrite)
+{
+	u8Tx = (u8SlaveAddress << 1) | (bReadNotWrite ? 1 : 0);
+}
+
+PUBLIC void vAHI_SiMasterWriteData8(uint8 u8Out)
+{
+	u8Tx = u8Out;
+}
+
+PUBLIC bool_t bAHI_SiMasterSetCmdReg(bool_t bSetSTA, bool_t bSetSTO, bool_t bSetRD, bool_t bSetWR,
+                                     bool_t bSetAckCtrl, bool_t bSetIACK)
+{
+	if (bSetIACK)
+	{
+		bHostSiInterrupt = FALSE;
+	}
+	if (!bSetWR)
+	{
+		/* Only clearing the interrupt is expected without a write */
+		if (bSetSTA || bSetSTO || bSetRD)
+		{
+			sHostSi.u32Violations++;
+		}
+		return TRUE;
+	}
+	if (bHostSiBusy)
+	{
+		/* Transmit register overwritten while a byte is going out */
+		sHostSi.u32Violations++;
+	}
+	if (bSetSTA)
+	{
+		sHostSi.u32Starts++;
+		if (u8Tx != (PCA9685_ADDRESS << 1))
+		{
+			sHostSi.u32Violations++;
+		}
+		bInTransfer = TRUE;
+		bWantRegister = TRUE;
+	}
+	else if (!bInTransfer)
+	{
+		/* Data without a START */
+		sHostSi.u32Violations++;
+	}
+	bTxStart = bSetSTA;
+	bTxStop = bSetSTO;
+	bHostSiBusy = TRUE;
+	if (bHostSiInstant && !bInInterrupt)
+	{
+		/* The byte goes and the interrupt is taken before the caller's
+		 * next instruction, and the bus runs to the end of the queue */
+		bHostSi_Byte();
+		u32HostSi_Run(HOST_SI_ALL);
+	}
+	return TRUE;
+}
+
+PUBLIC bool_t bAHI_SiMasterPollTransferInProgress(void)
+{
+	sHostSi.u32Polls++;
+	bHostSi_Byte();
+	return FALSE;
+}
+
+PUBLIC bool_t bAHI_SiMasterCheckRxNack(void)
+{
+	return bLastNack;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,108 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          HostSi.h
+ *
+ * DESCRIPTION:        Host build: SI master and PCA9685 model - Interface
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+#ifndef HOST_SI_H
+#define HOST_SI_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <jendefs.h>
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Length of one bit on the bus at 400kHz, in ns. A byte is 9 bits with its
+ * ACK, and START and STOP take about one bit each. */
+#define HOST_SI_BIT_NS			(2500)
+
+/* Makes u32HostSi_Run send everything that is queued */
+#define HOST_SI_ALL				(0xffffffffUL)
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/* Bus traffic, and the mistakes the model has caught */
+typedef struct
+{
+	uint32 u32Transfers;		/* Transfers ended by a STOP */
+	uint32 u32Starts;			/* STARTs, repeated STARTs included */
+	uint32 u32Bytes;			/* Bytes sent, address bytes included */
+	uint32 u32Polls;			/* bAHI_SiMasterPollTransferInProgress calls */
+	uint32 u32Violations;		/* Commands the SI master can't carry out */
+	uint32 u32TornChannels;		/* Channels left part written at a STOP */
+} tsHostSi;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+PUBLIC bool_t bHostSi_Byte(void);
+PUBLIC uint32 u32HostSi_Run(uint32 u32MaxBytes);
+PUBLIC uint64 u64HostSi_BusNs(const tsHostSi *psFrom);
+
+/****************************************************************************/
+/***        External Variables                                            ***/
+/****************************************************************************/
+
+extern tsHostSi sHostSi;
+
+/* PCA9685 registers as written, and its outputs as latched at the last
+ * STOP */
+extern uint8 au8HostPcaRegisters[256];
+extern uint8 au8HostPcaOutputs[256];
+
+/* Number of bytes from now on which the PCA9685 won't acknowledge */
+extern uint32 u32HostSiNacks;
+
+/* A byte is being sent, and the SI interrupt is pending */
+extern bool_t bHostSiBusy;
+extern bool_t bHostSiInterrupt;
+
+/* Makes a byte started outside the SI interrupt go at once, with the
+ * interrupt taken straight after the bAHI_SiMasterSetCmdReg call */
+extern bool_t bHostSiInstant;
+
+#endif /* HOST_SI_H */
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,549 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          HostStubs.c
+ *
+ * DESCRIPTION:        Host build: SDK stubs and test helpers - Implementation
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <string.h>
+#include <time.h>
+#include <jendefs.h>
+#include <AppHardwareApi.h>
+#include "PeripheralRegs_JN5168.h"
+#include "PDM.h"
+#include "os.h"
+#include "os_gen.h"
+#include "app_temp_sensor.h"
+#include "app_zcl_light_task.h"
+#include "HostStubs.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Bytes the UART model can hold which the firmware hasn't read yet */
+#define HOST_UART_RX_SIZE		(8192)
+
+/* Line status reads after which a byte being shifted out is taken to have
+ * gone, so that a loop waiting for TEMT ends */
+#define HOST_UART_TEMT_POLLS	(1000)
+
+/* Clock the UART baud rate is divided down from */
+#define HOST_UART_CLOCK			(16000000UL)
+
+/* Largest number of PDM records, and the largest record */
+#define HOST_PDM_RECORDS		(16)
+#define HOST_PDM_RECORD_SIZE	(2048)
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef struct
+{
+	uint16 u16Id;
+	uint16 u16Length;
+	uint8 au8Data[HOST_PDM_RECORD_SIZE];
+} tsHostPdmRecord;
+
+/****************************************************************************/
+/*          Exported Variables                                              */
+/****************************************************************************/
+
+PUBLIC uint32 u32HostFailures;
+PUBLIC uint32 u32HostTickTimer;
+PUBLIC uint32 u32HostSerialActivations;
+PUBLIC uint32 u32HostTimerPeriod;
+PUBLIC uint32 u32HostTimerArmed;
+PUBLIC uint32 u32HostTimerStarts;
+PUBLIC int16 i16HostTemperature = 25;
+
+/* Handles from os_gen.h. The tests only compare them. */
+PUBLIC OS_thTask APP_SerialTask = (OS_thTask)&APP_SerialTask;
+PUBLIC OS_thSWTimer APP_TickTimer = (OS_thSWTimer)&APP_TickTimer;
+
+/* Defined by app_temp_sensor.c and app_zcl_light_task.c on the device.
+ * Programs which build app_temp_sensor.c define HOST_REAL_TEMP_SENSOR. */
+#ifndef HOST_REAL_TEMP_SENSOR
+PUBLIC volatile bool_t bOverheat;
+PUBLIC volatile uint32 u32TS_Derating = TS_DERATING_ONE;
+#endif
+PUBLIC uint32 u32TickOverruns;
+PUBLIC uint32 u32TickMaxLate;
+
+PUBLIC uint8 au8HostUartTx[HOST_UART_TX_SIZE];
+PUBLIC uint32 au32HostUartTxBaud[HOST_UART_TX_SIZE];
+PUBLIC uint32 u32HostUartTxLength;
+PUBLIC bool_t bHostUartTxInterrupt;
+PUBLIC uint32 u32HostUartTemtPolls;
+
+PUBLIC uint16 u16HostAdcReading;
+PUBLIC bool_t bHostAdcRunning;
+PUBLIC uint32 u32HostAnaIntStatus;
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+PRIVATE tsHostPdmRecord asHostPdm[HOST_PDM_RECORDS];
+PRIVATE uint8 u8HostPdmRecords;
+PRIVATE uint32 u32HostRandom = 1;
+PRIVATE uint8 au8HostUartRx[HOST_UART_RX_SIZE];
+PRIVATE uint32 u32HostUartRxHead;
+PRIVATE uint32 u32HostUartRxTail;
+PRIVATE uint16 u16HostUartRxFifoSize;
+PRIVATE uint16 u16HostUartRxFifo;
+PRIVATE bool_t bHostUartBreak;
+PRIVATE uint8 au8HostUartTxFifo[256];
+PRIVATE uint16 u16HostUartTxFifoSize;
+PRIVATE uint16 u16HostUartTxFifo;
+/* Byte being shifted out, and the baud rate it started at (0 once the
+ * rate has changed under it) */
+PRIVATE bool_t bHostUartShifting;
+PRIVATE uint8 u8HostUartShift;
+PRIVATE uint32 u32HostUartShiftBaud;
+/* TX FIFO empty interrupt waiting to be acknowledged */
+PRIVATE bool_t bHostUartTxEmpty;
+PRIVATE uint32 u32HostUartTemtWait;
+PRIVATE uint8 u8HostUartClocksPerBit;
+PRIVATE uint16 u16HostUartDivisor;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: u64Host_TimeNs
+ *
+ * DESCRIPTION:
+ * Monotonic host time in ns, for the benchmarks
+ ****************************************************************************/
+PUBLIC uint64 u64Host_TimeNs(void)
+{
+	struct timespec sNow;
+
+	clock_gettime(CLOCK_MONOTONIC, &sNow);
+	return (uint64)sNow.tv_sec * 1000000000ULL + (uint64)sNow.tv_nsec;
+}
+
+/****************************************************************************
+ * NAME: u32Host_Random
+ *
+ * DESCRIPTION:
+ * Repeatable pseudo random numbers (xorshift32), so a failing run can be
+ * reproduced from its seed
+ ****************************************************************************/
+PUBLIC uint32 u32Host_Random(void)
+{
+	u32HostRandom ^= u32HostRandom << 13;
+	u32HostRandom ^= u32HostRandom >> 17;
+	u32HostRandom ^= u32HostRandom << 5;
+	return u32HostRandom;
+}
+
+PUBLIC void vHost_Seed(uint32 u32Seed)
+{
+	u32HostRandom = (u32Seed != 0) ? u32Seed : 1;
+}
+
+/****************************************************************************
+ * NAME: iHost_Result
+ *
+ * DESCRIPTION:
+ * Prints the outcome of a test program and returns its exit status
+ ****************************************************************************/
+PUBLIC int iHost_Result(const char *pcName)
+{
+	if (u32HostFailures != 0)
+	{
+		printf("%s: %u checks FAILED\n", pcName, u32HostFailures);
+		return 1;
+	}
+	printf("%s: passed\n", pcName);
+	return 0;
+}
+
+/* PDM, kept in RAM. Nothing is stored until a test saves it. */
+
+PUBLIC PDM_teStatus PDM_eReadDataFromRecord(uint16 u16IdValue, void *pvDataBuffer,
+                                            uint16 u16DataBufferLength, uint16 *pu16DataBytesRead)
+{
+	uint8 i;
+
+	*pu16DataBytesRead = 0;
+	for (i = 0; i < u8HostPdmRecords; i++)
+	{
+		if (asHostPdm[i].u16Id == u16IdValue)
+		{
+			*pu16DataBytesRead = MIN(u16DataBufferLength, asHostPdm[i].u16Length);
+			memcpy(pvDataBuffer, asHostPdm[i].au8Data, *pu16DataBytesRead);
+			return PDM_E_STATUS_OK;
+		}
+	}
+	return PDM_E_STATUS_INVLD_PARAM;
+}
+
+PUBLIC PDM_teStatus PDM_eSaveRecordData(uint16 u16IdValue, void *pvDataBuffer, uint16 u16Datalength)
+{
+	uint8 i;
+
+	if (u16Datalength > HOST_PDM_RECORD_SIZE)
+	{
+		return PDM_E_STATUS_INVLD_PARAM;
+	}
+	for (i = 0; (i < u8HostPdmRecords) && (asHostPdm[i].u16Id != u16IdValue); i++);
+	if (i == u8HostPdmRecords)
+	{
+		if (u8HostPdmRecords == HOST_PDM_RECORDS)
+		{
+			return PDM_E_STATUS_PDM_FULL;
+		}
+		u8HostPdmRecords++;
+	}
+	asHostPdm[i].u16Id = u16IdValue;
+	asHostPdm[i].u16Length = u16Datalength;
+	memcpy(asHostPdm[i].au8Data, pvDataBuffer, u16Datalength);
+	return PDM_E_STATUS_OK;
+}
+
+/* OS */
+
+PUBLIC OS_teStatus OS_eActivateTask(OS_thTask hTask)
+{
+	if (hTask == APP_SerialTask)
+	{
+		u32HostSerialActivations++;
+	}
+	return OS_E_OK;
+}
+
+PUBLIC OS_teStatus OS_eStartSWTimer(OS_thSWTimer hSWTimer, uint32 u32Ticks, void *pvData)
+{
+	u32HostTimerPeriod = u32Ticks;
+	u32HostTimerArmed++;
+	u32HostTimerStarts++;
+	return OS_E_OK;
+}
+
+PUBLIC OS_teStatus OS_eContinueSWTimer(OS_thSWTimer hSWTimer, uint32 u32Ticks, void *pvData)
+{
+	u32HostTimerPeriod = u32Ticks;
+	u32HostTimerArmed++;
+	return OS_E_OK;
+}
+
+PUBLIC OS_teStatus OS_eStopSWTimer(OS_thSWTimer hSWTimer)
+{
+	return OS_E_OK;
+}
+
+PUBLIC OS_teStatus OS_eGetSWTimerStatus(OS_thSWTimer hSWTimer)
+{
+	return OS_E_SWTIMER_STOPPED;
+}
+
+PUBLIC uint32 u32AHI_TickTimerRead(void)
+{
+	return u32HostTickTimer;
+}
+
+PUBLIC void vAHI_SwReset(void)
+{
+}
+
+/* Timers and DIO. Only the PCA9685 driver's indicator LED and the TimerPWM
+ * driver's outputs use them, which nothing checks. */
+
+PUBLIC void vAHI_TimerEnable(uint8 u8Timer, uint8 u8Prescale, bool_t bIntRiseEnable,
+                             bool_t bIntPeriodEnable, bool_t bOutputEnable) {}
+PUBLIC void vAHI_TimerConfigureOutputs(uint8 u8Timer, bool_t bInvertPwmOutput, bool_t bGateDisable) {}
+PUBLIC void vAHI_TimerDIOControl(uint8 u8Timer, bool_t bDioEnable) {}
+PUBLIC void vAHI_TimerStartRepeat(uint8 u8Timer, uint16 u16Hi, uint16 u16Lo) {}
+PUBLIC uint8 u8AHI_TimerFired(uint8 u8Timer) { return 0; }
+PUBLIC void vAHI_DioSetDirection(uint32 u32Inputs, uint32 u32Outputs) {}
+PUBLIC void vAHI_DioSetOutput(uint32 u32On, uint32 u32Off) {}
+
+/* Defined by app_zcl_light_task.c on the device. test_tick, which defines
+ * HOST_TICK_TASK, builds the real one with Tick_Task. */
+
+#ifndef HOST_TICK_TASK
+PUBLIC void APP_ZCL_vWakeTick(void) {}
+#endif
+
+/* Temperature sensor, without the ADC */
+
+#ifndef HOST_REAL_TEMP_SENSOR
+PUBLIC int16 i16TS_GetTemperature(void)
+{
+	return i16HostTemperature;
+}
+
+PUBLIC bool_t bTS_UpdateDerating(void)
+{
+	return FALSE;
+}
+#endif
+
+/* ADC. vHost_AdcComplete ends the accumulation which was started last,
+ * with the given reading, and raises its interrupt; the test then calls
+ * the ISR itself. The analogue interrupt status is cleared by writing 1s. */
+
+PUBLIC bool_t bHost_AdcComplete(uint16 u16Reading)
+{
+	if (!bHostAdcRunning)
+	{
+		return FALSE;
+	}
+	u16HostAdcReading = u16Reading;
+	bHostAdcRunning = FALSE;
+	u32HostAnaIntStatus |= HOST_ANA_INT_ADC;
+	return TRUE;
+}
+
+PUBLIC void vAHI_ApConfigure(bool_t bAPRegulator, bool_t bIntEnable, uint8 u8SampleSelect,
+                             uint8 u8ClockDivRatio, bool_t bRefSelect) {}
+PUBLIC bool_t bAHI_APRegulatorEnabled(void) { return TRUE; }
+PUBLIC void vAHI_AdcEnable(bool_t bContinuous, bool_t bInputRange, uint8 u8Source) {}
+
+PUBLIC void vAHI_AdcStartAccumulateSamples(uint8 u8AccSamples)
+{
+	bHostAdcRunning = TRUE;
+}
+
+PUBLIC uint16 u16AHI_AdcRead(void)
+{
+	return u16HostAdcReading;
+}
+
+PUBLIC uint32 u32REG_AnaRead(uint32 u32Index)
+{
+	return (u32Index == REG_ANPER_IS) ? u32HostAnaIntStatus : 0;
+}
+
+PUBLIC void vREG_AnaWrite(uint32 u32Index, uint32 u32Value)
+{
+	if (u32Index == REG_ANPER_IS)
+	{
+		u32HostAnaIntStatus &= ~u32Value;
+	}
+}
+
+/* UART. Received bytes wait in au8HostUartRx until vHost_UartFillRxFifo
+ * moves them into the FIFO, up to the size of the firmware's RX buffer, as
+ * if they had arrived since the last interrupt. Bytes written go into a TX
+ * FIFO of the size of the firmware's TX buffer, and from there through the
+ * shift register into au8HostUartTx, one for each vHost_UartSendCharacter
+ * call. As on the JN5168, the TX FIFO empty interrupt is raised when the
+ * last byte leaves the FIFO, or when it is enabled while the FIFO is empty,
+ * and stays raised until the interrupt status is read. */
+
+PUBLIC void vHost_UartReceive(const uint8 *pu8Data, uint32 u32Length)
+{
+	while ((u32Length > 0) && (u32HostUartRxHead - u32HostUartRxTail < HOST_UART_RX_SIZE))
+	{
+		au8HostUartRx[u32HostUartRxHead++ % HOST_UART_RX_SIZE] = *pu8Data++;
+		u32Length--;
+	}
+}
+
+PUBLIC uint16 u16Host_UartFillRxFifo(void)
+{
+	u16HostUartRxFifo = (uint16)MIN(u32HostUartRxHead - u32HostUartRxTail, u16HostUartRxFifoSize);
+	return u16HostUartRxFifo;
+}
+
+PUBLIC void vHost_UartBreak(void)
+{
+	bHostUartBreak = TRUE;
+}
+
+PUBLIC bool_t bHost_UartInterrupt(void)
+{
+	return (u16HostUartRxFifo > 0) || bHostUartBreak || (bHostUartTxInterrupt && bHostUartTxEmpty);
+}
+
+PUBLIC uint32 u32Host_UartBaudRate(void)
+{
+	if (u16HostUartDivisor == 0)
+	{
+		return 0;
+	}
+	return HOST_UART_CLOCK / ((u8HostUartClocksPerBit + 1UL) * u16HostUartDivisor);
+}
+
+PUBLIC bool_t bHost_UartSendCharacter(void)
+{
+	bool_t bSent = bHostUartShifting;
+
+	u32HostUartTemtWait = 0;
+	if (bHostUartShifting)
+	{
+		if (u32HostUartTxLength < HOST_UART_TX_SIZE)
+		{
+			au8HostUartTx[u32HostUartTxLength] = u8HostUartShift;
+			au32HostUartTxBaud[u32HostUartTxLength] = u32HostUartShiftBaud;
+		}
+		u32HostUartTxLength++;
+		bHostUartShifting = FALSE;
+	}
+	if (u16HostUartTxFifo > 0)
+	{
+		u8HostUartShift = au8HostUartTxFifo[0];
+		u32HostUartShiftBaud = u32Host_UartBaudRate();
+		bHostUartShifting = TRUE;
+		u16HostUartTxFifo--;
+		memmove(au8HostUartTxFifo, &au8HostUartTxFifo[1], u16HostUartTxFifo);
+		if (u16HostUartTxFifo == 0)
+		{
+			bHostUartTxEmpty = TRUE;
+		}
+		bSent = TRUE;
+	}
+	return bSent;
+}
+
+PUBLIC void vAHI_UartSetLocation(uint8 u8Uart, bool_t bLocation) {}
+
+PUBLIC bool_t bAHI_UartEnable(uint8 u8Uart, uint8 *pu8TxBuffer, uint16 u16TxBufferLength,
+                              uint8 *pu8RxBuffer, uint16 u16RxBufferLength)
+{
+	u16HostUartTxFifoSize = (uint16)MIN(u16TxBufferLength, sizeof(au8HostUartTxFifo));
+	u16HostUartRxFifoSize = u16RxBufferLength;
+	return TRUE;
+}
+
+PUBLIC void vAHI_UartSetControl(uint8 u8Uart, bool_t bEvenParity, bool_t bEnableParity,
+                                uint8 u8WordLength, bool_t bOneStopBit, bool_t bRtsValue) {}
+PUBLIC void vAHI_UartSetRTSCTS(uint8 u8Uart, bool_t bRtsCts) {}
+PUBLIC void vAHI_UartSetAutoFlowCtrl(uint8 u8Uart, uint8 u8RxFifoLevel, bool_t bFlowCtrlPolarity,
+                                     bool_t bAutoRts, bool_t bAutoCts) {}
+
+PUBLIC void vAHI_UartSetInterrupt(uint8 u8Uart, bool_t bEnableModemStatus, bool_t bEnableRxLineStatus,
+                                  bool_t bEnableTxFifoEmpty, bool_t bEnableRxData, uint8 u8FifoLevel)
+{
+	bHostUartTxInterrupt = bEnableTxFifoEmpty;
+	if (bEnableTxFifoEmpty && (u16HostUartTxFifo == 0))
+	{
+		bHostUartTxEmpty = TRUE;
+	}
+}
+
+/* Changing the baud rate garbles the byte being shifted out */
+PUBLIC void vAHI_UartSetClocksPerBit(uint8 u8Uart, uint8 u8Cpb)
+{
+	u8HostUartClocksPerBit = u8Cpb;
+	u32HostUartShiftBaud = 0;
+}
+
+PUBLIC void vAHI_UartSetBaudDivisor(uint8 u8Uart, uint16 u16Divisor)
+{
+	u16HostUartDivisor = u16Divisor;
+	u32HostUartShiftBaud = 0;
+}
+
+PUBLIC uint16 u16AHI_UartReadRxFifoLevel(uint8 u8Uart)
+{
+	return u16HostUartRxFifo;
+}
+
+PUBLIC uint16 u16AHI_UartReadTxFifoLevel(uint8 u8Uart)
+{
+	return u16HostUartTxFifo;
+}
+
+PUBLIC uint8 u8AHI_UartReadData(uint8 u8Uart)
+{
+	if (u16HostUartRxFifo == 0)
+	{
+		return 0;
+	}
+	u16HostUartRxFifo--;
+	return au8HostUartRx[u32HostUartRxTail++ % HOST_UART_RX_SIZE];
+}
+
+/* A byte written while the shift register is idle goes straight into it */
+PUBLIC void vAHI_UartWriteData(uint8 u8Uart, uint8 u8Data)
+{
+	if (u16HostUartTxFifo < u16HostUartTxFifoSize)
+	{
+		au8HostUartTxFifo[u16HostUartTxFifo++] = u8Data;
+	}
+	bHostUartTxEmpty = FALSE;
+	if (!bHostUartShifting)
+	{
+		(void)bHost_UartSendCharacter();
+	}
+}
+
+PUBLIC uint8 u8AHI_UartReadInterruptStatus(uint8 u8Uart)
+{
+	bHostUartTxEmpty = FALSE;
+	return 0;
+}
+
+PUBLIC uint8 u8AHI_UartReadLineStatus(uint8 u8Uart)
+{
+	uint8 u8Status = 0;
+
+	if (bHostUartBreak)
+	{
+		u8Status |= E_AHI_UART_LS_BI;
+		bHostUartBreak = FALSE;
+	}
+	if (u16HostUartTxFifo == 0)
+	{
+		u8Status |= E_AHI_UART_LS_THRE;
+		if (bHostUartShifting)
+		{
+			u32HostUartTemtPolls++;
+			if (++u32HostUartTemtWait >= HOST_UART_TEMT_POLLS)
+			{
+				(void)bHost_UartSendCharacter();
+			}
+		}
+		if (!bHostUartShifting)
+		{
+			u8Status |= E_AHI_UART_LS_TEMT;
+		}
+	}
+	return u8Status;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
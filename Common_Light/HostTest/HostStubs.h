@@ -0,0 +1,136 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          HostStubs.h
+ *
+ * DESCRIPTION:        Host build: SDK stubs and test helpers - Interface
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+#ifndef HOST_STUBS_H
+#define HOST_STUBS_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <jendefs.h>
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Counts a failed check and carries on, so that one run reports every
+ * failure. Test programs return u32HostFailures != 0. */
+#define HOST_CHECK(bCondition, ...)											\
+	do																		\
+	{																		\
+		if (!(bCondition))													\
+		{																	\
+			printf("FAIL %s:%d: ", __FILE__, __LINE__);						\
+			printf(__VA_ARGS__);											\
+			printf("\n");													\
+			u32HostFailures++;												\
+		}																	\
+	} while (0)
+
+/* Size of au8HostUartTx */
+#define HOST_UART_TX_SIZE		(8192)
+
+/* Bit of the analogue peripheral interrupt status raised by the ADC */
+#define HOST_ANA_INT_ADC		(0x01)
+
+/* Tick timer counts per ms, as on the JN5168 (16MHz) */
+#define HOST_TICKS_PER_MS		(16000UL)
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+PUBLIC uint64 u64Host_TimeNs(void);
+PUBLIC uint32 u32Host_Random(void);
+PUBLIC void vHost_Seed(uint32 u32Seed);
+PUBLIC int iHost_Result(const char *pcName);
+PUBLIC void vHost_UartReceive(const uint8 *pu8Data, uint32 u32Length);
+PUBLIC uint16 u16Host_UartFillRxFifo(void);
+PUBLIC void vHost_UartBreak(void);
+PUBLIC bool_t bHost_UartInterrupt(void);
+PUBLIC bool_t bHost_UartSendCharacter(void);
+PUBLIC uint32 u32Host_UartBaudRate(void);
+PUBLIC bool_t bHost_AdcComplete(uint16 u16Reading);
+
+/****************************************************************************/
+/***        External Variables                                            ***/
+/****************************************************************************/
+
+extern uint32 u32HostFailures;
+
+/* Tick timer, in 16MHz counts. Tests move this on themselves. */
+extern uint32 u32HostTickTimer;
+
+/* Number of OS_eActivateTask calls for APP_SerialTask, and the period of
+ * the last OS_eStartSWTimer or OS_eContinueSWTimer call, in ticks */
+extern uint32 u32HostSerialActivations;
+extern uint32 u32HostTimerPeriod;
+extern uint32 u32HostTimerArmed;
+
+/* Number of OS_eStartSWTimer calls, which arm a timer from now rather than
+ * from its last expiry */
+extern uint32 u32HostTimerStarts;
+
+/* Bytes the UART has sent, the baud rate each was sent at (0 if the rate
+ * changed while it was being sent), how many (counting any which didn't
+ * fit), and whether the TX FIFO empty interrupt is enabled */
+extern uint8 au8HostUartTx[HOST_UART_TX_SIZE];
+extern uint32 au32HostUartTxBaud[HOST_UART_TX_SIZE];
+extern uint32 u32HostUartTxLength;
+extern bool_t bHostUartTxInterrupt;
+
+/* Line status reads which found the TX FIFO empty, but the last byte still
+ * being shifted out */
+extern uint32 u32HostUartTemtPolls;
+
+/* Board temperature returned by i16TS_GetTemperature */
+extern int16 i16HostTemperature;
+
+/* Reading returned by u16AHI_AdcRead, whether an accumulation has been
+ * started and not completed, and the analogue peripheral interrupt status */
+extern uint16 u16HostAdcReading;
+extern bool_t bHostAdcRunning;
+extern uint32 u32HostAnaIntStatus;
+
+#endif /* HOST_STUBS_H */
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
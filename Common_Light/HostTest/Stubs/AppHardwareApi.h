@@ -0,0 +1,145 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          AppHardwareApi.h
+ *
+ * DESCRIPTION:        Host build stand-in for an SDK header
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Stand-in for the SDK's AppHardwareApi.h, declaring only what the light
+ * modules use. The functions are implemented by HostStubs.c and HostSi.c. */
+
+#ifndef APPHARDWAREAPI_H_INCLUDED
+#define APPHARDWAREAPI_H_INCLUDED
+
+#include <jendefs.h>
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define E_AHI_UART_0					(0)
+#define E_AHI_UART_EVEN_PARITY			(TRUE)
+#define E_AHI_UART_PARITY_DISABLE		(FALSE)
+#define E_AHI_UART_WORD_LEN_8			(3)
+#define E_AHI_UART_1_STOP_BIT			(TRUE)
+#define E_AHI_UART_RTS_LOW				(FALSE)
+#define E_AHI_UART_FIFO_ARTS_LEVEL_8	(0)
+#define E_AHI_UART_FIFO_LEVEL_1			(0)
+#define E_AHI_UART_FIFO_LEVEL_8			(2)
+
+/* Line status bits */
+#define E_AHI_UART_LS_DR				(0x01)
+#define E_AHI_UART_LS_BI				(0x10)
+#define E_AHI_UART_LS_THRE				(0x20)
+#define E_AHI_UART_LS_TEMT				(0x40)
+#define E_AHI_UART_LS_ERROR				(0x80)
+
+#define E_AHI_TIMER_0					(0)
+#define E_AHI_TIMER_1					(1)
+#define E_AHI_TIMER_2					(2)
+#define E_AHI_TIMER_3					(3)
+#define E_AHI_TIMER_4					(4)
+
+/* Analogue peripherals */
+#define E_AHI_AP_REGULATOR_ENABLE		(TRUE)
+#define E_AHI_AP_INT_ENABLE				(TRUE)
+#define E_AHI_AP_SAMPLE_8				(3)
+#define E_AHI_AP_CLOCKDIV_500KHZ		(2)
+#define E_AHI_AP_INTREF					(TRUE)
+#define E_AHI_AP_INPUT_RANGE_2			(FALSE)
+#define E_AHI_ADC_CONTINUOUS			(TRUE)
+#define E_AHI_ADC_SRC_ADC_1				(0)
+#define E_AHI_ADC_ACC_SAMPLE_16			(3)
+
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/* UART */
+PUBLIC void vAHI_UartSetLocation(uint8 u8Uart, bool_t bLocation);
+PUBLIC bool_t bAHI_UartEnable(uint8 u8Uart, uint8 *pu8TxBuffer, uint16 u16TxBufferLength,
+                              uint8 *pu8RxBuffer, uint16 u16RxBufferLength);
+PUBLIC void vAHI_UartSetControl(uint8 u8Uart, bool_t bEvenParity, bool_t bEnableParity,
+                                uint8 u8WordLength, bool_t bOneStopBit, bool_t bRtsValue);
+PUBLIC void vAHI_UartSetRTSCTS(uint8 u8Uart, bool_t bRtsCts);
+PUBLIC void vAHI_UartSetAutoFlowCtrl(uint8 u8Uart, uint8 u8RxFifoLevel, bool_t bFlowCtrlPolarity,
+                                     bool_t bAutoRts, bool_t bAutoCts);
+PUBLIC void vAHI_UartSetInterrupt(uint8 u8Uart, bool_t bEnableModemStatus, bool_t bEnableRxLineStatus,
+                                  bool_t bEnableTxFifoEmpty, bool_t bEnableRxData, uint8 u8FifoLevel);
+PUBLIC void vAHI_UartSetClocksPerBit(uint8 u8Uart, uint8 u8Cpb);
+PUBLIC void vAHI_UartSetBaudDivisor(uint8 u8Uart, uint16 u16Divisor);
+PUBLIC uint16 u16AHI_UartReadRxFifoLevel(uint8 u8Uart);
+PUBLIC uint16 u16AHI_UartReadTxFifoLevel(uint8 u8Uart);
+PUBLIC uint8 u8AHI_UartReadData(uint8 u8Uart);
+PUBLIC void vAHI_UartWriteData(uint8 u8Uart, uint8 u8Data);
+PUBLIC uint8 u8AHI_UartReadInterruptStatus(uint8 u8Uart);
+PUBLIC uint8 u8AHI_UartReadLineStatus(uint8 u8Uart);
+
+/* Serial interface master */
+PUBLIC void vAHI_SiMasterConfigure(bool_t bPulseSuppressionEnable, bool_t bInterruptEnable,
+                                   uint16 u16PreScaler);
+PUBLIC void vAHI_SiMasterWriteSlaveAddr(uint8 u8SlaveAddress, bool_t bReadNotWrite);
+PUBLIC void vAHI_SiMasterWriteData8(uint8 u8Out);
+PUBLIC bool_t bAHI_SiMasterSetCmdReg(bool_t bSetSTA, bool_t bSetSTO, bool_t bSetRD, bool_t bSetWR,
+                                     bool_t bSetAckCtrl, bool_t bSetIACK);
+PUBLIC bool_t bAHI_SiMasterPollTransferInProgress(void);
+PUBLIC bool_t bAHI_SiMasterCheckRxNack(void);
+
+/* Analogue peripherals */
+PUBLIC void vAHI_ApConfigure(bool_t bAPRegulator, bool_t bIntEnable, uint8 u8SampleSelect,
+                             uint8 u8ClockDivRatio, bool_t bRefSelect);
+PUBLIC bool_t bAHI_APRegulatorEnabled(void);
+PUBLIC void vAHI_AdcEnable(bool_t bContinuous, bool_t bInputRange, uint8 u8Source);
+PUBLIC void vAHI_AdcStartAccumulateSamples(uint8 u8AccSamples);
+PUBLIC uint16 u16AHI_AdcRead(void);
+
+/* Timers, DIO and system */
+PUBLIC void vAHI_TimerEnable(uint8 u8Timer, uint8 u8Prescale, bool_t bIntRiseEnable,
+                             bool_t bIntPeriodEnable, bool_t bOutputEnable);
+PUBLIC void vAHI_TimerConfigureOutputs(uint8 u8Timer, bool_t bInvertPwmOutput, bool_t bGateDisable);
+PUBLIC void vAHI_TimerDIOControl(uint8 u8Timer, bool_t bDioEnable);
+PUBLIC void vAHI_TimerStartRepeat(uint8 u8Timer, uint16 u16Hi, uint16 u16Lo);
+PUBLIC uint8 u8AHI_TimerFired(uint8 u8Timer);
+PUBLIC void vAHI_DioSetDirection(uint32 u32Inputs, uint32 u32Outputs);
+PUBLIC void vAHI_DioSetOutput(uint32 u32On, uint32 u32Off);
+PUBLIC uint32 u32AHI_TickTimerRead(void);
+PUBLIC void vAHI_SwReset(void);
+
+#endif /* APPHARDWAREAPI_H_INCLUDED */
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,135 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          bench_colourspace.c
+ *
+ * DESCRIPTION:        Host benchmark of the colour space conversions
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Measures the cost of the colour space conversions. vCS_XYToRGB runs on
+ * every tick for bulbs fading in xy, vCS_RGBToXY once per transition, and
+ * vLC_CorrectColour on every driver update of an RGB bulb. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <jendefs.h>
+#include "app_light_colourspace.h"
+#include "app_light_calibration.h"
+#include "App_MultiLight.h"
+#include "HostStubs.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define BENCH_COLOURS			(4096)
+#define BENCH_ROUNDS			(500)
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+PRIVATE uint32 au32Rgb[BENCH_COLOURS][3];
+PRIVATE uint32 au32Xy[BENCH_COLOURS][3];
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+int main(void)
+{
+	volatile uint32 u32Sink = 0;
+	uint32 u32Red, u32Green, u32Blue;
+	uint64 u64Start;
+	double dRGBToXY, dXYToRGB, dCorrect;
+	uint32 i, j;
+
+	vHost_Seed(7);
+	for (i = 0; i < BENCH_COLOURS; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			au32Rgb[i][j] = u32Host_Random() & 0xffff;
+		}
+	}
+
+	u64Start = u64Host_TimeNs();
+	for (j = 0; j < BENCH_ROUNDS; j++)
+	{
+		for (i = 0; i < BENCH_COLOURS; i++)
+		{
+			vCS_RGBToXY(au32Rgb[i][0], au32Rgb[i][1], au32Rgb[i][2], &au32Xy[i][0], &au32Xy[i][1], &au32Xy[i][2]);
+		}
+	}
+	dRGBToXY = (double)(u64Host_TimeNs() - u64Start) / (BENCH_ROUNDS * BENCH_COLOURS);
+
+	u64Start = u64Host_TimeNs();
+	for (j = 0; j < BENCH_ROUNDS; j++)
+	{
+		for (i = 0; i < BENCH_COLOURS; i++)
+		{
+			vCS_XYToRGB(au32Xy[i][0], au32Xy[i][1], au32Xy[i][2], &u32Red, &u32Green, &u32Blue);
+			u32Sink += u32Red + u32Green + u32Blue;
+		}
+	}
+	dXYToRGB = (double)(u64Host_TimeNs() - u64Start) / (BENCH_ROUNDS * BENCH_COLOURS);
+
+	/* The matrix is the identity until set, but the cost doesn't depend on
+	 * its entries */
+	vLC_LoadCalibrationFromNVM();
+	u64Start = u64Host_TimeNs();
+	for (j = 0; j < BENCH_ROUNDS; j++)
+	{
+		for (i = 0; i < BENCH_COLOURS; i++)
+		{
+			u32Red = au32Rgb[i][0];
+			u32Green = au32Rgb[i][1];
+			u32Blue = au32Rgb[i][2];
+			vLC_CorrectColour(NUM_MONO_LIGHTS, &u32Red, &u32Green, &u32Blue);
+			u32Sink += u32Red + u32Green + u32Blue;
+		}
+	}
+	dCorrect = (double)(u64Host_TimeNs() - u64Start) / (BENCH_ROUNDS * BENCH_COLOURS);
+
+	printf("vCS_RGBToXY:       %6.1f ns/call\n", dRGBToXY);
+	printf("vCS_XYToRGB:       %6.1f ns/call\n", dXYToRGB);
+	printf("vLC_CorrectColour: %6.1f ns/call\n", dCorrect);
+	return 0;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
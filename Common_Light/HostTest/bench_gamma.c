@@ -0,0 +1,192 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          bench_gamma.c
+ *
+ * DESCRIPTION:        Host benchmark of the gamma path
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Accuracy and cost of the gamma path, u32LC_AdjustIntensity, for every
+ * gamma from 0.2 to 5.0 and every input intensity. Errors are against
+ * pow(), in PWM steps. app_light_calibration.c is included here so that
+ * the gamma of a channel can be set without the serial interface. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <math.h>
+#include <jendefs.h>
+#include "HostStubs.h"
+#include "app_light_calibration.c"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Gammas swept, 0.2 to 5.0 in steps of 0.1, as tenths */
+#define BENCH_GAMMA_MIN			(2)
+#define BENCH_GAMMA_MAX			(50)
+
+/* Times round every intensity for the timing */
+#define BENCH_ROUNDS			(20)
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef struct
+{
+	double dBiggest;
+	double dTotal;
+	uint32 u32Count;
+	uint32 u32BiggestGamma;
+	uint32 u32BiggestIntensity;
+} tsBenchError;
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: vBench_Sweep
+ *
+ * DESCRIPTION:
+ * Adds the errors of every intensity at one gamma to psError. The ideal
+ * output is clamped the same way as u32LC_AdjustIntensity, to one PWM step
+ * at the bottom and full scale at the top.
+ ****************************************************************************/
+PRIVATE void vBench_Sweep(uint32 u32Tenths, tsBenchError *psError)
+{
+	double dGamma;
+	double dIdeal;
+	double dError;
+	uint32 i;
+
+	atsLC_Calibration[0].u16Gamma = (uint16)((u32Tenths * 1024 + 5) / 10);
+#ifndef VARIANT_MINI
+	vLC_UpdateIntensityTable(0);
+#endif
+	dGamma = atsLC_Calibration[0].u16Gamma / 1024.0;
+	for (i = 1; i <= 0xffff; i++)
+	{
+		dIdeal = pow(i / 65535.0, dGamma) * 4095.0;
+		dIdeal = MIN(MAX(dIdeal, 1.0), 4095.0);
+		dError = fabs((double)u32LC_AdjustIntensity((uint16)i, 0) / (1 << LC_PWM_FRAC_BITS) - dIdeal);
+		psError->dTotal += dError;
+		psError->u32Count++;
+		if (dError > psError->dBiggest)
+		{
+			psError->dBiggest = dError;
+			psError->u32BiggestGamma = u32Tenths;
+			psError->u32BiggestIntensity = i;
+		}
+	}
+}
+
+/****************************************************************************
+ * NAME: vBench_Report
+ *
+ * DESCRIPTION:
+ * Prints the errors of a range of gammas
+ ****************************************************************************/
+PRIVATE void vBench_Report(const char *pcName, const tsBenchError *psError)
+{
+	printf("  %-18s biggest error %5.2f PWM steps (gamma %u.%u, intensity %5u), mean %.3f\n",
+			pcName, psError->dBiggest, psError->u32BiggestGamma / 10, psError->u32BiggestGamma % 10,
+			psError->u32BiggestIntensity, psError->dTotal / psError->u32Count);
+}
+
+/****************************************************************************
+ * NAME: dBench_Time
+ *
+ * DESCRIPTION:
+ * ns per u32LC_AdjustIntensity call at one gamma, over every intensity
+ ****************************************************************************/
+PRIVATE double dBench_Time(uint32 u32Tenths)
+{
+	volatile uint32 u32Sink = 0;
+	uint64 u64Start;
+	uint32 i, j;
+
+	atsLC_Calibration[0].u16Gamma = (uint16)((u32Tenths * 1024 + 5) / 10);
+#ifndef VARIANT_MINI
+	vLC_UpdateIntensityTable(0);
+#endif
+	u64Start = u64Host_TimeNs();
+	for (j = 0; j < BENCH_ROUNDS; j++)
+	{
+		for (i = 0; i <= 0xffff; i++)
+		{
+			u32Sink += u32LC_AdjustIntensity((uint16)i, 0);
+		}
+	}
+	return (double)(u64Host_TimeNs() - u64Start) / (BENCH_ROUNDS * 0x10000);
+}
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+int main(void)
+{
+	tsBenchError sLow = { 0 };
+	tsBenchError sHigh = { 0 };
+	uint32 u32Tenths;
+
+	vLC_LoadCalibrationFromNVM();
+	atsLC_Calibration[0].u16Brightness = 1024;
+
+#ifdef VARIANT_MINI
+	printf("u32LC_AdjustIntensity against pow(), direct calculation:\n");
+#else
+	printf("u32LC_AdjustIntensity against pow(), intensity table:\n");
+#endif
+	/* Gammas below 1.0 are steep at the bottom, so they are reported
+	 * separately */
+	for (u32Tenths = BENCH_GAMMA_MIN; u32Tenths <= BENCH_GAMMA_MAX; u32Tenths++)
+	{
+		vBench_Sweep(u32Tenths, (u32Tenths < 10) ? &sLow : &sHigh);
+	}
+	vBench_Report("gamma 0.2 to 0.9", &sLow);
+	vBench_Report("gamma 1.0 to 5.0", &sHigh);
+
+	printf("u32LC_AdjustIntensity: %5.1f ns/call at gamma 0.5, %5.1f at 2.8, %5.1f at 5.0\n",
+			dBench_Time(5), dBench_Time(28), dBench_Time(50));
+	return 0;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,208 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          bench_i2c.c
+ *
+ * DESCRIPTION:        Host build: PCA9685 I2C traffic benchmark
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Counts the I2C traffic to the PCA9685 while bulbs fade, with the real
+ * interpolator and PCA9685 driver running on the SI master model in
+ * HostSi.c. As in App_MultiLight.c, every 100ms update starts the next
+ * 10 tick step of each fading bulb with vLI_Start. The bus is left to run
+ * to the end of the queue after every tick. Then it counts the traffic of
+ * the dither stage alone, with steady bulbs and DriverBulb_vDither called
+ * every tick as Tick_Task does. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <jendefs.h>
+#include "App_MultiLight.h"
+#include "app_light_interpolation.h"
+#include "app_light_calibration.h"
+#include "DriverBulb.h"
+#include "HostStubs.h"
+#include "HostSi.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Simulated length of each measurement, in 100ms updates */
+#define BENCH_UPDATES			(100)
+
+/* Fades change these */
+#define FADE_LEVEL				(1 << 0)
+#define FADE_COLOUR				(1 << 1)
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: vBench_Fade
+ *
+ * DESCRIPTION:
+ * Fades the bulbs with a bit set in u32Bulbs up and down for
+ * BENCH_UPDATES 100ms updates, and prints the I2C traffic per second
+ ****************************************************************************/
+PRIVATE void vBench_Fade(const char *pcName, uint32 u32Bulbs, uint8 u8Fade)
+{
+	tsHostSi sFrom;
+	double dSeconds = BENCH_UPDATES / 10.0;
+	uint32 u32Update;
+	uint32 u32Level;
+	uint32 u32Red;
+	uint8 u8Bulb;
+	uint8 u8Tick;
+
+	for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		DriverBulb_vOn(u8Bulb);
+		vLI_SetCurrentValues(u8Bulb, 128, 255, 128, 0, 0);
+		vLI_UpdateDriver(u8Bulb);
+	}
+	u32HostSi_Run(HOST_SI_ALL);
+
+	sFrom = sHostSi;
+	for (u32Update = 0; u32Update < BENCH_UPDATES; u32Update++)
+	{
+		/* Up and down once a second, through most of the range */
+		u32Level = 20 + (u32Update % 10) * 23;
+		u32Red = 255 - (u32Update % 10) * 25;
+		for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+		{
+			if (u32Bulbs & (1UL << u8Bulb))
+			{
+				vLI_Start(u8Bulb,
+						(u8Fade & FADE_LEVEL) ? u32Level : 128,
+						(u8Fade & FADE_COLOUR) ? u32Red : 255,
+						128,
+						(u8Fade & FADE_COLOUR) ? 255 - u32Red : 0,
+						0);
+			}
+		}
+		for (u8Tick = 0; u8Tick < LI_TICKS_PER_100MS; u8Tick++)
+		{
+			vLI_Tick();
+			u32HostSi_Run(HOST_SI_ALL);
+		}
+	}
+
+	printf("  %-26s %7.0f %7.0f %8.0f   %5.1f%%\n", pcName,
+			(sHostSi.u32Transfers - sFrom.u32Transfers) / dSeconds,
+			(sHostSi.u32Starts - sFrom.u32Starts) / dSeconds,
+			(sHostSi.u32Bytes - sFrom.u32Bytes) / dSeconds,
+			u64HostSi_BusNs(&sFrom) / dSeconds / 1e7);
+}
+
+/****************************************************************************
+ * NAME: vBench_Dither
+ *
+ * DESCRIPTION:
+ * Holds the bulbs with a bit set in u32Bulbs at a low level, and the rest
+ * off, with dithering on. Prints the I2C traffic per second of calling
+ * DriverBulb_vDither on every tick for BENCH_UPDATES 100ms updates.
+ ****************************************************************************/
+PRIVATE void vBench_Dither(uint32 u32Bulbs)
+{
+	tsHostSi sFrom;
+	double dSeconds = BENCH_UPDATES / 10.0;
+	char acName[32];
+	uint32 u32Tick;
+	uint8 u8Channels = 0;
+	uint8 u8Bulb;
+	uint8 i;
+
+	sLC_Settings.bDither = TRUE;
+	for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		DriverBulb_vSetOnOff(u8Bulb, (u32Bulbs & (1UL << u8Bulb)) != 0);
+		vLI_SetCurrentValues(u8Bulb, 40 + u8Bulb, 255, 160, 60, 0);
+		vLI_UpdateDriver(u8Bulb);
+	}
+	u32HostSi_Run(HOST_SI_ALL);
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		u8Channels += (DriverBulb_u16GetChannelPWM(i) & ((1 << LC_PWM_FRAC_BITS) - 1)) != 0;
+	}
+
+	sFrom = sHostSi;
+	for (u32Tick = 0; u32Tick < BENCH_UPDATES * LI_TICKS_PER_100MS; u32Tick++)
+	{
+		DriverBulb_vDither();
+		u32HostSi_Run(HOST_SI_ALL);
+	}
+	sLC_Settings.bDither = FALSE;
+
+	snprintf(acName, sizeof(acName), "dither, %u channel%s", u8Channels, (u8Channels == 1) ? "" : "s");
+	printf("  %-26s %7.0f %7.0f %8.0f   %5.1f%%\n", acName,
+			(sHostSi.u32Transfers - sFrom.u32Transfers) / dSeconds,
+			(sHostSi.u32Starts - sFrom.u32Starts) / dSeconds,
+			(sHostSi.u32Bytes - sFrom.u32Bytes) / dSeconds,
+			u64HostSi_BusNs(&sFrom) / dSeconds / 1e7);
+}
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+int main(void)
+{
+	uint32 u32All = (1UL << NUM_BULBS) - 1;
+	uint32 u32Rgb = u32All & ~((1UL << NUM_MONO_LIGHTS) - 1);
+
+	DriverBulb_vInit();
+	vLC_LoadCalibrationFromNVM();
+
+	printf("PCA9685 I2C traffic per second, %d mono and %d RGB bulbs:\n",
+			NUM_MONO_LIGHTS, NUM_RGB_LIGHTS);
+	printf("  %-26s %7s %7s %8s   %s\n", "", "xfers", "STARTs", "bytes", "bus");
+	vBench_Fade("idle", 0, 0);
+	vBench_Fade("one mono bulb, level", 1, FADE_LEVEL);
+	vBench_Fade("one RGB bulb, colour", 1UL << NUM_MONO_LIGHTS, FADE_COLOUR);
+	vBench_Fade("RGB bulbs, level+colour", u32Rgb, FADE_LEVEL | FADE_COLOUR);
+	vBench_Fade("all bulbs, level+colour", u32All, FADE_LEVEL | FADE_COLOUR);
+	vBench_Dither(1);
+	vBench_Dither(1UL << NUM_MONO_LIGHTS);
+	vBench_Dither(u32All);
+	return 0;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
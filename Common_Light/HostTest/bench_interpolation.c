@@ -0,0 +1,114 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          bench_interpolation.c
+ *
+ * DESCRIPTION:        Host benchmark of the interpolation tick
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Measures the cost of vLI_Tick with no bulb, one bulb and every bulb in
+ * transition. The bulb driver only records what it is given, so this is the
+ * cost of the interpolator itself, plus colour correction. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <jendefs.h>
+#include "app_light_interpolation.h"
+#include "app_light_calibration.h"
+#include "DriverBulb.h"
+#include "HostStubs.h"
+#include "HostDriver.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Ticks timed per measurement. Transitions are made long enough to stay
+ * active for all of them. */
+#define BENCH_TICKS				(2000000UL)
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: dBench_Tick
+ *
+ * DESCRIPTION:
+ * Starts a level and colour transition on the first u8Active bulbs, and
+ * returns the mean time of a vLI_Tick call in ns
+ ****************************************************************************/
+PRIVATE double dBench_Tick(uint8 u8Active)
+{
+	uint64 u64Start;
+	uint32 i;
+	uint8 u8Bulb;
+
+	for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		vLI_SetCurrentValues(u8Bulb, 1, 255, 0, 0, 0);
+		if (u8Bulb < u8Active)
+		{
+			vLI_StartLevel(u8Bulb, 254, BENCH_TICKS + 1);
+			vLI_StartColour(u8Bulb, 0, 0, 255, 0, BENCH_TICKS + 1);
+		}
+	}
+	u64Start = u64Host_TimeNs();
+	for (i = 0; i < BENCH_TICKS; i++)
+	{
+		vLI_Tick();
+	}
+	return (double)(u64Host_TimeNs() - u64Start) / BENCH_TICKS;
+}
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+int main(void)
+{
+	vLC_LoadCalibrationFromNVM();
+
+	printf("vLI_Tick, %d bulbs:\n", NUM_BULBS);
+	printf("  idle:             %6.1f ns/tick\n", dBench_Tick(0));
+	printf("  1 bulb active:    %6.1f ns/tick\n", dBench_Tick(1));
+	printf("  %d bulbs active:   %6.1f ns/tick\n", NUM_BULBS, dBench_Tick(NUM_BULBS));
+	return 0;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
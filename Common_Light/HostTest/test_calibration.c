@@ -0,0 +1,585 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          test_calibration.c
+ *
+ * DESCRIPTION:        Host build: calibration tests
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Tests of app_light_calibration.c, which is included here so that its
+ * private functions and state can be reached. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <math.h>
+#include <jendefs.h>
+#include "HostStubs.h"
+#include "app_light_calibration.c"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Gammas tried, 0.2 to 5.0 with 1024 = 1.0 */
+#define TEST_GAMMA_MIN			(205)
+#define TEST_GAMMA_MAX			(5120)
+#define TEST_GAMMA_STEP			(51)
+
+/* Below this the curve is checked against pow() */
+#define TEST_LOW_INTENSITY		(4096)
+
+/* Gammas whose reachable PWM codes are counted */
+#define TEST_CODE_GAMMAS		{ 1024, 2253, 2867 }
+
+/* Random colours and matrices tried on each RGB bulb */
+#define TEST_COLOURS			(200000)
+#define TEST_MATRICES			(2000)
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+PRIVATE uint32 u32WorstTable;
+PRIVATE double dWorstLow;
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: u32Test_Direct
+ *
+ * DESCRIPTION:
+ * u32LC_AdjustIntensity as it would be without the intensity table
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Direct(uint8 u8Channel, uint16 u16Intensity)
+{
+	uint32 x;
+
+	if (u16Intensity == 0)
+		return 0;
+	x = u32LC_ApplyCalibration(u8Channel, u16Intensity);
+	x = x * atsLC_Calibration[u8Channel].u16Brightness;
+	x = (x >> 10) + ((x & 512) >> 9);
+	if (x < (1 << LC_PWM_FRAC_BITS)) x = (1 << LC_PWM_FRAC_BITS);
+	if (x > LC_PWM_MAX) x = LC_PWM_MAX;
+	return x;
+}
+
+/****************************************************************************
+ * NAME: bTest_Exact
+ *
+ * DESCRIPTION:
+ * Whether u32LC_AdjustIntensity must equal the direct calculation at an
+ * intensity: everywhere on the Mini, and at the table's sample points and
+ * below its direct limit on the Standard
+ ****************************************************************************/
+PRIVATE bool_t bTest_Exact(uint8 u8Channel, uint32 u32Intensity)
+{
+#ifdef VARIANT_MINI
+	return TRUE;
+#else
+	return (u32Intensity < au16IntensityDirect[u8Channel])
+		|| ((u32Intensity & ((1 << INTENSITY_TABLE_SHIFT) - 1)) == 0)
+		|| (u32Intensity == 0xffff);
+#endif
+}
+
+/****************************************************************************
+ * NAME: vTest_Channel
+ *
+ * DESCRIPTION:
+ * Rebuilds the tables of a channel and checks u32LC_AdjustIntensity for
+ * every intensity. It must never decrease, and must equal the direct
+ * calculation where bTest_Exact says so. Elsewhere, for a gamma curve, it
+ * may differ by the interpolation error, which the steps of the direct
+ * calculation dominate: that resolves the log of the intensity to one unit
+ * of log_table_long, 1/4096, and the gamma multiplies it. A measured curve
+ * is straight between knots, so it must lie between the sample points
+ * either side.
+ ****************************************************************************/
+PRIVATE void vTest_Channel(uint8 u8Channel)
+{
+	uint32 u32Gamma = atsLC_Calibration[u8Channel].u16Gamma;
+	bool_t bCurve = (atsLC_Curve[u8Channel].u8NumKnots >= 2);
+	uint32 u32Table;
+	uint32 u32Direct;
+	uint32 u32Diff;
+	uint32 u32Tolerance;
+	uint32 u32Low;
+	uint32 u32High;
+	uint32 u32Last = 0;
+	uint32 i;
+
+#ifndef VARIANT_MINI
+	vLC_UpdateIntensityTable(u8Channel);
+#endif
+	for (i = 0; i <= 0xffff; i++)
+	{
+		u32Table = u32LC_AdjustIntensity((uint16)i, u8Channel);
+		u32Direct = u32Test_Direct(u8Channel, (uint16)i);
+		u32Diff = (u32Table > u32Direct) ? u32Table - u32Direct : u32Direct - u32Table;
+
+		if (u32Table < u32Last)
+		{
+			HOST_CHECK(FALSE, "channel %u gamma %u: intensity %u gives %u, less than %u",
+					u8Channel, u32Gamma, i, u32Table, u32Last);
+			return;
+		}
+		u32Last = u32Table;
+
+		if (bTest_Exact(u8Channel, i))
+		{
+			u32Tolerance = 0;
+		}
+		else if (bCurve)
+		{
+			u32Low = u32Test_Direct(u8Channel, (uint16)(i & ~0xff));
+			u32High = u32Test_Direct(u8Channel, (uint16)MIN((i | 0xff) + 1, 0xffff));
+			u32Tolerance = (u32Table < u32Low) || (u32Table > u32High) ? 0 : u32Diff;
+		}
+		else
+		{
+			u32Tolerance = (uint32)(((uint64)u32Direct * u32Gamma) >> 21) + (1 << LC_PWM_FRAC_BITS);
+			u32WorstTable = MAX(u32WorstTable, u32Diff);
+		}
+		if (u32Diff > u32Tolerance)
+		{
+			HOST_CHECK(FALSE, "channel %u gamma %u brightness %u intensity %u: %u, direct %u",
+					u8Channel, u32Gamma, atsLC_Calibration[u8Channel].u16Brightness,
+					i, u32Table, u32Direct);
+			return;
+		}
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_LowIntensity
+ *
+ * DESCRIPTION:
+ * The bottom of the gamma curve, which steep gammas below 1.0 make hard,
+ * must be within one PWM step of pow()
+ ****************************************************************************/
+PRIVATE void vTest_LowIntensity(uint8 u8Channel)
+{
+	double dGamma = atsLC_Calibration[u8Channel].u16Gamma / 1024.0;
+	double dIdeal;
+	double dError;
+	uint32 i;
+
+	for (i = 1; i < TEST_LOW_INTENSITY; i++)
+	{
+		dIdeal = pow(i / 65535.0, dGamma) * LC_PWM_MAX;
+		dIdeal = MAX(dIdeal, 1 << LC_PWM_FRAC_BITS);
+		dError = fabs(u32LC_AdjustIntensity((uint16)i, u8Channel) - dIdeal) / (1 << LC_PWM_FRAC_BITS);
+		dWorstLow = MAX(dWorstLow, dError);
+		if (dError > 1.0)
+		{
+			HOST_CHECK(FALSE, "gamma %.2f intensity %u: %u, pow() gives %.1f", dGamma, i,
+					u32LC_AdjustIntensity((uint16)i, u8Channel), dIdeal);
+			return;
+		}
+	}
+}
+
+#ifndef VARIANT_MINI
+/****************************************************************************
+ * NAME: vTest_TableAccuracy
+ *
+ * DESCRIPTION:
+ * Between its sample points the intensity table must be at least as close
+ * to pow() as the direct calculation, over every intensity, for a few
+ * gammas and brightnesses
+ ****************************************************************************/
+PRIVATE void vTest_TableAccuracy(uint8 u8Channel)
+{
+	static const uint16 au16Settings[][2] =
+	{
+		{ 205, 1024 }, { 1024, 1024 }, { 2867, 1024 }, { 2867, 600 }, { 2252, 1300 }, { 5120, 1024 }
+	};
+	double dGamma;
+	double dScale;
+	double dIdeal;
+	double dTable;
+	double dDirect;
+	uint32 i;
+	uint8 j;
+
+	for (j = 0; j < sizeof(au16Settings) / sizeof(au16Settings[0]); j++)
+	{
+		atsLC_Calibration[u8Channel].u16Gamma = au16Settings[j][0];
+		atsLC_Calibration[u8Channel].u16Brightness = au16Settings[j][1];
+		vLC_UpdateIntensityTable(u8Channel);
+		dGamma = au16Settings[j][0] / 1024.0;
+		dScale = LC_PWM_MAX * au16Settings[j][1] / 1024.0;
+		dTable = 0.0;
+		dDirect = 0.0;
+		for (i = 1; i <= 0xffff; i++)
+		{
+			dIdeal = pow(i / 65535.0, dGamma) * dScale;
+			dIdeal = MIN(MAX(dIdeal, 1 << LC_PWM_FRAC_BITS), LC_PWM_MAX);
+			dTable = MAX(dTable, fabs(u32LC_AdjustIntensity((uint16)i, u8Channel) - dIdeal));
+			dDirect = MAX(dDirect, fabs(u32Test_Direct(u8Channel, (uint16)i) - dIdeal));
+		}
+		printf("Gamma %.2f, brightness %.2f: largest error from pow() %.2f PWM steps direct, %.2f with table\n",
+				dGamma, au16Settings[j][1] / 1024.0, dDirect / (1 << LC_PWM_FRAC_BITS),
+				dTable / (1 << LC_PWM_FRAC_BITS));
+		HOST_CHECK(dTable <= dDirect, "gamma %.2f brightness %u: table %.2f from pow(), direct %.2f",
+				dGamma, au16Settings[j][1], dTable, dDirect);
+	}
+}
+#endif
+
+/****************************************************************************
+ * NAME: vTest_Codes
+ *
+ * DESCRIPTION:
+ * Counts the distinct PWM codes a channel reaches over every 16 bit
+ * intensity, and the distinct PWM values with their fractions, which the
+ * dither stage can put out. The 16 bit path must reach more codes than
+ * the 255 intensities of 8 bit levels did through the same curve, and at
+ * gamma 1.0 every code from 1 to 4095.
+ ****************************************************************************/
+PRIVATE void vTest_Codes(uint8 u8Channel)
+{
+	static const uint16 au16Gamma[] = TEST_CODE_GAMMAS;
+	uint32 u32Codes;
+	uint32 u32Values;
+	uint32 u32Codes8;
+	uint32 u32PWM;
+	uint32 u32Code;
+	uint32 u32LastPWM;
+	uint32 u32LastCode;
+	uint32 i;
+	uint8 g;
+
+	atsLC_Calibration[u8Channel].u16Brightness = 1024;
+	for (g = 0; g < sizeof(au16Gamma) / sizeof(au16Gamma[0]); g++)
+	{
+		atsLC_Calibration[u8Channel].u16Gamma = au16Gamma[g];
+#ifndef VARIANT_MINI
+		vLC_UpdateIntensityTable(u8Channel);
+#endif
+		/* The curve never goes down, so each new value is a new one */
+		u32Codes = 0;
+		u32Values = 0;
+		u32LastPWM = 0;
+		u32LastCode = 0;
+		for (i = 1; i <= 0xffff; i++)
+		{
+			u32PWM = u32LC_AdjustIntensity((uint16)i, u8Channel);
+			u32Code = (u32PWM + (1 << (LC_PWM_FRAC_BITS - 1))) >> LC_PWM_FRAC_BITS;
+			u32Values += (u32PWM != u32LastPWM);
+			u32Codes += (u32Code != u32LastCode);
+			u32LastPWM = u32PWM;
+			u32LastCode = u32Code;
+		}
+		u32Codes8 = 0;
+		u32LastCode = 0;
+		for (i = 1; i <= 0xff; i++)
+		{
+			u32PWM = u32LC_AdjustIntensity((uint16)(i * 257), u8Channel);
+			u32Code = (u32PWM + (1 << (LC_PWM_FRAC_BITS - 1))) >> LC_PWM_FRAC_BITS;
+			u32Codes8 += (u32Code != u32LastCode);
+			u32LastCode = u32Code;
+		}
+		printf("Gamma %.2f: %u distinct PWM codes, %u with dithering (8 bit input: %u)\n",
+				au16Gamma[g] / 1024.0, u32Codes, u32Values, u32Codes8);
+		HOST_CHECK((u32Codes > u32Codes8) && (u32Values > u32Codes),
+				"gamma %u: %u codes, %u values, %u from 8 bit input", au16Gamma[g], u32Codes, u32Values, u32Codes8);
+		if (au16Gamma[g] == 1024)
+		{
+			HOST_CHECK(u32Codes == 4095, "gamma 1.0 reaches %u codes", u32Codes);
+		}
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_SetCurve
+ *
+ * DESCRIPTION:
+ * Gives a channel a measured curve, from pairs of intensity and PWM value
+ ****************************************************************************/
+PRIVATE void vTest_SetCurve(uint8 u8Channel, const uint16 (*pau16Knots)[2], uint8 u8NumKnots)
+{
+	uint8 i;
+
+	for (i = 0; i < u8NumKnots; i++)
+	{
+		atsLC_Curve[u8Channel].au16Intensity[i] = pau16Knots[i][0];
+		atsLC_Curve[u8Channel].au16PWM[i] = pau16Knots[i][1];
+	}
+	atsLC_Curve[u8Channel].u8NumKnots = u8NumKnots;
+}
+
+/****************************************************************************
+ * NAME: vTest_SetMatrix
+ *
+ * DESCRIPTION:
+ * Sets the colour correction matrix of an RGB bulb, given as 9 entries
+ ****************************************************************************/
+PRIVATE void vTest_SetMatrix(uint8 u8Bulb, const int16 *pai16Entries)
+{
+	uint8 i;
+
+	for (i = 0; i < 9; i++)
+	{
+		ai16LC_ColourMatrix[u8Bulb - NUM_MONO_LIGHTS][i / 3][i % 3] = pai16Entries[i];
+	}
+}
+
+/****************************************************************************
+ * NAME: u32Test_Correct
+ *
+ * DESCRIPTION:
+ * One output of vLC_CorrectColour, worked out in 64 bits: the row times
+ * the colour, rounded to the nearest and clamped to 0 to 65535
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Correct(const int16 *pai16Row, const uint32 *pau32Colour)
+{
+	int64 i64Sum = MATRIX_ONE / 2;
+	uint8 i;
+
+	for (i = 0; i < 3; i++)
+	{
+		i64Sum += (int64)pai16Row[i] * MIN(pau32Colour[i], 0xffff);
+	}
+	i64Sum = (i64Sum < 0) ? 0 : i64Sum / MATRIX_ONE;
+	return (uint32)MIN(i64Sum, 0xffff);
+}
+
+/****************************************************************************
+ * NAME: bTest_CorrectColour
+ *
+ * DESCRIPTION:
+ * Runs vLC_CorrectColour on one colour and checks it against the 64 bit
+ * calculation, or against the colour itself if bIdentity
+ ****************************************************************************/
+PRIVATE bool_t bTest_CorrectColour(uint8 u8Bulb, const int16 *pai16Entries, const uint32 *pau32Colour, bool_t bIdentity)
+{
+	uint32 au32Out[3];
+	uint32 u32Expected;
+	uint8 i;
+
+	au32Out[0] = pau32Colour[0];
+	au32Out[1] = pau32Colour[1];
+	au32Out[2] = pau32Colour[2];
+	vLC_CorrectColour(u8Bulb, &au32Out[0], &au32Out[1], &au32Out[2]);
+	for (i = 0; i < 3; i++)
+	{
+		u32Expected = bIdentity ? pau32Colour[i] : u32Test_Correct(&pai16Entries[i * 3], pau32Colour);
+		if (au32Out[i] != u32Expected)
+		{
+			HOST_CHECK(FALSE, "bulb %u colour %u,%u,%u: output %u is %u, expected %u",
+					u8Bulb, pau32Colour[0], pau32Colour[1], pau32Colour[2], i, au32Out[i], u32Expected);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/****************************************************************************
+ * NAME: vTest_ColourIdentity
+ *
+ * DESCRIPTION:
+ * The identity matrix, which every RGB bulb has until it is set, must pass
+ * every colour through unchanged, so that uncorrected bulbs get exactly
+ * what they got before the correction stage. Mono bulbs are never changed.
+ ****************************************************************************/
+PRIVATE void vTest_ColourIdentity(void)
+{
+	static const int16 ai16Identity[9] = { MATRIX_ONE, 0, 0, 0, MATRIX_ONE, 0, 0, 0, MATRIX_ONE };
+	static const int16 ai16Swap[9] = { 0, MATRIX_ONE, 0, MATRIX_ONE, 0, 0, 0, 0, MATRIX_ONE };
+	uint32 au32Colour[3];
+	uint32 u32Red, u32Green, u32Blue;
+	uint32 i;
+	uint8 u8Bulb;
+
+	for (u8Bulb = NUM_MONO_LIGHTS; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		for (i = 0; i <= 0xffff; i++)
+		{
+			au32Colour[0] = i;
+			au32Colour[1] = i ^ 0x5555;
+			au32Colour[2] = 0xffff - i;
+			if (!bTest_CorrectColour(u8Bulb, ai16Identity, au32Colour, TRUE))
+				break;
+		}
+		for (i = 0; i < TEST_COLOURS; i++)
+		{
+			au32Colour[0] = u32Host_Random() & 0xffff;
+			au32Colour[1] = u32Host_Random() & 0xffff;
+			au32Colour[2] = u32Host_Random() & 0xffff;
+			if (!bTest_CorrectColour(u8Bulb, ai16Identity, au32Colour, TRUE))
+				break;
+		}
+	}
+
+	/* Even with every RGB matrix swapping red and green */
+	for (u8Bulb = NUM_MONO_LIGHTS; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		vTest_SetMatrix(u8Bulb, ai16Swap);
+	}
+	for (u8Bulb = 0; u8Bulb < NUM_MONO_LIGHTS; u8Bulb++)
+	{
+		u32Red = 1000;
+		u32Green = 2000;
+		u32Blue = 3000;
+		vLC_CorrectColour(u8Bulb, &u32Red, &u32Green, &u32Blue);
+		HOST_CHECK((u32Red == 1000) && (u32Green == 2000) && (u32Blue == 3000),
+				"mono bulb %u colour changed to %u,%u,%u", u8Bulb, u32Red, u32Green, u32Blue);
+	}
+	for (u8Bulb = NUM_MONO_LIGHTS; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		vTest_SetMatrix(u8Bulb, ai16Identity);
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_ColourClamp
+ *
+ * DESCRIPTION:
+ * Matrices with entries anywhere in the allowed range, +/-2.0, must give
+ * the rounded product clamped to 0 to 65535, without overflowing. Every
+ * entry at +2.0 or -2.0 with full scale inputs is the worst case.
+ ****************************************************************************/
+PRIVATE void vTest_ColourClamp(void)
+{
+	static const uint32 au32Edges[][3] =
+	{
+		{ 0, 0, 0 }, { 0xffff, 0xffff, 0xffff }, { 0xffff, 0, 0 }, { 0, 0xffff, 0 },
+		{ 0, 0, 0xffff }, { 1, 1, 1 }, { 0x8000, 0x7fff, 0xffff }
+	};
+	int16 ai16Entries[9];
+	uint32 au32Colour[3];
+	uint32 i, j;
+	uint8 u8Bulb = NUM_MONO_LIGHTS;
+
+	for (i = 0; i < TEST_MATRICES; i++)
+	{
+		for (j = 0; j < 9; j++)
+		{
+			switch (i % 4)
+			{
+			case 0:		/* every entry at one end of the range */
+				ai16Entries[j] = (i & 4) ? -MATRIX_ENTRY_MAX : MATRIX_ENTRY_MAX;
+				break;
+			case 1:		/* a random mix of the two ends */
+				ai16Entries[j] = (u32Host_Random() & 1) ? -MATRIX_ENTRY_MAX : MATRIX_ENTRY_MAX;
+				break;
+			default:
+				ai16Entries[j] = (int16)(u32Host_Random() % (2 * MATRIX_ENTRY_MAX + 1)) - MATRIX_ENTRY_MAX;
+				break;
+			}
+		}
+		vTest_SetMatrix(u8Bulb, ai16Entries);
+
+		for (j = 0; j < sizeof(au32Edges) / sizeof(au32Edges[0]); j++)
+		{
+			if (!bTest_CorrectColour(u8Bulb, ai16Entries, au32Edges[j], FALSE))
+				break;
+		}
+		for (j = 0; j < TEST_COLOURS / TEST_MATRICES; j++)
+		{
+			au32Colour[0] = u32Host_Random() & 0xffff;
+			au32Colour[1] = u32Host_Random() & 0xffff;
+			au32Colour[2] = u32Host_Random() & 0xffff;
+			if (!bTest_CorrectColour(u8Bulb, ai16Entries, au32Colour, FALSE))
+				break;
+		}
+	}
+	vLC_LoadCalibrationFromNVM();
+}
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+int main(void)
+{
+	static const uint16 au16Brightness[] = { 1024, 600, 1300 };
+	/* A sharp knee low down, and knots closer than a table segment */
+	static const uint16 au16Knee[][2] = { { 0, 16 }, { 900, 24000 }, { 65535, LC_PWM_MAX } };
+	static const uint16 au16Dense[][2] =
+	{
+		{ 100, 16 }, { 300, 800 }, { 400, 900 }, { 700, 4000 },
+		{ 5000, 9000 }, { 5100, 12000 }, { 40000, 50000 }, { 65000, 60000 }
+	};
+	uint32 u32Gamma;
+	uint8 i;
+
+	vLC_LoadCalibrationFromNVM();
+
+	for (i = 0; i < sizeof(au16Brightness) / sizeof(au16Brightness[0]); i++)
+	{
+		for (u32Gamma = TEST_GAMMA_MIN; u32Gamma <= TEST_GAMMA_MAX; u32Gamma += TEST_GAMMA_STEP)
+		{
+			atsLC_Calibration[0].u16Gamma = u32Gamma;
+			atsLC_Calibration[0].u16Brightness = au16Brightness[i];
+			vTest_Channel(0);
+			if (au16Brightness[i] == 1024)
+			{
+				vTest_LowIntensity(0);
+			}
+		}
+	}
+
+	vTest_Codes(0);
+#ifndef VARIANT_MINI
+	vTest_TableAccuracy(0);
+#endif
+
+	atsLC_Calibration[0].u16Gamma = DEFAULT_GAMMA;
+	atsLC_Calibration[0].u16Brightness = DEFAULT_BRIGHTNESS;
+	vTest_SetCurve(0, au16Knee, sizeof(au16Knee) / sizeof(au16Knee[0]));
+	vTest_Channel(0);
+	vTest_SetCurve(0, au16Dense, sizeof(au16Dense) / sizeof(au16Dense[0]));
+	vTest_Channel(0);
+	atsLC_Curve[0].u8NumKnots = 0;
+
+	vTest_ColourIdentity();
+	vTest_ColourClamp();
+
+	printf("Intensity table: largest difference from direct %.2f PWM steps\n",
+			(double)u32WorstTable / (1 << LC_PWM_FRAC_BITS));
+	printf("Below intensity %u: largest error from pow() %.2f PWM steps\n",
+			TEST_LOW_INTENSITY, dWorstLow);
+	return iHost_Result("test_calibration");
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
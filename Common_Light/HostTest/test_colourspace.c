@@ -0,0 +1,237 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          test_colourspace.c
+ *
+ * DESCRIPTION:        Host test of the colour space conversions
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Checks vCS_RGBToXY and vCS_XYToRGB against a double precision reference
+ * built from the same primaries as generate_colour_table.py */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <math.h>
+#include <jendefs.h>
+#include "app_light_colourspace.h"
+#include "HostStubs.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Primaries, white point and gamma from generate_colour_table.py */
+#define RED_X				0.68
+#define RED_Y				0.31
+#define GREEN_X				0.11
+#define GREEN_Y				0.82
+#define BLUE_X				0.13
+#define BLUE_Y				0.04
+#define WHITE_X				0.33
+#define WHITE_Y				0.33
+#define GAMMA				(2867 / 1024.0)
+
+#define TEST_COLOURS		200000
+/* Colours darker than ZCL level 1 are not compared */
+#define TEST_PEAK_MIN		258
+
+/* Largest allowed errors: xy in CIE units, round trip in linear light as a
+ * fraction of full scale */
+#define TEST_XY_LIMIT		0.001
+#define TEST_ROUND_TRIP_LIMIT	0.005
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+PRIVATE double adRgbToXyz[3][3];
+PRIVATE double adXyzToRgb[3][3];
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+PRIVATE void vInvert(double adIn[3][3], double adOut[3][3])
+{
+	double dDet;
+	int r, c;
+
+	dDet = adIn[0][0] * (adIn[1][1] * adIn[2][2] - adIn[1][2] * adIn[2][1])
+	     - adIn[0][1] * (adIn[1][0] * adIn[2][2] - adIn[1][2] * adIn[2][0])
+	     + adIn[0][2] * (adIn[1][0] * adIn[2][1] - adIn[1][1] * adIn[2][0]);
+	for (r = 0; r < 3; r++)
+	{
+		for (c = 0; c < 3; c++)
+		{
+			adOut[c][r] = (adIn[(r + 1) % 3][(c + 1) % 3] * adIn[(r + 2) % 3][(c + 2) % 3]
+			             - adIn[(r + 1) % 3][(c + 2) % 3] * adIn[(r + 2) % 3][(c + 1) % 3]) / dDet;
+		}
+	}
+}
+
+/****************************************************************************
+ * NAME: vBuildMatrices
+ *
+ * DESCRIPTION:
+ * RGB to XYZ matrix whose columns are the primaries, scaled so that full
+ * red, green and blue add up to the white point, and its inverse
+ ****************************************************************************/
+PRIVATE void vBuildMatrices(void)
+{
+	const double adPrimary[3][2] = {{RED_X, RED_Y}, {GREEN_X, GREEN_Y}, {BLUE_X, BLUE_Y}};
+	const double adWhite[3] = {WHITE_X / WHITE_Y, 1.0, (1.0 - WHITE_X - WHITE_Y) / WHITE_Y};
+	double adM[3][3];
+	double adInv[3][3];
+	double dScale;
+	int r, c;
+
+	for (c = 0; c < 3; c++)
+	{
+		adM[0][c] = adPrimary[c][0] / adPrimary[c][1];
+		adM[1][c] = 1.0;
+		adM[2][c] = (1.0 - adPrimary[c][0] - adPrimary[c][1]) / adPrimary[c][1];
+	}
+	vInvert(adM, adInv);
+	for (c = 0; c < 3; c++)
+	{
+		dScale = adInv[c][0] * adWhite[0] + adInv[c][1] * adWhite[1] + adInv[c][2] * adWhite[2];
+		for (r = 0; r < 3; r++)
+		{
+			adRgbToXyz[r][c] = adM[r][c] * dScale;
+		}
+	}
+	vInvert(adRgbToXyz, adXyzToRgb);
+}
+
+PRIVATE void vReferenceRGBToXY(const uint32 au32Rgb[3], double *pdX, double *pdY)
+{
+	double adLinear[3];
+	double adXyz[3];
+	int r;
+
+	for (r = 0; r < 3; r++)
+	{
+		adLinear[r] = pow(au32Rgb[r] / 65535.0, GAMMA);
+	}
+	for (r = 0; r < 3; r++)
+	{
+		adXyz[r] = adRgbToXyz[r][0] * adLinear[0] + adRgbToXyz[r][1] * adLinear[1] + adRgbToXyz[r][2] * adLinear[2];
+	}
+	*pdX = adXyz[0] / (adXyz[0] + adXyz[1] + adXyz[2]);
+	*pdY = adXyz[1] / (adXyz[0] + adXyz[1] + adXyz[2]);
+}
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+int main(void)
+{
+	uint32 au32Rgb[3];
+	uint32 au32Out[3];
+	uint32 u32X, u32Y, u32Peak;
+	double dX, dY;
+	double dError;
+	double dWorstXY = 0.0;
+	double dWorstRoundTrip = 0.0;
+	double dTotalRoundTrip = 0.0;
+	uint32 u32Compared = 0;
+	uint32 i;
+	int c;
+
+	vBuildMatrices();
+	vHost_Seed(1);
+	for (i = 0; i < TEST_COLOURS; i++)
+	{
+		for (c = 0; c < 3; c++)
+		{
+			au32Rgb[c] = u32Host_Random() & 0xffff;
+		}
+		/* Plenty of saturated colours, which are the hard ones */
+		if (u32Host_Random() & 1)
+		{
+			au32Rgb[u32Host_Random() % 3] = 0;
+		}
+		if (MAX(MAX(au32Rgb[0], au32Rgb[1]), au32Rgb[2]) < TEST_PEAK_MIN)
+		{
+			continue;
+		}
+		vCS_RGBToXY(au32Rgb[0], au32Rgb[1], au32Rgb[2], &u32X, &u32Y, &u32Peak);
+		vReferenceRGBToXY(au32Rgb, &dX, &dY);
+		dError = MAX(fabs(u32X / 65536.0 - dX), fabs(u32Y / 65536.0 - dY));
+		dWorstXY = MAX(dWorstXY, dError);
+		HOST_CHECK(u32Peak == MAX(MAX(au32Rgb[0], au32Rgb[1]), au32Rgb[2]), "peak of %u %u %u is %u",
+		           au32Rgb[0], au32Rgb[1], au32Rgb[2], u32Peak);
+
+		/* Going back should give the same colour, compared in linear light,
+		 * which is what is actually seen */
+		vCS_XYToRGB(u32X, u32Y, u32Peak, &au32Out[0], &au32Out[1], &au32Out[2]);
+		for (c = 0; c < 3; c++)
+		{
+			dError = fabs(pow(au32Out[c] / 65535.0, GAMMA) - pow(au32Rgb[c] / 65535.0, GAMMA));
+			dWorstRoundTrip = MAX(dWorstRoundTrip, dError);
+			dTotalRoundTrip += dError;
+		}
+		u32Compared++;
+	}
+	printf("xy error: largest %.2e\n", dWorstXY);
+	printf("RGB round trip error: largest %.3f%%, mean %.4f%% of full scale linear light\n",
+	       dWorstRoundTrip * 100.0, dTotalRoundTrip / (u32Compared * 3) * 100.0);
+	HOST_CHECK(dWorstXY <= TEST_XY_LIMIT, "xy error %.2e is over %.2e", dWorstXY, TEST_XY_LIMIT);
+	HOST_CHECK(dWorstRoundTrip <= TEST_ROUND_TRIP_LIMIT, "round trip error %.3f%% is over %.3f%%",
+	           dWorstRoundTrip * 100.0, TEST_ROUND_TRIP_LIMIT * 100.0);
+
+	/* Black gives the white point, and back to black */
+	vCS_RGBToXY(0, 0, 0, &u32X, &u32Y, &u32Peak);
+	HOST_CHECK(fabs(u32X / 65536.0 - WHITE_X) < 0.0001 && fabs(u32Y / 65536.0 - WHITE_Y) < 0.0001 && u32Peak == 0,
+	           "black gives %u %u %u", u32X, u32Y, u32Peak);
+	vCS_XYToRGB(u32X, u32Y, 0, &au32Out[0], &au32Out[1], &au32Out[2]);
+	HOST_CHECK(au32Out[0] == 0 && au32Out[1] == 0 && au32Out[2] == 0, "black comes back as %u %u %u",
+	           au32Out[0], au32Out[1], au32Out[2]);
+
+	/* Full white comes back exactly */
+	vCS_RGBToXY(65535, 65535, 65535, &u32X, &u32Y, &u32Peak);
+	vCS_XYToRGB(u32X, u32Y, u32Peak, &au32Out[0], &au32Out[1], &au32Out[2]);
+	for (c = 0; c < 3; c++)
+	{
+		HOST_CHECK(au32Out[c] >= 65535 - 256, "white comes back as %u %u %u", au32Out[0], au32Out[1], au32Out[2]);
+	}
+	return iHost_Result("test_colourspace");
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,406 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          test_interpolation.c
+ *
+ * DESCRIPTION:        Host build: interpolation stepping property test
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Property test of the interpolation stepping in app_light_interpolation.c,
+ * which is included here so that its private state can be checked. Every
+ * transition must move from its start to its target in exactly the number
+ * of steps asked for, and after i of n steps be at start + i * (target -
+ * start) / n, rounded towards the start. That makes each step the quotient
+ * or one more, never backwards, and lands exactly on the target. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <math.h>
+#include <jendefs.h>
+#include "HostStubs.h"
+#include "app_light_interpolation.c"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define TEST_TRANSITIONS		(2000000UL)
+/* Every step count up to this is tried */
+#define TEST_ALL_STEPS			(2000)
+/* Longest ZCL transition, 0xfffe tenths of a second, in ticks */
+#define TEST_MAX_STEPS			(0xfffeUL * LI_TICKS_PER_100MS)
+#define TEST_KNOB_COMMANDS		(500)
+/* Largest relative error of a trip into the log domain and back, from
+ * level 1 up */
+#define TEST_LOG_ROUND_TRIP		(0.005)
+/* Length of the fades whose perceived steps are compared, the output
+ * their steps count from, and how much larger than an even step a log
+ * domain fade may take */
+#define TEST_FADE_STEPS			(100)
+#define TEST_FADE_FLOOR			(4 << LC_PWM_FRAC_BITS)
+#define TEST_FADE_EVENNESS		(1.25)
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+PRIVATE uint32 u32Transitions;
+PRIVATE uint32 u32Interrupted;
+PRIVATE uint64 u64Steps;
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: vTest_Transition
+ *
+ * DESCRIPTION:
+ * Starts a u32Steps step transition of one variable of a bulb, and checks
+ * each of its first u32Run steps. The bulb's other variables must be idle.
+ ****************************************************************************/
+PRIVATE void vTest_Transition(uint8 u8Bulb, uint8 u8Param, uint32 u32Target,
+		uint32 u32Steps, uint32 u32Run)
+{
+	uint32 u32Start = au32Current[u8Param][u8Bulb];
+	uint32 u32End = u32Target << SCALE;
+	uint32 u32Diff = (u32End > u32Start) ? u32End - u32Start : u32Start - u32End;
+	uint32 u32Moved;
+	uint32 u32Want;
+	uint32 i;
+
+	vLI_InitVar(u8Bulb, u8Param, u32Target, u32Steps);
+	u32Transitions++;
+
+	if ((u32Steps == 0) || (u32Diff == 0))
+	{
+		HOST_CHECK(au32Current[u8Param][u8Bulb] == u32End &&
+				au32StepsLeft[u8Param][u8Bulb] == 0,
+				"%u steps from %u to %u not set at once", u32Steps, u32Start, u32End);
+		return;
+	}
+	HOST_CHECK(u32ActiveMask & LI_BULB_MASK(u8Bulb), "bulb %u not made active", u8Bulb);
+
+	for (i = 1; i <= u32Run; i++)
+	{
+		vLI_StepBulb(u8Bulb);
+		u64Steps++;
+
+		if (au32Current[u8Param][u8Bulb] > u32Start)
+		{
+			u32Moved = au32Current[u8Param][u8Bulb] - u32Start;
+		}
+		else
+		{
+			u32Moved = u32Start - au32Current[u8Param][u8Bulb];
+		}
+		u32Want = (uint32)(((uint64)u32Diff * i) / u32Steps);
+		if ((u32Moved != u32Want) || ((u32Moved != 0) &&
+			((u32End > u32Start) != (au32Current[u8Param][u8Bulb] > u32Start))))
+		{
+			HOST_CHECK(FALSE, "%u to %u in %u steps: at %u after %u steps, want %c%u",
+					u32Start, u32End, u32Steps, au32Current[u8Param][u8Bulb], i,
+					(u32End > u32Start) ? '+' : '-', u32Want);
+			return;
+		}
+		if ((i < u32Steps) != ((u32ActiveMask & LI_BULB_MASK(u8Bulb)) != 0))
+		{
+			HOST_CHECK(FALSE, "bulb %u active mask wrong after %u of %u steps",
+					u8Bulb, i, u32Steps);
+			return;
+		}
+	}
+	if (u32Run == u32Steps)
+	{
+		HOST_CHECK(au32Current[u8Param][u8Bulb] == u32End, "%u steps missed %u by %d",
+				u32Steps, u32End, (int)(au32Current[u8Param][u8Bulb] - u32End));
+	}
+	else
+	{
+		u32Interrupted++;
+	}
+}
+
+/****************************************************************************
+ * NAME: u32Test_RandomSteps
+ *
+ * DESCRIPTION:
+ * Step counts as they come: mostly one 100ms ZCL update, or a few seconds,
+ * and once in a while anything up to the longest ZCL transition
+ ****************************************************************************/
+PRIVATE uint32 u32Test_RandomSteps(void)
+{
+	uint32 u32Kind = u32Host_Random() % 10000;
+
+	if (u32Kind < 4000)
+	{
+		return LI_TICKS_PER_100MS;
+	}
+	if (u32Kind < 9900)
+	{
+		return u32Host_Random() % 64;
+	}
+	if (u32Kind < 9999)
+	{
+		return u32Host_Random() % 6000;
+	}
+	return u32Host_Random() % (TEST_MAX_STEPS + 1);
+}
+
+/****************************************************************************
+ * NAME: vTest_Divu10
+ *
+ * DESCRIPTION:
+ * u32divu10 is used for 10 step transitions, which can span any 16 bit
+ * value with SCALE fractional bits
+ ****************************************************************************/
+PRIVATE void vTest_Divu10(void)
+{
+	uint32 n;
+
+	for (n = 0; n <= (0xffffUL << SCALE); n++)
+	{
+		if (u32divu10(n) != n / 10)
+		{
+			HOST_CHECK(FALSE, "u32divu10(%u) = %u", n, u32divu10(n));
+			return;
+		}
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_DimmerKnob
+ *
+ * DESCRIPTION:
+ * Bulbs starting at different levels are given the same run of short level
+ * commands, each cutting the last one off part way like a dimmer knob
+ * being turned. They must all end at the same value.
+ ****************************************************************************/
+PRIVATE void vTest_DimmerKnob(void)
+{
+	uint32 u32Level;
+	uint32 u32Steps;
+	uint32 u32Ticks;
+	uint32 i;
+	uint8 u8Bulb;
+
+	for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		vLI_SetCurrentValues(u8Bulb, 1 + u8Bulb * 37, 255, 255, 255, 0);
+	}
+	for (i = 0; i < TEST_KNOB_COMMANDS; i++)
+	{
+		u32Level = 1 + u32Host_Random() % 254;
+		u32Steps = 1 + u32Host_Random() % 20;
+		for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+		{
+			vLI_StartLevel(u8Bulb, u32Level, u32Steps);
+		}
+		for (u32Ticks = u32Host_Random() % (u32Steps + 1); u32Ticks > 0; u32Ticks--)
+		{
+			vLI_Tick();
+		}
+	}
+	while (bLI_AnyTransitionActive())
+	{
+		vLI_Tick();
+	}
+	for (u8Bulb = 1; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		HOST_CHECK(au32Current[LI_LEVEL][u8Bulb] == au32Current[LI_LEVEL][0],
+				"bulb %u level %u, bulb 0 level %u", u8Bulb,
+				au32Current[LI_LEVEL][u8Bulb], au32Current[LI_LEVEL][0]);
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_LogRoundTrip
+ *
+ * DESCRIPTION:
+ * Every intensity from level 1 up must come back from the log domain to
+ * within TEST_LOG_ROUND_TRIP of itself
+ ****************************************************************************/
+PRIVATE void vTest_LogRoundTrip(void)
+{
+	double dWorst = 0.0;
+	double dError;
+	uint32 u32Back;
+	uint32 i;
+
+	for (i = LI_LEVEL_TO_16BIT(1); i <= 0xffff; i++)
+	{
+		u32Back = u16LC_LogToIntensity(u32LC_IntensityToLog((uint16)i));
+		dError = fabs((double)u32Back - i) / i;
+		dWorst = MAX(dWorst, dError);
+		if (dError > TEST_LOG_ROUND_TRIP)
+		{
+			HOST_CHECK(FALSE, "intensity %u comes back from the log domain as %u", i, u32Back);
+			return;
+		}
+	}
+	printf("Log round trip: largest error %.3f%%\n", dWorst * 100.0);
+}
+
+/****************************************************************************
+ * NAME: dTest_Fade
+ *
+ * DESCRIPTION:
+ * Fades bulb 0 from level 1 to full in TEST_FADE_STEPS ticks, in the log
+ * domain or not. The output must never go down, and must land on full.
+ * Returns the largest perceived step, taken as the change in the log of
+ * the PWM output at the default gamma. Only steps from at least
+ * TEST_FADE_FLOOR count, as below it the 1/16 step resolution of the
+ * output makes every change large. The step an even fade over the same
+ * part would take is put in pdEven.
+ ****************************************************************************/
+PRIVATE double dTest_Fade(bool_t bLog, double *pdEven)
+{
+	double dWorst = 0.0;
+	uint32 u32From = 0;
+	uint32 u32Steps = 0;
+	uint32 u32Last;
+	uint32 u32PWM;
+	uint32 i;
+
+	sLC_Settings.u32LogFadeMask = bLog ? 1 : 0;
+	vLI_StartLevel(0, 1, 0);
+	vLI_StartLevel(0, CLD_LEVELCONTROL_MAX_LEVEL, TEST_FADE_STEPS);
+	u32Last = u32LC_AdjustIntensity((uint16)u32LI_GetLevel(0), 0);
+	for (i = 0; i < TEST_FADE_STEPS; i++)
+	{
+		vLI_StepBulb(0);
+		u32PWM = u32LC_AdjustIntensity((uint16)u32LI_GetLevel(0), 0);
+		if (u32PWM < u32Last)
+		{
+			HOST_CHECK(FALSE, "%s fade goes down from %u to %u at step %u", bLog ? "log" : "linear",
+					u32Last, u32PWM, i);
+			break;
+		}
+		if (u32Last >= TEST_FADE_FLOOR)
+		{
+			u32From = (u32Steps == 0) ? u32Last : u32From;
+			u32Steps++;
+			dWorst = MAX(dWorst, log((double)u32PWM / u32Last));
+		}
+		u32Last = u32PWM;
+	}
+	HOST_CHECK(u32Last == LC_PWM_MAX, "%s fade ends at %u", bLog ? "log" : "linear", u32Last);
+	*pdEven = log((double)LC_PWM_MAX / u32From) / u32Steps;
+	sLC_Settings.u32LogFadeMask = 0;
+	vLI_StartLevel(0, 1, 0);
+	return dWorst;
+}
+
+/****************************************************************************
+ * NAME: vTest_LogFade
+ *
+ * DESCRIPTION:
+ * A log domain fade over the whole range must take perceived steps within
+ * TEST_FADE_EVENNESS of the even step, and smaller than a linear fade's
+ * largest
+ ****************************************************************************/
+PRIVATE void vTest_LogFade(void)
+{
+	double dLinearEven;
+	double dLogEven;
+	double dLinear = dTest_Fade(FALSE, &dLinearEven);
+	double dLog = dTest_Fade(TRUE, &dLogEven);
+
+	printf("Largest perceived step of a %u tick fade: linear %.3f, log %.3f, even %.3f\n",
+			TEST_FADE_STEPS, dLinear, dLog, dLogEven);
+	HOST_CHECK((dLog < dLinear) && (dLog <= dLogEven * TEST_FADE_EVENNESS),
+			"log fade steps by up to %.3f, even %.3f, linear %.3f", dLog, dLogEven, dLinear);
+}
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+int main(void)
+{
+	uint32 u32Steps;
+	uint32 u32Run;
+	uint32 i;
+	uint8 u8Bulb;
+	uint8 u8Param;
+
+	vHost_Seed(10);
+	vLC_LoadCalibrationFromNVM();
+	vTest_Divu10();
+
+	/* Every step count, from random starting points with a fraction */
+	for (u32Steps = 0; u32Steps <= TEST_ALL_STEPS; u32Steps++)
+	{
+		for (u8Param = 0; u8Param < LI_NUM_PARAMS; u8Param++)
+		{
+			vLI_SetVar(0, u8Param, u32Host_Random() & 0xffff);
+			au32Current[u8Param][0] |= u32Host_Random() & ((1 << SCALE) - 1);
+			vTest_Transition(0, u8Param, u32Host_Random() & 0xffff, u32Steps, u32Steps);
+		}
+	}
+
+	/* Random transitions, a quarter of them cut off part way by the next,
+	 * which then starts from wherever that one got to */
+	for (i = 0; i < TEST_TRANSITIONS; i++)
+	{
+		u8Bulb = u32Host_Random() % NUM_BULBS;
+		u8Param = u32Host_Random() % LI_NUM_PARAMS;
+		u32Steps = u32Test_RandomSteps();
+		u32Run = u32Steps;
+		if ((u32Steps != 0) && ((u32Host_Random() & 3) == 0))
+		{
+			u32Run = u32Host_Random() % u32Steps;
+		}
+		vTest_Transition(u8Bulb, u8Param, u32Host_Random() & 0xffff, u32Steps, u32Run);
+		if (u32Run != u32Steps)
+		{
+			/* Leave the other variables idle for the next transition */
+			au32StepsLeft[u8Param][u8Bulb] = 0;
+		}
+	}
+
+	vTest_DimmerKnob();
+	vTest_LogRoundTrip();
+	vTest_LogFade();
+
+	printf("%u transitions (%u cut off), %llu steps checked\n",
+			u32Transitions, u32Interrupted, (unsigned long long)u64Steps);
+	return iHost_Result("test_interpolation");
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,787 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          test_pca9685.c
+ *
+ * DESCRIPTION:        Host build: PCA9685 driver tests
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Tests of the PCA9685 bulb driver on the SI master model in HostSi.c.
+ * DriverBulb_PCA9685.c and app_light_calibration.c are included here so
+ * that their private state can be checked and set. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <jendefs.h>
+#include "HostStubs.h"
+#include "HostSi.h"
+#include "app_light_interpolation.h"
+#include "app_light_calibration.c"
+#include "DriverBulb_PCA9685.c"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Random sets of levels, channel currents and budgets tried */
+#define TEST_BUDGET_ROUNDS		(20000)
+
+/* Largest channel current tried, in mA */
+#define TEST_CURRENT_MAX		(2000)
+
+/* Frames sent while the bus is part way through the ones before */
+#define TEST_OVERLAP_FRAMES		(5000)
+
+/* Ticks each set of dithered targets is run for, and how far the mean
+ * output of each channel may be from its target, in 1/16 PWM steps */
+#define TEST_DITHER_TICKS		(1600)
+#define TEST_DITHER_TOLERANCE	(1.0)
+
+/* Random sets of targets dithered on every channel at once */
+#define TEST_DITHER_ROUNDS		(50)
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: vTest_SetCurrents
+ *
+ * DESCRIPTION:
+ * Gives every channel a random current between 0 and TEST_CURRENT_MAX
+ ****************************************************************************/
+PRIVATE void vTest_SetCurrents(void)
+{
+	uint8 i;
+
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		au16LC_ChannelCurrent[i] = (uint16)(u32Host_Random() % (TEST_CURRENT_MAX + 1));
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_SetLevels
+ *
+ * DESCRIPTION:
+ * Sends every bulb to a random level and colour, some of them off, and
+ * lets the bus write it all
+ ****************************************************************************/
+PRIVATE void vTest_SetLevels(void)
+{
+	uint8 u8Bulb;
+
+	for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		DriverBulb_vSetOnOff(u8Bulb, (u32Host_Random() % 8) != 0);
+		vLI_SetCurrentValues(u8Bulb, 1 + u32Host_Random() % 254,
+				u32Host_Random() % 256, u32Host_Random() % 256, u32Host_Random() % 256, 0);
+		vLI_UpdateDriver(u8Bulb);
+	}
+	u32HostSi_Run(HOST_SI_ALL);
+}
+
+/****************************************************************************
+ * NAME: u32Test_Output
+ *
+ * DESCRIPTION:
+ * What the PCA9685 is putting out on a channel, from its registers as
+ * latched at the last STOP: LC_PWM_MAX for full ON, PWM_FULL_OFF for full
+ * OFF, otherwise the code in PWM steps
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Output(uint8 u8Channel)
+{
+	const uint8 *pu8Led = &au8HostPcaOutputs[REG_LEDx_ON_L + u8Channel * REG_LEDx_STRIDE];
+	uint16 u16On = pu8Led[0] | ((pu8Led[1] & 0x0f) << 8);
+	uint16 u16Off = pu8Led[2] | ((pu8Led[3] & 0x0f) << 8);
+
+	if (pu8Led[3] & 0x10)
+		return PWM_FULL_OFF;
+	if (pu8Led[1] & 0x10)
+		return LC_PWM_MAX;
+	return (uint32)((u16Off - u16On) & 0xfff);
+}
+
+/****************************************************************************
+ * NAME: vTest_CheckRegisters
+ *
+ * DESCRIPTION:
+ * Every channel's output must be what the driver last wrote to it
+ ****************************************************************************/
+PRIVATE void vTest_CheckRegisters(void)
+{
+	uint32 u32Expected;
+	uint8 i;
+
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		u32Expected = au32ChannelOutput[i];
+		if ((u32Expected != PWM_FULL_OFF) && (u32Expected != LC_PWM_MAX))
+		{
+			u32Expected = (u32Expected + (PWM_ONE >> 1)) >> LC_PWM_FRAC_BITS;
+		}
+		HOST_CHECK(u32Test_Output(i) == u32Expected, "channel %u puts out %u, written %u",
+				i, u32Test_Output(i), au32ChannelOutput[i]);
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_Command
+ *
+ * DESCRIPTION:
+ * Runs a serial command, and lets the bus write what it changes
+ ****************************************************************************/
+PRIVATE void vTest_Command(const char *pcCommand)
+{
+	char acCommand[32];
+
+	snprintf(acCommand, sizeof(acCommand), "%s", pcCommand);
+	vLC_ProcessCommand(acCommand);
+	u32HostSi_Run(HOST_SI_ALL);
+}
+
+/****************************************************************************
+ * NAME: vTest_Budget
+ *
+ * DESCRIPTION:
+ * Random levels, channel currents and budgets. PowerTotal must be the
+ * current the channels ask for, rounded up. If it is over the budget, every
+ * channel must be scaled by budget / PowerTotal, to within the Q16
+ * multiplier, the total after scaling must be within the budget, and the
+ * update must be counted in PowerClips. The total is taken from the values
+ * with their fractions, which dithering puts out on average. Otherwise
+ * every channel must get what it asks for.
+ ****************************************************************************/
+PRIVATE void vTest_Budget(void)
+{
+	uint32 u32Round;
+	uint32 u32Load;
+	uint64 u64Scaled;
+	uint32 u32Clips;
+	uint32 u32Asked;
+	uint32 u32Output;
+	uint32 u32Ideal;
+	uint32 u32Failures;
+	uint32 u32Budget;
+	char acCommand[32];
+	bool_t bOver;
+	uint8 i;
+
+	for (u32Round = 0; u32Round < TEST_BUDGET_ROUNDS; u32Round++)
+	{
+		u32Failures = u32HostFailures;
+		vTest_Command("p 0");
+		vTest_SetCurrents();
+		vTest_SetLevels();
+
+		/* Anything from a tenth of what is asked for to more than all of it,
+		 * or no limit */
+		u32Load = 0;
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			if (au32ChannelPWM[i] != PWM_FULL_OFF)
+			{
+				u32Load += ((au32ChannelPWM[i] + PWM_ONE - 1) >> LC_PWM_FRAC_BITS) * au16LC_ChannelCurrent[i];
+			}
+		}
+		u32Budget = (u32Round % 10 == 0) ? 0 :
+				(u32Load / 40950) + 1 + u32Host_Random() % (u32Load / 4095 + 1);
+		snprintf(acCommand, sizeof(acCommand), "p %u", u32Budget);
+		u32Clips = u32LC_PowerClips;
+		vTest_Command(acCommand);
+
+		HOST_CHECK(u32LC_PowerTotal == (u32Load + 4094) / 4095, "PowerTotal %u for a load of %u",
+				u32LC_PowerTotal, u32Load);
+		bOver = (sLC_Settings.u32PowerBudget != 0) && (u32LC_PowerTotal > sLC_Settings.u32PowerBudget);
+		HOST_CHECK(u32LC_PowerClips == u32Clips + (bOver ? 1 : 0), "PowerClips went from %u to %u",
+				u32Clips, u32LC_PowerClips);
+
+		u64Scaled = 0;
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			u32Asked = au32ChannelPWM[i];
+			u32Output = au32ChannelOutput[i];
+			if (u32Asked == PWM_FULL_OFF)
+			{
+				HOST_CHECK(u32Output == PWM_FULL_OFF, "channel %u is off but puts out %u", i, u32Output);
+				continue;
+			}
+			if (!bOver)
+			{
+				HOST_CHECK(u32Output == u32Asked, "channel %u asks for %u within the budget, puts out %u",
+						i, u32Asked, u32Output);
+				continue;
+			}
+			/* Truncating the multiplier and the product loses up to 2 */
+			u32Ideal = (uint32)(((uint64)u32Asked * sLC_Settings.u32PowerBudget) / u32LC_PowerTotal);
+			if (u32Ideal < (PWM_ONE >> 1) + 2)
+			{
+				HOST_CHECK((u32Output == PWM_FULL_OFF) || (u32Output + 2 >= u32Ideal),
+						"channel %u asks for %u, scaled to %u, puts out %u", i, u32Asked, u32Ideal, u32Output);
+			}
+			else
+			{
+				HOST_CHECK((u32Output <= u32Ideal) && (u32Output + 2 >= u32Ideal),
+						"channel %u asks for %u, scaled to %u, puts out %u", i, u32Asked, u32Ideal, u32Output);
+			}
+			if (u32Output != PWM_FULL_OFF)
+			{
+				u64Scaled += (uint64)u32Output * au16LC_ChannelCurrent[i];
+			}
+		}
+		if (bOver)
+		{
+			HOST_CHECK(u64Scaled <= (uint64)sLC_Settings.u32PowerBudget * LC_PWM_MAX,
+					"%.2fmA after scaling, budget %u", (double)u64Scaled / LC_PWM_MAX, sLC_Settings.u32PowerBudget);
+		}
+		vTest_CheckRegisters();
+		if (u32HostFailures != u32Failures)
+			break;
+	}
+	vTest_Command("p 0");
+}
+
+/****************************************************************************
+ * NAME: vTest_BudgetFullDuty
+ *
+ * DESCRIPTION:
+ * The case the budget is for: every channel at full level, set up with the
+ * serial 'a' and 'p' commands. With equal currents every channel must come
+ * down to the same code, each command must count one clip, and raising the
+ * budget to PowerTotal must restore the full outputs.
+ ****************************************************************************/
+PRIVATE void vTest_BudgetFullDuty(void)
+{
+	uint32 u32Asked;
+	uint32 u32Total;
+	uint32 u32Clips;
+	char acCommand[32];
+	uint8 u8Bulb;
+	uint8 i;
+
+	vTest_Command("a 4095 500");
+	for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		DriverBulb_vSetOnOff(u8Bulb, TRUE);
+		vLI_SetCurrentValues(u8Bulb, 254, 255, 255, 255, 0);
+		vLI_UpdateDriver(u8Bulb);
+	}
+	u32HostSi_Run(HOST_SI_ALL);
+
+	u32Asked = au32ChannelPWM[0];
+	u32Total = (NUM_CHANNELS * 500 * ((u32Asked + PWM_ONE - 1) >> LC_PWM_FRAC_BITS) + 4094) / 4095;
+	u32Clips = u32LC_PowerClips;
+	vTest_Command("p 3000");
+	HOST_CHECK(u32LC_PowerTotal == u32Total, "PowerTotal %u at full level, expected %u",
+			u32LC_PowerTotal, u32Total);
+	HOST_CHECK(u32LC_PowerClips == u32Clips + 1, "'p' counted %u clips", u32LC_PowerClips - u32Clips);
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		HOST_CHECK(au32ChannelPWM[i] == u32Asked, "channel %u asks for %u, channel 0 for %u",
+				i, au32ChannelPWM[i], u32Asked);
+		HOST_CHECK(u32Test_Output(i) == (u32Asked * 3000 / u32Total + (PWM_ONE >> 1)) >> LC_PWM_FRAC_BITS,
+				"channel %u at code %u with %u of %umA allowed", i, u32Test_Output(i), 3000, u32Total);
+	}
+
+	/* Full level is full ON mode */
+	snprintf(acCommand, sizeof(acCommand), "p %u", u32Total);
+	vTest_Command(acCommand);
+	u32Asked = (u32Asked >= LC_PWM_MAX) ? LC_PWM_MAX : (u32Asked + (PWM_ONE >> 1)) >> LC_PWM_FRAC_BITS;
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		HOST_CHECK(u32Test_Output(i) == u32Asked, "channel %u not back to %u", i, u32Asked);
+	}
+	vTest_Command("p 0");
+}
+
+/****************************************************************************
+ * NAME: vTest_Runs
+ *
+ * DESCRIPTION:
+ * Every set of staged channels must go out in one transfer, with one
+ * START for each run of neighbouring channels: the address and register
+ * number for each run, and the 4 registers of each channel. The staged
+ * channels must then put out their new codes, and the others their old.
+ * Then a frame which changes every bulb must be one transfer.
+ ****************************************************************************/
+PRIVATE void vTest_Runs(void)
+{
+	uint32 au32Before[NUM_CHANNELS];
+	uint16 au16Code[NUM_CHANNELS];
+	tsHostSi sFrom;
+	uint32 u32Mask;
+	uint32 u32Runs;
+	uint32 u32Channels;
+	uint8 u8Bulb;
+	uint8 i;
+
+	for (u32Mask = 1; u32Mask < (1UL << NUM_CHANNELS); u32Mask++)
+	{
+		u32Runs = 0;
+		u32Channels = 0;
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			au32Before[i] = u32Test_Output(i);
+			if (u32Mask & (1UL << i))
+			{
+				au16Code[i] = (uint16)(1 + u32Host_Random() % 4094);
+				PCA9685_vSetPWM(i, au16Code[i]);
+				u32Channels++;
+				if ((i == 0) || !(u32Mask & (1UL << (i - 1))))
+				{
+					u32Runs++;
+				}
+			}
+		}
+		sFrom = sHostSi;
+		PCA9685_vWriteChannels();
+		u32HostSi_Run(HOST_SI_ALL);
+
+		if ((sHostSi.u32Transfers - sFrom.u32Transfers != 1)
+		 || (sHostSi.u32Starts - sFrom.u32Starts != u32Runs)
+		 || (sHostSi.u32Bytes - sFrom.u32Bytes != 2 * u32Runs + REG_LEDx_STRIDE * u32Channels))
+		{
+			HOST_CHECK(FALSE, "channels %03x: %u transfers, %u STARTs, %u bytes, expected 1, %u, %u",
+					u32Mask, sHostSi.u32Transfers - sFrom.u32Transfers, sHostSi.u32Starts - sFrom.u32Starts,
+					sHostSi.u32Bytes - sFrom.u32Bytes, u32Runs, 2 * u32Runs + REG_LEDx_STRIDE * u32Channels);
+			return;
+		}
+		HOST_CHECK(u16StagedChannels == 0, "channels %03x still staged", u32Mask);
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			HOST_CHECK(u32Test_Output(i) == ((u32Mask & (1UL << i)) ? au16Code[i] : au32Before[i]),
+					"channels %03x: channel %u puts out %u", u32Mask, i, u32Test_Output(i));
+		}
+	}
+
+	/* All channels are one run, 50 bytes on the Standard */
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		PCA9685_vSetPWM(i, (uint16)(100 + i));
+	}
+	sFrom = sHostSi;
+	PCA9685_vWriteChannels();
+	u32HostSi_Run(HOST_SI_ALL);
+	HOST_CHECK((sHostSi.u32Starts - sFrom.u32Starts == 1)
+			&& (sHostSi.u32Bytes - sFrom.u32Bytes == 2 + REG_LEDx_STRIDE * NUM_CHANNELS),
+			"all channels: %u STARTs, %u bytes", sHostSi.u32Starts - sFrom.u32Starts,
+			sHostSi.u32Bytes - sFrom.u32Bytes);
+
+	sFrom = sHostSi;
+	DriverBulb_vBeginFrame();
+	for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		DriverBulb_vSetOnOff(u8Bulb, TRUE);
+		vLI_SetCurrentValues(u8Bulb, 1 + u32Host_Random() % 254,
+				u32Host_Random() % 256, u32Host_Random() % 256, u32Host_Random() % 256, 0);
+		vLI_UpdateDriver(u8Bulb);
+	}
+	DriverBulb_vCommitFrame();
+	u32HostSi_Run(HOST_SI_ALL);
+	HOST_CHECK(sHostSi.u32Transfers - sFrom.u32Transfers == 1, "frame of every bulb took %u transfers",
+			sHostSi.u32Transfers - sFrom.u32Transfers);
+	vTest_CheckRegisters();
+}
+
+/****************************************************************************
+ * NAME: u32Test_Stage
+ *
+ * DESCRIPTION:
+ * Stages a random code on each channel in u32Mask, records it in
+ * pu16Code, and returns the number of runs of neighbouring channels
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Stage(uint32 u32Mask, uint16 *pu16Code)
+{
+	uint32 u32Runs = 0;
+	uint8 i;
+
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		if (u32Mask & (1UL << i))
+		{
+			pu16Code[i] = (uint16)(1 + u32Host_Random() % 4094);
+			PCA9685_vSetPWM(i, pu16Code[i]);
+			if ((i == 0) || !(u32Mask & (1UL << (i - 1))))
+			{
+				u32Runs++;
+			}
+		}
+	}
+	return u32Runs;
+}
+
+/****************************************************************************
+ * NAME: vTest_CheckCodes
+ *
+ * DESCRIPTION:
+ * Every channel must put out the last code staged on it
+ ****************************************************************************/
+PRIVATE void vTest_CheckCodes(const char *pcName, const uint16 *pu16Code)
+{
+	uint8 i;
+
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		HOST_CHECK(u32Test_Output(i) == pu16Code[i], "%s: channel %u puts out %u, expected %u",
+				pcName, i, u32Test_Output(i), pu16Code[i]);
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_Overlap
+ *
+ * DESCRIPTION:
+ * Frames committed while the bus is part way through the frames before
+ * them, so that they are chained on by the SI interrupt rather than
+ * started by the commit, and the queue and its data wrap round many
+ * times. Channels which don't fit stay staged and go with the next frame.
+ * Every channel must end up with the last code staged on it.
+ ****************************************************************************/
+PRIVATE void vTest_Overlap(void)
+{
+	uint16 au16Code[NUM_CHANNELS];
+	tsHostSi sFrom;
+	uint32 u32Frame;
+	uint32 u32Writes = 0;
+	uint8 u8Tail;
+
+	memset(au16Code, 0, sizeof(au16Code));
+	(void)u32Test_Stage((1UL << NUM_CHANNELS) - 1, au16Code);
+	PCA9685_vWriteChannels();
+	u32HostSi_Run(HOST_SI_ALL);
+
+	sFrom = sHostSi;
+	for (u32Frame = 0; u32Frame < TEST_OVERLAP_FRAMES; u32Frame++)
+	{
+		u8Tail = u8I2CQueueTail;
+		(void)u32Test_Stage(1 + u32Host_Random() % ((1UL << NUM_CHANNELS) - 1), au16Code);
+		PCA9685_vWriteChannels();
+		u32HostSi_Run(u32Host_Random() % 40);
+		u32Writes += (uint8)(u8I2CQueueTail - u8Tail);
+	}
+	while (DriverBulb_bDitherActive() || (eI2CState != E_I2C_IDLE))
+	{
+		PCA9685_vWriteChannels();
+		u32HostSi_Run(HOST_SI_ALL);
+	}
+	HOST_CHECK(u32Writes > 4 * 256, "only %u writes", u32Writes);
+	HOST_CHECK(sHostSi.u32Transfers - sFrom.u32Transfers < TEST_OVERLAP_FRAMES,
+			"%u transfers for %u frames: none merged", sHostSi.u32Transfers - sFrom.u32Transfers,
+			TEST_OVERLAP_FRAMES);
+	vTest_CheckCodes("overlapping frames", au16Code);
+}
+
+/****************************************************************************
+ * NAME: vTest_Chaining
+ *
+ * DESCRIPTION:
+ * A frame committed while another is going out must follow it as its own
+ * transfer, after its STOP, with one START per run in each
+ ****************************************************************************/
+PRIVATE void vTest_Chaining(void)
+{
+	uint16 au16Code[NUM_CHANNELS];
+	tsHostSi sFrom;
+	uint32 u32Runs;
+
+	memset(au16Code, 0, sizeof(au16Code));
+	(void)u32Test_Stage((1UL << NUM_CHANNELS) - 1, au16Code);
+	PCA9685_vWriteChannels();
+	u32HostSi_Run(HOST_SI_ALL);
+
+	sFrom = sHostSi;
+	u32Runs = u32Test_Stage(0x555, au16Code);
+	PCA9685_vWriteChannels();
+	u32HostSi_Run(3);
+	HOST_CHECK(eI2CState != E_I2C_IDLE, "bus idle part way through a frame");
+	u32Runs += u32Test_Stage(0x0f0, au16Code);
+	PCA9685_vWriteChannels();
+	u32HostSi_Run(HOST_SI_ALL);
+	HOST_CHECK((sHostSi.u32Transfers - sFrom.u32Transfers == 2) && (sHostSi.u32Starts - sFrom.u32Starts == u32Runs),
+			"chained frames: %u transfers, %u STARTs, expected 2, %u", sHostSi.u32Transfers - sFrom.u32Transfers,
+			sHostSi.u32Starts - sFrom.u32Starts, u32Runs);
+	vTest_CheckCodes("chained frames", au16Code);
+
+	/* The same with the SI interrupt taken straight after each byte is
+	 * started, including the START which PCA9685_vI2CCommit issues */
+	bHostSiInstant = TRUE;
+	sFrom = sHostSi;
+	u32Runs = u32Test_Stage(0x555, au16Code);
+	PCA9685_vWriteChannels();
+	u32Runs += u32Test_Stage(0xaaa, au16Code);
+	PCA9685_vWriteChannels();
+	bHostSiInstant = FALSE;
+	HOST_CHECK((eI2CState == E_I2C_IDLE) && (sHostSi.u32Transfers - sFrom.u32Transfers == 2)
+			&& (sHostSi.u32Starts - sFrom.u32Starts == u32Runs),
+			"immediate interrupts: %u transfers, %u STARTs, expected 2, %u", sHostSi.u32Transfers - sFrom.u32Transfers,
+			sHostSi.u32Starts - sFrom.u32Starts, u32Runs);
+	vTest_CheckCodes("immediate interrupts", au16Code);
+}
+
+/****************************************************************************
+ * NAME: vTest_Nacks
+ *
+ * DESCRIPTION:
+ * A transfer with any byte not acknowledged must count one error, however
+ * many bytes weren't, and the transfer after it none
+ ****************************************************************************/
+PRIVATE void vTest_Nacks(void)
+{
+	uint16 au16Code[NUM_CHANNELS];
+	uint32 u32Errors = DriverBulb_u32GetErrors();
+
+	/* Every byte of a 3 run transfer */
+	(void)u32Test_Stage(0x111, au16Code);
+	PCA9685_vWriteChannels();
+	u32HostSiNacks = 3 * 2 + 3 * REG_LEDx_STRIDE;
+	u32HostSi_Run(HOST_SI_ALL);
+	HOST_CHECK(DriverBulb_u32GetErrors() == u32Errors + 1, "%u errors for one transfer", DriverBulb_u32GetErrors() - u32Errors);
+
+	/* Only the address byte */
+	(void)u32Test_Stage(0x111, au16Code);
+	PCA9685_vWriteChannels();
+	u32HostSiNacks = 1;
+	u32HostSi_Run(HOST_SI_ALL);
+	HOST_CHECK(DriverBulb_u32GetErrors() == u32Errors + 2, "address NACK not counted");
+
+	/* Only the last byte, before the STOP */
+	(void)u32Test_Stage(0x111, au16Code);
+	PCA9685_vWriteChannels();
+	u32HostSi_Run(3 * 2 + 3 * REG_LEDx_STRIDE - 1);
+	u32HostSiNacks = 1;
+	u32HostSi_Run(HOST_SI_ALL);
+	HOST_CHECK(DriverBulb_u32GetErrors() == u32Errors + 3, "last byte NACK not counted");
+
+	(void)u32Test_Stage(0x111, au16Code);
+	PCA9685_vWriteChannels();
+	u32HostSi_Run(HOST_SI_ALL);
+	HOST_CHECK(DriverBulb_u32GetErrors() == u32Errors + 3, "NACK counted again in the next transfer");
+	HOST_CHECK(u32HostSiNacks == 0, "%u NACKs left over", u32HostSiNacks);
+}
+
+/****************************************************************************
+ * NAME: vTest_QueueFull
+ *
+ * DESCRIPTION:
+ * With the bus stopped, frames of 6 runs fill the queue. Channels which
+ * don't fit must stay staged, keep DriverBulb_bDitherActive TRUE, take
+ * the codes staged after them, merge with channels staged later, and go
+ * out in one transfer from DriverBulb_vDither once there is room.
+ ****************************************************************************/
+PRIVATE void vTest_QueueFull(void)
+{
+	uint16 au16Code[NUM_CHANNELS];
+	tsHostSi sFrom;
+	uint32 u32Frames = 0;
+
+	memset(au16Code, 0, sizeof(au16Code));
+	(void)u32Test_Stage((1UL << NUM_CHANNELS) - 1, au16Code);
+	PCA9685_vWriteChannels();
+	u32HostSi_Run(HOST_SI_ALL);
+
+	while ((u16StagedChannels == 0) && (u32Frames <= I2C_QUEUE_SIZE))
+	{
+		(void)u32Test_Stage(0x555, au16Code);
+		PCA9685_vWriteChannels();
+		u32Frames++;
+	}
+	HOST_CHECK(u32Frames == I2C_QUEUE_SIZE / 6 + 1, "queue held %u frames of 6 writes", u32Frames - 1);
+	HOST_CHECK((u16StagedChannels == 0x555) && DriverBulb_bDitherActive(), "staged %03x when the queue was full",
+			u16StagedChannels);
+
+	/* More channels merge in, still without room */
+	(void)u32Test_Stage(0x002, au16Code);
+	DriverBulb_vDither();
+	HOST_CHECK(u16StagedChannels == 0x557, "staged %03x", u16StagedChannels);
+
+	sFrom = sHostSi;
+	u32HostSi_Run(HOST_SI_ALL);
+	HOST_CHECK(sHostSi.u32Transfers - sFrom.u32Transfers == u32Frames - 1, "%u transfers queued",
+			sHostSi.u32Transfers - sFrom.u32Transfers);
+	sFrom = sHostSi;
+	DriverBulb_vDither();
+	u32HostSi_Run(HOST_SI_ALL);
+	HOST_CHECK((u16StagedChannels == 0) && !DriverBulb_bDitherActive(), "still staged %03x", u16StagedChannels);
+	HOST_CHECK((sHostSi.u32Transfers - sFrom.u32Transfers == 1) && (sHostSi.u32Starts - sFrom.u32Starts == 5),
+			"merged frame: %u transfers, %u STARTs, expected 1, 5", sHostSi.u32Transfers - sFrom.u32Transfers,
+			sHostSi.u32Starts - sFrom.u32Starts);
+	vTest_CheckCodes("queue full", au16Code);
+}
+
+/****************************************************************************
+ * NAME: vTest_DitherRun
+ *
+ * DESCRIPTION:
+ * Asks for pu32PWM on each channel, with dithering on, and runs the real
+ * DriverBulb_vDither for TEST_DITHER_TICKS ticks with the bus sending
+ * everything after each. Every tick must send at most DITHER_MAX_WRITES
+ * channels. Every output must be one of the two codes either side of its
+ * target, which for a target below one step are full OFF and 1, and
+ * otherwise are within 1 to 4095. The mean output of each channel must be
+ * within TEST_DITHER_TOLERANCE of its target. The largest difference is
+ * kept in pdWorst.
+ ****************************************************************************/
+PRIVATE void vTest_DitherRun(const char *pcName, const uint32 *pu32PWM, double *pdWorst)
+{
+	uint32 au32Sum[NUM_CHANNELS];
+	tsHostSi sFrom;
+	uint32 u32Output;
+	uint32 u32Below;
+	uint32 u32Tick;
+	double dError;
+	uint8 i;
+
+	sLC_Settings.bDither = TRUE;
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		au32ChannelPWM[i] = pu32PWM[i];
+		au32Sum[i] = 0;
+	}
+	u16DirtyChannels = (1 << NUM_CHANNELS) - 1;
+	PCA9685_vFlushChannels();
+	u32HostSi_Run(HOST_SI_ALL);
+
+	for (u32Tick = 0; u32Tick < TEST_DITHER_TICKS; u32Tick++)
+	{
+		sFrom = sHostSi;
+		DriverBulb_vDither();
+		u32HostSi_Run(HOST_SI_ALL);
+		HOST_CHECK(sHostSi.u32Bytes - sFrom.u32Bytes <= (2 + REG_LEDx_STRIDE) * DITHER_MAX_WRITES,
+				"%s: %u bytes in one tick", pcName, sHostSi.u32Bytes - sFrom.u32Bytes);
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			u32Output = u32Test_Output(i);
+			u32Output = (u32Output == PWM_FULL_OFF) ? 0 : u32Output;
+			u32Below = pu32PWM[i] >> LC_PWM_FRAC_BITS;
+			if ((u32Output != u32Below) && (u32Output != u32Below + 1))
+			{
+				HOST_CHECK(FALSE, "%s: channel %u asks for %u, puts out %u on tick %u",
+						pcName, i, pu32PWM[i], u32Output, u32Tick);
+				return;
+			}
+			au32Sum[i] += u32Output;
+		}
+	}
+
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		dError = fabs((double)au32Sum[i] * PWM_ONE / TEST_DITHER_TICKS - pu32PWM[i]);
+		*pdWorst = MAX(*pdWorst, dError);
+		HOST_CHECK(dError <= TEST_DITHER_TOLERANCE, "%s: channel %u asks for %u, mean %.3f",
+				pcName, i, pu32PWM[i], (double)au32Sum[i] * PWM_ONE / TEST_DITHER_TICKS);
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_Dither
+ *
+ * DESCRIPTION:
+ * Dithering below one step, near full scale, and with every channel
+ * changing, so that some are starved of writes on every tick
+ ****************************************************************************/
+PRIVATE void vTest_Dither(void)
+{
+	uint32 au32PWM[NUM_CHANNELS];
+	double dWorst = 0.0;
+	uint32 u32Round;
+	uint8 i;
+
+	/* Below one step on two channels, the rest steady */
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		au32PWM[i] = 100 << LC_PWM_FRAC_BITS;
+	}
+	au32PWM[0] = 10;
+	au32PWM[1] = 13;
+	au32PWM[2] = 20;
+	vTest_DitherRun("below one step", au32PWM, &dWorst);
+
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		au32PWM[i] = LC_PWM_MAX - (PWM_ONE >> 1) - 1 - i;
+	}
+	vTest_DitherRun("near full scale", au32PWM, &dWorst);
+
+	for (u32Round = 0; u32Round < TEST_DITHER_ROUNDS; u32Round++)
+	{
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			au32PWM[i] = (PWM_ONE >> 1) + u32Host_Random() % (LC_PWM_MAX - PWM_ONE);
+		}
+		vTest_DitherRun("every channel", au32PWM, &dWorst);
+	}
+	printf("Dither: largest error of the mean %.4f PWM steps\n", dWorst / PWM_ONE);
+
+	/* Back to the nearest codes */
+	sLC_Settings.bDither = FALSE;
+	u16DirtyChannels = (1 << NUM_CHANNELS) - 1;
+	PCA9685_vFlushChannels();
+	u32HostSi_Run(HOST_SI_ALL);
+	HOST_CHECK(!DriverBulb_bDitherActive(), "still dithering");
+	vTest_CheckRegisters();
+}
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+int main(void)
+{
+	DriverBulb_vInit();
+	vLC_LoadCalibrationFromNVM();
+	/* Dithering would move the outputs away from what was written, so it
+	 * is only on in vTest_Dither */
+	sLC_Settings.bDither = FALSE;
+
+	vTest_BudgetFullDuty();
+	vTest_Budget();
+	vTest_Runs();
+	vTest_Overlap();
+	vTest_Chaining();
+	vTest_Nacks();
+	vTest_QueueFull();
+	vTest_Dither();
+
+	HOST_CHECK(sHostSi.u32Violations == 0, "%u SI master violations", sHostSi.u32Violations);
+	HOST_CHECK(sHostSi.u32TornChannels == 0, "%u channels torn at a STOP", sHostSi.u32TornChannels);
+	return iHost_Result("test_pca9685");
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
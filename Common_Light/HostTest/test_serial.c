@@ -0,0 +1,1165 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          test_serial.c
+ *
+ * DESCRIPTION:        Host build: serial interface tests
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Tests of the serial interface in app_light_calibration.c, which is
+ * included here so that its private functions and state can be reached.
+ * Bytes go in and out through the UART model in HostStubs.c, and the
+ * firmware's APP_isrUart and APP_SerialTask are run as the device would
+ * run them. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <jendefs.h>
+#include "HostStubs.h"
+#include "HostDriver.h"
+#include "app_light_calibration.c"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Longest frame tried, before encoding */
+#define TEST_FRAME_MAX			(600)
+
+/* Longest response frame tried. It must fit in au8TxRing. */
+#define TEST_RESPONSE_MAX		(MIN(TEST_FRAME_MAX, TX_RING_SIZE - 16))
+
+/* Stream frames sent with random sequence numbers */
+#define TEST_STREAM_FRAMES		(20000)
+
+/* Random frames tried at each length */
+#define TEST_FRAMES_PER_LENGTH	(20)
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/* Read position in au8HostUartTx */
+PRIVATE uint32 u32TxRead;
+
+/* Activations of APP_SerialTask which it has been run for */
+PRIVATE uint32 u32TaskActivations;
+
+/* TX ring high water mark in the last telemetry record */
+PRIVATE uint16 u16TxHighWaterSeen;
+
+/* Frames tried whose encoding ends in a 0x01 code byte */
+PRIVATE uint32 u32TrailingCodes;
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: u16Test_Crc
+ *
+ * DESCRIPTION:
+ * CRC-16/CCITT-FALSE of a buffer, worked out independently of the firmware
+ ****************************************************************************/
+PRIVATE uint16 u16Test_Crc(const uint8 *pu8Data, uint32 u32Length)
+{
+	uint32 u32Crc = 0xffff;
+	uint32 i, j;
+
+	for (i = 0; i < u32Length; i++)
+	{
+		for (j = 0; j < 8; j++)
+		{
+			u32Crc <<= 1;
+			if (((u32Crc >> 16) ^ (pu8Data[i] >> (7 - j))) & 1)
+			{
+				u32Crc ^= 0x1021;
+			}
+		}
+	}
+	return (uint16)u32Crc;
+}
+
+/****************************************************************************
+ * NAME: u32Test_Encode
+ *
+ * DESCRIPTION:
+ * COBS encodes a buffer the usual way, without the 0 delimiter. A buffer
+ * which ends in 0, or in a block of 254 non-zero bytes, gets a last code
+ * byte of 0x01 with nothing after it.
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Encode(const uint8 *pu8In, uint32 u32Length, uint8 *pu8Out)
+{
+	uint32 u32Code = 0;
+	uint32 u32Out = 1;
+	uint32 i;
+
+	pu8Out[0] = 1;
+	for (i = 0; i < u32Length; i++)
+	{
+		if (pu8In[i] != 0)
+		{
+			pu8Out[u32Out++] = pu8In[i];
+			pu8Out[u32Code]++;
+		}
+		if ((pu8In[i] == 0) || (pu8Out[u32Code] == 0xff))
+		{
+			u32Code = u32Out++;
+			pu8Out[u32Code] = 1;
+		}
+	}
+	return u32Out;
+}
+
+/****************************************************************************
+ * NAME: u32Test_Decode
+ *
+ * DESCRIPTION:
+ * Decodes a COBS encoded buffer, without the delimiter, and returns the
+ * decoded length, or 0xffffffff if it is malformed
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Decode(const uint8 *pu8In, uint32 u32Length, uint8 *pu8Out)
+{
+	uint32 u32In = 0;
+	uint32 u32Out = 0;
+	uint32 u32Code;
+	uint32 i;
+
+	while (u32In < u32Length)
+	{
+		u32Code = pu8In[u32In++];
+		if ((u32Code == 0) || (u32In + u32Code - 1 > u32Length))
+		{
+			return 0xffffffff;
+		}
+		for (i = 1; i < u32Code; i++)
+		{
+			if (pu8In[u32In] == 0)
+			{
+				return 0xffffffff;
+			}
+			pu8Out[u32Out++] = pu8In[u32In++];
+		}
+		if ((u32Code != 0xff) && (u32In < u32Length))
+		{
+			pu8Out[u32Out++] = 0;
+		}
+	}
+	return u32Out;
+}
+
+/****************************************************************************
+ * NAME: u32Test_Frame
+ *
+ * DESCRIPTION:
+ * Builds an encoded frame, without the delimiter, from a command and its
+ * data: the CRC is added, most significant byte first, and it is all COBS
+ * encoded
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Frame(const uint8 *pu8Data, uint32 u32Length, uint8 *pu8Out)
+{
+	uint8 au8Plain[TEST_FRAME_MAX + 2];
+	uint16 u16Crc = u16Test_Crc(pu8Data, u32Length);
+
+	memcpy(au8Plain, pu8Data, u32Length);
+	au8Plain[u32Length] = (uint8)(u16Crc >> 8);
+	au8Plain[u32Length + 1] = (uint8)u16Crc;
+	return u32Test_Encode(au8Plain, u32Length + 2, pu8Out);
+}
+
+/****************************************************************************
+ * NAME: vTest_RandomData
+ *
+ * DESCRIPTION:
+ * Fills a buffer with random bytes. Pattern 0 has no zeros, 1 is all
+ * zeros, and the others have a zero in about 1 of 2^u8Pattern bytes.
+ ****************************************************************************/
+PRIVATE void vTest_RandomData(uint8 *pu8Data, uint32 u32Length, uint8 u8Pattern)
+{
+	uint32 i;
+
+	for (i = 0; i < u32Length; i++)
+	{
+		if (u8Pattern == 1)
+		{
+			pu8Data[i] = 0;
+		}
+		else if ((u8Pattern != 0) && ((u32Host_Random() & ((1 << u8Pattern) - 1)) == 0))
+		{
+			pu8Data[i] = 0;
+		}
+		else
+		{
+			pu8Data[i] = (uint8)(1 + u32Host_Random() % 255);
+		}
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_ZeroCrcLow
+ *
+ * DESCRIPTION:
+ * Changes the last data byte until the low byte of the CRC is 0, so that
+ * the encoded frame ends in a 0x01 code byte
+ ****************************************************************************/
+PRIVATE void vTest_ZeroCrcLow(uint8 *pu8Frame, uint32 u32Length)
+{
+	uint32 i;
+
+	for (i = 0; i < 256; i++)
+	{
+		pu8Frame[u32Length - 1] = (uint8)i;
+		if ((u16Test_Crc(pu8Frame, u32Length) & 0xff) == 0)
+		{
+			return;
+		}
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_Crc
+ *
+ * DESCRIPTION:
+ * u16LC_Crc16 must give the CRC-16/CCITT-FALSE check value
+ ****************************************************************************/
+PRIVATE void vTest_Crc(void)
+{
+	const char *pcCheck = "123456789";
+	uint16 u16Crc = 0xffff;
+	uint8 i;
+
+	for (i = 0; i < 9; i++)
+	{
+		u16Crc = u16LC_Crc16(u16Crc, (uint8)pcCheck[i]);
+	}
+	HOST_CHECK(u16Crc == 0x29b1, "CRC of \"123456789\" is %04x", u16Crc);
+	HOST_CHECK(u16Test_Crc((const uint8 *)pcCheck, 9) == 0x29b1, "reference CRC is wrong");
+}
+
+/****************************************************************************
+ * NAME: vTest_Decode
+ *
+ * DESCRIPTION:
+ * u16LC_DecodeFrame must give back every frame the reference encoder
+ * encodes, at every length, and reject frames which are cut short or have
+ * a changed data byte
+ ****************************************************************************/
+PRIVATE void vTest_Decode(void)
+{
+	uint8 au8Data[TEST_FRAME_MAX];
+	uint8 au8Encoded[TEST_FRAME_MAX * 2];
+	uint8 au8Frame[TEST_FRAME_MAX * 2];
+	uint8 au8Decoded[TEST_FRAME_MAX * 2];
+	uint32 u32Encoded;
+	uint32 u32Length;
+	uint32 u32Byte;
+	uint16 u16Decoded;
+	uint8 i;
+
+	for (u32Length = 1; u32Length <= TEST_FRAME_MAX; u32Length++)
+	{
+		for (i = 0; i < TEST_FRAMES_PER_LENGTH; i++)
+		{
+			vTest_RandomData(au8Data, u32Length, i % 10);
+			if (i >= 10)
+			{
+				vTest_ZeroCrcLow(au8Data, u32Length);
+			}
+			u32Encoded = u32Test_Frame(au8Data, u32Length, au8Encoded);
+			if (au8Encoded[u32Encoded - 1] == 0x01)
+			{
+				u32TrailingCodes++;
+			}
+
+			memcpy(au8Frame, au8Encoded, u32Encoded);
+			u16Decoded = u16LC_DecodeFrame(au8Frame, (uint16)u32Encoded);
+			if ((u16Decoded != u32Length) || (memcmp(au8Frame, au8Data, u32Length) != 0))
+			{
+				HOST_CHECK(FALSE, "%u byte frame, pattern %u: decoded to %u bytes",
+						u32Length, i, u16Decoded);
+				return;
+			}
+
+			/* Cut short before the last code byte's data */
+			memcpy(au8Frame, au8Encoded, u32Encoded);
+			u32Byte = u32Encoded - 1;
+			while ((u32Byte > 0) && (au8Encoded[u32Byte] == 1))
+			{
+				u32Byte--;
+			}
+			HOST_CHECK(u16LC_DecodeFrame(au8Frame, (uint16)u32Byte) == 0,
+					"%u byte frame cut to %u bytes was accepted", u32Length, u32Byte);
+
+			/* Any changed data byte must fail the CRC */
+			memcpy(au8Frame, au8Encoded, u32Encoded);
+			u32Byte = u32Host_Random() % u32Encoded;
+			if (au8Frame[u32Byte] != 0x01)
+			{
+				au8Frame[u32Byte] = (uint8)(1 + (au8Frame[u32Byte] + u32Host_Random() % 254) % 255);
+			}
+			if ((au8Frame[u32Byte] != au8Encoded[u32Byte]) && (u32Test_Decode(au8Frame, u32Encoded, au8Decoded) == u32Length + 2))
+			{
+				HOST_CHECK(u16LC_DecodeFrame(au8Frame, (uint16)u32Encoded) == 0,
+						"%u byte frame with byte %u changed was accepted", u32Length, u32Byte);
+			}
+		}
+	}
+	au8Frame[0] = 0x01;
+	au8Frame[1] = 0x01;
+	HOST_CHECK(u16LC_DecodeFrame(au8Frame, 2) == 0, "frame too short to hold a CRC was accepted");
+}
+
+/****************************************************************************
+ * NAME: bTest_Response
+ *
+ * DESCRIPTION:
+ * Checks a response frame encoded into au8TxRing from u16From to u16TxHead:
+ * one 0 at the end and none before it, a CRC which checks out, and the
+ * command, status and data given
+ ****************************************************************************/
+PRIVATE bool_t bTest_Response(uint16 u16From, uint8 u8Command, uint8 u8Status, const uint8 *pu8Data, uint32 u32Length)
+{
+	uint8 au8Encoded[TX_RING_SIZE];
+	uint8 au8Decoded[TX_RING_SIZE];
+	uint32 u32Encoded = (uint16)(u16TxHead - u16From);
+	uint32 u32Decoded;
+	uint32 i;
+
+	for (i = 0; i < u32Encoded; i++)
+	{
+		au8Encoded[i] = au8TxRing[(u16From + i) & (TX_RING_SIZE - 1)];
+	}
+	if ((u32Encoded < 2) || (au8Encoded[u32Encoded - 1] != 0) || (memchr(au8Encoded, 0, u32Encoded - 1) != NULL))
+	{
+		HOST_CHECK(FALSE, "%u byte response: not one frame", u32Length);
+		return FALSE;
+	}
+	if (au8Encoded[u32Encoded - 2] == 0x01)
+	{
+		u32TrailingCodes++;
+	}
+	u32Decoded = u32Test_Decode(au8Encoded, u32Encoded - 1, au8Decoded);
+	if ((u32Decoded != u32Length + 4)
+	 || (u16Test_Crc(au8Decoded, u32Decoded) != 0)
+	 || (au8Decoded[0] != (u8Command | BIN_RESPONSE))
+	 || (au8Decoded[1] != u8Status)
+	 || (memcmp(&au8Decoded[2], pu8Data, u32Length) != 0))
+	{
+		HOST_CHECK(FALSE, "%u byte response: decoded to %u bytes, wrong", u32Length, u32Decoded);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/****************************************************************************
+ * NAME: vTest_Encode
+ *
+ * DESCRIPTION:
+ * Every response the firmware encodes must decode with the reference
+ * decoder, at every length up to TEST_RESPONSE_MAX. This crosses the 254
+ * byte COBS block boundary, and includes responses whose CRC ends in 0.
+ ****************************************************************************/
+PRIVATE void vTest_Encode(void)
+{
+	uint8 au8Data[2 + TEST_FRAME_MAX];
+	uint32 u32Length;
+	uint16 u16From;
+	uint32 j;
+	uint8 i;
+
+	for (u32Length = 0; u32Length <= TEST_RESPONSE_MAX; u32Length++)
+	{
+		for (i = 0; i < TEST_FRAMES_PER_LENGTH; i++)
+		{
+			au8Data[0] = BIN_CMD_GET_CHANNELS | BIN_RESPONSE;
+			au8Data[1] = BIN_STATUS_OK;
+			vTest_RandomData(&au8Data[2], u32Length, i % 10);
+			if ((i >= 10) && (u32Length > 0))
+			{
+				vTest_ZeroCrcLow(au8Data, u32Length + 2);
+			}
+
+			/* As if everything before had been sent */
+			u16TxTail = u16TxHead;
+			u16From = u16TxHead;
+			vLC_BinaryBegin(BIN_CMD_GET_CHANNELS, BIN_STATUS_OK);
+			for (j = 0; j < u32Length; j++)
+			{
+				vLC_BinaryPutByte(au8Data[2 + j]);
+			}
+			vLC_BinaryEnd();
+			if (!bTest_Response(u16From, BIN_CMD_GET_CHANNELS, BIN_STATUS_OK, &au8Data[2], u32Length))
+				return;
+		}
+	}
+	u16TxTail = u16TxHead;
+}
+
+/****************************************************************************
+ * NAME: bTest_Step
+ *
+ * DESCRIPTION:
+ * Runs APP_isrUart if a FIFO's worth of bytes has arrived, there is a
+ * break, or the TX FIFO empty interrupt is raised, then APP_SerialTask if
+ * it has been activated, and then lets one character time pass. Returns
+ * FALSE once there is nothing left to do.
+ ****************************************************************************/
+PRIVATE bool_t bTest_Step(void)
+{
+	uint32 u32Polls = u32HostUartTemtPolls;
+	bool_t bBusy = FALSE;
+
+	(void)u16Host_UartFillRxFifo();
+	if (bHost_UartInterrupt())
+	{
+		os_vAPP_isrUart();
+		/* It reads the line status for a break and for TEMT, but doesn't
+		 * wait for TEMT */
+		HOST_CHECK(u32HostUartTemtPolls - u32Polls <= 2, "APP_isrUart polled TEMT %u times",
+				u32HostUartTemtPolls - u32Polls);
+		bBusy = TRUE;
+	}
+	if (u32HostSerialActivations != u32TaskActivations)
+	{
+		u32TaskActivations = u32HostSerialActivations;
+		os_vAPP_SerialTask();
+		bBusy = TRUE;
+	}
+	if (bHost_UartSendCharacter())
+	{
+		bBusy = TRUE;
+	}
+	return bBusy;
+}
+
+/****************************************************************************
+ * NAME: vTest_Run
+ *
+ * DESCRIPTION:
+ * Runs the board until it has dealt with everything it has received, and
+ * sent everything it has to send
+ ****************************************************************************/
+PRIVATE void vTest_Run(void)
+{
+	while (bTest_Step());
+	if (u16TxTail != u16TxHead)
+	{
+		/* Bytes queued without the interrupt on */
+		HOST_CHECK(FALSE, "%u bytes stuck in the TX ring", (uint16)(u16TxHead - u16TxTail));
+		u16TxTail = u16TxHead;
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_Send
+ *
+ * DESCRIPTION:
+ * Sends bytes to the board, and runs it until it has dealt with them
+ ****************************************************************************/
+PRIVATE void vTest_Send(const uint8 *pu8Data, uint32 u32Length)
+{
+	vHost_UartReceive(pu8Data, u32Length);
+	vTest_Run();
+}
+
+/****************************************************************************
+ * NAME: bTest_SendFrame
+ *
+ * DESCRIPTION:
+ * Sends a command frame with its delimiter, and returns whether its
+ * encoding ended in a 0x01 code byte
+ ****************************************************************************/
+PRIVATE bool_t bTest_SendFrame(const uint8 *pu8Data, uint32 u32Length)
+{
+	uint8 au8Encoded[TEST_FRAME_MAX * 2 + 1];
+	uint32 u32Encoded = u32Test_Frame(pu8Data, u32Length, au8Encoded);
+
+	au8Encoded[u32Encoded] = 0;
+	vTest_Send(au8Encoded, u32Encoded + 1);
+	return (au8Encoded[u32Encoded - 1] == 0x01);
+}
+
+/****************************************************************************
+ * NAME: u32Test_Receive
+ *
+ * DESCRIPTION:
+ * Takes the next response frame the board has sent, decodes it and checks
+ * its CRC. Returns its length without the CRC, or 0 if there is none or it
+ * is bad.
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Receive(uint8 *pu8Response)
+{
+	uint8 au8Decoded[TX_RING_SIZE];
+	const uint8 *pu8End;
+	uint32 u32Encoded;
+	uint32 u32Decoded;
+
+	pu8End = memchr(&au8HostUartTx[u32TxRead], 0, u32HostUartTxLength - u32TxRead);
+	if (pu8End == NULL)
+	{
+		return 0;
+	}
+	u32Encoded = (uint32)(pu8End - &au8HostUartTx[u32TxRead]);
+	u32Decoded = u32Test_Decode(&au8HostUartTx[u32TxRead], u32Encoded, au8Decoded);
+	u32TxRead += u32Encoded + 1;
+	if ((u32Decoded == 0xffffffff) || (u32Decoded < 4) || (u16Test_Crc(au8Decoded, u32Decoded) != 0))
+	{
+		return 0;
+	}
+	memcpy(pu8Response, au8Decoded, u32Decoded - 2);
+	return u32Decoded - 2;
+}
+
+/****************************************************************************
+ * NAME: bTest_ReceiveText
+ *
+ * DESCRIPTION:
+ * Whether the board's next output is pcText
+ ****************************************************************************/
+PRIVATE bool_t bTest_ReceiveText(const char *pcText)
+{
+	uint32 u32Length = strlen(pcText);
+
+	if ((u32HostUartTxLength - u32TxRead < u32Length)
+	 || (memcmp(&au8HostUartTx[u32TxRead], pcText, u32Length) != 0))
+	{
+		return FALSE;
+	}
+	u32TxRead += u32Length;
+	return TRUE;
+}
+
+/****************************************************************************
+ * NAME: u32Test_Command
+ *
+ * DESCRIPTION:
+ * Sends a command frame, and takes the response as u32Test_Receive does
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Command(const uint8 *pu8Data, uint32 u32Length, uint8 *pu8Response)
+{
+	bTest_SendFrame(pu8Data, u32Length);
+	return u32Test_Receive(pu8Response);
+}
+
+/****************************************************************************
+ * NAME: u32Test_U32
+ *
+ * DESCRIPTION:
+ * Reads a 32 bit value from a response, least significant byte first
+ ****************************************************************************/
+PRIVATE uint32 u32Test_U32(const uint8 *pu8Data)
+{
+	return pu8Data[0] | (pu8Data[1] << 8) | (pu8Data[2] << 16) | ((uint32)pu8Data[3] << 24);
+}
+
+/****************************************************************************
+ * NAME: u16Test_U16
+ *
+ * DESCRIPTION:
+ * Reads a 16 bit value from a response, least significant byte first
+ ****************************************************************************/
+PRIVATE uint16 u16Test_U16(const uint8 *pu8Data)
+{
+	return (uint16)(pu8Data[0] | (pu8Data[1] << 8));
+}
+
+/****************************************************************************
+ * NAME: vTest_BinaryMode
+ *
+ * DESCRIPTION:
+ * Binary mode through the UART: 'e', frames which end in a 0x01 code
+ * byte, frames which fail, and BIN_CMD_EXIT back to lines
+ ****************************************************************************/
+PRIVATE void vTest_BinaryMode(void)
+{
+	uint8 au8Frame[TEST_FRAME_MAX];
+	uint8 au8Response[TX_RING_SIZE];
+	uint32 u32Length;
+	uint32 u32Errors;
+	uint16 u16Value;
+	bool_t bTrailing;
+
+	vTest_Send((const uint8 *)"e\r\n", 3);
+	HOST_CHECK(bTest_ReceiveText("Binary\r\n"), "no reply to 'e'");
+
+	au8Frame[0] = BIN_CMD_PING;
+	bTest_SendFrame(au8Frame, 1);
+	u32Length = u32Test_Receive(au8Response);
+	HOST_CHECK((u32Length == 2 + strlen(BOARD_VERSION))
+			&& (au8Response[0] == (BIN_CMD_PING | BIN_RESPONSE)) && (au8Response[1] == BIN_STATUS_OK)
+			&& (memcmp(&au8Response[2], BOARD_VERSION, strlen(BOARD_VERSION)) == 0),
+			"bad ping response, %u bytes", u32Length);
+
+	/* A brightness whose frame ends in a 0x01 code byte */
+	au8Frame[0] = BIN_CMD_SET_CHANNEL;
+	au8Frame[1] = 1;
+	au8Frame[2] = BIN_SETTING_BRIGHTNESS;
+	for (u16Value = 500; u16Value < 1500; u16Value++)
+	{
+		au8Frame[3] = (uint8)u16Value;
+		au8Frame[4] = (uint8)(u16Value >> 8);
+		if ((u16Test_Crc(au8Frame, 5) & 0xff) == 0)
+			break;
+	}
+	bTrailing = bTest_SendFrame(au8Frame, 5);
+	HOST_CHECK(bTrailing, "no brightness gives a CRC ending in 0");
+	u32Length = u32Test_Receive(au8Response);
+	HOST_CHECK((u32Length == 2) && (au8Response[1] == BIN_STATUS_OK), "frame ending in 0x01 not accepted");
+	HOST_CHECK(atsLC_Calibration[1].u16Brightness == u16Value, "brightness %u, expected %u",
+			atsLC_Calibration[1].u16Brightness, u16Value);
+
+	/* A bad CRC, and a frame too long for au8BinFrame, are dropped
+	 * without a response */
+	u32Errors = u32LC_FrameErrors;
+	au8Frame[3] ^= 0x40;
+	u32Length = u32Test_Frame(au8Frame, 5, au8Response);
+	au8Response[u32Length - 1] ^= 0x20;
+	au8Response[u32Length] = 0;
+	vTest_Send(au8Response, u32Length + 1);
+	memset(au8Frame, 0x55, sizeof(au8Frame));
+	au8Frame[0] = BIN_CMD_PING;
+	bTest_SendFrame(au8Frame, BIN_FRAME_SIZE);
+	HOST_CHECK(u32LC_FrameErrors == u32Errors + 2, "%u frame errors, expected 2", u32LC_FrameErrors - u32Errors);
+	HOST_CHECK(u32TxRead == u32HostUartTxLength, "response to a bad frame");
+	HOST_CHECK(atsLC_Calibration[1].u16Brightness == u16Value, "bad frame changed the brightness");
+
+	au8Frame[0] = BIN_CMD_EXIT;
+	bTest_SendFrame(au8Frame, 1);
+	u32Length = u32Test_Receive(au8Response);
+	HOST_CHECK((u32Length == 2) && (au8Response[0] == (BIN_CMD_EXIT | BIN_RESPONSE)), "bad exit response");
+	vTest_Send((const uint8 *)"v\r\n", 3);
+	HOST_CHECK(bTest_ReceiveText(BOARD_VERSION) && bTest_ReceiveText("\r\n"), "not back to lines after BIN_CMD_EXIT");
+}
+
+/****************************************************************************
+ * NAME: vTest_Stream
+ *
+ * DESCRIPTION:
+ * Stream frames through the UART. A frame is shown if its sequence number
+ * is up to 127 ahead of the last one shown, and the numbers it skipped are
+ * counted as dropped; otherwise it is late, and is neither shown nor
+ * answered. This goes round the 8 bit sequence many times, with gaps,
+ * repeats and old frames, and checks the output and counts after each.
+ ****************************************************************************/
+PRIVATE void vTest_Stream(void)
+{
+	uint8 au8Frame[2 + 2 * NUM_CHANNELS];
+	uint8 au8Response[TX_RING_SIZE];
+	uint16 au16Shown[NUM_CHANNELS];
+	uint32 u32Shown = 0;
+	uint32 u32Dropped = 0;
+	uint32 u32Late = 0;
+	uint32 u32Refreshes;
+	uint32 u32Length;
+	uint32 u32Frame;
+	uint32 u32Pick;
+	uint16 u16Value;
+	uint8 u8Sequence = 0;
+	uint8 u8Ahead;
+	uint8 i;
+
+	vTest_Send((const uint8 *)"e\r\n", 3);
+	HOST_CHECK(bTest_ReceiveText("Binary\r\n"), "no reply to 'e'");
+
+	/* Frames are refused until the stream starts */
+	au8Frame[0] = BIN_CMD_STREAM_FRAME;
+	memset(&au8Frame[1], 1, 1 + 2 * NUM_CHANNELS);
+	u32Length = u32Test_Command(au8Frame, 2 + 2 * NUM_CHANNELS, au8Response);
+	HOST_CHECK((u32Length == 2) && (au8Response[1] == BIN_STATUS_BAD_VALUE), "frame accepted before the stream started");
+
+	au8Frame[0] = BIN_CMD_STREAM_START;
+	au8Frame[1] = 0;
+	u32Length = u32Test_Command(au8Frame, 2, au8Response);
+	HOST_CHECK((u32Length == 2) && (au8Response[1] == BIN_STATUS_OK) && bLC_Streaming, "stream didn't start");
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		HOST_CHECK(u32LC_GetStreamPWM(i) == 0, "channel %u on before the first frame", i);
+	}
+
+	/* Wrong length */
+	au8Frame[0] = BIN_CMD_STREAM_FRAME;
+	u32Length = u32Test_Command(au8Frame, 1 + 2 * NUM_CHANNELS, au8Response);
+	HOST_CHECK((u32Length == 2) && (au8Response[1] == BIN_STATUS_BAD_LENGTH), "short frame accepted");
+
+	for (u32Frame = 0; u32Frame < TEST_STREAM_FRAMES; u32Frame++)
+	{
+		/* The first frame sets the sequence. After that, mostly the next
+		 * frame, then gaps of up to 127, repeats, old frames and ones far
+		 * enough ahead to count as behind. */
+		u32Pick = u32Host_Random() % 16;
+		if (u32Frame == 0)
+		{
+			u8Ahead = 250;
+		}
+		else if (u32Pick < 8)
+		{
+			u8Ahead = 1;
+		}
+		else if (u32Pick < 11)
+		{
+			u8Ahead = (uint8)(2 + u32Host_Random() % 126);
+		}
+		else if (u32Pick == 11)
+		{
+			u8Ahead = (u32Host_Random() & 1) ? 127 : 128;
+		}
+		else if (u32Pick == 12)
+		{
+			u8Ahead = 0;
+		}
+		else
+		{
+			u8Ahead = (uint8)(128 + u32Host_Random() % 128);
+		}
+
+		au8Frame[0] = BIN_CMD_STREAM_FRAME;
+		au8Frame[1] = (uint8)(u8Sequence + u8Ahead);
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			/* Values over STREAM_VALUE_MAX are clipped */
+			u16Value = (uint16)(u32Host_Random() % 5000);
+			au8Frame[2 + 2 * i] = (uint8)u16Value;
+			au8Frame[3 + 2 * i] = (uint8)(u16Value >> 8);
+		}
+
+		u32Refreshes = u32HostRefreshes;
+		bTest_SendFrame(au8Frame, 2 + 2 * NUM_CHANNELS);
+		if ((u32Frame == 0) || ((u8Ahead >= 1) && (u8Ahead <= 127)))
+		{
+			if (u32Frame > 0)
+			{
+				u32Dropped += u8Ahead - 1;
+			}
+			u32Shown++;
+			u8Sequence = au8Frame[1];
+			for (i = 0; i < NUM_CHANNELS; i++)
+			{
+				au16Shown[i] = (uint16)MIN(au8Frame[2 + 2 * i] | (au8Frame[3 + 2 * i] << 8), STREAM_VALUE_MAX);
+			}
+			HOST_CHECK(u32HostRefreshes == u32Refreshes + 1, "frame %u shown without a refresh", u32Frame);
+		}
+		else
+		{
+			u32Late++;
+			HOST_CHECK(u32HostRefreshes == u32Refreshes, "late frame %u refreshed the outputs", u32Frame);
+		}
+		HOST_CHECK(u32TxRead == u32HostUartTxLength, "response to stream frame %u", u32Frame);
+
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			if (u32LC_GetStreamPWM(i) != ((uint32)au16Shown[i] << LC_PWM_FRAC_BITS))
+			{
+				HOST_CHECK(FALSE, "frame %u, %u ahead: channel %u is %u, expected %u", u32Frame, u8Ahead, i,
+						u32LC_GetStreamPWM(i) >> LC_PWM_FRAC_BITS, au16Shown[i]);
+				return;
+			}
+		}
+		if ((u32LC_StreamShown != u32Shown) || (u32LC_StreamDropped != u32Dropped) || (u32LC_StreamLate != u32Late))
+		{
+			HOST_CHECK(FALSE, "frame %u, %u ahead: shown %u dropped %u late %u, expected %u %u %u",
+					u32Frame, u8Ahead, u32LC_StreamShown, u32LC_StreamDropped, u32LC_StreamLate,
+					u32Shown, u32Dropped, u32Late);
+			return;
+		}
+	}
+
+	au8Frame[0] = BIN_CMD_STREAM_STOP;
+	u32Length = u32Test_Command(au8Frame, 1, au8Response);
+	HOST_CHECK((u32Length == 14) && (au8Response[1] == BIN_STATUS_OK)
+			&& (u32Test_U32(&au8Response[2]) == u32Shown)
+			&& (u32Test_U32(&au8Response[6]) == u32Dropped)
+			&& (u32Test_U32(&au8Response[10]) == u32Late),
+			"bad stream stop response");
+	HOST_CHECK(!bLC_Streaming, "still streaming after BIN_CMD_STREAM_STOP");
+	printf("Stream: %u frames shown, %u dropped, %u late\n", u32Shown, u32Dropped, u32Late);
+
+	/* A new stream starts its sequence again */
+	au8Frame[0] = BIN_CMD_STREAM_START;
+	au8Frame[1] = 0;
+	u32Test_Command(au8Frame, 2, au8Response);
+	au8Frame[0] = BIN_CMD_STREAM_FRAME;
+	au8Frame[1] = u8Sequence;
+	bTest_SendFrame(au8Frame, 2 + 2 * NUM_CHANNELS);
+	HOST_CHECK((u32LC_StreamShown == 1) && (u32LC_StreamLate == 0), "new stream didn't resynchronise");
+	au8Frame[0] = BIN_CMD_STREAM_STOP;
+	u32Test_Command(au8Frame, 1, au8Response);
+
+	au8Frame[0] = BIN_CMD_EXIT;
+	u32Test_Command(au8Frame, 1, au8Response);
+}
+
+/****************************************************************************
+ * NAME: u32Test_Subscribe
+ *
+ * DESCRIPTION:
+ * Sends BIN_CMD_SUBSCRIBE for a period in ms. Returns the period in the
+ * response, or 0xffffffff if the command was refused.
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Subscribe(uint16 u16Period)
+{
+	uint8 au8Frame[3];
+	uint8 au8Response[TX_RING_SIZE];
+	uint32 u32Length;
+
+	au8Frame[0] = BIN_CMD_SUBSCRIBE;
+	au8Frame[1] = (uint8)u16Period;
+	au8Frame[2] = (uint8)(u16Period >> 8);
+	u32Length = u32Test_Command(au8Frame, 3, au8Response);
+	if ((u32Length == 4) && (au8Response[0] == (BIN_CMD_SUBSCRIBE | BIN_RESPONSE)) && (au8Response[1] == BIN_STATUS_OK))
+	{
+		return u16Test_U16(&au8Response[2]);
+	}
+	HOST_CHECK((u32Length == 2) && (au8Response[1] == BIN_STATUS_BAD_VALUE), "bad response to a %u ms subscription", u16Period);
+	return 0xffffffff;
+}
+
+/****************************************************************************
+ * NAME: u32Test_Records
+ *
+ * DESCRIPTION:
+ * Takes the telemetry records the board has sent, checks each against
+ * what it was given, and returns how many there were. pu16Sequence is the
+ * sequence number the first is expected to have, and is moved on past the
+ * last; records may be missing if bGaps is TRUE.
+ ****************************************************************************/
+PRIVATE uint32 u32Test_Records(uint16 *pu16Sequence, bool_t bGaps)
+{
+	uint8 au8Response[TX_RING_SIZE];
+	uint32 u32Records = 0;
+	uint32 u32Length;
+	uint16 u16Sequence;
+	uint8 i;
+
+	while (u32TxRead < u32HostUartTxLength)
+	{
+		u32Length = u32Test_Receive(au8Response);
+		if ((u32Length != 23 + 2 * NUM_CHANNELS) || (au8Response[0] != (BIN_CMD_TELEMETRY | BIN_RESPONSE))
+		 || (au8Response[1] != BIN_STATUS_OK))
+		{
+			HOST_CHECK(FALSE, "bad telemetry record, %u bytes", u32Length);
+			return u32Records;
+		}
+		u16Sequence = u16Test_U16(&au8Response[2]);
+		HOST_CHECK((u16Sequence == *pu16Sequence) || (bGaps && ((int16)(u16Sequence - *pu16Sequence) > 0)),
+				"telemetry record %u, expected %u", u16Sequence, *pu16Sequence);
+		*pu16Sequence = (uint16)(u16Sequence + 1);
+
+		HOST_CHECK((int16)u16Test_U16(&au8Response[4]) == i16HostTemperature, "temperature %d",
+				(int16)u16Test_U16(&au8Response[4]));
+		HOST_CHECK(au8Response[6] == (bOverheat ? 1 : 0), "flags %02x", au8Response[6]);
+		HOST_CHECK((u32Test_U32(&au8Response[7]) == u32TickOverruns)
+				&& (u32Test_U32(&au8Response[11]) == u32TickMaxLate)
+				&& (u32Test_U32(&au8Response[15]) == u32HostDriverErrors),
+				"bad tick or driver counts");
+		/* The TX ring may have filled further since the record was made */
+		HOST_CHECK((u16Test_U16(&au8Response[19]) == u16RxHighWater)
+				&& (u16Test_U16(&au8Response[21]) >= u16TxHighWaterSeen)
+				&& (u16Test_U16(&au8Response[21]) <= u16TxHighWater),
+				"ring high water marks %u %u, expected %u %u", u16Test_U16(&au8Response[19]),
+				u16Test_U16(&au8Response[21]), u16RxHighWater, u16TxHighWater);
+		u16TxHighWaterSeen = u16Test_U16(&au8Response[21]);
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			HOST_CHECK(u16Test_U16(&au8Response[23 + 2 * i]) == au16HostChannelPWM[i], "channel %u PWM %u, expected %u",
+					i, u16Test_U16(&au8Response[23 + 2 * i]), au16HostChannelPWM[i]);
+		}
+		u32Records++;
+	}
+	return u32Records;
+}
+
+/****************************************************************************
+ * NAME: vTest_Telemetry
+ *
+ * DESCRIPTION:
+ * BIN_CMD_SUBSCRIBE periods, the records pushed every period by
+ * vLC_TelemetryTick and their layout, records dropped while au8TxRing is
+ * full, and no more records after a period of 0 or BIN_CMD_EXIT
+ ****************************************************************************/
+PRIVATE void vTest_Telemetry(void)
+{
+	const uint16 au16Period[][2] = {
+		{1, 100}, {99, 100}, {100, 100}, {101, 200}, {250, 300},
+		{1000, 1000}, {59901, 60000}, {60000, 60000}
+	};
+	uint8 au8Frame[2];
+	uint8 au8Response[TX_RING_SIZE];
+	uint16 u16Sequence = 0;
+	uint32 u32Records;
+	uint32 u32Length;
+	uint32 u32Tick;
+	uint32 u32Fit;
+	uint8 i;
+
+	vTest_Send((const uint8 *)"e\r\n", 3);
+	HOST_CHECK(bTest_ReceiveText("Binary\r\n"), "no reply to 'e'");
+
+	i16HostTemperature = -12;
+	bOverheat = TRUE;
+	u32TickOverruns = 0x12345678;
+	u32TickMaxLate = 0x9abcdef0;
+	u32HostDriverErrors = 0x0f1e2d3c;
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		au16HostChannelPWM[i] = (uint16)(0x1001 * (i + 1));
+	}
+
+	/* Asked for */
+	au8Frame[0] = BIN_CMD_TELEMETRY;
+	bTest_SendFrame(au8Frame, 1);
+	HOST_CHECK(u32Test_Records(&u16Sequence, FALSE) == 1, "no record for BIN_CMD_TELEMETRY");
+	u32Length = u32Test_Command(au8Frame, 2, au8Response);
+	HOST_CHECK((u32Length == 2) && (au8Response[1] == BIN_STATUS_BAD_LENGTH), "BIN_CMD_TELEMETRY with data accepted");
+
+	/* Periods are rounded up to 100ms, and refused over 60s */
+	for (i = 0; i < sizeof(au16Period) / sizeof(au16Period[0]); i++)
+	{
+		HOST_CHECK(u32Test_Subscribe(au16Period[i][0]) == au16Period[i][1], "%u ms subscription", au16Period[i][0]);
+	}
+	HOST_CHECK(u32Test_Subscribe(60001) == 0xffffffff, "60001 ms subscription accepted");
+	HOST_CHECK(u32Test_Subscribe(65535) == 0xffffffff, "65535 ms subscription accepted");
+	HOST_CHECK(u16TelemetryPeriod == 600, "refused subscription changed the period");
+	au8Frame[0] = BIN_CMD_SUBSCRIBE;
+	au8Frame[1] = 1;
+	u32Length = u32Test_Command(au8Frame, 2, au8Response);
+	HOST_CHECK((u32Length == 2) && (au8Response[1] == BIN_STATUS_BAD_LENGTH), "short BIN_CMD_SUBSCRIBE accepted");
+
+	/* Pushed every 300ms */
+	HOST_CHECK(u32Test_Subscribe(250) == 300, "250 ms subscription");
+	for (u32Tick = 1; u32Tick <= 30; u32Tick++)
+	{
+		vLC_TelemetryTick();
+		vTest_Run();
+		HOST_CHECK(u32Test_Records(&u16Sequence, FALSE) == ((u32Tick % 3) == 0),
+				"record at tick %u", u32Tick);
+		if (u32Tick == 10)
+		{
+			bOverheat = FALSE;
+			i16HostTemperature = 71;
+			u32HostDriverErrors++;
+		}
+	}
+
+	/* With nothing being sent, the ring fills. Records which don't fit
+	 * are dropped whole, and leave a gap in the sequence. */
+	HOST_CHECK(u32Test_Subscribe(100) == 100, "100 ms subscription");
+	u32Fit = 0;
+	for (u32Tick = 0; u32Tick < 2 * TX_RING_SIZE / 16; u32Tick++)
+	{
+		vLC_TelemetryTick();
+		os_vAPP_SerialTask();
+		if (u16TxHead != u16BinTxPos + 1)
+		{
+			break;
+		}
+		u32Fit++;
+	}
+	HOST_CHECK(u32Tick < 2 * TX_RING_SIZE / 16, "TX ring never filled");
+	for (i = 0; i < 5; i++)
+	{
+		vLC_TelemetryTick();
+		os_vAPP_SerialTask();
+	}
+	vTest_Run();
+	u32Records = u32Test_Records(&u16Sequence, TRUE);
+	HOST_CHECK((u32Records == u32Fit) && (u16Sequence == u16TelemetrySequence - 6),
+			"%u records of %u sent with the ring full, up to %u of %u", u32Records, u32Fit,
+			u16Sequence, u16TelemetrySequence);
+	HOST_CHECK(u16TxHighWater > TX_RING_SIZE - 40, "TX high water mark %u", u16TxHighWater);
+	u16Sequence = u16TelemetrySequence;
+	vLC_TelemetryTick();
+	vTest_Run();
+	HOST_CHECK(u32Test_Records(&u16Sequence, FALSE) == 1, "no record after the ring emptied");
+
+	/* Stopped by a period of 0 */
+	HOST_CHECK(u32Test_Subscribe(0) == 0, "0 ms subscription");
+	for (u32Tick = 0; u32Tick < 10; u32Tick++)
+	{
+		vLC_TelemetryTick();
+		vTest_Run();
+	}
+	HOST_CHECK(u32Test_Records(&u16Sequence, FALSE) == 0, "records after a period of 0");
+
+	/* Stopped by BIN_CMD_EXIT, and not started again by 'e' */
+	HOST_CHECK(u32Test_Subscribe(100) == 100, "100 ms subscription");
+	au8Frame[0] = BIN_CMD_EXIT;
+	u32Test_Command(au8Frame, 1, au8Response);
+	vTest_Send((const uint8 *)"e\r\n", 3);
+	HOST_CHECK(bTest_ReceiveText("Binary\r\n"), "no reply to 'e'");
+	for (u32Tick = 0; u32Tick < 10; u32Tick++)
+	{
+		vLC_TelemetryTick();
+		vTest_Run();
+	}
+	HOST_CHECK(u32TxRead == u32HostUartTxLength, "records after BIN_CMD_EXIT");
+	u32Test_Command(au8Frame, 1, au8Response);
+
+	printf("Telemetry: %u records fit in the TX ring\n", u32Fit);
+}
+
+/****************************************************************************
+ * NAME: bTest_SentAt
+ *
+ * DESCRIPTION:
+ * Whether the bytes sent from u32From on were all sent within 1% of
+ * u32BaudRate
+ ****************************************************************************/
+PRIVATE bool_t bTest_SentAt(uint32 u32From, uint32 u32BaudRate)
+{
+	uint32 i;
+
+	for (i = u32From; i < u32HostUartTxLength; i++)
+	{
+		if ((au32HostUartTxBaud[i] * 100ULL < u32BaudRate * 99ULL)
+		 || (au32HostUartTxBaud[i] * 100ULL > u32BaudRate * 101ULL))
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/****************************************************************************
+ * NAME: vTest_BaudRate
+ *
+ * DESCRIPTION:
+ * Every rate in asLC_BaudRates is found and within 1%, and no other. The
+ * response to 'u' goes out at the old rate, and the UART changes once the
+ * last character has been shifted out, without APP_isrUart waiting for it.
+ * A break goes back to DEFAULT_BAUD_RATE, and drops a change which is
+ * still waiting.
+ ****************************************************************************/
+PRIVATE void vTest_BaudRate(void)
+{
+	const uint32 au32Supported[] = {38400, 115200, 230400, 500000, 1000000};
+	const uint32 au32Unsupported[] = {0, 1200, 9600, 19200, 57600, 38401, 250000, 2000000, 0xffffffff};
+	const tsLC_BaudRate *psBaudRate;
+	uint32 u32Actual;
+	uint32 u32From;
+	uint32 u32Polls;
+	uint8 i;
+
+	for (i = 0; i < sizeof(au32Supported) / sizeof(au32Supported[0]); i++)
+	{
+		psBaudRate = psLC_FindBaudRate(au32Supported[i]);
+		if (psBaudRate == NULL)
+		{
+			HOST_CHECK(FALSE, "%u baud not found", au32Supported[i]);
+			continue;
+		}
+		u32Actual = 16000000UL / ((psBaudRate->u8ClocksPerBit + 1UL) * psBaudRate->u16Divisor);
+		HOST_CHECK((psBaudRate->u32BaudRate == au32Supported[i])
+				&& (u32Actual * 100ULL >= au32Supported[i] * 99ULL)
+				&& (u32Actual * 100ULL <= au32Supported[i] * 101ULL),
+				"%u baud is %u", au32Supported[i], u32Actual);
+	}
+	for (i = 0; i < sizeof(au32Unsupported) / sizeof(au32Unsupported[0]); i++)
+	{
+		HOST_CHECK(psLC_FindBaudRate(au32Unsupported[i]) == NULL, "%u baud found", au32Unsupported[i]);
+	}
+
+	HOST_CHECK(u32Host_UartBaudRate() == 38461, "starts at %u baud", u32Host_UartBaudRate());
+	u32From = u32HostUartTxLength;
+	vTest_Send((const uint8 *)"u 9600\r\n", 8);
+	HOST_CHECK(bTest_ReceiveText("Invalid baud rate\r\n") && bTest_SentAt(u32From, 38400)
+			&& (u32Host_UartBaudRate() == 38461) && (psLC_PendingBaudRate == NULL),
+			"unsupported baud rate not refused");
+
+	/* The last character of the response is still being shifted out when
+	 * the TX FIFO empties, so APP_isrUart must come back for it */
+	u32From = u32HostUartTxLength;
+	u32Polls = u32HostUartTemtPolls;
+	vTest_Send((const uint8 *)"u 115200\r\n", 10);
+	HOST_CHECK(bTest_ReceiveText("Baud=115200\r\n") && bTest_SentAt(u32From, 38400),
+			"response to 'u' not sent whole at 38400 baud");
+	HOST_CHECK(u32HostUartTemtPolls > u32Polls, "the last character was never waited for");
+	HOST_CHECK((u32Host_UartBaudRate() == 114285) && (psLC_PendingBaudRate == NULL) && !bHostUartTxInterrupt,
+			"%u baud after 'u 115200'", u32Host_UartBaudRate());
+	u32From = u32HostUartTxLength;
+	vTest_Send((const uint8 *)"v\r\n", 3);
+	HOST_CHECK(bTest_ReceiveText(BOARD_VERSION) && bTest_ReceiveText("\r\n") && bTest_SentAt(u32From, 115200),
+			"not answering at 115200 baud");
+
+	/* Back to 38400 on a break */
+	vHost_UartBreak();
+	vTest_Run();
+	HOST_CHECK(u32Host_UartBaudRate() == 38461, "%u baud after a break", u32Host_UartBaudRate());
+
+	/* A break while the response is being sent drops the change */
+	vHost_UartReceive((const uint8 *)"u 230400\r\n", 10);
+	while ((psLC_PendingBaudRate == NULL) && bTest_Step());
+	HOST_CHECK(psLC_PendingBaudRate != NULL, "'u 230400' didn't start a change");
+	vHost_UartBreak();
+	vTest_Run();
+	HOST_CHECK((u32Host_UartBaudRate() == 38461) && (psLC_PendingBaudRate == NULL),
+			"%u baud after a break during 'u 230400'", u32Host_UartBaudRate());
+	HOST_CHECK(bTest_ReceiveText("Baud=230400\r\n"), "no response to 'u 230400'");
+
+	/* Straight to the fastest and back */
+	vTest_Send((const uint8 *)"u 1000000\r\n", 11);
+	HOST_CHECK(bTest_ReceiveText("Baud=1000000\r\n") && (u32Host_UartBaudRate() == 1000000),
+			"%u baud after 'u 1000000'", u32Host_UartBaudRate());
+	u32From = u32HostUartTxLength;
+	vTest_Send((const uint8 *)"u 38400\r\n", 9);
+	HOST_CHECK(bTest_ReceiveText("Baud=38400\r\n") && bTest_SentAt(u32From, 1000000)
+			&& (u32Host_UartBaudRate() == 38461), "%u baud after 'u 38400'", u32Host_UartBaudRate());
+}
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+int main(void)
+{
+	vLC_InitSerialInterface();
+	vLC_LoadCalibrationFromNVM();
+
+	vTest_Crc();
+	vTest_Decode();
+	vTest_Encode();
+	vTest_BinaryMode();
+	vTest_Stream();
+	vTest_Telemetry();
+	vTest_BaudRate();
+
+	printf("COBS: %u frames ending in a 0x01 code byte\n", u32TrailingCodes);
+	return iHost_Result("test_serial");
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,261 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          test_thermal.c
+ *
+ * DESCRIPTION:        Host build: thermal derating against a fixture model
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Tests of app_temp_sensor.c, which is included here so that its filter can
+ * be restarted. The board temperature comes from a first order model of a
+ * light fixture: it heats towards the ambient temperature plus a rise in
+ * proportion to the light output, with a single time constant. Every 100ms
+ * the model's temperature is turned into an accumulated ADC reading through
+ * the thermistor table, which goes in through the ADC interrupt, and then
+ * the overheat check and the derating run as in Tick_Task.
+ *
+ * With derating the board must settle below the overheat cutoff, at the
+ * temperature where the heating balances the derating, without the cutoff
+ * ever tripping and without the output hunting. Without it, the cutoff is
+ * expected to switch the fixture on and off. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <math.h>
+#include <jendefs.h>
+#include "os_gen.h"
+#include "HostStubs.h"
+#include "app_temp_sensor.c"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* The model runs at the rate of the Tick_Task 100ms update */
+#define SIM_STEP_S				(0.1)
+#define SIM_STEPS_PER_MINUTE	(600)
+#define SIM_MINUTES				(180)
+/* Settling is checked over the last hour */
+#define SIM_SETTLED_MINUTES		(120)
+
+/* Largest swings allowed once settled, and largest distance from the
+ * temperature where heating and derating balance. At the balance the ADC
+ * reading can flip between two counts, which moves the output by about
+ * 0.02%, so a swing any larger is hunting. */
+#define TEST_SETTLED_BAND		(0.01)
+#define TEST_OUTPUT_BAND		(0.001)
+#define TEST_BALANCE_ERROR		(0.5)
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/* A fixture, and whether the derating runs */
+typedef struct
+{
+	const char *pcName;
+	double dAmbient;		/* Degrees Celsius */
+	double dRise;			/* Degrees Celsius above ambient at full output */
+	double dTimeConstant;	/* Seconds */
+	bool_t bDerating;
+} tsTestFixture;
+
+/* What one run did */
+typedef struct
+{
+	double dPeak;
+	double dSettledMin;
+	double dSettledMax;
+	double dOutputMin;
+	double dOutputMax;
+	uint32 u32Switches;		/* Cutoff on/off changes while settled */
+	bool_t bTripped;		/* The cutoff ever switched the output off */
+} tsTestRun;
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: u16Test_AdcReading
+ *
+ * DESCRIPTION:
+ * Accumulated ADC reading for a board temperature, interpolated between the
+ * entries of temperature_lookup and truncated as the ADC would
+ ****************************************************************************/
+PRIVATE uint16 u16Test_AdcReading(double dTemperature)
+{
+	double dReading;
+	uint32 i;
+
+	dTemperature = MIN(MAX(dTemperature, 0.0), TEMPERATURE_LOOKUP_LENGTH - 1.001);
+	i = (uint32)dTemperature;
+	dReading = temperature_lookup[i]
+			- (temperature_lookup[i] - temperature_lookup[i + 1]) * (dTemperature - i);
+	return (uint16)dReading;
+}
+
+/****************************************************************************
+ * NAME: vTest_Run
+ *
+ * DESCRIPTION:
+ * Runs a fixture from cold for SIM_MINUTES
+ ****************************************************************************/
+PRIVATE void vTest_Run(const tsTestFixture *psFixture, tsTestRun *psRun)
+{
+	double dTemperature = psFixture->dAmbient;
+	double dOutput;
+	bool_t bWasOff = FALSE;
+	uint32 n;
+
+	bFilterStarted = FALSE;
+	bOverheat = FALSE;
+	u32TS_Derating = TS_DERATING_ONE;
+	vTS_InitTempSensor();
+
+	psRun->dPeak = dTemperature;
+	psRun->dSettledMin = 1000.0;
+	psRun->dSettledMax = -1000.0;
+	psRun->dOutputMin = 1.0;
+	psRun->dOutputMax = 0.0;
+	psRun->u32Switches = 0;
+	psRun->bTripped = FALSE;
+
+	for (n = 0; n < SIM_MINUTES * SIM_STEPS_PER_MINUTE; n++)
+	{
+		HOST_CHECK(bHost_AdcComplete(u16Test_AdcReading(dTemperature)), "%s: ADC not restarted",
+				psFixture->pcName);
+		os_vAPP_isrAdc();
+		HOST_CHECK((u32HostAnaIntStatus & HOST_ANA_INT_ADC) == 0, "%s: ADC interrupt not cleared",
+				psFixture->pcName);
+
+		/* As the Tick_Task 100ms update */
+		if (!bOverheat && (i16TS_GetTemperature() > TEMPERATURE_OVERHEAT_CUTOFF))
+		{
+			bOverheat = TRUE;
+			psRun->bTripped = TRUE;
+		}
+		if (bOverheat && (i16TS_GetTemperature() < TEMPERATURE_RESTORE_THRESHOLD))
+		{
+			bOverheat = FALSE;
+		}
+		if (psFixture->bDerating)
+		{
+			(void)bTS_UpdateDerating();
+		}
+
+		dOutput = bOverheat ? 0.0 : (double)u32TS_Derating / TS_DERATING_ONE;
+		dTemperature += (psFixture->dAmbient + psFixture->dRise * dOutput - dTemperature)
+				* SIM_STEP_S / psFixture->dTimeConstant;
+		psRun->dPeak = MAX(psRun->dPeak, dTemperature);
+
+		if (n >= SIM_SETTLED_MINUTES * SIM_STEPS_PER_MINUTE)
+		{
+			psRun->dSettledMin = MIN(psRun->dSettledMin, dTemperature);
+			psRun->dSettledMax = MAX(psRun->dSettledMax, dTemperature);
+			psRun->dOutputMin = MIN(psRun->dOutputMin, dOutput);
+			psRun->dOutputMax = MAX(psRun->dOutputMax, dOutput);
+			if (bOverheat != bWasOff)
+			{
+				psRun->u32Switches++;
+			}
+		}
+		bWasOff = bOverheat;
+	}
+}
+
+/****************************************************************************
+ * NAME: vTest_Fixture
+ *
+ * DESCRIPTION:
+ * Runs a fixture and checks that derating settles it where heating and
+ * derating balance, or that without derating the cutoff cycles it
+ ****************************************************************************/
+PRIVATE void vTest_Fixture(const tsTestFixture *psFixture)
+{
+	tsTestRun sRun;
+	double dSpan = TEMPERATURE_OVERHEAT_CUTOFF - TEMPERATURE_DERATE_START;
+	double dBalance;
+
+	vTest_Run(psFixture, &sRun);
+	printf("%-24s peak %6.2f C, settled %6.3f - %6.3f C at %6.2f%% - %6.2f%% output, "
+			"%u switches\n", psFixture->pcName, sRun.dPeak, sRun.dSettledMin,
+			sRun.dSettledMax, sRun.dOutputMin * 100.0, sRun.dOutputMax * 100.0,
+			sRun.u32Switches);
+	if (!psFixture->bDerating)
+	{
+		HOST_CHECK(sRun.u32Switches > 0, "%s: the cutoff never cycled", psFixture->pcName);
+		return;
+	}
+
+	/* Ambient + rise * (cutoff - T) / span = T */
+	dBalance = (psFixture->dAmbient * dSpan + psFixture->dRise * TEMPERATURE_OVERHEAT_CUTOFF)
+			/ (dSpan + psFixture->dRise);
+	HOST_CHECK(!sRun.bTripped && sRun.dPeak < TEMPERATURE_OVERHEAT_CUTOFF, "%s: peak %.2f C",
+			psFixture->pcName, sRun.dPeak);
+	HOST_CHECK(sRun.u32Switches == 0 && sRun.dSettledMax - sRun.dSettledMin < TEST_SETTLED_BAND
+			&& sRun.dOutputMax - sRun.dOutputMin < TEST_OUTPUT_BAND,
+			"%s: still moving, %.3f - %.3f C", psFixture->pcName, sRun.dSettledMin, sRun.dSettledMax);
+	HOST_CHECK(fabs(sRun.dSettledMax - dBalance) < TEST_BALANCE_ERROR,
+			"%s: settled at %.2f C, balance at %.2f C", psFixture->pcName, sRun.dSettledMax, dBalance);
+}
+
+/****************************************************************************/
+/***        Main                                                          ***/
+/****************************************************************************/
+
+int main(void)
+{
+	static const tsTestFixture asFixtures[] =
+	{
+		{ "cutoff only",			25.0, 80.0, 300.0, FALSE },
+		{ "derating",				25.0, 80.0, 300.0, TRUE },
+		{ "derating, 20s",			25.0, 80.0, 20.0, TRUE },
+		{ "derating, 40C ambient",	40.0, 80.0, 300.0, TRUE },
+		{ "derating, 120C rise",	25.0, 120.0, 300.0, TRUE }
+	};
+	uint32 i;
+
+	for (i = 0; i < sizeof(asFixtures) / sizeof(asFixtures[0]); i++)
+	{
+		vTest_Fixture(&asFixtures[i]);
+	}
+	return iHost_Result("test_thermal");
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,400 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          test_tick.c
+ *
+ * DESCRIPTION:        Host build: Tick_Task wakeup simulation
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/* Runs the Tick_Task from app_zcl_light_task.c against a simulated tick
+ * timer and counts how often it wakes the device. The rest of that file
+ * needs the ZigBee stack, so the Makefile copies the task and
+ * APP_ZCL_vWakeTick out of it into Tick_Task.inc and this file supplies
+ * what the task calls in the ZCL.
+ *
+ * Checks that the 100ms and 1s ZCL events keep exact time whether the timer
+ * runs every 10ms or only for the 100ms update, that work started between
+ * wakeups wakes the timer for the next 10ms tick and finishes on time, and
+ * that timer latency does not make them drift. */
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdio.h>
+#include <jendefs.h>
+#include <AppHardwareApi.h>
+#include "os.h"
+#include "os_gen.h"
+#include "zcl.h"
+#include "app_zcl_light_task.h"
+#include "app_light_calibration.h"
+#include "app_temp_sensor.h"
+#include "app_light_interpolation.h"
+#include "DriverBulb.h"
+#include "HostStubs.h"
+#include "HostDriver.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* As app_timer_driver.h in the SDK: software timer periods are in tick
+ * timer counts */
+#define APP_TIME_MS(t)			(HOST_TICKS_PER_MS * (t))
+
+#define E_ZCL_CBET_TIMER		(1)
+
+#define SIM_SECOND				(1000ULL * HOST_TICKS_PER_MS)
+#define SIM_HOUR				(3600ULL * SIM_SECOND)
+
+/* The task before the timer was made conditional re-armed every 10ms */
+#define BASELINE_WAKEUPS		(100.0)
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/* The parts of the ZCL callback event the task fills in */
+typedef struct
+{
+	void *pZPSevent;
+	int eEventType;
+} tsZCL_CallBackEvent;
+
+typedef enum
+{
+	E_ZCL_SUCCESS
+} teZCL_Status;
+
+/* Statistics for one stretch of simulated time */
+typedef struct
+{
+	const char *pcName;
+	uint64 u64Length;
+	uint32 u32Wakeups;
+	uint32 u32Commands;
+} tsSimRun;
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/* Simulated time and the expiry of the tick timer, in tick timer counts.
+ * 64 bit so that hours of it do not wrap; the task sees the low 32 bits. */
+PRIVATE uint64 u64Now;
+PRIVATE uint64 u64Expiry;
+
+/* Deadline of the wakeup being run, and of the last ZCL events */
+PRIVATE uint64 u64Deadline;
+PRIVATE uint64 u64LastUpdate;
+PRIVATE uint64 u64LastSecond;
+PRIVATE bool_t bUpdateSeen;
+PRIVATE bool_t bSecondSeen;
+PRIVATE uint32 u32Updates;
+PRIVATE uint32 u32Seconds;
+
+/* A level transition started by a simulated command */
+PRIVATE bool_t bCommandActive;
+PRIVATE uint8 u8CommandBulb;
+PRIVATE uint64 u64CommandTime;
+PRIVATE uint32 u32CommandSteps;
+
+/****************************************************************************/
+/***        ZCL stand-ins called by Tick_Task                             ***/
+/****************************************************************************/
+
+PRIVATE teZCL_Status eZLL_Update100mS(void)
+{
+	if (bUpdateSeen)
+	{
+		HOST_CHECK(u64Deadline - u64LastUpdate == 100 * HOST_TICKS_PER_MS,
+				"100ms update %llu ticks after the last",
+				(unsigned long long)(u64Deadline - u64LastUpdate));
+	}
+	u64LastUpdate = u64Deadline;
+	bUpdateSeen = TRUE;
+	u32Updates++;
+	return E_ZCL_SUCCESS;
+}
+
+PRIVATE void vZCL_EventHandler(tsZCL_CallBackEvent *psEvent)
+{
+	HOST_CHECK(psEvent->eEventType == E_ZCL_CBET_TIMER, "event type %d", psEvent->eEventType);
+	HOST_CHECK(psEvent->pZPSevent == NULL, "timer event with a stack event");
+	if (bSecondSeen)
+	{
+		HOST_CHECK(u64Deadline - u64LastSecond == SIM_SECOND,
+				"1s timer event %llu ticks after the last",
+				(unsigned long long)(u64Deadline - u64LastSecond));
+	}
+	u64LastSecond = u64Deadline;
+	bSecondSeen = TRUE;
+	u32Seconds++;
+}
+
+/* The task itself, copied out of app_zcl_light_task.c by the Makefile */
+#include "Tick_Task.inc"
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: vSim_Wakeup
+ *
+ * DESCRIPTION:
+ * Runs Tick_Task for the timer expiry, u32Latency ticks late, and moves the
+ * expiry on by the period it arms, as OS_eContinueSWTimer does
+ ****************************************************************************/
+PRIVATE void vSim_Wakeup(uint32 u32Latency)
+{
+	uint32 u32Armed = u32HostTimerArmed;
+
+	u64Deadline = u64Expiry;
+	u64Now = u64Expiry + u32Latency;
+	u32HostTickTimer = (uint32)u64Now;
+	os_vTick_Task();
+
+	HOST_CHECK(u32HostTimerArmed == u32Armed + 1, "timer armed %u times",
+			u32HostTimerArmed - u32Armed);
+	HOST_CHECK((u32HostTimerPeriod % APP_TIME_MS(TICK_PERIOD_MS)) == 0 &&
+			u32HostTimerPeriod > 0 && u32HostTimerPeriod <= APP_TIME_MS(100),
+			"timer period %u ticks", u32HostTimerPeriod);
+	u64Expiry += u32HostTimerPeriod;
+}
+
+/****************************************************************************
+ * NAME: vSim_Woken
+ *
+ * DESCRIPTION:
+ * Called after work has been started outside Tick_Task. If APP_ZCL_vWakeTick
+ * restarted the timer, moves the expiry to the period it armed from now,
+ * which must be the next 10ms tick on the grid of the 100ms updates.
+ ****************************************************************************/
+PRIVATE void vSim_Woken(uint32 u32Starts)
+{
+	if (u32HostTimerStarts == u32Starts)
+	{
+		return;
+	}
+	HOST_CHECK(u32HostTimerStarts == u32Starts + 1, "timer started %u times",
+			u32HostTimerStarts - u32Starts);
+	HOST_CHECK(u32HostTimerPeriod > 0 && u32HostTimerPeriod <= APP_TIME_MS(TICK_PERIOD_MS),
+			"woken timer period %u ticks", u32HostTimerPeriod);
+	u64Expiry = u64Now + u32HostTimerPeriod;
+	HOST_CHECK((u64Expiry - u64LastUpdate) % APP_TIME_MS(TICK_PERIOD_MS) == 0,
+			"woken timer due %llu ticks after the last 100ms update",
+			(unsigned long long)(u64Expiry - u64LastUpdate));
+}
+
+/****************************************************************************
+ * NAME: vSim_Command
+ *
+ * DESCRIPTION:
+ * Starts a level transition on a random bulb, as a Move to Level command
+ * handled in ZCL_Task would. A command that arrives before a late wakeup
+ * has run is handled after it.
+ ****************************************************************************/
+PRIVATE void vSim_Command(uint64 u64Time, uint32 u32Steps)
+{
+	uint32 u32Starts = u32HostTimerStarts;
+
+	u64Now = MAX(u64Time, u64Now);
+	u32HostTickTimer = (uint32)u64Now;
+
+	u8CommandBulb = u32Host_Random() % NUM_BULBS;
+	u32CommandSteps = u32Steps;
+	u64CommandTime = u64Now;
+	bCommandActive = TRUE;
+	vLI_StartLevel(u8CommandBulb, 1 + u32Host_Random() % 254, u32Steps);
+	vSim_Woken(u32Starts);
+	/* A command for the level the bulb is already at starts nothing */
+	HOST_CHECK(!bLI_LevelTransitionActive(u8CommandBulb) ||
+			u64Expiry <= u64Now + APP_TIME_MS(TICK_PERIOD_MS), "transition waits %llu ticks for the timer", (unsigned long long)(u64Expiry - u64Now));
+}
+
+/****************************************************************************
+ * NAME: vSim_Dither
+ *
+ * DESCRIPTION:
+ * Starts dithering half way between two 100ms updates, as the d command
+ * handled in APP_SerialTask does
+ ****************************************************************************/
+PRIVATE void vSim_Dither(void)
+{
+	uint32 u32Starts = u32HostTimerStarts;
+
+	u64Now = u64LastUpdate + APP_TIME_MS(55);
+	u32HostTickTimer = (uint32)u64Now;
+	bHostDitherActive = TRUE;
+	APP_ZCL_vWakeTick();
+	HOST_CHECK(u32HostTimerStarts == u32Starts + 1, "dithering did not wake the timer");
+	vSim_Woken(u32Starts);
+	HOST_CHECK(u64Expiry == u64LastUpdate + APP_TIME_MS(60), "dithering starts %llu ticks late",
+			(unsigned long long)(u64Expiry - u64LastUpdate - APP_TIME_MS(60)));
+}
+
+/****************************************************************************
+ * NAME: vSim_CheckCommand
+ *
+ * DESCRIPTION:
+ * Once the last command's transition has finished, checks that it took no
+ * longer than its steps plus the wait for the next 10ms tick
+ ****************************************************************************/
+PRIVATE void vSim_CheckCommand(void)
+{
+	uint64 u64Limit;
+
+	if (bCommandActive && !bLI_LevelTransitionActive(u8CommandBulb))
+	{
+		u64Limit = u64CommandTime + (uint64)(u32CommandSteps + 1) * APP_TIME_MS(TICK_PERIOD_MS);
+		HOST_CHECK(u64Deadline <= u64Limit,
+				"%u step transition finished %llu ticks late", u32CommandSteps,
+				(unsigned long long)(u64Deadline - u64Limit));
+		bCommandActive = FALSE;
+	}
+}
+
+/****************************************************************************
+ * NAME: vSim_Run
+ *
+ * DESCRIPTION:
+ * Simulates psRun->u64Length ticks. A command with a u32Steps transition
+ * arrives at a random time in every u64CommandPeriod (none if 0), and each
+ * wakeup is up to u32MaxLatency ticks late.
+ ****************************************************************************/
+PRIVATE void vSim_Run(tsSimRun *psRun, uint64 u64CommandPeriod, uint32 u32Steps,
+		uint32 u32MaxLatency)
+{
+	uint64 u64End = u64Expiry + psRun->u64Length;
+	uint64 u64NextCommand = 0;
+	uint32 u32Latency;
+
+	if (u64CommandPeriod)
+	{
+		u64NextCommand = u64Expiry + u32Host_Random() % u64CommandPeriod;
+	}
+	while (u64Expiry < u64End)
+	{
+		if (u64CommandPeriod && (u64NextCommand < u64Expiry))
+		{
+			vSim_Command(u64NextCommand, u32Steps);
+			psRun->u32Commands++;
+			u64NextCommand += u64CommandPeriod;
+		}
+		u32Latency = u32MaxLatency ? u32Host_Random() % u32MaxLatency : 0;
+		vSim_Wakeup(u32Latency);
+		psRun->u32Wakeups++;
+		vSim_CheckCommand();
+	}
+}
+
+/****************************************************************************
+ * NAME: vSim_Report
+ ****************************************************************************/
+PRIVATE void vSim_Report(tsSimRun *psRun)
+{
+	double dSeconds = (double)psRun->u64Length / SIM_SECOND;
+
+	printf("  %-34s %6.1f wakeups/s (%3.0f%% of %.0f/s)\n", psRun->pcName,
+			psRun->u32Wakeups / dSeconds,
+			100.0 * psRun->u32Wakeups / dSeconds / BASELINE_WAKEUPS,
+			BASELINE_WAKEUPS);
+}
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+int main(void)
+{
+	tsSimRun asRuns[] =
+	{
+		{ "idle hour",                        SIM_HOUR },
+		{ "1s fade every 10s, hour",          SIM_HOUR },
+		{ "5s fade every 10s, hour",          SIM_HOUR },
+		{ "idle hour, up to 5ms late",        SIM_HOUR },
+		{ "PWM dithering, minute",            60 * SIM_SECOND },
+	};
+	uint32 u32UpdatesBefore;
+	uint32 u32SecondsBefore;
+	uint64 u64Simulated;
+	uint8 u8Bulb;
+	uint8 i;
+
+	vHost_Seed(8);
+	vLC_LoadCalibrationFromNVM();
+	for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		vLI_SetCurrentValues(u8Bulb, 128, 255, 255, 255, 0);
+	}
+
+	/* The first run of the task takes its start time as the deadline */
+	u64Expiry = 0;
+
+	vSim_Run(&asRuns[0], 0, 0, 0);
+	vSim_Run(&asRuns[1], 10 * SIM_SECOND, 100, 0);
+	vSim_Run(&asRuns[2], 10 * SIM_SECOND, 500, 0);
+	vSim_Run(&asRuns[3], 0, 0, APP_TIME_MS(5));
+	HOST_CHECK(u32TickOverruns == 0, "%u overruns with 5ms latency", u32TickOverruns);
+	HOST_CHECK(u32TickMaxLate < APP_TIME_MS(5) && u32TickMaxLate > APP_TIME_MS(4),
+			"largest lateness %u ticks", u32TickMaxLate);
+
+	vSim_Dither();
+	vSim_Run(&asRuns[4], 0, 0, 0);
+	bHostDitherActive = FALSE;
+
+	/* Nothing has drifted over the whole simulation */
+	u32UpdatesBefore = u32Updates;
+	u32SecondsBefore = u32Seconds;
+	vSim_Run(&(tsSimRun){ "settle", SIM_SECOND }, 0, 0, 0);
+	u64Simulated = u64LastUpdate;
+	HOST_CHECK(u32Updates - u32UpdatesBefore == 10, "%u updates in a second",
+			u32Updates - u32UpdatesBefore);
+	HOST_CHECK(u32Seconds - u32SecondsBefore == 1, "%u timer events in a second",
+			u32Seconds - u32SecondsBefore);
+	HOST_CHECK((uint64)(u32Updates - 1) * APP_TIME_MS(100) == u64Simulated,
+			"%u updates in %llu ticks", u32Updates, (unsigned long long)u64Simulated);
+
+	printf("Tick_Task wakeups, %d bulbs:\n", NUM_BULBS);
+	for (i = 0; i < sizeof(asRuns) / sizeof(asRuns[0]); i++)
+	{
+		vSim_Report(&asRuns[i]);
+	}
+	return iHost_Result("test_tick");
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
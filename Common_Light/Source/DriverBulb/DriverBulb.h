@@ -76,6 +76,13 @@ PUBLIC void 	 	DriverBulb_vSetLevel(uint8 u8Bulb, uint32 u32Level);
 PUBLIC void         DriverBulb_vSetOnOff(uint8 u8Bulb, bool_t bOn);
 PUBLIC void         DriverBulb_vSetColour(uint8 u8Bulb, uint32 u32Red, uint32 u32Green, uint32 u32Blue);
 PUBLIC void	        DriverBulb_vOutput(uint8 u8Bulb);
+PUBLIC void	        DriverBulb_vDither(void);
+PUBLIC bool_t       DriverBulb_bDitherActive(void);
+PUBLIC void         DriverBulb_vBeginFrame(void);
+PUBLIC void         DriverBulb_vCommitFrame(void);
+PUBLIC void         DriverBulb_vRefresh(void);
+PUBLIC uint16       DriverBulb_u16GetChannelPWM(uint8 u8Channel);
+PUBLIC uint32       DriverBulb_u32GetErrors(void);
 
 /****************************************************************************/
 /***        Exported Variables                                            ***/
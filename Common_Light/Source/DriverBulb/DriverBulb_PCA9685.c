@@ -40,22 +40,127 @@
 
 #define PCA9685_ADDRESS		(0x40)		/* 7 bit default I2C address of PCA9685 */
 
-#define FAST_DIV_BY_255(x)	((((x) << 8) + (x) + 255) >> 16)
+/* Divide a product of two 16 bit intensities by 65535, exact at full scale */
+#define FAST_DIV_BY_65535(x)	(((x) + ((x) >> 16) + 1) >> 16)
+
+/* Maximum number of channels the dither stage may change per tick. They
+ * are sent in one I2C transfer, at 4 bytes (~90us at 400kHz) per channel
+ * and 2 more per run of neighbouring channels. */
+#define DITHER_MAX_WRITES		(4)
+/* Limit of the accumulated dither error, in 1/16 PWM steps. This stops the
+ * error from winding up while a channel is starved of writes. */
+#define DITHER_ERROR_LIMIT		(32)
+
+#define PWM_ONE					(1 << LC_PWM_FRAC_BITS)
+
+/* Value of au32ChannelPWM for a channel in full OFF mode */
+#define PWM_FULL_OFF			(0xffffffff)
+
+/* Size of the I2C queue, in writes and in data bytes. Both must be powers
+ * of 2. A frame of all 12 channels takes up to 6 writes and 48 bytes. */
+#define I2C_QUEUE_SIZE			(16)
+#define I2C_DATA_SIZE			(256)
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/* Called from the SI interrupt when a transfer has ended with a STOP */
+typedef void (*tprI2CDone)(bool_t bNack);
+
+/* One write to consecutive PCA9685 registers. Its data bytes are in
+ * au8I2CData, following those of the write before it. */
+typedef struct
+{
+	uint8       u8Reg;          /* First register */
+	uint8       u8Len;          /* Number of data bytes, at least 1 */
+	bool_t      bStop;          /* FALSE to follow with a repeated START */
+	tprI2CDone  prDone;         /* Called after the STOP, or NULL */
+} tsI2CWrite;
+
+typedef enum
+{
+	E_I2C_IDLE,
+	E_I2C_ADDRESS,              /* START and slave address sent */
+	E_I2C_DATA                  /* Register number or data byte sent */
+} teI2CState;
 
 /****************************************************************************/
 /***        Local Function Prototypes                                     ***/
 /****************************************************************************/
 PRIVATE void PCA9685_vWriteRegister(uint8 u8Reg, uint8 u8Data);
-PRIVATE void PCA9685_vWriteRegisterMulti(uint8 u8Reg, uint8 *pu8Data, uint8 u8Len);
+PRIVATE void PCA9685_vWriteDone(bool_t bNack);
+PRIVATE bool_t PCA9685_bI2CRoom(uint8 u8Writes, uint16 u16Bytes);
+PRIVATE void PCA9685_vI2CQueue(uint8 u8Reg, uint8 *pu8Data, uint8 u8Len, bool_t bStop, tprI2CDone prDone);
+PRIVATE void PCA9685_vI2CCommit(void);
+PRIVATE void PCA9685_vI2CNext(void);
+PRIVATE void PCA9685_vI2CWait(void);
+PRIVATE void PCA9685_vSetPWM(uint8 u8Channel, uint16 u16PWM);
+PRIVATE void PCA9685_vSetFull(uint8 u8Channel, bool_t bOn);
+PRIVATE void PCA9685_vWriteChannels(void);
+PRIVATE void PCA9685_vBulbChanged(uint8 u8Bulb);
+PRIVATE void PCA9685_vComputeBulb(uint8 u8Bulb, bool_t bForce);
+PRIVATE void PCA9685_vFlushChannels(void);
 
 /****************************************************************************/
 /***        Local Variables                                               ***/
 /****************************************************************************/
 PRIVATE bool_t  bIsOn[NUM_BULBS];
-PRIVATE uint8   u8CurrLevel[NUM_BULBS];
-PRIVATE uint8   u8CurrRed[NUM_BULBS];
-PRIVATE uint8   u8CurrGreen[NUM_BULBS];
-PRIVATE uint8   u8CurrBlue[NUM_BULBS];
+PRIVATE uint16  u16CurrLevel[NUM_BULBS];
+PRIVATE uint16  u16CurrRed[NUM_BULBS];
+PRIVATE uint16  u16CurrGreen[NUM_BULBS];
+PRIVATE uint16  u16CurrBlue[NUM_BULBS];
+
+/* Dither state. au16DitherTarget holds the PWM value of each channel with
+ * LC_PWM_FRAC_BITS fractional bits, au16DitherCode the PWM code currently
+ * written to the PCA9685, 0 for full OFF. Bit n of u16DitherMask is set
+ * while channel n has a fractional PWM value. */
+PRIVATE uint16  au16DitherTarget[NUM_CHANNELS];
+PRIVATE uint16  au16DitherCode[NUM_CHANNELS];
+PRIVATE int16   ai16DitherError[NUM_CHANNELS];
+PRIVATE uint16  u16DitherMask;
+PRIVATE uint8   u8DitherFirst;
+
+/* Frame state. While u8FrameDepth is non-zero the setters only set the bit
+ * of the changed bulb in u32DirtyBulbs. au32ChannelPWM holds the PWM value
+ * each channel is asked for (LC_PWM_FRAC_BITS fractional bits, or
+ * PWM_FULL_OFF), and bit n of u16DirtyChannels is set while channel n has a
+ * value which hasn't been written to the PCA9685 yet. au32ChannelOutput holds
+ * what was last written, after the power budget (LC_PWM_MAX for full ON or
+ * PWM_FULL_OFF), and u32BudgetScale the power budget multiplier it was
+ * written with. */
+PRIVATE uint8   u8FrameDepth;
+PRIVATE uint32  u32DirtyBulbs;
+PRIVATE uint32  au32ChannelPWM[NUM_CHANNELS];
+PRIVATE uint16  u16DirtyChannels;
+PRIVATE uint32  au32ChannelOutput[NUM_CHANNELS];
+PRIVATE uint32  u32BudgetScale = LC_POWER_SCALE_ONE;
+
+/* Copy of the LEDn_ON_L..LEDn_OFF_H registers of every channel, in
+ * register order. Bit n of u16StagedChannels is set while channel n has
+ * values here which haven't been sent to the PCA9685 yet. */
+PRIVATE uint8   au8LedRegisters[NUM_CHANNELS * REG_LEDx_STRIDE];
+PRIVATE uint16  u16StagedChannels;
+
+/* Number of I2C transfers which the PCA9685 didn't acknowledge */
+PRIVATE uint32  u32I2CErrors;
+
+/* I2C queue. The tasks add writes at u8I2CQueueEnd and hand them to the SI
+ * interrupt by moving u8I2CQueueHead up to it, once a whole transfer is in
+ * place. The interrupt sends writes from u8I2CQueueTail, and their data from
+ * u16I2CDataTail. u8I2CCount is the number of data bytes of the current
+ * write sent so far, and bI2CNack is set if any byte of the current
+ * transfer wasn't acknowledged. */
+PRIVATE tsI2CWrite asI2CQueue[I2C_QUEUE_SIZE];
+PRIVATE uint8   au8I2CData[I2C_DATA_SIZE];
+PRIVATE uint8   u8I2CQueueEnd;
+PRIVATE uint16  u16I2CDataEnd;
+PRIVATE volatile uint8      u8I2CQueueHead;
+PRIVATE volatile uint8      u8I2CQueueTail;
+PRIVATE volatile uint16     u16I2CDataTail;
+PRIVATE volatile teI2CState eI2CState = E_I2C_IDLE;
+PRIVATE uint8   u8I2CCount;
+PRIVATE bool_t  bI2CNack;
 
 /****************************************************************************/
 /***        Exported Functions                                            ***/
@@ -78,6 +183,7 @@ PRIVATE uint8   u8CurrBlue[NUM_BULBS];
 PUBLIC void DriverBulb_vInit(void)
 {
 	static bool_t bInit = FALSE;
+	uint8 i;
 
 	/* Not already initialized ? */
 	if (bInit == FALSE)
@@ -90,9 +196,9 @@ PUBLIC void DriverBulb_vInit(void)
 		vAHI_DioSetOutput(0x00000000, 0xffffffff);
 
 		/* Initialize Serial Interface (a.k.a. I2C):
-		 * enable pulse suppression filter, set prescaler to 7, so that I2C bus
-		 * operates at 400 kHz */
-		vAHI_SiMasterConfigure(TRUE, FALSE, 7);
+		 * enable pulse suppression filter and the interrupt, set prescaler
+		 * to 7, so that I2C bus operates at 400 kHz */
+		vAHI_SiMasterConfigure(TRUE, TRUE, 7);
 
 		/* Put PCA9685 into SLEEP mode, before setting pre-scale register. */
 		PCA9685_vWriteRegister(REG_MODE1, 0x10);
@@ -110,6 +216,19 @@ PUBLIC void DriverBulb_vInit(void)
 		/* Ensure that PCA9685 outputs are configured to be push-pull */
 		PCA9685_vWriteRegister(REG_MODE2, 0x04);
 
+		/* This runs before the OS has started, so the SI interrupt can't
+		 * be taken yet */
+		PCA9685_vI2CWait();
+
+		/* All channels come out of reset in full OFF mode */
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			au32ChannelPWM[i] = PWM_FULL_OFF;
+			au32ChannelOutput[i] = PWM_FULL_OFF;
+			PCA9685_vSetFull(i, FALSE);
+		}
+		u16StagedChannels = 0;
+
 		/* Now initialized */
 		bInit = TRUE;
 	}
@@ -136,7 +255,7 @@ PUBLIC void DriverBulb_vOn(uint8 u8Bulb)
 		/* Note light is on */
 		bIsOn[u8Bulb] = TRUE;
 		/* Set outputs */
-		DriverBulb_vOutput(u8Bulb);
+		PCA9685_vBulbChanged(u8Bulb);
 	}
 }
 
@@ -161,7 +280,7 @@ PUBLIC void DriverBulb_vOff(uint8 u8Bulb)
 		/* Note light is off */
 		bIsOn[u8Bulb] = FALSE;
 		/* Set outputs */
-		DriverBulb_vOutput(u8Bulb);
+		PCA9685_vBulbChanged(u8Bulb);
 	}
 }
 
@@ -211,7 +330,7 @@ PUBLIC bool_t DriverBulb_bOn(uint8 u8Bulb)
  *
  * PARAMETERS:      Name     RW  Usage
  *                  u8Bulb   R   Bulb number to set level of
- *         	        u32Level R   Light level 0-LAMP_LEVEL_MAX
+ *         	        u32Level R   Light level 0-65535
  *
  * RETURNS:
  * void
@@ -220,22 +339,22 @@ PUBLIC bool_t DriverBulb_bOn(uint8 u8Bulb)
 PUBLIC void DriverBulb_vSetLevel(uint8 u8Bulb, uint32 u32Level)
 {
 	/* Different value ? */
-	if (u8CurrLevel[u8Bulb] != (uint8) u32Level)
+	if (u16CurrLevel[u8Bulb] != (uint16) u32Level)
 	{
 		/* Note the new level */
-		if (u32Level > CLD_LEVELCONTROL_MAX_LEVEL)
+		if (u32Level > 0xffff)
 		{
-			u8CurrLevel[u8Bulb] = CLD_LEVELCONTROL_MAX_LEVEL;
+			u16CurrLevel[u8Bulb] = 0xffff;
 		}
 		else
 		{
-			u8CurrLevel[u8Bulb] = (uint8) MAX(1, u32Level);
+			u16CurrLevel[u8Bulb] = (uint16) MAX(1, u32Level);
 		}
 		/* Is the lamp on ? */
 		if (bIsOn[u8Bulb])
 		{
 			/* Set outputs */
-			DriverBulb_vOutput(u8Bulb);
+			PCA9685_vBulbChanged(u8Bulb);
 		}
 	}
 }
@@ -248,9 +367,9 @@ PUBLIC void DriverBulb_vSetLevel(uint8 u8Bulb, uint32 u32Level)
  *
  * PARAMETERS:      Name     RW  Usage
  *                  u8Bulb   R   Bulb number to set colour of
- *         	        u32Red   R   Relative red amount
- *         	        u32Green R   Relative green amount
- *         	        u32Blue  R   Relative blue amount
+ *         	        u32Red   R   Relative red amount 0-65535
+ *         	        u32Green R   Relative green amount 0-65535
+ *         	        u32Blue  R   Relative blue amount 0-65535
  *
  * RETURNS:
  * void
@@ -260,19 +379,19 @@ PUBLIC void DriverBulb_vSetLevel(uint8 u8Bulb, uint32 u32Level)
 PUBLIC void DriverBulb_vSetColour(uint8 u8Bulb, uint32 u32Red, uint32 u32Green, uint32 u32Blue)
 {
 	/* Different value ? */
-	if ((u8CurrRed[u8Bulb] != (uint8) u32Red)
-	 || (u8CurrGreen[u8Bulb] != (uint8) u32Green)
-	 || (u8CurrBlue[u8Bulb] != (uint8) u32Blue))
+	if ((u16CurrRed[u8Bulb] != (uint16) u32Red)
+	 || (u16CurrGreen[u8Bulb] != (uint16) u32Green)
+	 || (u16CurrBlue[u8Bulb] != (uint16) u32Blue))
 	{
 		/* Note the new values */
-		u8CurrRed[u8Bulb]   = (uint8) MIN(u32Red, 255);
-		u8CurrGreen[u8Bulb] = (uint8) MIN(u32Green, 255);
-		u8CurrBlue[u8Bulb]  = (uint8) MIN(u32Blue, 255);
+		u16CurrRed[u8Bulb]   = (uint16) MIN(u32Red, 0xffff);
+		u16CurrGreen[u8Bulb] = (uint16) MIN(u32Green, 0xffff);
+		u16CurrBlue[u8Bulb]  = (uint16) MIN(u32Blue, 0xffff);
 		/* Is the lamp on ? */
 		if (bIsOn[u8Bulb])
 		{
 			/* Set outputs */
-			DriverBulb_vOutput(u8Bulb);
+			PCA9685_vBulbChanged(u8Bulb);
 		}
 	}
 }
@@ -281,7 +400,10 @@ PUBLIC void DriverBulb_vSetColour(uint8 u8Bulb, uint32 u32Red, uint32 u32Green,
  *
  * NAME:			DriverBulb_vOutput
  *
- * DESCRIPTION:     Tell PCA9685 to update PWM channels for a bulb
+ * DESCRIPTION:     Tell PCA9685 to update PWM channels for a bulb. All
+ *                  channels of the bulb are rewritten, even if their value
+ *                  hasn't changed. Inside a frame the writes are held back
+ *                  until DriverBulb_vCommitFrame.
  *
  * PARAMETERS:      Name     RW  Usage
  *                  u8Bulb   R   Bulb to update
@@ -291,121 +413,622 @@ PUBLIC void DriverBulb_vSetColour(uint8 u8Bulb, uint32 u32Red, uint32 u32Green,
  *
  ****************************************************************************/
 PUBLIC void DriverBulb_vOutput(uint8 u8Bulb)
+{
+	PCA9685_vComputeBulb(u8Bulb, TRUE);
+	if (u8FrameDepth == 0)
+	{
+		PCA9685_vFlushChannels();
+	}
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_vBeginFrame
+ *
+ * DESCRIPTION:     Starts a frame. Until the matching DriverBulb_vCommitFrame,
+ *                  DriverBulb_vSetLevel, DriverBulb_vSetColour, DriverBulb_vOn
+ *                  and DriverBulb_vOff only note which bulbs have changed.
+ *                  Frames may be nested; only the outermost commit writes.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PUBLIC void DriverBulb_vBeginFrame(void)
+{
+	u8FrameDepth++;
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_vCommitFrame
+ *
+ * DESCRIPTION:     Ends a frame. The PWM value of each channel of every bulb
+ *                  changed during the frame is worked out once, and the
+ *                  channels whose value differs from what the PCA9685 already
+ *                  has are written in one pass.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PUBLIC void DriverBulb_vCommitFrame(void)
+{
+	uint32 u32Mask;
+	uint8  u8Bulb;
+
+	if (u8FrameDepth > 0)
+	{
+		u8FrameDepth--;
+	}
+	if (u8FrameDepth != 0)
+	{
+		return;
+	}
+
+	u32Mask = u32DirtyBulbs;
+	for (u8Bulb = 0; u32Mask != 0; u8Bulb++, u32Mask >>= 1)
+	{
+		if (u32Mask & 1)
+		{
+			PCA9685_vComputeBulb(u8Bulb, FALSE);
+		}
+	}
+	PCA9685_vFlushChannels();
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_vRefresh
+ *
+ * DESCRIPTION:     Works out the PWM value of every channel again, and
+ *                  writes only the channels whose value has changed. This
+ *                  is used to show stream frames.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PUBLIC void DriverBulb_vRefresh(void)
+{
+	uint8 u8Bulb;
+
+	for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		PCA9685_vComputeBulb(u8Bulb, FALSE);
+	}
+	if (u8FrameDepth == 0)
+	{
+		PCA9685_vFlushChannels();
+	}
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_vDither
+ *
+ * DESCRIPTION:     Temporal dithering of fractional PWM values, called once
+ *                  per tick. Each dithered channel carries the difference
+ *                  between its wanted and its written PWM value forward, and
+ *                  is moved to whichever of the two codes either side of its
+ *                  wanted value brings that error closest to zero (first
+ *                  order sigma-delta). Writes are limited to
+ *                  DITHER_MAX_WRITES per tick; starved channels are served
+ *                  first on the next tick.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PUBLIC void DriverBulb_vDither(void)
+{
+	uint8  u8Writes = 0;
+	uint8  u8Channel;
+	uint8  n;
+	int32  i32Target;
+	int32  i32Lowest;
+	int32  i32Error;
+	int32  i32Code;
+	bool_t bStarved = FALSE;
+
+	if (u16DitherMask == 0)
+	{
+		/* Retry any channels which didn't fit in the I2C queue */
+		PCA9685_vWriteChannels();
+		return;
+	}
+
+	u8Channel = u8DitherFirst;
+	for (n = 0; n < NUM_CHANNELS; n++)
+	{
+		if (u16DitherMask & (1 << u8Channel))
+		{
+			/* Only the two codes either side of the target are used, so a
+			 * starved channel can't overshoot. They are 1 to 4095, as the
+			 * PCA9685 doesn't like equal ON and OFF counts, except that a
+			 * target below one step is dithered against full OFF, written
+			 * as code 0. */
+			i32Target = (int32)au16DitherTarget[u8Channel];
+			i32Lowest = i32Target >> LC_PWM_FRAC_BITS;
+			i32Code = (i32Target + ai16DitherError[u8Channel] + (PWM_ONE >> 1)) >> LC_PWM_FRAC_BITS;
+			i32Code = MAX(i32Code, i32Lowest);
+			i32Code = MIN(i32Code, i32Lowest + 1);
+			if ((uint16)i32Code != au16DitherCode[u8Channel])
+			{
+				if (u8Writes < DITHER_MAX_WRITES)
+				{
+					if (i32Code == 0)
+					{
+						PCA9685_vSetFull(u8Channel, FALSE);
+						au16DitherCode[u8Channel] = 0;
+					}
+					else
+					{
+						PCA9685_vSetPWM(u8Channel, (uint16)i32Code);
+					}
+					u8Writes++;
+				}
+				else if (!bStarved)
+				{
+					bStarved = TRUE;
+					u8DitherFirst = u8Channel;
+				}
+			}
+			/* Accumulate the error of what is actually being output. It
+			 * is kept within DITHER_ERROR_LIMIT, and so that target plus
+			 * error rounds to a code which can be written, or it would
+			 * wind up against either end. */
+			i32Error = ai16DitherError[u8Channel] + i32Target
+					- ((int32)au16DitherCode[u8Channel] << LC_PWM_FRAC_BITS);
+			i32Error = MAX(i32Error, -DITHER_ERROR_LIMIT);
+			i32Error = MIN(i32Error, DITHER_ERROR_LIMIT);
+			i32Error = MAX(i32Error, ((i32Target < PWM_ONE) ? 0 : PWM_ONE) - (PWM_ONE >> 1) - i32Target);
+			i32Error = MIN(i32Error, LC_PWM_MAX + (PWM_ONE >> 1) - 1 - i32Target);
+			ai16DitherError[u8Channel] = (int16)i32Error;
+		}
+		u8Channel++;
+		if (u8Channel >= NUM_CHANNELS)
+		{
+			u8Channel = 0;
+		}
+	}
+	PCA9685_vWriteChannels();
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_bDitherActive
+ *
+ * DESCRIPTION:     Tells the tick whether DriverBulb_vDither has any work
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         TRUE while any channel is being dithered, or is waiting
+ *                  for room in the I2C queue
+ *
+ ****************************************************************************/
+PUBLIC bool_t DriverBulb_bDitherActive(void)
+{
+	return ((u16DitherMask != 0) || (u16StagedChannels != 0));
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_u16GetChannelPWM
+ *
+ * DESCRIPTION:     Gets the PWM value last written to a channel, after
+ *                  derating and the power budget
+ *
+ * PARAMETERS:      Name        RW  Usage
+ *                  u8Channel   R   PCA9685 channel
+ *
+ * RETURNS:         PWM value with LC_PWM_FRAC_BITS fractional bits, 0 for
+ *                  off
+ *
+ ****************************************************************************/
+PUBLIC uint16 DriverBulb_u16GetChannelPWM(uint8 u8Channel)
+{
+	if (au32ChannelOutput[u8Channel] == PWM_FULL_OFF)
+	{
+		return 0;
+	}
+	return (uint16)au32ChannelOutput[u8Channel];
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_u32GetErrors
+ *
+ * DESCRIPTION:     Gets the number of I2C transfers to the PCA9685 which
+ *                  weren't acknowledged since reset
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         Number of failed transfers
+ *
+ ****************************************************************************/
+PUBLIC uint32 DriverBulb_u32GetErrors(void)
+{
+	return u32I2CErrors;
+}
+
+/****************************************************************************
+ * NAME: APP_isrTimer1
+ *
+ * DESCRIPTION:
+ * ISR for Timer1
+ ****************************************************************************/
+OS_ISR(APP_isrTimer1)
+{
+	/* Clear interrupt source */
+	u8AHI_TimerFired(E_AHI_TIMER_1);
+
+	/* This doesn't do anything, but it needs to be here otherwise there
+	 * will be an undefined reference error. */
+}
+
+/****************************************************************************
+ * NAME: APP_isrI2C
+ *
+ * DESCRIPTION:
+ * ISR for the Serial Interface, taken when each I2C byte has been sent
+ ****************************************************************************/
+OS_ISR(APP_isrI2C)
+{
+	bI2CNack |= bAHI_SiMasterCheckRxNack();
+	PCA9685_vI2CNext();
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME:			PCA9685_vBulbChanged
+ *
+ * DESCRIPTION:     Called by the setters when the state of a bulb changes.
+ *                  Outside a frame the bulb's outputs are updated at once,
+ *                  inside a frame this is left to DriverBulb_vCommitFrame.
+ *
+ * PARAMETERS:      Name     RW  Usage
+ *                  u8Bulb   R   Bulb which has changed
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PRIVATE void PCA9685_vBulbChanged(uint8 u8Bulb)
+{
+	if (u8FrameDepth > 0)
+	{
+		u32DirtyBulbs |= (1UL << u8Bulb);
+	}
+	else
+	{
+		PCA9685_vComputeBulb(u8Bulb, FALSE);
+		PCA9685_vFlushChannels();
+	}
+}
+
+/****************************************************************************
+ *
+ * NAME:			PCA9685_vComputeBulb
+ *
+ * DESCRIPTION:     Works out the PWM value of each channel of a bulb, and
+ *                  marks the channels whose value has changed for
+ *                  PCA9685_vFlushChannels. While streaming, the values come
+ *                  from the current stream frame instead of the bulb state.
+ *
+ * PARAMETERS:      Name     RW  Usage
+ *                  u8Bulb   R   Bulb to update
+ *                  bForce   R   Mark all channels of the bulb, even if their
+ *                               value hasn't changed
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PRIVATE void PCA9685_vComputeBulb(uint8 u8Bulb, bool_t bForce)
 {
 	uint32  v;
-	uint16  u16PWM;
-	uint8   u8Brightness[3];
+	uint32  u32PWM;
+	uint16  u16Brightness[3];
 	int8    i;
 	uint8   u8Channel[3];
 	uint8   u8NumChannels;
 	bool_t  bIsRGB;
-	uint8   u8Data[4];
+	bool_t  bOutputOn;
 
 	bIsRGB = u8Bulb >= NUM_MONO_LIGHTS;
 	u8NumChannels = bIsRGB ? 3 : 1;
+	bOutputOn = (bIsOn[u8Bulb] || bLC_Streaming) && !bOverheat;
+
+	if (bIsRGB)
+	{
+		u8Channel[0] = u8LC_GetChannel(u8Bulb, BULB_RED);
+		u8Channel[1] = u8LC_GetChannel(u8Bulb, BULB_GREEN);
+		u8Channel[2] = u8LC_GetChannel(u8Bulb, BULB_BLUE);
+		/* Scale colour for brightness level */
+		v = (uint32)u16CurrRed[u8Bulb] * (uint32)u16CurrLevel[u8Bulb];
+		u16Brightness[0] = (uint16)FAST_DIV_BY_65535(v);
+		v = (uint32)u16CurrGreen[u8Bulb] * (uint32)u16CurrLevel[u8Bulb];
+		u16Brightness[1] = (uint16)FAST_DIV_BY_65535(v);
+		v = (uint32)u16CurrBlue[u8Bulb] * (uint32)u16CurrLevel[u8Bulb];
+		u16Brightness[2] = (uint16)FAST_DIV_BY_65535(v);
+	}
+	else
+	{
+		u8Channel[0] = u8LC_GetChannel(u8Bulb, BULB_WHITE);
+		u16Brightness[0] = u16CurrLevel[u8Bulb];
+	}
 
-	/* Is bulb on ? */
-	if (bIsOn[u8Bulb] && !bOverheat)
+	for (i = 0; i < u8NumChannels; i++)
 	{
-		if (bIsRGB)
+		if (!bOutputOn)
 		{
-			/* Scale colour for brightness level */
-			v = (uint32)u8CurrRed[u8Bulb] * (uint32)u8CurrLevel[u8Bulb];
-			u8Brightness[0] = (uint8)FAST_DIV_BY_255(v);
-			u8Channel[0] = u8LC_GetChannel(u8Bulb, BULB_RED);
-			v = (uint32)u8CurrGreen[u8Bulb] * (uint32)u8CurrLevel[u8Bulb];
-			u8Brightness[1] = (uint8)FAST_DIV_BY_255(v);
-			u8Channel[1] = u8LC_GetChannel(u8Bulb, BULB_GREEN);
-			v = (uint32)u8CurrBlue[u8Bulb] * (uint32)u8CurrLevel[u8Bulb];
-			u8Brightness[2] = (uint8)FAST_DIV_BY_255(v);
-			u8Channel[2] = u8LC_GetChannel(u8Bulb, BULB_BLUE);
+			u32PWM = PWM_FULL_OFF;
 		}
-		else
+		else if (bLC_Streaming)
 		{
-			u8Brightness[0] = u8CurrLevel[u8Bulb];
-			u8Channel[0] = u8LC_GetChannel(u8Bulb, BULB_WHITE);
+			u32PWM = u32LC_GetStreamPWM(u8Channel[i]);
+			/* Same derating as below. 0 means off. */
+			u32PWM = (u32PWM == 0) ? PWM_FULL_OFF : (u32PWM * u32TS_Derating) >> TS_DERATING_FRAC_BITS;
 		}
-
-		for (i = 0; i < u8NumChannels; i++)
+		else
 		{
 			/* Don't allow fully off, as PCA9685 doesn't like it when the
 			 * ON and OFF count registers are the same */
-			if (u8Brightness[i] == 0) u8Brightness[i] = 1;
-			/* Set PWM duty cycle */
-			u16PWM = (uint16)u32LC_AdjustIntensity(u8Brightness[i], u8Channel[i]);
-			if (u16PWM >= 4095)
-			{
-				/* Use full ON mode */
-				PCA9685_vWriteRegister(REG_LEDx_ON_H + u8Channel[i] * REG_LEDx_STRIDE, 0x10); // full ON
-				PCA9685_vWriteRegister(REG_LEDx_OFF_H + u8Channel[i] * REG_LEDx_STRIDE, 0x00); // disable full OFF
-			}
-			else
-			{
-				/* Use PWM mode */
-				uint16 u16On, u16Off;
-
-				/* Add a channel-dependent offset to ON/OFF times so that the
-				 * power supply isn't hammered at count = 0 */
-				u16On = (uint16)u8Channel[i] * 256;
-				u16Off = (u16On + u16PWM) & 0xfff;
-				u8Data[0] = (uint8_t)u16On;                   /* REG_LEDx_ON_L */
-				u8Data[1] = (uint8_t)((u16On >> 8) & 0x0f);   /* REG_LEDx_ON_H */
-				u8Data[2] = (uint8_t)u16Off;                  /* REG_LEDx_OFF_L */
-				u8Data[3] = (uint8_t)((u16Off >> 8) & 0x0f);  /* REG_LEDx_OFF_H */
-				/* Write ON/OFF registers using a multi-register write.
-				 * This is necessary because the PCA9685 outputs will change
-				 * at the end of an I2C transfer. So all registers should be
-				 * written in one transfer, so that the channel doesn't glitch
-				 * during writes. */
-				PCA9685_vWriteRegisterMulti(REG_LEDx_ON_L + u8Channel[i] * REG_LEDx_STRIDE, u8Data, sizeof(u8Data));
-			}
+			if (u16Brightness[i] == 0) u16Brightness[i] = 1;
+			u32PWM = u32LC_AdjustIntensity(u16Brightness[i], u8Channel[i]);
+			/* Scale down while the board is running hot. This can't overflow
+			 * as u32PWM <= LC_PWM_MAX < 65536. */
+			u32PWM = (u32PWM * u32TS_Derating) >> TS_DERATING_FRAC_BITS;
 		}
-	}
-	else /* Turn off */
-	{
-		if (bIsRGB)
+
+		if (bForce || (au32ChannelPWM[u8Channel[i]] != u32PWM))
 		{
-			u8Channel[0] = u8LC_GetChannel(u8Bulb, BULB_RED);
-			u8Channel[1] = u8LC_GetChannel(u8Bulb, BULB_GREEN);
-			u8Channel[2] = u8LC_GetChannel(u8Bulb, BULB_BLUE);
+			au32ChannelPWM[u8Channel[i]] = u32PWM;
+			u16DirtyChannels |= (1 << u8Channel[i]);
 		}
-		else
+	}
+
+	u32DirtyBulbs &= ~(1UL << u8Bulb);
+}
+
+/****************************************************************************
+ *
+ * NAME:			PCA9685_vFlushChannels
+ *
+ * DESCRIPTION:     Applies the power budget, and writes every channel marked
+ *                  by PCA9685_vComputeBulb, or whose output the power budget
+ *                  has changed, to the PCA9685, one I2C transfer per channel.
+ *                  The total current is worked out in one pass over all
+ *                  channels, and if it is over budget every channel is
+ *                  scaled down by the same factor.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PRIVATE void PCA9685_vFlushChannels(void)
+{
+	uint32 u32Load = 0;
+	uint32 u32Scale;
+	uint32 u32PWM;
+	uint16 u16Check;
+	uint8  u8Channel;
+
+	for (u8Channel = 0; u8Channel < NUM_CHANNELS; u8Channel++)
+	{
+		if (au32ChannelPWM[u8Channel] != PWM_FULL_OFF)
 		{
-			u8Channel[0] = u8LC_GetChannel(u8Bulb, BULB_WHITE);
+			/* Round up, as the fraction is scaled and dithered too */
+			u32Load += ((au32ChannelPWM[u8Channel] + PWM_ONE - 1) >> LC_PWM_FRAC_BITS)
+					* u16LC_GetChannelCurrent(u8Channel);
 		}
-		for (i = 0; i < u8NumChannels; i++)
+	}
+	u32Scale = u32LC_PowerBudgetScale(u32Load);
+
+	/* A new multiplier may change the output of any channel */
+	u16Check = u16DirtyChannels;
+	if (u32Scale != u32BudgetScale)
+	{
+		u32BudgetScale = u32Scale;
+		u16Check = (1 << NUM_CHANNELS) - 1;
+	}
+
+	for (u8Channel = 0; u16Check != 0; u8Channel++)
+	{
+		if (u16Check & (1 << u8Channel))
 		{
-			PCA9685_vWriteRegister(REG_LEDx_OFF_H + u8Channel[i] * REG_LEDx_STRIDE, 0x10); // full OFF
-			PCA9685_vWriteRegister(REG_LEDx_ON_H + u8Channel[i] * REG_LEDx_STRIDE, 0x00); // disable full ON
+			u16Check &= ~(1 << u8Channel);
+			u32PWM = au32ChannelPWM[u8Channel];
+			if (u32PWM != PWM_FULL_OFF)
+			{
+				/* u32Scale <= LC_POWER_SCALE_ONE and u32PWM <= LC_PWM_MAX,
+				 * so this can't overflow */
+				if (u32Scale != LC_POWER_SCALE_ONE)
+				{
+					u32PWM = (u32PWM * u32Scale) >> LC_POWER_SCALE_FRAC_BITS;
+				}
+				if (u32PWM < (PWM_ONE >> 1))
+				{
+					/* Would round to a code of 0, which the PCA9685 doesn't
+					 * like, so use full OFF mode */
+					u32PWM = PWM_FULL_OFF;
+				}
+				else if (u32PWM > LC_PWM_MAX)
+				{
+					u32PWM = LC_PWM_MAX;
+				}
+			}
+			if (!(u16DirtyChannels & (1 << u8Channel)) && (au32ChannelOutput[u8Channel] == u32PWM))
+			{
+				/* Not asked to write, and the output hasn't changed */
+				continue;
+			}
+			u16DirtyChannels &= ~(1 << u8Channel);
+			au32ChannelOutput[u8Channel] = u32PWM;
+
+			if ((u32PWM == PWM_FULL_OFF) || (u32PWM >= LC_PWM_MAX))
+			{
+				u16DitherMask &= ~(1 << u8Channel);
+				PCA9685_vSetFull(u8Channel, (u32PWM != PWM_FULL_OFF));
+			}
+			else
+			{
+				if (sLC_Settings.bDither && (u32PWM & (PWM_ONE - 1)))
+				{
+					/* Fractional value, leave it to the dither stage to
+					 * alternate between the neighbouring codes */
+					u16DitherMask |= (1 << u8Channel);
+				}
+				else
+				{
+					u16DitherMask &= ~(1 << u8Channel);
+				}
+				au16DitherTarget[u8Channel] = (uint16)u32PWM;
+				/* Start from the nearest code */
+				PCA9685_vSetPWM(u8Channel, (uint16)((u32PWM + (PWM_ONE >> 1)) >> LC_PWM_FRAC_BITS));
+			}
 		}
 	}
+	PCA9685_vWriteChannels();
+}
 
+/****************************************************************************
+ *
+ * NAME:			PCA9685_vSetPWM
+ *
+ * DESCRIPTION:     Stage a PWM duty cycle for a PCA9685 channel, to be sent
+ *                  by PCA9685_vWriteChannels
+ *
+ * PARAMETERS:      Name        RW  Usage
+ *                  u8Channel   R   PCA9685 channel
+ *                  u16PWM      R   PWM code, 1 to 4095
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PRIVATE void PCA9685_vSetPWM(uint8 u8Channel, uint16 u16PWM)
+{
+	uint16 u16On, u16Off;
+	uint8  *pu8Data = &au8LedRegisters[u8Channel * REG_LEDx_STRIDE];
+
+	/* Add a channel-dependent offset to ON/OFF times so that the
+	 * power supply isn't hammered at count = 0 */
+	u16On = (uint16)u8Channel * 256;
+	u16Off = (u16On + u16PWM) & 0xfff;
+	pu8Data[0] = (uint8_t)u16On;                   /* REG_LEDx_ON_L */
+	pu8Data[1] = (uint8_t)((u16On >> 8) & 0x0f);   /* REG_LEDx_ON_H */
+	pu8Data[2] = (uint8_t)u16Off;                  /* REG_LEDx_OFF_L */
+	pu8Data[3] = (uint8_t)((u16Off >> 8) & 0x0f);  /* REG_LEDx_OFF_H */
+	u16StagedChannels |= (1 << u8Channel);
+	au16DitherCode[u8Channel] = u16PWM;
 }
 
 /****************************************************************************
- * NAME: APP_isrTimer1
  *
- * DESCRIPTION:
- * ISR for Timer1
+ * NAME:			PCA9685_vSetFull
+ *
+ * DESCRIPTION:     Stage full ON or full OFF mode for a PCA9685 channel, to
+ *                  be sent by PCA9685_vWriteChannels
+ *
+ * PARAMETERS:      Name        RW  Usage
+ *                  u8Channel   R   PCA9685 channel
+ *                  bOn         R   TRUE for full ON, FALSE for full OFF
+ *
+ * RETURNS:         void
+ *
  ****************************************************************************/
-OS_ISR(APP_isrTimer1)
+PRIVATE void PCA9685_vSetFull(uint8 u8Channel, bool_t bOn)
 {
-	/* Clear interrupt source */
-	u8AHI_TimerFired(E_AHI_TIMER_1);
+	uint8  *pu8Data = &au8LedRegisters[u8Channel * REG_LEDx_STRIDE];
 
-	/* This doesn't do anything, but it needs to be here otherwise there
-	 * will be an undefined reference error. */
+	pu8Data[0] = 0x00;                  /* REG_LEDx_ON_L */
+	pu8Data[1] = bOn ? 0x10 : 0x00;     /* REG_LEDx_ON_H */
+	pu8Data[2] = 0x00;                  /* REG_LEDx_OFF_L */
+	pu8Data[3] = bOn ? 0x00 : 0x10;     /* REG_LEDx_OFF_H */
+	u16StagedChannels |= (1 << u8Channel);
 }
 
-/****************************************************************************/
-/***        Local Functions                                               ***/
-/****************************************************************************/
+/****************************************************************************
+ *
+ * NAME:			PCA9685_vWriteChannels
+ *
+ * DESCRIPTION:     Queue every staged channel to be sent to the PCA9685 in
+ *                  one I2C transfer. Each run of neighbouring staged
+ *                  channels is one auto-increment write, and the runs are
+ *                  joined by repeated STARTs, which costs less than
+ *                  resending the channels between them. The PCA9685 only
+ *                  changes its outputs at the STOP, so all the channels
+ *                  change together and none glitch half way through a
+ *                  write. Writing all 12 channels is 50 bytes on the bus
+ *                  (~1.1ms at 400kHz), against 72 bytes in 12 transfers.
+ *                  If the queue is too full, the channels stay staged and
+ *                  are merged into the next frame, or sent by the next
+ *                  DriverBulb_vDither.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PRIVATE void PCA9685_vWriteChannels(void)
+{
+	uint16 u16Staged = u16StagedChannels;
+	uint16 u16Starts = u16Staged & ~(u16Staged << 1);
+	uint8  u8Writes = 0;
+	uint8  u8Channels = 0;
+	uint8  u8First;
+	uint8  u8Last;
+
+	/* Count the runs, and the channels in them */
+	for (u8First = 0; u8First < NUM_CHANNELS; u8First++)
+	{
+		u8Writes += (u16Starts >> u8First) & 1;
+		u8Channels += (u16Staged >> u8First) & 1;
+	}
+	if ((u8Writes == 0) || !PCA9685_bI2CRoom(u8Writes, u8Channels * REG_LEDx_STRIDE))
+	{
+		return;
+	}
+
+	u8First = 0;
+	while (u16Staged != 0)
+	{
+		/* Find the next run of staged channels */
+		while (!(u16Staged & (1 << u8First)))
+		{
+			u8First++;
+		}
+		u8Last = u8First;
+		while ((u8Last + 1 < NUM_CHANNELS) && (u16Staged & (1 << (u8Last + 1))))
+		{
+			u8Last++;
+		}
+		u16Staged &= ~(((1 << (u8Last + 1)) - 1));
+		/* STOP after the last run only */
+		PCA9685_vI2CQueue(REG_LEDx_ON_L + u8First * REG_LEDx_STRIDE,
+				&au8LedRegisters[u8First * REG_LEDx_STRIDE],
+				(uint8)((u8Last - u8First + 1) * REG_LEDx_STRIDE),
+				(u16Staged == 0), PCA9685_vWriteDone);
+		u8First = u8Last + 1;
+	}
+	PCA9685_vI2CCommit();
+	u16StagedChannels = 0;
+}
 
 /****************************************************************************
  *
  * NAME:       		PCA9685_vWriteRegister
  *
- * DESCRIPTION:		Writes to one of the PCA9685's registers
+ * DESCRIPTION:		Queues a write to one of the PCA9685's registers. This
+ *                  is only used by DriverBulb_vInit, when the queue is empty.
  *
  *
  * PARAMETERS:      Name     RW  Usage
@@ -418,62 +1041,222 @@ OS_ISR(APP_isrTimer1)
  ****************************************************************************/
 PRIVATE void PCA9685_vWriteRegister(uint8 u8Reg, uint8 u8Data)
 {
-	vAHI_SiMasterWriteSlaveAddr(PCA9685_ADDRESS, FALSE);
-	/* START, WRITE, ACK */
-	bAHI_SiMasterSetCmdReg(TRUE, FALSE, FALSE, TRUE, TRUE, FALSE);
-	while (bAHI_SiMasterPollTransferInProgress());
-	vAHI_SiMasterWriteData8(u8Reg);
-	/* WRITE, ACK */
-	bAHI_SiMasterSetCmdReg(FALSE, FALSE, FALSE, TRUE, TRUE, FALSE);
-	while (bAHI_SiMasterPollTransferInProgress());
-	vAHI_SiMasterWriteData8(u8Data);
-	/* STOP, WRITE, ACK */
-	bAHI_SiMasterSetCmdReg(FALSE, TRUE, FALSE, TRUE, TRUE, FALSE);
-	while (bAHI_SiMasterPollTransferInProgress());
+	if (PCA9685_bI2CRoom(1, 1))
+	{
+		PCA9685_vI2CQueue(u8Reg, &u8Data, 1, TRUE, PCA9685_vWriteDone);
+		PCA9685_vI2CCommit();
+	}
 }
 
 /****************************************************************************
  *
- * NAME:       		PCA9685_vWriteRegisterMulti
+ * NAME:       		PCA9685_vWriteDone
  *
- * DESCRIPTION:		Writes to one or more of the PCA9685's registers
+ * DESCRIPTION:		Retires a transfer to the PCA9685. Called from the SI
+ *                  interrupt after the STOP.
  *
+ * PARAMETERS:      Name     RW  Usage
+ *         	        bNack    R   TRUE if any byte wasn't acknowledged
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+PRIVATE void PCA9685_vWriteDone(bool_t bNack)
+{
+	if (bNack)
+	{
+		u32I2CErrors++;
+	}
+}
+
+/****************************************************************************
+ *
+ * NAME:       		PCA9685_bI2CRoom
+ *
+ * DESCRIPTION:		Checks whether the I2C queue has room for more writes
+ *
+ * PARAMETERS:      Name      RW  Usage
+ *         	        u8Writes  R   Number of writes
+ *         	        u16Bytes  R   Total number of data bytes of the writes
+ *
+ * RETURNS:
+ * TRUE if they fit
+ *
+ ****************************************************************************/
+PRIVATE bool_t PCA9685_bI2CRoom(uint8 u8Writes, uint16 u16Bytes)
+{
+	return (((uint8)(u8I2CQueueEnd - u8I2CQueueTail) + u8Writes <= I2C_QUEUE_SIZE)
+		 && ((uint16)(u16I2CDataEnd - u16I2CDataTail) + u16Bytes <= I2C_DATA_SIZE));
+}
+
+/****************************************************************************
+ *
+ * NAME:       		PCA9685_vI2CQueue
+ *
+ * DESCRIPTION:		Adds a write to the I2C queue, after checking for room
+ *                  with PCA9685_bI2CRoom. The SI interrupt doesn't see it
+ *                  until PCA9685_vI2CCommit.
  *
  * PARAMETERS:      Name     RW  Usage
  *         	        u8Reg    R   First register number to write to
- *         	        pu8Data  R   Pointer to array of register values
+ *         	        pu8Data  R   Pointer to array of register values, which
+ *         	                     are copied
  *         	        u8Len    R   Number of registers to write to
+ *         	        bStop    R   FALSE to keep the bus, so that the next
+ *         	                     write starts with a repeated START
+ *         	        prDone   R   Called after the STOP, or NULL
  *
  * RETURNS:
  * void
  *
  ****************************************************************************/
-PRIVATE void PCA9685_vWriteRegisterMulti(uint8 u8Reg, uint8 *pu8Data, uint8 u8Len)
+PRIVATE void PCA9685_vI2CQueue(uint8 u8Reg, uint8 *pu8Data, uint8 u8Len, bool_t bStop, tprI2CDone prDone)
 {
+	tsI2CWrite *psWrite = &asI2CQueue[u8I2CQueueEnd & (I2C_QUEUE_SIZE - 1)];
 	uint8 i;
 
-	vAHI_SiMasterWriteSlaveAddr(PCA9685_ADDRESS, FALSE);
-	/* START, WRITE, ACK */
-	bAHI_SiMasterSetCmdReg(TRUE, FALSE, FALSE, TRUE, TRUE, FALSE);
-	while (bAHI_SiMasterPollTransferInProgress());
-	vAHI_SiMasterWriteData8(u8Reg);
-	/* WRITE, ACK */
-	bAHI_SiMasterSetCmdReg(FALSE, FALSE, FALSE, TRUE, TRUE, FALSE);
-	while (bAHI_SiMasterPollTransferInProgress());
+	psWrite->u8Reg = u8Reg;
+	psWrite->u8Len = u8Len;
+	psWrite->bStop = bStop;
+	psWrite->prDone = prDone;
 	for (i = 0; i < u8Len; i++)
 	{
-		vAHI_SiMasterWriteData8(pu8Data[i]);
-		if (i == (u8Len - 1))
+		au8I2CData[u16I2CDataEnd & (I2C_DATA_SIZE - 1)] = pu8Data[i];
+		u16I2CDataEnd++;
+	}
+	u8I2CQueueEnd++;
+}
+
+/****************************************************************************
+ *
+ * NAME:       		PCA9685_vI2CCommit
+ *
+ * DESCRIPTION:		Hands the writes queued since the last commit to the SI
+ *                  interrupt, and starts the first of them if the bus is
+ *                  idle. The last write queued must end with a STOP.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+PRIVATE void PCA9685_vI2CCommit(void)
+{
+	/* The SI interrupt can be taken at any point here. It only goes idle
+	 * when it finds no committed writes, and nothing but the START below
+	 * raises it while idle. If it is busy when the new head is published,
+	 * it goes on to the new writes itself, and the state read below is not
+	 * idle. If it went idle before, it stays idle, and the writes are
+	 * started here. Either way they are started exactly once. */
+	u8I2CQueueHead = u8I2CQueueEnd;
+	if (eI2CState == E_I2C_IDLE)
+	{
+		PCA9685_vI2CNext();
+	}
+}
+
+/****************************************************************************
+ *
+ * NAME:       		PCA9685_vI2CNext
+ *
+ * DESCRIPTION:		Moves the I2C queue on by one byte. Called by the SI
+ *                  interrupt when the last byte has been sent, and by
+ *                  PCA9685_vI2CCommit to start the bus.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+PRIVATE void PCA9685_vI2CNext(void)
+{
+	tsI2CWrite *psWrite = &asI2CQueue[u8I2CQueueTail & (I2C_QUEUE_SIZE - 1)];
+
+	if ((eI2CState == E_I2C_DATA) && (u8I2CCount == psWrite->u8Len))
+	{
+		/* Write finished */
+		u8I2CQueueTail++;
+		eI2CState = E_I2C_IDLE;
+		if (psWrite->bStop)
+		{
+			if (psWrite->prDone != NULL)
+			{
+				psWrite->prDone(bI2CNack);
+			}
+			bI2CNack = FALSE;
+		}
+		psWrite = &asI2CQueue[u8I2CQueueTail & (I2C_QUEUE_SIZE - 1)];
+	}
+
+	switch (eI2CState)
+	{
+	case E_I2C_IDLE:
+		if (u8I2CQueueTail == u8I2CQueueHead)
+		{
+			/* Nothing more to send, just clear the interrupt */
+			bAHI_SiMasterSetCmdReg(FALSE, FALSE, FALSE, FALSE, FALSE, TRUE);
+			break;
+		}
+		/* Set the state first: when this is called from
+		 * PCA9685_vI2CCommit, the interrupt for the START can be taken
+		 * as soon as it has been issued */
+		eI2CState = E_I2C_ADDRESS;
+		vAHI_SiMasterWriteSlaveAddr(PCA9685_ADDRESS, FALSE);
+		/* START, WRITE, ACK. This is a repeated START if the last write
+		 * didn't end with a STOP. */
+		bAHI_SiMasterSetCmdReg(TRUE, FALSE, FALSE, TRUE, TRUE, TRUE);
+		break;
+
+	case E_I2C_ADDRESS:
+		vAHI_SiMasterWriteData8(psWrite->u8Reg);
+		/* WRITE, ACK */
+		bAHI_SiMasterSetCmdReg(FALSE, FALSE, FALSE, TRUE, TRUE, TRUE);
+		eI2CState = E_I2C_DATA;
+		u8I2CCount = 0;
+		break;
+
+	case E_I2C_DATA:
+		vAHI_SiMasterWriteData8(au8I2CData[u16I2CDataTail & (I2C_DATA_SIZE - 1)]);
+		u16I2CDataTail++;
+		u8I2CCount++;
+		if ((u8I2CCount == psWrite->u8Len) && psWrite->bStop)
 		{
 			/* Last byte */
 			/* STOP, WRITE, ACK */
-			bAHI_SiMasterSetCmdReg(FALSE, TRUE, FALSE, TRUE, TRUE, FALSE);
+			bAHI_SiMasterSetCmdReg(FALSE, TRUE, FALSE, TRUE, TRUE, TRUE);
 		}
 		else
 		{
 			/* WRITE, ACK */
-			bAHI_SiMasterSetCmdReg(FALSE, FALSE, FALSE, TRUE, TRUE, FALSE);
+			bAHI_SiMasterSetCmdReg(FALSE, FALSE, FALSE, TRUE, TRUE, TRUE);
 		}
+		break;
+	}
+}
+
+/****************************************************************************
+ *
+ * NAME:       		PCA9685_vI2CWait
+ *
+ * DESCRIPTION:		Sends everything in the I2C queue by polling, for use
+ *                  before the OS has started and the SI interrupt can be
+ *                  taken
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+PRIVATE void PCA9685_vI2CWait(void)
+{
+	while (eI2CState != E_I2C_IDLE)
+	{
 		while (bAHI_SiMasterPollTransferInProgress());
+		bI2CNack |= bAHI_SiMasterCheckRxNack();
+		PCA9685_vI2CNext();
 	}
 }
@@ -29,29 +29,37 @@
 /* Number of active PWM channels */
 #define NUM_PWM_CHANNELS			((NUM_MONO_LIGHTS) + ((NUM_RGB_LIGHTS) * 3))
 
-#define FAST_DIV_BY_255(x)			((((x) << 8) + (x) + 255) >> 16)
+/* Divide a product of two 16 bit intensities by 65535, exact at full scale */
+#define FAST_DIV_BY_65535(x)		(((x) + ((x) >> 16) + 1) >> 16)
+
+#define PWM_ONE						(1 << LC_PWM_FRAC_BITS)
 
 /****************************************************************************/
 /***        Local Function Prototypes                                     ***/
 /****************************************************************************/
 
 PRIVATE void UpdatePWMValue(uint8 u8Timer, uint16 u16Value);
+PRIVATE void BulbChanged(uint8 u8Bulb);
 
 /****************************************************************************/
 /***        Local Variables                                               ***/
 /****************************************************************************/
 PRIVATE bool_t  bIsOn[NUM_BULBS];
-PRIVATE uint8   u8CurrLevel[NUM_BULBS];
-PRIVATE uint8   u8CurrRed[NUM_BULBS];
-PRIVATE uint8   u8CurrGreen[NUM_BULBS];
-PRIVATE uint8   u8CurrBlue[NUM_BULBS];
+PRIVATE uint16  u16CurrLevel[NUM_BULBS];
+PRIVATE uint16  u16CurrRed[NUM_BULBS];
+PRIVATE uint16  u16CurrGreen[NUM_BULBS];
+PRIVATE uint16  u16CurrBlue[NUM_BULBS];
 
 /* List of PWM channels. These values are not timer numbers, they are values
  * that can be passed to the integrated peripheral library. */
 PRIVATE volatile uint8  au8PWMChannels[NUM_PWM_CHANNELS];
-/* List of PWM values (u16Hi parameter for vAHI_TimerStartRepeat) which will
- * be written into the corresponding PWM channel specified by au8PWMChannels. */
+/* List of PWM values (u16Hi parameter for vAHI_TimerStartRepeat, with
+ * LC_PWM_FRAC_BITS fractional bits) which will be written into the
+ * corresponding PWM channel specified by au8PWMChannels. LC_PWM_MAX means
+ * fully on. */
 PRIVATE volatile uint16 au16PWMValues[NUM_PWM_CHANNELS];
+/* Accumulated dither error of each PWM channel */
+PRIVATE int16 ai16DitherError[NUM_PWM_CHANNELS];
 /* Entries in this list will be set to TRUE if the corresponding entry in
  * au16PWMValues has been updated. */
 PRIVATE volatile bool_t abPWMUpdated[NUM_PWM_CHANNELS];
@@ -59,6 +67,11 @@ PRIVATE volatile bool_t abPWMUpdated[NUM_PWM_CHANNELS];
  * channel which the phase controller will update next. */
 PRIVATE volatile uint8  u8CurrentPWMChannel;
 
+/* Frame state. While u8FrameDepth is non-zero the setters only set the bit
+ * of the changed bulb in u32DirtyBulbs. */
+PRIVATE uint8  u8FrameDepth;
+PRIVATE uint32 u32DirtyBulbs;
+
 /* Array that is used to convert timer number into a value that can be passed
  * to the integrated peripheral library. */
 PRIVATE uint8 au8Timers[5] = {E_AHI_TIMER_0, E_AHI_TIMER_1,
@@ -165,7 +178,7 @@ PUBLIC void DriverBulb_vOn(uint8 u8Bulb)
 		/* Note light is on */
 		bIsOn[u8Bulb] = TRUE;
 		/* Set outputs */
-		DriverBulb_vOutput(u8Bulb);
+		BulbChanged(u8Bulb);
 	}
 }
 
@@ -190,7 +203,7 @@ PUBLIC void DriverBulb_vOff(uint8 u8Bulb)
 		/* Note light is off */
 		bIsOn[u8Bulb] = FALSE;
 		/* Set outputs */
-		DriverBulb_vOutput(u8Bulb);
+		BulbChanged(u8Bulb);
 	}
 }
 
@@ -240,7 +253,7 @@ PUBLIC bool_t DriverBulb_bOn(uint8 u8Bulb)
  *
  * PARAMETERS:      Name     RW  Usage
  *                  u8Bulb   R   Bulb number to set level of
- *         	        u32Level R   Light level 0-LAMP_LEVEL_MAX
+ *         	        u32Level R   Light level 0-65535
  *
  * RETURNS:
  * void
@@ -249,22 +262,22 @@ PUBLIC bool_t DriverBulb_bOn(uint8 u8Bulb)
 PUBLIC void DriverBulb_vSetLevel(uint8 u8Bulb, uint32 u32Level)
 {
 	/* Different value ? */
-	if (u8CurrLevel[u8Bulb] != (uint8) u32Level)
+	if (u16CurrLevel[u8Bulb] != (uint16) u32Level)
 	{
 		/* Note the new level */
-		if (u32Level > CLD_LEVELCONTROL_MAX_LEVEL)
+		if (u32Level > 0xffff)
 		{
-			u8CurrLevel[u8Bulb] = CLD_LEVELCONTROL_MAX_LEVEL;
+			u16CurrLevel[u8Bulb] = 0xffff;
 		}
 		else
 		{
-			u8CurrLevel[u8Bulb] = (uint8) MAX(1, u32Level);
+			u16CurrLevel[u8Bulb] = (uint16) MAX(1, u32Level);
 		}
 		/* Is the lamp on ? */
 		if (bIsOn[u8Bulb])
 		{
 			/* Set outputs */
-			DriverBulb_vOutput(u8Bulb);
+			BulbChanged(u8Bulb);
 		}
 	}
 }
@@ -277,9 +290,9 @@ PUBLIC void DriverBulb_vSetLevel(uint8 u8Bulb, uint32 u32Level)
  *
  * PARAMETERS:      Name     RW  Usage
  *                  u8Bulb   R   Bulb number to set colour of
- *         	        u32Red   R   Relative red amount
- *         	        u32Green R   Relative green amount
- *         	        u32Blue  R   Relative blue amount
+ *         	        u32Red   R   Relative red amount 0-65535
+ *         	        u32Green R   Relative green amount 0-65535
+ *         	        u32Blue  R   Relative blue amount 0-65535
  *
  * RETURNS:
  * void
@@ -289,19 +302,19 @@ PUBLIC void DriverBulb_vSetLevel(uint8 u8Bulb, uint32 u32Level)
 PUBLIC void DriverBulb_vSetColour(uint8 u8Bulb, uint32 u32Red, uint32 u32Green, uint32 u32Blue)
 {
 	/* Different value ? */
-	if ((u8CurrRed[u8Bulb] != (uint8) u32Red)
-	 || (u8CurrGreen[u8Bulb] != (uint8) u32Green)
-	 || (u8CurrBlue[u8Bulb] != (uint8) u32Blue))
+	if ((u16CurrRed[u8Bulb] != (uint16) u32Red)
+	 || (u16CurrGreen[u8Bulb] != (uint16) u32Green)
+	 || (u16CurrBlue[u8Bulb] != (uint16) u32Blue))
 	{
 		/* Note the new values */
-		u8CurrRed[u8Bulb]   = (uint8) MIN(u32Red, 255);
-		u8CurrGreen[u8Bulb] = (uint8) MIN(u32Green, 255);
-		u8CurrBlue[u8Bulb]  = (uint8) MIN(u32Blue, 255);
+		u16CurrRed[u8Bulb]   = (uint16) MIN(u32Red, 0xffff);
+		u16CurrGreen[u8Bulb] = (uint16) MIN(u32Green, 0xffff);
+		u16CurrBlue[u8Bulb]  = (uint16) MIN(u32Blue, 0xffff);
 		/* Is the lamp on ? */
 		if (bIsOn[u8Bulb])
 		{
 			/* Set outputs */
-			DriverBulb_vOutput(u8Bulb);
+			BulbChanged(u8Bulb);
 		}
 	}
 }
@@ -310,7 +323,9 @@ PUBLIC void DriverBulb_vSetColour(uint8 u8Bulb, uint32 u32Red, uint32 u32Green,
  *
  * NAME:			DriverBulb_vOutput
  *
- * DESCRIPTION:     Tell PCA9685 to update PWM channels for a bulb
+ * DESCRIPTION:     Tell PCA9685 to update PWM channels for a bulb. While
+ *                  streaming, the values come from the current stream
+ *                  frame instead of the bulb state.
  *
  * PARAMETERS:      Name     RW  Usage
  *                  u8Bulb   R   Bulb to update
@@ -322,8 +337,8 @@ PUBLIC void DriverBulb_vSetColour(uint8 u8Bulb, uint32 u32Red, uint32 u32Green,
 PUBLIC void DriverBulb_vOutput(uint8 u8Bulb)
 {
 	uint32  v;
-	uint16  u16PWM;
-	uint8   u8Brightness[3];
+	uint32  u32PWM;
+	uint16  u16Brightness[3];
 	int8    i;
 	uint8   u8Channel[3];
 	uint8   u8NumChannels;
@@ -333,39 +348,45 @@ PUBLIC void DriverBulb_vOutput(uint8 u8Bulb)
 	u8NumChannels = bIsRGB ? 3 : 1;
 
 	/* Is bulb on ? */
-	if (bIsOn[u8Bulb] && !bOverheat)
+	if ((bIsOn[u8Bulb] || bLC_Streaming) && !bOverheat)
 	{
 		if (bIsRGB)
 		{
 			/* Scale colour for brightness level */
-			v = (uint32)u8CurrRed[u8Bulb] * (uint32)u8CurrLevel[u8Bulb];
-			u8Brightness[0] = (uint8)FAST_DIV_BY_255(v);
+			v = (uint32)u16CurrRed[u8Bulb] * (uint32)u16CurrLevel[u8Bulb];
+			u16Brightness[0] = (uint16)FAST_DIV_BY_65535(v);
 			u8Channel[0] = u8LC_GetChannel(u8Bulb, BULB_RED);
-			v = (uint32)u8CurrGreen[u8Bulb] * (uint32)u8CurrLevel[u8Bulb];
-			u8Brightness[1] = (uint8)FAST_DIV_BY_255(v);
+			v = (uint32)u16CurrGreen[u8Bulb] * (uint32)u16CurrLevel[u8Bulb];
+			u16Brightness[1] = (uint16)FAST_DIV_BY_65535(v);
 			u8Channel[1] = u8LC_GetChannel(u8Bulb, BULB_GREEN);
-			v = (uint32)u8CurrBlue[u8Bulb] * (uint32)u8CurrLevel[u8Bulb];
-			u8Brightness[2] = (uint8)FAST_DIV_BY_255(v);
+			v = (uint32)u16CurrBlue[u8Bulb] * (uint32)u16CurrLevel[u8Bulb];
+			u16Brightness[2] = (uint16)FAST_DIV_BY_65535(v);
 			u8Channel[2] = u8LC_GetChannel(u8Bulb, BULB_BLUE);
 		}
 		else
 		{
-			u8Brightness[0] = u8CurrLevel[u8Bulb];
+			u16Brightness[0] = u16CurrLevel[u8Bulb];
 			u8Channel[0] = u8LC_GetChannel(u8Bulb, BULB_WHITE);
 		}
 
 		for (i = 0; i < u8NumChannels; i++)
 		{
-			/* Don't allow fully off */
-			if (u8Brightness[i] == 0) u8Brightness[i] = 1;
-			/* Set PWM duty cycle */
-			u16PWM = (uint16)u32LC_AdjustIntensity(u8Brightness[i], u8Channel[i]);
-			if (u16PWM >= 4095)
+			if (bLC_Streaming)
+			{
+				/* 0 means off, and stays 0 after derating */
+				u32PWM = u32LC_GetStreamPWM(u8Channel[i]);
+			}
+			else
 			{
-				/* Full on */
-				u16PWM = 4096;
+				/* Don't allow fully off */
+				if (u16Brightness[i] == 0) u16Brightness[i] = 1;
+				/* Set PWM duty cycle */
+				u32PWM = u32LC_AdjustIntensity(u16Brightness[i], u8Channel[i]);
 			}
-			UpdatePWMValue(au8Timers[u8Channel[i]], u16PWM);
+			/* Scale down while the board is running hot. This can't overflow
+			 * as u32PWM <= LC_PWM_MAX < 65536. */
+			u32PWM = (u32PWM * u32TS_Derating) >> TS_DERATING_FRAC_BITS;
+			UpdatePWMValue(au8Timers[u8Channel[i]], (uint16)u32PWM);
 		}
 	}
 	else /* Turn off */
@@ -389,6 +410,162 @@ PUBLIC void DriverBulb_vOutput(uint8 u8Bulb)
 
 }
 
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_vBeginFrame
+ *
+ * DESCRIPTION:     Starts a frame. Until the matching DriverBulb_vCommitFrame,
+ *                  the setters only note which bulbs have changed. Frames
+ *                  may be nested; only the outermost commit updates outputs.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PUBLIC void DriverBulb_vBeginFrame(void)
+{
+	u8FrameDepth++;
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_vCommitFrame
+ *
+ * DESCRIPTION:     Ends a frame, updating the outputs of every bulb which
+ *                  changed during the frame once.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PUBLIC void DriverBulb_vCommitFrame(void)
+{
+	uint32 u32Mask;
+	uint8  u8Bulb;
+
+	if (u8FrameDepth > 0)
+	{
+		u8FrameDepth--;
+	}
+	if (u8FrameDepth != 0)
+	{
+		return;
+	}
+
+	u32Mask = u32DirtyBulbs;
+	u32DirtyBulbs = 0;
+	for (u8Bulb = 0; u32Mask != 0; u8Bulb++, u32Mask >>= 1)
+	{
+		if (u32Mask & 1)
+		{
+			DriverBulb_vOutput(u8Bulb);
+		}
+	}
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_vRefresh
+ *
+ * DESCRIPTION:     Updates the outputs of every bulb. This is used to show
+ *                  stream frames.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PUBLIC void DriverBulb_vRefresh(void)
+{
+	uint8 u8Bulb;
+
+	for (u8Bulb = 0; u8Bulb < NUM_BULBS; u8Bulb++)
+	{
+		DriverBulb_vOutput(u8Bulb);
+	}
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_vDither
+ *
+ * DESCRIPTION:     Temporal dithering hook called once per tick. Nothing to
+ *                  do here, as the phase controller ISR dithers every PWM
+ *                  cycle.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PUBLIC void DriverBulb_vDither(void)
+{
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_bDitherActive
+ *
+ * DESCRIPTION:     Tells the tick whether DriverBulb_vDither has any work,
+ *                  which it never has on this driver.
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         FALSE
+ *
+ ****************************************************************************/
+PUBLIC bool_t DriverBulb_bDitherActive(void)
+{
+	return FALSE;
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_u16GetChannelPWM
+ *
+ * DESCRIPTION:     Gets the PWM value of a channel, after derating
+ *
+ * PARAMETERS:      Name        RW  Usage
+ *                  u8Channel   R   Timer channel
+ *
+ * RETURNS:         PWM value with LC_PWM_FRAC_BITS fractional bits, 0 for
+ *                  off
+ *
+ ****************************************************************************/
+PUBLIC uint16 DriverBulb_u16GetChannelPWM(uint8 u8Channel)
+{
+	uint8 i;
+
+	for (i = 0; i < NUM_PWM_CHANNELS; i++)
+	{
+		if (au8PWMChannels[i] == au8Timers[u8Channel])
+		{
+			return au16PWMValues[i];
+		}
+	}
+	/* The phase controller timer */
+	return 0;
+}
+
+/****************************************************************************
+ *
+ * NAME:			DriverBulb_u32GetErrors
+ *
+ * DESCRIPTION:     Gets the number of failed output updates, which can't
+ *                  happen on this driver
+ *
+ * PARAMETERS:      None
+ *
+ * RETURNS:         0
+ *
+ ****************************************************************************/
+PUBLIC uint32 DriverBulb_u32GetErrors(void)
+{
+	return 0;
+}
+
 /****************************************************************************
  * NAME: APP_isrTimer1
  *
@@ -397,13 +574,40 @@ PUBLIC void DriverBulb_vOutput(uint8 u8Bulb)
  ****************************************************************************/
 OS_ISR(APP_isrTimer1)
 {
+	uint16 u16Value;
+	uint16 u16Code;
+	bool_t bDither;
+
 	/* Clear interrupt source */
 	u8AHI_TimerFired(au8Timers[PHASE_CONTROLLER_TIMER]);
 
-	if (abPWMUpdated[u8CurrentPWMChannel])
+	u16Value = au16PWMValues[u8CurrentPWMChannel];
+	bDither = sLC_Settings.bDither
+			&& (u16Value < LC_PWM_MAX)
+			&& (u16Value & (PWM_ONE - 1));
+
+	/* Fractional values are dithered once every PWM cycle */
+	if (abPWMUpdated[u8CurrentPWMChannel] || bDither)
 	{
+		if (u16Value >= LC_PWM_MAX)
+		{
+			/* Full on */
+			u16Code = 4096;
+		}
+		else if (bDither)
+		{
+			/* First order sigma-delta: output the code that brings the
+			 * accumulated error closest to zero */
+			u16Code = (uint16)(((int32)u16Value + ai16DitherError[u8CurrentPWMChannel]
+					+ (PWM_ONE >> 1)) >> LC_PWM_FRAC_BITS);
+			ai16DitherError[u8CurrentPWMChannel] += (int16)u16Value - (int16)(u16Code << LC_PWM_FRAC_BITS);
+		}
+		else
+		{
+			u16Code = (u16Value + (PWM_ONE >> 1)) >> LC_PWM_FRAC_BITS;
+		}
 		/* Update next PWM value */
-		vAHI_TimerStartRepeat(au8PWMChannels[u8CurrentPWMChannel], au16PWMValues[u8CurrentPWMChannel], 4096);
+		vAHI_TimerStartRepeat(au8PWMChannels[u8CurrentPWMChannel], u16Code, 4096);
 		abPWMUpdated[u8CurrentPWMChannel] = FALSE;
 	}
 
@@ -415,10 +619,48 @@ OS_ISR(APP_isrTimer1)
 	}
 }
 
+/****************************************************************************
+ * NAME: APP_isrI2C
+ *
+ * DESCRIPTION:
+ * ISR for the Serial Interface
+ ****************************************************************************/
+OS_ISR(APP_isrI2C)
+{
+	/* The Serial Interface isn't used by this driver, but the ISR needs to be
+	 * here otherwise there will be an undefined reference error. */
+}
+
 /****************************************************************************/
 /***        Local Functions                                               ***/
 /****************************************************************************/
 
+/****************************************************************************
+ *
+ * NAME:			BulbChanged
+ *
+ * DESCRIPTION:     Called by the setters when the state of a bulb changes.
+ *                  Outside a frame the bulb's outputs are updated at once,
+ *                  inside a frame this is left to DriverBulb_vCommitFrame.
+ *
+ * PARAMETERS:      Name     RW  Usage
+ *                  u8Bulb   R   Bulb which has changed
+ *
+ * RETURNS:         void
+ *
+ ****************************************************************************/
+PRIVATE void BulbChanged(uint8 u8Bulb)
+{
+	if (u8FrameDepth > 0)
+	{
+		u32DirtyBulbs |= (1UL << u8Bulb);
+	}
+	else
+	{
+		DriverBulb_vOutput(u8Bulb);
+	}
+}
+
 /****************************************************************************
  *
  * NAME:			UpdatePWMValue
@@ -432,7 +674,8 @@ OS_ISR(APP_isrTimer1)
  * PARAMETERS:      Name     RW  Usage
  *                  u8Timer  R   Timer to update (integrated peripherals
  *                               library value)
- *                  u16Value R   PWM value, 0 = fully off, 4095 = fully on
+ *                  u16Value R   PWM value with LC_PWM_FRAC_BITS fractional
+ *                               bits, 0 = fully off, LC_PWM_MAX = fully on
  *
  *
  * RETURNS:         void
@@ -49,8 +49,10 @@
 #include "PDM.h"
 #include "PDM_IDs.h"
 #include "os.h"
+#include "os_gen.h"
 #include "app_zcl_light_task.h"
 #include "app_light_calibration.h"
+#include "app_light_interpolation.h"
 #include "app_temp_sensor.h"
 #include "DriverBulb.h"
 
@@ -63,14 +65,131 @@
 #define DEFAULT_GAMMA			2867
 /* Default calibration value for brightness. 1024 = 1.0. */
 #define DEFAULT_BRIGHTNESS		1024
+/* Temporal dithering is off by default */
+#define DEFAULT_DITHER			FALSE
+/* All bulbs fade linearly by default */
+#define DEFAULT_LOG_FADE_MASK	0
+/* All bulbs fade colour in RGB by default */
+#define DEFAULT_XY_FADE_MASK	0
+/* No channel current is known and there is no power budget by default */
+#define DEFAULT_CHANNEL_CURRENT	0
+#define DEFAULT_POWER_BUDGET	0
+/* Default baud rate of the configuration UART. This is also the rate which
+ * a break on the RX line goes back to. */
+#define DEFAULT_BAUD_RATE		38400
+
+/* Number of fractional bits in colour correction matrix entries */
+#define MATRIX_FRAC_BITS		12
+#define MATRIX_ONE				(1 << MATRIX_FRAC_BITS)
+/* Largest magnitude of a matrix entry (2.0). This keeps the sum of three
+ * products with 16 bit colour values within 32 bits. */
+#define MATRIX_ENTRY_MAX		(2 * MATRIX_ONE)
+
+/* Maximum number of knots in a measured calibration curve */
+#define MAX_CURVE_KNOTS			16
+
+/* Log value which represents an intensity of 0, the end of exp_table */
+#define LOG_ZERO				((EXP_TABLE_LENGTH - 1) << EXP_TABLE_SHIFT)
+
+/* log_table_long has one entry per 16 intensity steps, and entry 0 is
+ * -infinity, so the gamma curve scales intensities below
+ * LOW_INTENSITY_LIMIT up by 2^LOW_INTENSITY_SHIFT before looking them up */
+#define LOW_INTENSITY_SHIFT		(5)
+#define LOW_INTENSITY_LIMIT		(1 << (16 - LOW_INTENSITY_SHIFT))
+
+#ifndef VARIANT_MINI
+/* The gamma curve of each channel is sampled at 2^INTENSITY_TABLE_BITS + 1
+ * evenly spaced intensities, and interpolated in between. The Mini variant
+ * doesn't have the RAM for these tables. */
+#define INTENSITY_TABLE_BITS	8
+#define INTENSITY_TABLE_SHIFT	(16 - INTENSITY_TABLE_BITS)
+#define INTENSITY_TABLE_SIZE	((1 << INTENSITY_TABLE_BITS) + 1)
+/* Curves which are steep at the bottom, a gamma below 1.0 or a measured
+ * curve, are too far from straight over the first few segments to be
+ * interpolated, so intensities below INTENSITY_DIRECT_LIMIT are calculated
+ * directly for them. Other curves only skip the first segment. */
+#define INTENSITY_DIRECT_LIMIT	(8 << INTENSITY_TABLE_SHIFT)
+#endif
 
 /* Size of UART TX buffer in number of bytes */
 #define TX_BUF_SIZE				32
 /* Size of UART RX buffer in number of bytes */
 #define RX_BUF_SIZE				32
+/* Size of the ring buffer which carries received bytes from APP_isrUart to
+ * APP_SerialTask, in number of bytes. This must be a power of two. On the
+ * Standard variant it holds a whole binary frame, which takes 1.6ms at
+ * 1Mbaud. */
+#ifdef VARIANT_MINI
+#define RX_RING_SIZE			128
+#else
+#define RX_RING_SIZE			256
+#endif
+/* RX FIFO level which raises an interrupt. Fewer bytes than this still
+ * raise a timeout interrupt once the line goes quiet, so this only saves
+ * interrupts at high baud rates. */
+#define RX_FIFO_LEVEL			E_AHI_UART_FIFO_LEVEL_8
+/* Size of the ring buffer which holds responses until APP_isrUart moves them
+ * to the UART, in number of bytes. This must be a power of two, and large
+ * enough for the response to the 'i' command. */
+#ifdef VARIANT_MINI
+#define TX_RING_SIZE			512
+#else
+#define TX_RING_SIZE			1024
+#endif
 
 /* Maximum size of configuration line, in number of characters */
 #define MAX_LINE_SIZE			40
+/* Maximum size of a COBS encoded binary frame, not counting the 0
+ * delimiter, in number of bytes. This is enough for a BIN_CMD_SET_CHANNEL
+ * frame which sets every setting of every channel. */
+#define BIN_FRAME_SIZE			160
+
+/* Binary mode command IDs. Responses use the command ID with bit 7 set. */
+#define BIN_CMD_PING			0x01
+#define BIN_CMD_EXIT			0x02
+#define BIN_CMD_SAVE			0x03
+#define BIN_CMD_SET_CHANNEL		0x10
+#define BIN_CMD_GET_CHANNELS	0x11
+#define BIN_CMD_SET_CURVE		0x12
+#define BIN_CMD_SET_MATRIX		0x13
+#define BIN_CMD_STREAM_START	0x20
+#define BIN_CMD_STREAM_FRAME	0x21
+#define BIN_CMD_STREAM_STOP		0x22
+#define BIN_CMD_SUBSCRIBE		0x30
+#define BIN_CMD_TELEMETRY		0x31
+#define BIN_RESPONSE			0x80
+
+/* Binary mode response status codes */
+#define BIN_STATUS_OK			0
+#define BIN_STATUS_UNKNOWN		1
+#define BIN_STATUS_BAD_LENGTH	2
+#define BIN_STATUS_BAD_VALUE	3
+
+/* Settings in BIN_CMD_SET_CHANNEL entries */
+#define BIN_SETTING_GAMMA		0
+#define BIN_SETTING_BRIGHTNESS	1
+#define BIN_SETTING_CURRENT		2
+/* Channel current is only kept by the Standard variant */
+#ifdef VARIANT_MINI
+#define BIN_SETTING_LAST		BIN_SETTING_BRIGHTNESS
+#else
+#define BIN_SETTING_LAST		BIN_SETTING_CURRENT
+#endif
+
+/* Size of one entry of a BIN_CMD_SET_CHANNEL frame: channel, setting and
+ * 16 bit value */
+#define BIN_CHANNEL_ENTRY_SIZE	4
+/* Size of one entry of a BIN_CMD_SET_MATRIX frame: bulb and 9 16 bit
+ * entries */
+#define BIN_MATRIX_ENTRY_SIZE	19
+
+/* Stream values are 12 bit, 0 = off and STREAM_VALUE_MAX = full on */
+#define STREAM_VALUE_MAX		4095
+
+/* vLC_TelemetryTick is called this often, in ms, so telemetry periods are
+ * multiples of this. The longest period is TELEMETRY_PERIOD_MAX ms. */
+#define TELEMETRY_TICK_MS		100
+#define TELEMETRY_PERIOD_MAX	60000
 
 /* Convert preprocessor definition x to string literal. Both of these are
  * necessary. */
@@ -86,16 +205,37 @@
 /***        Type Definitions                                              ***/
 /****************************************************************************/
 
+/* UART clock settings for a baud rate. The baud rate is 16MHz divided by
+ * (u8ClocksPerBit + 1) * u16Divisor. */
+typedef struct
+{
+	uint32 u32BaudRate;
+	uint8 u8ClocksPerBit;
+	uint16 u16Divisor;
+} tsLC_BaudRate;
+
 typedef struct
 {
 	uint16 u16Gamma;
 	uint16 u16Brightness;
 } tsLC_ChannelCalibration;
 
+/* Measured calibration curve of a channel. This replaces the gamma curve when
+ * it has at least two knots. Knots are in order of increasing intensity, and
+ * the PWM values (with LC_PWM_FRAC_BITS fractional bits) never decrease. */
+typedef struct
+{
+	uint8 u8NumKnots;
+	uint16 au16Intensity[MAX_CURVE_KNOTS];
+	uint16 au16PWM[MAX_CURVE_KNOTS];
+} tsLC_ChannelCurve;
+
 typedef enum
 {
   CHANNEL_GAMMA,
-  CHANNEL_BRIGHTNESS
+  CHANNEL_BRIGHTNESS,
+  CHANNEL_KNOTS,
+  CHANNEL_CURRENT
 } teChannelSetting;
 
 /****************************************************************************/
@@ -103,27 +243,151 @@ typedef enum
 /****************************************************************************/
 
 PRIVATE uint32 antilog(uint32 y);
+PRIVATE uint32 u32LC_ApplyGamma(uint16 u16Intensity, uint32 u32Gamma);
+PRIVATE uint32 u32LC_EvaluateCurve(const tsLC_ChannelCurve *psCurve, uint16 u16Intensity);
+PRIVATE uint32 u32LC_ApplyCalibration(uint8 u8Channel, uint16 u16Intensity);
+PRIVATE bool_t bLC_StagedCurveValid(uint8 u8NumKnots);
+PRIVATE void vLC_WriteMatrixStatusToUART(uint8 u8Bulb);
+PRIVATE int32 i32LC_StringToSignedInteger(const char *pcString, char **pcEndPtr);
+#ifndef VARIANT_MINI
+PRIVATE void vLC_UpdateIntensityTable(uint8 u8Channel);
+#endif
 PRIVATE void vLC_ProcessCommand(char *pcCommand);
 PRIVATE void vLC_WriteChannelStatusToUART(uint8 u8Channel, teChannelSetting teSetting);
 PRIVATE void vLC_WriteStringToUART(const char *pcStr);
 PRIVATE void vLC_WriteUnsignedIntegerToUART(unsigned int uValue);
+PRIVATE void vLC_StartTransmit(uint16 u16Head);
+PRIVATE void vLC_SetUartInterrupts(bool_t bTransmit);
+PRIVATE const tsLC_BaudRate *psLC_FindBaudRate(uint32 u32BaudRate);
+PRIVATE void vLC_SetBaudRate(const tsLC_BaudRate *psBaudRate);
+PRIVATE void vLC_ProcessFrame(uint8 *pu8Frame, uint16 u16Length);
+PRIVATE uint16 u16LC_DecodeFrame(uint8 *pu8Frame, uint16 u16Length);
+PRIVATE uint16 u16LC_Crc16(uint16 u16Crc, uint8 u8Byte);
+PRIVATE void vLC_BinaryBegin(uint8 u8Command, uint8 u8Status);
+PRIVATE void vLC_BinaryPutByte(uint8 u8Byte);
+PRIVATE void vLC_BinaryPutU16(uint16 u16Value);
+PRIVATE void vLC_BinaryPutU32(uint32 u32Value);
+PRIVATE void vLC_StreamFrame(uint8 *pu8Data);
+PRIVATE void vLC_StopStream(void);
+PRIVATE void vLC_SendTelemetry(void);
+PRIVATE void vLC_BinaryEncodeByte(uint8 u8Byte);
+PRIVATE void vLC_BinaryEnd(void);
 PRIVATE uint32_t u32LC_StringToUnsignedInteger(const char *pcString, char **pcEndPtr);
 
 /****************************************************************************/
 /*          Exported Variables                                              */
 /****************************************************************************/
 
+PUBLIC tsLC_Settings sLC_Settings;
+PUBLIC bool_t bLC_Streaming;
+
 /****************************************************************************/
 /***        Local Variables                                               ***/
 /****************************************************************************/
 
 #include "log_table.h"
 PRIVATE tsLC_ChannelCalibration atsLC_Calibration[NUM_CHANNELS];
+PRIVATE tsLC_ChannelCurve atsLC_Curve[NUM_CHANNELS];
+/* Knots uploaded with the 'k' command, until the 'c' command copies them to
+ * one or more channels */
+PRIVATE tsLC_ChannelCurve sLC_StagedCurve;
+/* Colour correction matrix of each RGB bulb, with MATRIX_FRAC_BITS
+ * fractional bits. Row n gives output red, green or blue as a mix of the
+ * input red, green and blue. */
+PRIVATE int16 ai16LC_ColourMatrix[NUM_RGB_LIGHTS][3][3];
+#ifndef VARIANT_MINI
+/* Calibration curve of each channel, as returned by u32LC_ApplyCalibration.
+ * This must be rebuilt with vLC_UpdateIntensityTable whenever the gamma or
+ * the measured curve of a channel changes. */
+PRIVATE uint16 au16IntensityTable[NUM_CHANNELS][INTENSITY_TABLE_SIZE];
+/* Intensities below this are calculated directly instead of from the table */
+PRIVATE uint16 au16IntensityDirect[NUM_CHANNELS];
+/* Current drawn by each channel at full duty, in mA */
+PRIVATE uint16 au16LC_ChannelCurrent[NUM_CHANNELS];
+/* Total current asked for by the last output update, in mA, before the
+ * power budget was applied, and the number of updates which the power
+ * budget has scaled down */
+PRIVATE uint32 u32LC_PowerTotal;
+PRIVATE uint32 u32LC_PowerClips;
+#endif
 PRIVATE uint8 au8TxBuf[TX_BUF_SIZE];
 PRIVATE uint8 au8RxBuf[RX_BUF_SIZE];
 PRIVATE char acCurrentLine[MAX_LINE_SIZE + 1]; // + 1 for null
 PRIVATE unsigned int uCurrentLineSize;
+/* TRUE after the 'e' command, until BIN_CMD_EXIT. In binary mode
+ * APP_SerialTask collects 0 delimited frames into au8BinFrame instead of
+ * lines. */
+PRIVATE bool_t bLC_BinaryMode;
+PRIVATE uint8 au8BinFrame[BIN_FRAME_SIZE];
+PRIVATE uint16 u16BinFrameSize;
+PRIVATE bool_t bBinFrameOverflow;
+/* TRUE if the 'e' line ended with CR, so that the LF after it is not taken
+ * as the start of a frame */
+PRIVATE bool_t bBinSkipLF;
+/* Frames which were dropped because they were too long, or failed COBS
+ * decoding or the CRC check */
+PRIVATE uint32 u32LC_FrameErrors;
+/* State of the binary response which is being encoded into au8TxRing. The
+ * frame is only made visible to APP_isrUart by vLC_BinaryEnd. */
+PRIVATE uint16 u16BinTxPos;
+PRIVATE uint16 u16BinTxCodePos;
+PRIVATE uint8 u8BinTxCode;
+PRIVATE uint16 u16BinTxCrc;
+PRIVATE bool_t bBinTxOverflow;
+/* Stream frames are double buffered. Frames are unpacked into the back
+ * buffer, and then become the front buffer, which is what the bulb drivers
+ * read through u32LC_GetStreamPWM, so they never see part of a frame. */
+PRIVATE uint16 au16StreamValue[2][NUM_CHANNELS];
+PRIVATE uint8 u8StreamFront;
+PRIVATE bool_t bStreamCalibrated;
+PRIVATE bool_t bStreamSynced;
+PRIVATE uint8 u8StreamSequence;
+/* Stream frames shown, frames missing from the sequence, and frames which
+ * arrived after a newer frame, since the last BIN_CMD_STREAM_START */
+PRIVATE uint32 u32LC_StreamShown;
+PRIVATE uint32 u32LC_StreamDropped;
+PRIVATE uint32 u32LC_StreamLate;
+/* A telemetry record is due every u16TelemetryPeriod calls of
+ * vLC_TelemetryTick, or never if it is 0. vLC_TelemetryTick only sets
+ * bTelemetryDue; APP_SerialTask sends the record, so that it is the only
+ * writer of au8TxRing. */
+PRIVATE uint16 u16TelemetryPeriod;
+PRIVATE uint16 u16TelemetryCount;
+PRIVATE volatile bool_t bTelemetryDue;
+PRIVATE uint16 u16TelemetrySequence;
+/* Most bytes ever waiting in au8RxRing and au8TxRing */
+PRIVATE volatile uint16 u16RxHighWater;
+PRIVATE uint16 u16TxHighWater;
+/* Received bytes. Only APP_isrUart writes au8RxRing and u16RxHead, and only
+ * APP_SerialTask writes u16RxTail, so no locking is needed. The ring is
+ * empty when both are equal. */
+PRIVATE volatile uint8 au8RxRing[RX_RING_SIZE];
+PRIVATE volatile uint16 u16RxHead;
+PRIVATE volatile uint16 u16RxTail;
+/* Bytes waiting to be sent. Only APP_SerialTask writes au8TxRing and
+ * u16TxHead, and only APP_isrUart writes u16TxTail. */
+PRIVATE volatile uint8 au8TxRing[TX_RING_SIZE];
+PRIVATE volatile uint16 u16TxHead;
+PRIVATE volatile uint16 u16TxTail;
+#ifdef DEBUG_SERIAL_TIMING
+/* Longest time spent in APP_isrUart, in tick timer (16 MHz) counts */
+PRIVATE volatile uint32 u32IsrMaxTicks;
+#endif
 PRIVATE uint32 u32NewComputedWhiteMode;
+/* Baud rate the UART is running at, and the rate to change to once
+ * everything queued has been sent (NULL if none) */
+PRIVATE const tsLC_BaudRate * volatile psLC_BaudRate;
+PRIVATE const tsLC_BaudRate * volatile psLC_PendingBaudRate;
+
+/* Supported baud rates. Rates which 16MHz doesn't divide into exactly are
+ * within 1%. */
+PRIVATE const tsLC_BaudRate asLC_BaudRates[] = {
+	{38400,		15,	26},	/* +0.16% */
+	{115200,	13,	10},	/* -0.79% */
+	{230400,	13,	5},		/* -0.79% */
+	{500000,	15,	2},
+	{1000000,	15,	1}
+};
 
 #ifdef VARIANT_MINI
 /* Map of bulbs to JN5168 Timer channels. */
@@ -161,8 +425,9 @@ PUBLIC void vLC_InitSerialInterface(void)
 	/* Enable UART */
 	bAHI_UartEnable(E_AHI_UART_0, au8TxBuf, sizeof(au8TxBuf), au8RxBuf, sizeof(au8RxBuf));
 
-	/* 38400 baud, 8N1 */
-	vAHI_UartSetBaudRate(E_AHI_UART_0, E_AHI_UART_RATE_38400);
+	/* 38400 baud, 8N1. vLC_LoadCalibrationFromNVM changes to the saved baud
+	 * rate. */
+	vLC_SetBaudRate(psLC_FindBaudRate(DEFAULT_BAUD_RATE));
 	vAHI_UartSetControl(E_AHI_UART_0,
 			E_AHI_UART_EVEN_PARITY,
 			E_AHI_UART_PARITY_DISABLE,
@@ -172,8 +437,9 @@ PUBLIC void vLC_InitSerialInterface(void)
 	/* Don't use RTS/CTS */
 	vAHI_UartSetRTSCTS(E_AHI_UART_0, FALSE);
 	vAHI_UartSetAutoFlowCtrl(E_AHI_UART_0, E_AHI_UART_FIFO_ARTS_LEVEL_8, FALSE, FALSE, FALSE);
-	/* Interrupt on RX */
-	vAHI_UartSetInterrupt(E_AHI_UART_0, FALSE, FALSE, FALSE, TRUE, E_AHI_UART_FIFO_LEVEL_1);
+	/* Interrupt on RX and on breaks. The TX FIFO empty interrupt is only
+	 * enabled while au8TxRing has bytes to send. */
+	vLC_SetUartInterrupts(FALSE);
 
 	/* Set new computed white mode to existing computed white mode, so that
 	 * the "i" command returns the correct mode. */
@@ -184,13 +450,175 @@ PUBLIC void vLC_InitSerialInterface(void)
  * NAME: APP_isrUart
  *
  * DESCRIPTION:
- * ISR for UART0
+ * ISR for UART0. This only moves received bytes into au8RxRing, and
+ * activates APP_SerialTask once a line or binary frame is complete, or the
+ * ring is half full; commands can take milliseconds, so they are processed
+ * by the task. Bytes which arrive while the ring is full are dropped. It
+ * also refills the TX FIFO from au8TxRing, and turns the TX FIFO empty
+ * interrupt off once there is nothing left to send.
+ * A baud rate change from the 'u' command is made here once the response
+ * has been sent, including its last character, so that it is never garbled.
+ * A break on the RX line goes back to DEFAULT_BAUD_RATE, so that a host
+ * which doesn't know the saved baud rate can always get through.
  ****************************************************************************/
 OS_ISR(APP_isrUart)
 {
+	uint8 nextByte;
+	uint16 u16Head;
+	uint16 u16Tail;
+	uint16 u16Space;
+	bool_t bLineEnd = FALSE;
+#ifdef DEBUG_SERIAL_TIMING
+	uint32 u32Start = u32AHI_TickTimerRead();
+	uint32 u32Ticks;
+#endif
+
+	if (u8AHI_UartReadLineStatus(E_AHI_UART_0) & E_AHI_UART_LS_BI)
+	{
+		/* A change the 'u' command asked for is dropped too */
+		psLC_PendingBaudRate = NULL;
+		if (psLC_BaudRate->u32BaudRate != DEFAULT_BAUD_RATE)
+		{
+			vLC_SetBaudRate(psLC_FindBaudRate(DEFAULT_BAUD_RATE));
+		}
+	}
+
+	u16Head = u16RxHead;
 	while (u16AHI_UartReadRxFifoLevel(E_AHI_UART_0) > 0)
 	{
-		uint8 nextByte = u8AHI_UartReadData(E_AHI_UART_0);
+		nextByte = u8AHI_UartReadData(E_AHI_UART_0);
+		if ((uint16)(u16Head - u16RxTail) < RX_RING_SIZE)
+		{
+			au8RxRing[u16Head & (RX_RING_SIZE - 1)] = nextByte;
+			u16Head++;
+		}
+		/* Binary frames end with 0, which never appears in a line */
+		if ((nextByte == '\n') || (nextByte == '\r') || (nextByte == 0))
+		{
+			bLineEnd = TRUE;
+		}
+	}
+	/* Publish the new bytes only after they have been written */
+	u16RxHead = u16Head;
+	if ((uint16)(u16Head - u16RxTail) > u16RxHighWater)
+	{
+		u16RxHighWater = (uint16)(u16Head - u16RxTail);
+	}
+	if (bLineEnd || ((uint16)(u16Head - u16RxTail) >= (RX_RING_SIZE / 2)))
+	{
+		OS_eActivateTask(APP_SerialTask);
+	}
+
+	/* Reading the interrupt status also acknowledges TX FIFO empty */
+	(void)u8AHI_UartReadInterruptStatus(E_AHI_UART_0);
+	u16Tail = u16TxTail;
+	u16Space = TX_BUF_SIZE - u16AHI_UartReadTxFifoLevel(E_AHI_UART_0);
+	while ((u16Tail != u16TxHead) && (u16Space > 0))
+	{
+		vAHI_UartWriteData(E_AHI_UART_0, au8TxRing[u16Tail & (TX_RING_SIZE - 1)]);
+		u16Tail++;
+		u16Space--;
+	}
+	u16TxTail = u16Tail;
+	if (u16Tail == u16TxHead)
+	{
+		if (psLC_PendingBaudRate == NULL)
+		{
+			vLC_SetUartInterrupts(FALSE);
+		}
+		else if (u16AHI_UartReadTxFifoLevel(E_AHI_UART_0) == 0)
+		{
+			if (u8AHI_UartReadLineStatus(E_AHI_UART_0) & E_AHI_UART_LS_TEMT)
+			{
+				vLC_SetBaudRate(psLC_PendingBaudRate);
+				psLC_PendingBaudRate = NULL;
+			}
+			else
+			{
+				/* The last character is still being shifted out, and
+				 * there is no interrupt for when it has gone. Rather
+				 * than wait here, APP_SerialTask turns the TX FIFO empty
+				 * interrupt back on, which runs this again. */
+				OS_eActivateTask(APP_SerialTask);
+			}
+			vLC_SetUartInterrupts(FALSE);
+		}
+		/* Otherwise the TX FIFO empty interrupt comes back once the
+		 * response to 'u' has left the FIFO */
+	}
+#ifdef DEBUG_SERIAL_TIMING
+	u32Ticks = u32AHI_TickTimerRead() - u32Start;
+	if (u32Ticks > u32IsrMaxTicks)
+	{
+		u32IsrMaxTicks = u32Ticks;
+	}
+#endif
+}
+
+/****************************************************************************
+ * NAME: APP_SerialTask
+ *
+ * DESCRIPTION:
+ * Assembles the bytes received by APP_isrUart into lines, and processes
+ * each complete line as a command. Running commands from a task rather than
+ * from the ISR keeps the tick and the stack from being held up by them, and
+ * means they can't interrupt other tasks half way through a light update.
+ * In binary mode, bytes are assembled into frames instead, and each frame
+ * which passes the CRC check is processed by vLC_ProcessFrame.
+ ****************************************************************************/
+OS_TASK(APP_SerialTask)
+{
+	uint8 nextByte;
+	uint16 u16Length;
+
+	while (u16RxTail != u16RxHead)
+	{
+		nextByte = au8RxRing[u16RxTail & (RX_RING_SIZE - 1)];
+		u16RxTail++;
+		if (bLC_BinaryMode)
+		{
+			if (bBinSkipLF)
+			{
+				bBinSkipLF = FALSE;
+				if (nextByte == '\n')
+				{
+					continue;
+				}
+			}
+			if (nextByte != 0)
+			{
+				if (u16BinFrameSize < BIN_FRAME_SIZE)
+				{
+					au8BinFrame[u16BinFrameSize++] = nextByte;
+				}
+				else
+				{
+					bBinFrameOverflow = TRUE;
+				}
+				continue;
+			}
+			/* End of frame. Empty frames are allowed, so that a host can
+			 * send a 0 to resynchronise. */
+			if (bBinFrameOverflow)
+			{
+				u32LC_FrameErrors++;
+			}
+			else if (u16BinFrameSize > 0)
+			{
+				u16Length = u16LC_DecodeFrame(au8BinFrame, u16BinFrameSize);
+				if (u16Length == 0)
+				{
+					u32LC_FrameErrors++;
+				}
+				else
+				{
+					vLC_ProcessFrame(au8BinFrame, u16Length);
+				}
+			}
+			u16BinFrameSize = 0;
+			bBinFrameOverflow = FALSE;
+			continue;
+		}
 		/* Accept both carriage return or newline characters as command end.
 		 * If both are sent, that will be interpreted as a blank line and
 		 * ignored. */
@@ -201,6 +629,7 @@ OS_ISR(APP_isrUart)
 			if (uCurrentLineSize > 0)
 			{
 				vLC_ProcessCommand(acCurrentLine);
+				bBinSkipLF = bLC_BinaryMode && (nextByte == '\r');
 			}
 			/* Begin next line */
 			uCurrentLineSize = 0;
@@ -211,6 +640,23 @@ OS_ISR(APP_isrUart)
 			acCurrentLine[uCurrentLineSize++] = (char)nextByte;
 		}
 	}
+
+	if (bTelemetryDue)
+	{
+		bTelemetryDue = FALSE;
+		if (u16TelemetryPeriod != 0)
+		{
+			vLC_SendTelemetry();
+		}
+	}
+
+	/* A baud rate change is waiting for the last character to be sent.
+	 * Turning the TX FIFO empty interrupt on while the FIFO is empty runs
+	 * APP_isrUart straight away, to check again. */
+	if (psLC_PendingBaudRate != NULL)
+	{
+		vLC_SetUartInterrupts(TRUE);
+	}
 }
 
 /****************************************************************************
@@ -235,6 +681,7 @@ PUBLIC void vLC_LoadCalibrationFromNVM(void)
 {
 	PDM_teStatus eStatus;
 	uint16 u16ByteRead;
+	uint8 i;
 
 	eStatus = PDM_eReadDataFromRecord(PDM_ID_APP_LIGHT_CALIB,
 				&atsLC_Calibration,
@@ -243,13 +690,81 @@ PUBLIC void vLC_LoadCalibrationFromNVM(void)
 	if ((eStatus != PDM_E_STATUS_OK) || (u16ByteRead != sizeof(atsLC_Calibration)))
 	{
 		/* Failed to load calibration data from PDM; load defaults. */
-		unsigned int i;
 		for (i = 0; i < NUM_CHANNELS; i++)
 		{
 			atsLC_Calibration[i].u16Gamma = DEFAULT_GAMMA;
 			atsLC_Calibration[i].u16Brightness = DEFAULT_BRIGHTNESS;
 		}
 	}
+
+	eStatus = PDM_eReadDataFromRecord(PDM_ID_APP_LIGHT_CURVES,
+				&atsLC_Curve,
+	            sizeof(atsLC_Curve), &u16ByteRead);
+
+	if ((eStatus != PDM_E_STATUS_OK) || (u16ByteRead != sizeof(atsLC_Curve)))
+	{
+		/* Failed to load curves from PDM; use gamma on all channels. */
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			atsLC_Curve[i].u8NumKnots = 0;
+		}
+	}
+
+	eStatus = PDM_eReadDataFromRecord(PDM_ID_APP_COLOUR_MATRIX,
+				&ai16LC_ColourMatrix,
+	            sizeof(ai16LC_ColourMatrix), &u16ByteRead);
+
+	if ((eStatus != PDM_E_STATUS_OK) || (u16ByteRead != sizeof(ai16LC_ColourMatrix)))
+	{
+		/* Failed to load colour matrices from PDM; use identity. */
+		memset(ai16LC_ColourMatrix, 0, sizeof(ai16LC_ColourMatrix));
+		for (i = 0; i < NUM_RGB_LIGHTS; i++)
+		{
+			ai16LC_ColourMatrix[i][0][0] = MATRIX_ONE;
+			ai16LC_ColourMatrix[i][1][1] = MATRIX_ONE;
+			ai16LC_ColourMatrix[i][2][2] = MATRIX_ONE;
+		}
+	}
+#ifndef VARIANT_MINI
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		vLC_UpdateIntensityTable(i);
+	}
+
+	eStatus = PDM_eReadDataFromRecord(PDM_ID_APP_CHANNEL_CURRENT,
+				&au16LC_ChannelCurrent,
+	            sizeof(au16LC_ChannelCurrent), &u16ByteRead);
+
+	if ((eStatus != PDM_E_STATUS_OK) || (u16ByteRead != sizeof(au16LC_ChannelCurrent)))
+	{
+		/* Failed to load channel currents from PDM; load defaults. */
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			au16LC_ChannelCurrent[i] = DEFAULT_CHANNEL_CURRENT;
+		}
+	}
+#endif
+
+	eStatus = PDM_eReadDataFromRecord(PDM_ID_APP_LIGHT_SETTINGS,
+				&sLC_Settings,
+	            sizeof(sLC_Settings), &u16ByteRead);
+
+	if ((eStatus != PDM_E_STATUS_OK) || (u16ByteRead != sizeof(sLC_Settings)))
+	{
+		/* Failed to load settings from PDM; load defaults. */
+		sLC_Settings.bDither = DEFAULT_DITHER;
+		sLC_Settings.u32LogFadeMask = DEFAULT_LOG_FADE_MASK;
+		sLC_Settings.u32XYFadeMask = DEFAULT_XY_FADE_MASK;
+#ifndef VARIANT_MINI
+		sLC_Settings.u32PowerBudget = DEFAULT_POWER_BUDGET;
+#endif
+		sLC_Settings.u32BaudRate = DEFAULT_BAUD_RATE;
+	}
+	if (psLC_FindBaudRate(sLC_Settings.u32BaudRate) == NULL)
+	{
+		sLC_Settings.u32BaudRate = DEFAULT_BAUD_RATE;
+	}
+	vLC_SetBaudRate(psLC_FindBaudRate(sLC_Settings.u32BaudRate));
 }
 
 /****************************************************************************
@@ -261,144 +776,606 @@ PUBLIC void vLC_LoadCalibrationFromNVM(void)
 PUBLIC void vLC_SaveCalibrationToNVM(void)
 {
 	PDM_eSaveRecordData(PDM_ID_APP_LIGHT_CALIB, &atsLC_Calibration, sizeof(atsLC_Calibration));
+	PDM_eSaveRecordData(PDM_ID_APP_LIGHT_CURVES, &atsLC_Curve, sizeof(atsLC_Curve));
+	PDM_eSaveRecordData(PDM_ID_APP_COLOUR_MATRIX, &ai16LC_ColourMatrix, sizeof(ai16LC_ColourMatrix));
+#ifndef VARIANT_MINI
+	PDM_eSaveRecordData(PDM_ID_APP_CHANNEL_CURRENT, &au16LC_ChannelCurrent, sizeof(au16LC_ChannelCurrent));
+#endif
 	PDM_eSaveRecordData(PDM_ID_APP_COMPUTE_WHITE, &u32NewComputedWhiteMode, sizeof(u32NewComputedWhiteMode));
+	PDM_eSaveRecordData(PDM_ID_APP_LIGHT_SETTINGS, &sLC_Settings, sizeof(sLC_Settings));
 }
 
 /****************************************************************************
  * NAME: u32LC_AdjustIntensity
  *
  * DESCRIPTION:
- * Adjusts intensity based on current calibration values. u8Intensity is
- * expected to be between 1 and 255 (inclusive). This will return a value
- * between 1 and 4095 (inclusive).
+ * Adjusts intensity based on current calibration values. u16Intensity is
+ * expected to be between 1 and 65535 (inclusive). This will return a PWM
+ * value with LC_PWM_FRAC_BITS fractional bits, between 1.0 and 4095.0
+ * (inclusive). The fraction is used by the drivers for dithering.
+ * This is called for every channel write, so on the Standard variant the
+ * gamma or measured curve comes from the channel's intensity table, and the
+ * cost doesn't depend on the number of knots. Only the lowest intensities
+ * are calculated directly, see INTENSITY_DIRECT_LIMIT.
  ****************************************************************************/
-PUBLIC uint32 u32LC_AdjustIntensity(uint8 u8Intensity, uint8 u8ChannelNum)
+PUBLIC uint32 u32LC_AdjustIntensity(uint16 u16Intensity, uint8 u8ChannelNum)
 {
 	uint32 x;
-	uint32 y;
-	uint32 u32Gamma = atsLC_Calibration[u8ChannelNum].u16Gamma;
+#ifndef VARIANT_MINI
+	uint32 i;
+	uint32 u32Frac;
+	const uint16 *pu16Table = au16IntensityTable[u8ChannelNum];
+#endif
 	uint32 u32Brightness = atsLC_Calibration[u8ChannelNum].u16Brightness;
 
-	if (u8Intensity == 0)
+	if (u16Intensity == 0)
 		return 0;
-	if (u8Intensity > 254)
-		u8Intensity = 254;
-	y = log_table_short[u8Intensity];
-	y = y * u32Gamma;
-	y = (y >> 10) + ((y & 512) >> 9); /* round */
-	x = antilog(y);
+#ifdef VARIANT_MINI
+	x = u32LC_ApplyCalibration(u8ChannelNum, u16Intensity);
+#else
+	if (u16Intensity == 0xffff)
+	{
+		/* The last entry is sampled at 65535, so full scale is exact */
+		x = pu16Table[INTENSITY_TABLE_SIZE - 1];
+	}
+	else if (u16Intensity < au16IntensityDirect[u8ChannelNum])
+	{
+		x = u32LC_ApplyCalibration(u8ChannelNum, u16Intensity);
+	}
+	else
+	{
+		/* The curve never decreases, so the difference is never negative */
+		i = u16Intensity >> INTENSITY_TABLE_SHIFT;
+		u32Frac = u16Intensity & ((1 << INTENSITY_TABLE_SHIFT) - 1);
+		x = pu16Table[i] + (((pu16Table[i + 1] - pu16Table[i]) * u32Frac) >> INTENSITY_TABLE_SHIFT);
+	}
+#endif
 	x = x * u32Brightness;
 	x = (x >> 10) + ((x & 512) >> 9); /* round */
-	if (x < 1) x = 1;
-	if (x > 4095) x = 4095;
+	if (x < (1 << LC_PWM_FRAC_BITS)) x = (1 << LC_PWM_FRAC_BITS);
+	if (x > LC_PWM_MAX) x = LC_PWM_MAX;
 	return x;
 }
 
-/****************************************************************************/
-/***        Local    Functions                                            ***/
-/****************************************************************************/
+/****************************************************************************
+ * NAME: vLC_CorrectColour
+ *
+ * DESCRIPTION:
+ * Multiplies the 16 bit red, green and blue values of an RGB bulb by the
+ * bulb's colour correction matrix, to make up for LEDs whose primaries
+ * differ from the ones the colour cluster assumes. Results are rounded and
+ * clamped to 0 to 65535. The identity matrix leaves every value unchanged.
+ * Mono bulbs are left alone.
+ ****************************************************************************/
+PUBLIC void vLC_CorrectColour(uint8 u8Bulb, uint32 *pu32Red, uint32 *pu32Green, uint32 *pu32Blue)
+{
+	int16 (*pai16Matrix)[3];
+	int32 i32Red, i32Green, i32Blue;
+	int32 ai32Out[3];
+	uint8 i;
+
+	if (u8Bulb < NUM_MONO_LIGHTS)
+		return;
+	pai16Matrix = ai16LC_ColourMatrix[u8Bulb - NUM_MONO_LIGHTS];
+	i32Red   = (int32)MIN(*pu32Red, 0xffff);
+	i32Green = (int32)MIN(*pu32Green, 0xffff);
+	i32Blue  = (int32)MIN(*pu32Blue, 0xffff);
+	for (i = 0; i < 3; i++)
+	{
+		ai32Out[i] = pai16Matrix[i][0] * i32Red
+				+ pai16Matrix[i][1] * i32Green
+				+ pai16Matrix[i][2] * i32Blue
+				+ (MATRIX_ONE >> 1);
+		if (ai32Out[i] < 0)
+		{
+			ai32Out[i] = 0;
+		}
+		ai32Out[i] >>= MATRIX_FRAC_BITS;
+		if (ai32Out[i] > 0xffff)
+		{
+			ai32Out[i] = 0xffff;
+		}
+	}
+	*pu32Red   = (uint32)ai32Out[0];
+	*pu32Green = (uint32)ai32Out[1];
+	*pu32Blue  = (uint32)ai32Out[2];
+}
 
+#ifndef VARIANT_MINI
 /****************************************************************************
- * NAME:	antilog
+ * NAME: u16LC_GetChannelCurrent
  *
  * DESCRIPTION:
- *			Inverse log i.e. exponentiate. This will return the index i such
- *			that log_table_long(i) is close to y.
- *			Output values will be in the range 0 to 4095, where 0 represents
- *			0 intensity and 4095 represents maximum intensity.
+ * Get the current drawn by a channel at full duty, in mA
  ****************************************************************************/
-PRIVATE uint32 antilog(uint32 y)
+PUBLIC uint16 u16LC_GetChannelCurrent(uint8 u8Channel)
 {
-	uint32 left_index;
-	uint32 right_index;
-	uint32 diff_left;
-	uint32 diff_right;
-
-    if (y > log_table_long[1])
-        return 0;
-    /* Binary search through log_table_long */
-    left_index = 1;
-    right_index = 4095;
-    while ((left_index + 1) != right_index)
-    {
-    	uint32 i = (right_index + left_index) >> 1;
-        if (log_table_long[i] < y)
-            right_index = i;
-        else
-            left_index = i;
-    }
-    diff_left = log_table_long[left_index] - y;
-    diff_right = y - log_table_long[right_index];
-    if (diff_left < diff_right)
-        return left_index;
-    else
-        return right_index;
+	return au16LC_ChannelCurrent[u8Channel];
 }
 
 /****************************************************************************
- * NAME:	vLC_ProcessCommand
+ * NAME: u32LC_PowerBudgetScale
  *
  * DESCRIPTION:
- *			Process and execute calibration/configuration command
+ * Works out how far all channels have to be scaled down to keep their total
+ * current within the power budget. u32Load is the sum over all channels of
+ * their PWM value, rounded up to whole steps, times
+ * u16LC_GetChannelCurrent(channel). This should be called once for every
+ * output update.
+ *
+ * RETURNS:
+ * Multiplier for the PWM values, with LC_POWER_SCALE_FRAC_BITS fractional
+ * bits. LC_POWER_SCALE_ONE means the channels are within the budget.
  ****************************************************************************/
-PRIVATE void vLC_ProcessCommand(char *pcCommand)
+PUBLIC uint32 u32LC_PowerBudgetScale(uint32 u32Load)
 {
-	uint32 u32ChannelMask = 0; /* bit n set means that channel is selected */
-	uint32 u32Parameter = 0;
-	char *pcCommandNext = pcCommand; /* pointer to start of command */
-	bool bFirst;
-	unsigned int i;
-	int16 i16Temperature;
+	const uint32 u32FullDuty = LC_PWM_MAX >> LC_PWM_FRAC_BITS;
 
-	if (strlen(pcCommand) < 1)
+	/* Round up, so that the scaled total never exceeds the budget */
+	u32LC_PowerTotal = u32Load / u32FullDuty + ((u32Load % u32FullDuty) ? 1 : 0);
+	if ((sLC_Settings.u32PowerBudget == 0) || (u32LC_PowerTotal <= sLC_Settings.u32PowerBudget))
+	{
+		return LC_POWER_SCALE_ONE;
+	}
+	u32LC_PowerClips++;
+	return (sLC_Settings.u32PowerBudget << LC_POWER_SCALE_FRAC_BITS) / u32LC_PowerTotal;
+}
+#endif
+
+/****************************************************************************
+ * NAME: u32LC_GetStreamPWM
+ *
+ * DESCRIPTION:
+ * Gets the PWM value of a channel from the current stream frame, for the
+ * bulb drivers to use while bLC_Streaming is set. Stream values are either
+ * PWM values, or intensities which go through u32LC_AdjustIntensity like
+ * bulb levels, depending on the mode the stream was started with.
+ *
+ * RETURNS:
+ * PWM value with LC_PWM_FRAC_BITS fractional bits, 0 for off, or
+ * LC_PWM_MAX for fully on
+ ****************************************************************************/
+PUBLIC uint32 u32LC_GetStreamPWM(uint8 u8Channel)
+{
+	uint32 u32Value = au16StreamValue[u8StreamFront][u8Channel];
+
+	if (u32Value == 0)
+	{
+		return 0;
+	}
+	if (bStreamCalibrated)
+	{
+		/* Scale 4095 up to 65535 */
+		return u32LC_AdjustIntensity((uint16)((u32Value << 4) | (u32Value >> 8)), u8Channel);
+	}
+	return u32Value << LC_PWM_FRAC_BITS;
+}
+
+/****************************************************************************
+ * NAME: vLC_TelemetryTick
+ *
+ * DESCRIPTION:
+ * Times the telemetry records which a host has subscribed to with
+ * BIN_CMD_SUBSCRIBE. This must be called every TELEMETRY_TICK_MS. When a
+ * record is due, APP_SerialTask is activated to send it.
+ ****************************************************************************/
+PUBLIC void vLC_TelemetryTick(void)
+{
+	if (u16TelemetryPeriod == 0)
 	{
-		vLC_WriteStringToUART("Command too short\r\n");
 		return;
 	}
+	u16TelemetryCount++;
+	if (u16TelemetryCount >= u16TelemetryPeriod)
+	{
+		u16TelemetryCount = 0;
+		bTelemetryDue = TRUE;
+		OS_eActivateTask(APP_SerialTask);
+	}
+}
 
-	switch(pcCommand[0])
+/****************************************************************************
+ * NAME: u32LC_IntensityToLog
+ *
+ * DESCRIPTION:
+ * Converts a 16 bit intensity into the log domain, in the units of
+ * log_table_long. The position of the intensity in log_table_long is found
+ * as an index plus a 16 bit fraction, then the two neighbouring entries are
+ * interpolated. Entry 0 is -infinity, so the lowest intensities use entry 1.
+ * An intensity of 0 gives LOG_ZERO.
+ ****************************************************************************/
+PUBLIC uint32 u32LC_IntensityToLog(uint16 u16Intensity)
+{
+	uint32 x;
+	uint32 i;
+	uint32 u32Frac;
+
+	if (u16Intensity == 0)
+		return LOG_ZERO;
+	x = (uint32)u16Intensity * 4095;
+	i = x >> 16;
+	u32Frac = x & 0xffff;
+	if (i == 0)
 	{
-	case 'g':
-	case 'b':
-		/* Set gamma or brightness */
-		/* Format of command is [g or b] <channel mask> <value> */
-		u32ChannelMask = u32LC_StringToUnsignedInteger(&(pcCommand[1]), &pcCommandNext);
-		u32Parameter = u32LC_StringToUnsignedInteger(pcCommandNext, NULL);
-		bFirst = true;
-		for (i = 0; i < NUM_CHANNELS; i++)
-		{
-			if ((u32ChannelMask >> i) & 1)
-			{
-				if (bFirst)
-				{
-					bFirst = false;
-				}
-				else
-				{
-					vLC_WriteStringToUART(",");
-				}
-				if (pcCommand[0] == 'g')
-				{
-					atsLC_Calibration[i].u16Gamma = u32Parameter;
-					vLC_WriteChannelStatusToUART(i, CHANNEL_GAMMA);
-				}
-				else if (pcCommand[0] == 'b')
-				{
-					atsLC_Calibration[i].u16Brightness = u32Parameter;
-					vLC_WriteChannelStatusToUART(i, CHANNEL_BRIGHTNESS);
-				}
-			}
-		}
-		vLC_WriteStringToUART("\r\n");
-		/* Refresh current PWM values, to account for new calibration
-		 * parameters. */
-		for (i = 0; i < NUM_BULBS; i++)
-		{
-			DriverBulb_vOutput((uint8)i);
-		}
-		break;
+		i = 1;
+		u32Frac = 0;
+	}
+	/* Rounded, or full scale would come out one unit below it */
+	return log_table_long[i] - (((log_table_long[i] - log_table_long[i + 1]) * u32Frac + 0x8000) >> 16);
+}
 
-	case 'n':
+/****************************************************************************
+ * NAME: u16LC_LogToIntensity
+ *
+ * DESCRIPTION:
+ * Converts a log value from u32LC_IntensityToLog back into a 16 bit
+ * intensity, by interpolating between two exp_table entries. This is cheap
+ * enough to be done on every interpolation tick.
+ ****************************************************************************/
+PUBLIC uint16 u16LC_LogToIntensity(uint32 u32Log)
+{
+	uint32 i;
+	uint32 u32Frac;
+
+	if (u32Log >= LOG_ZERO)
+		return 0;
+	i = u32Log >> EXP_TABLE_SHIFT;
+	u32Frac = u32Log & ((1 << EXP_TABLE_SHIFT) - 1);
+	return (uint16)(exp_table[i] - (((exp_table[i] - exp_table[i + 1]) * u32Frac) >> EXP_TABLE_SHIFT));
+}
+
+/****************************************************************************/
+/***        Local    Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME:	u32LC_ApplyGamma
+ *
+ * DESCRIPTION:
+ *			Raises a 16 bit intensity to the power of u32Gamma (1024 = 1.0)
+ *			in the log domain. Returns a PWM value with LC_PWM_FRAC_BITS
+ *			fractional bits, between 0 and 4095.0, before brightness is
+ *			applied.
+ ****************************************************************************/
+PRIVATE uint32 u32LC_ApplyGamma(uint16 u16Intensity, uint32 u32Gamma)
+{
+	uint32 y;
+
+	if (u16Intensity == 0)
+		return 0;
+	if (u16Intensity < LOW_INTENSITY_LIMIT)
+	{
+		/* Take the scaling back off in the log domain */
+		y = u32LC_IntensityToLog(u16Intensity << LOW_INTENSITY_SHIFT)
+			+ (log_table_long[1] - log_table_long[1 << LOW_INTENSITY_SHIFT]);
+	}
+	else
+	{
+		y = u32LC_IntensityToLog(u16Intensity);
+	}
+	y = y * u32Gamma;
+	y = (y >> 10) + ((y & 512) >> 9); /* round */
+	return antilog(y);
+}
+
+/****************************************************************************
+ * NAME:	u32LC_EvaluateCurve
+ *
+ * DESCRIPTION:
+ *			Evaluates a measured calibration curve at a 16 bit intensity,
+ *			by interpolating between the two knots on either side.
+ *			Intensities outside the knots take the PWM value of the
+ *			nearest end knot. The curve must have at least two knots.
+ ****************************************************************************/
+PRIVATE uint32 u32LC_EvaluateCurve(const tsLC_ChannelCurve *psCurve, uint16 u16Intensity)
+{
+	uint32 u32Low;
+	uint32 u32High;
+	uint32 u32Mid;
+
+	u32High = psCurve->u8NumKnots - 1;
+	if (u16Intensity <= psCurve->au16Intensity[0])
+		return psCurve->au16PWM[0];
+	if (u16Intensity >= psCurve->au16Intensity[u32High])
+		return psCurve->au16PWM[u32High];
+	/* Binary search for the segment, at most 4 steps for 16 knots */
+	u32Low = 0;
+	while ((u32Low + 1) != u32High)
+	{
+		u32Mid = (u32Low + u32High) >> 1;
+		if (psCurve->au16Intensity[u32Mid] <= u16Intensity)
+			u32Low = u32Mid;
+		else
+			u32High = u32Mid;
+	}
+	/* The product is at most 65520 * 65535, which just fits in 32 bits */
+	return psCurve->au16PWM[u32Low]
+			+ ((uint32)(psCurve->au16PWM[u32High] - psCurve->au16PWM[u32Low])
+				* (uint32)(u16Intensity - psCurve->au16Intensity[u32Low]))
+			/ (uint32)(psCurve->au16Intensity[u32High] - psCurve->au16Intensity[u32Low]);
+}
+
+/****************************************************************************
+ * NAME:	u32LC_ApplyCalibration
+ *
+ * DESCRIPTION:
+ *			Converts a 16 bit intensity into a PWM value with
+ *			LC_PWM_FRAC_BITS fractional bits, before brightness is applied.
+ *			This uses the channel's measured curve if it has one, or its
+ *			gamma otherwise.
+ ****************************************************************************/
+PRIVATE uint32 u32LC_ApplyCalibration(uint8 u8Channel, uint16 u16Intensity)
+{
+	if (atsLC_Curve[u8Channel].u8NumKnots >= 2)
+	{
+		return u32LC_EvaluateCurve(&atsLC_Curve[u8Channel], u16Intensity);
+	}
+	return u32LC_ApplyGamma(u16Intensity, atsLC_Calibration[u8Channel].u16Gamma);
+}
+
+/****************************************************************************
+ * NAME:	bLC_StagedCurveValid
+ *
+ * DESCRIPTION:
+ *			Checks that the first u8NumKnots staged knots make a usable
+ *			curve: no knots (gamma is used), or 2 to MAX_CURVE_KNOTS knots
+ *			with increasing intensities and PWM values which never
+ *			decrease.
+ ****************************************************************************/
+PRIVATE bool_t bLC_StagedCurveValid(uint8 u8NumKnots)
+{
+	uint8 i;
+
+	if (u8NumKnots == 0)
+		return TRUE;
+	if ((u8NumKnots < 2) || (u8NumKnots > MAX_CURVE_KNOTS))
+		return FALSE;
+	for (i = 0; i < u8NumKnots; i++)
+	{
+		if (sLC_StagedCurve.au16PWM[i] > LC_PWM_MAX)
+			return FALSE;
+		if ((i > 0)
+		 && ((sLC_StagedCurve.au16Intensity[i] <= sLC_StagedCurve.au16Intensity[i - 1])
+		  || (sLC_StagedCurve.au16PWM[i] < sLC_StagedCurve.au16PWM[i - 1])))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+#ifndef VARIANT_MINI
+/****************************************************************************
+ * NAME:	vLC_UpdateIntensityTable
+ *
+ * DESCRIPTION:
+ *			Samples the calibration curve of a channel into its intensity
+ *			table, and sets how far up the curve is calculated directly.
+ *			The last entry stands for an intensity of 65536, which is
+ *			sampled at 65535.
+ ****************************************************************************/
+PRIVATE void vLC_UpdateIntensityTable(uint8 u8Channel)
+{
+	uint32 i;
+
+	for (i = 0; i < INTENSITY_TABLE_SIZE; i++)
+	{
+		au16IntensityTable[u8Channel][i] =
+			(uint16)u32LC_ApplyCalibration(u8Channel, (uint16)MIN(i << INTENSITY_TABLE_SHIFT, 0xffff));
+	}
+	if ((atsLC_Curve[u8Channel].u8NumKnots >= 2) || (atsLC_Calibration[u8Channel].u16Gamma < 1024))
+	{
+		au16IntensityDirect[u8Channel] = INTENSITY_DIRECT_LIMIT;
+	}
+	else
+	{
+		au16IntensityDirect[u8Channel] = 1 << INTENSITY_TABLE_SHIFT;
+	}
+}
+#endif
+
+/****************************************************************************
+ * NAME:	antilog
+ *
+ * DESCRIPTION:
+ *			Inverse log i.e. exponentiate. This will return the position i
+ *			between two entries of log_table_long such that log_table_long(i)
+ *			is close to y, with LC_PWM_FRAC_BITS fractional bits.
+ *			Output values will be in the range 0 to 4095.0, where 0 represents
+ *			0 intensity and 4095.0 represents maximum intensity.
+ *			That position is 4095 * exp(-y / 4096), so it is read directly
+ *			from exp_table (which is scaled to 65535) instead of searching
+ *			log_table_long.
+ ****************************************************************************/
+PRIVATE uint32 antilog(uint32 y)
+{
+	uint32 x;
+
+	x = u16LC_LogToIntensity(y);
+	/* Scale 65535 down to 4095 << LC_PWM_FRAC_BITS = 65520 */
+	return x - (x >> 12);
+}
+
+/****************************************************************************
+ * NAME:	vLC_ProcessCommand
+ *
+ * DESCRIPTION:
+ *			Process and execute calibration/configuration command
+ ****************************************************************************/
+PRIVATE void vLC_ProcessCommand(char *pcCommand)
+{
+	uint32 u32ChannelMask = 0; /* bit n set means that channel is selected */
+	uint32 u32Parameter = 0;
+	char *pcCommandNext = pcCommand; /* pointer to start of command */
+	bool bFirst;
+	unsigned int i;
+	int16 i16Temperature;
+	int32 ai32Row[3];
+	const tsLC_BaudRate *psBaudRate;
+
+	if (strlen(pcCommand) < 1)
+	{
+		vLC_WriteStringToUART("Command too short\r\n");
+		return;
+	}
+
+	switch(pcCommand[0])
+	{
+	case 'g':
+	case 'b':
+#ifndef VARIANT_MINI
+	case 'a':
+#endif
+		/* Set gamma, brightness or current */
+		/* Format of command is [g, b or a] <channel mask> <value> */
+		u32ChannelMask = u32LC_StringToUnsignedInteger(&(pcCommand[1]), &pcCommandNext);
+		u32Parameter = u32LC_StringToUnsignedInteger(pcCommandNext, NULL);
+		bFirst = true;
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			if ((u32ChannelMask >> i) & 1)
+			{
+				if (bFirst)
+				{
+					bFirst = false;
+				}
+				else
+				{
+					vLC_WriteStringToUART(",");
+				}
+				if (pcCommand[0] == 'g')
+				{
+					atsLC_Calibration[i].u16Gamma = u32Parameter;
+#ifndef VARIANT_MINI
+					vLC_UpdateIntensityTable(i);
+#endif
+					vLC_WriteChannelStatusToUART(i, CHANNEL_GAMMA);
+				}
+				else if (pcCommand[0] == 'b')
+				{
+					atsLC_Calibration[i].u16Brightness = u32Parameter;
+					vLC_WriteChannelStatusToUART(i, CHANNEL_BRIGHTNESS);
+				}
+#ifndef VARIANT_MINI
+				else if (pcCommand[0] == 'a')
+				{
+					au16LC_ChannelCurrent[i] = (uint16)MIN(u32Parameter, 0xffff);
+					vLC_WriteChannelStatusToUART(i, CHANNEL_CURRENT);
+				}
+#endif
+			}
+		}
+		vLC_WriteStringToUART("\r\n");
+		/* Refresh current PWM values, to account for new calibration
+		 * parameters. */
+		DriverBulb_vBeginFrame();
+		for (i = 0; i < NUM_BULBS; i++)
+		{
+			DriverBulb_vOutput((uint8)i);
+		}
+		DriverBulb_vCommitFrame();
+		break;
+
+	case 'k':
+		/* Stage a knot of a measured calibration curve */
+		/* Format of command is k <knot> <intensity> <PWM value * 16> */
+		u32Parameter = u32LC_StringToUnsignedInteger(&(pcCommand[1]), &pcCommandNext);
+		if (u32Parameter >= MAX_CURVE_KNOTS)
+		{
+			vLC_WriteStringToUART("Invalid knot\r\n");
+			break;
+		}
+		sLC_StagedCurve.au16Intensity[u32Parameter] =
+			(uint16)MIN(u32LC_StringToUnsignedInteger(pcCommandNext, &pcCommandNext), 0xffff);
+		sLC_StagedCurve.au16PWM[u32Parameter] =
+			(uint16)MIN(u32LC_StringToUnsignedInteger(pcCommandNext, NULL), 0xffff);
+		vLC_WriteStringToUART("Knot");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)u32Parameter);
+		vLC_WriteStringToUART("=");
+		vLC_WriteUnsignedIntegerToUART(sLC_StagedCurve.au16Intensity[u32Parameter]);
+		vLC_WriteStringToUART(":");
+		vLC_WriteUnsignedIntegerToUART(sLC_StagedCurve.au16PWM[u32Parameter]);
+		vLC_WriteStringToUART("\r\n");
+		break;
+
+	case 'c':
+		/* Copy staged knots to channels, or go back to gamma */
+		/* Format of command is c <channel mask> <number of knots> */
+		u32ChannelMask = u32LC_StringToUnsignedInteger(&(pcCommand[1]), &pcCommandNext);
+		u32Parameter = u32LC_StringToUnsignedInteger(pcCommandNext, NULL);
+		if ((u32Parameter > MAX_CURVE_KNOTS) || !bLC_StagedCurveValid((uint8)u32Parameter))
+		{
+			vLC_WriteStringToUART("Invalid curve\r\n");
+			break;
+		}
+		sLC_StagedCurve.u8NumKnots = (uint8)u32Parameter;
+		bFirst = true;
+		for (i = 0; i < NUM_CHANNELS; i++)
+		{
+			if ((u32ChannelMask >> i) & 1)
+			{
+				if (bFirst)
+				{
+					bFirst = false;
+				}
+				else
+				{
+					vLC_WriteStringToUART(",");
+				}
+				atsLC_Curve[i] = sLC_StagedCurve;
+#ifndef VARIANT_MINI
+				vLC_UpdateIntensityTable(i);
+#endif
+				vLC_WriteChannelStatusToUART(i, CHANNEL_KNOTS);
+			}
+		}
+		vLC_WriteStringToUART("\r\n");
+		/* Refresh current PWM values, to account for the new curves */
+		for (i = 0; i < NUM_BULBS; i++)
+		{
+			DriverBulb_vOutput((uint8)i);
+		}
+		break;
+
+	case 'm':
+		/* Set one row of the colour correction matrix of RGB bulbs */
+		/* Format of command is m <bulb mask> <row> <red> <green> <blue> */
+		u32ChannelMask = u32LC_StringToUnsignedInteger(&(pcCommand[1]), &pcCommandNext);
+		u32Parameter = u32LC_StringToUnsignedInteger(pcCommandNext, &pcCommandNext);
+		ai32Row[0] = i32LC_StringToSignedInteger(pcCommandNext, &pcCommandNext);
+		ai32Row[1] = i32LC_StringToSignedInteger(pcCommandNext, &pcCommandNext);
+		ai32Row[2] = i32LC_StringToSignedInteger(pcCommandNext, NULL);
+		if ((u32Parameter > 2)
+		 || (ai32Row[0] > MATRIX_ENTRY_MAX) || (ai32Row[0] < -MATRIX_ENTRY_MAX)
+		 || (ai32Row[1] > MATRIX_ENTRY_MAX) || (ai32Row[1] < -MATRIX_ENTRY_MAX)
+		 || (ai32Row[2] > MATRIX_ENTRY_MAX) || (ai32Row[2] < -MATRIX_ENTRY_MAX))
+		{
+			vLC_WriteStringToUART("Invalid matrix\r\n");
+			break;
+		}
+		bFirst = true;
+		for (i = NUM_MONO_LIGHTS; i < NUM_BULBS; i++)
+		{
+			if ((u32ChannelMask >> i) & 1)
+			{
+				if (bFirst)
+				{
+					bFirst = false;
+				}
+				else
+				{
+					vLC_WriteStringToUART(",");
+				}
+				ai16LC_ColourMatrix[i - NUM_MONO_LIGHTS][u32Parameter][0] = (int16)ai32Row[0];
+				ai16LC_ColourMatrix[i - NUM_MONO_LIGHTS][u32Parameter][1] = (int16)ai32Row[1];
+				ai16LC_ColourMatrix[i - NUM_MONO_LIGHTS][u32Parameter][2] = (int16)ai32Row[2];
+				vLC_WriteMatrixStatusToUART((uint8)i);
+				/* Refresh the bulb's colour */
+				vLI_UpdateDriver((uint8)i);
+			}
+		}
+		vLC_WriteStringToUART("\r\n");
+		break;
+
+	case 'n':
 		/* Get raw channel names */
 		/* Output will be a series of <raw channel number>=<name> entries,
 		 * separated by ",". */
@@ -460,9 +1437,48 @@ PRIVATE void vLC_ProcessCommand(char *pcCommand)
 			vLC_WriteChannelStatusToUART(i, CHANNEL_GAMMA);
 			vLC_WriteStringToUART(",");
 			vLC_WriteChannelStatusToUART(i, CHANNEL_BRIGHTNESS);
+			vLC_WriteStringToUART(",");
+			vLC_WriteChannelStatusToUART(i, CHANNEL_KNOTS);
+#ifndef VARIANT_MINI
+			vLC_WriteStringToUART(",");
+			vLC_WriteChannelStatusToUART(i, CHANNEL_CURRENT);
+#endif
+		}
+		for (i = NUM_MONO_LIGHTS; i < NUM_BULBS; i++)
+		{
+			vLC_WriteStringToUART(",");
+			vLC_WriteMatrixStatusToUART((uint8)i);
 		}
 		vLC_WriteStringToUART(",ComputedWhiteMode=");
 		vLC_WriteUnsignedIntegerToUART((unsigned int)u32NewComputedWhiteMode);
+		vLC_WriteStringToUART(",Dither=");
+		vLC_WriteUnsignedIntegerToUART(sLC_Settings.bDither ? 1 : 0);
+		vLC_WriteStringToUART(",LogFade=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)sLC_Settings.u32LogFadeMask);
+		vLC_WriteStringToUART(",XYFade=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)sLC_Settings.u32XYFadeMask);
+#ifndef VARIANT_MINI
+		vLC_WriteStringToUART(",PowerBudget=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)sLC_Settings.u32PowerBudget);
+		vLC_WriteStringToUART(",PowerTotal=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)u32LC_PowerTotal);
+		vLC_WriteStringToUART(",PowerClips=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)u32LC_PowerClips);
+#endif
+		vLC_WriteStringToUART(",Baud=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)psLC_BaudRate->u32BaudRate);
+		vLC_WriteStringToUART(",FrameErrors=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)u32LC_FrameErrors);
+		vLC_WriteStringToUART(",StreamShown=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)u32LC_StreamShown);
+		vLC_WriteStringToUART(",StreamDropped=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)u32LC_StreamDropped);
+		vLC_WriteStringToUART(",StreamLate=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)u32LC_StreamLate);
+#ifdef DEBUG_SERIAL_TIMING
+		vLC_WriteStringToUART(",IsrMaxTicks=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)u32IsrMaxTicks);
+#endif
 		vLC_WriteStringToUART("\r\n");
 		break;
 
@@ -479,6 +1495,79 @@ PRIVATE void vLC_ProcessCommand(char *pcCommand)
 		vLC_WriteStringToUART("\r\n");
 		break;
 
+	case 'd':
+		/* Enable or disable temporal dithering */
+		/* Format of command is d <0 or 1> */
+		sLC_Settings.bDither = (u32LC_StringToUnsignedInteger(&(pcCommand[1]), NULL) != 0);
+		vLC_WriteStringToUART("Dither=");
+		vLC_WriteUnsignedIntegerToUART(sLC_Settings.bDither ? 1 : 0);
+		vLC_WriteStringToUART("\r\n");
+		/* Refresh current PWM values, so that dithering starts or stops,
+		 * and start ticking now if it has started */
+		for (i = 0; i < NUM_BULBS; i++)
+		{
+			DriverBulb_vOutput((uint8)i);
+		}
+		APP_ZCL_vWakeTick();
+		break;
+
+	case 'f':
+		/* Select linear or log domain level fades */
+		/* Format of command is f <bulb mask> <0 or 1>. The new mode is used
+		 * from the next level change of each bulb. */
+		u32Parameter = u32LC_StringToUnsignedInteger(&(pcCommand[1]), &pcCommandNext);
+		if (u32LC_StringToUnsignedInteger(pcCommandNext, NULL) != 0)
+		{
+			sLC_Settings.u32LogFadeMask |= u32Parameter;
+		}
+		else
+		{
+			sLC_Settings.u32LogFadeMask &= ~u32Parameter;
+		}
+		sLC_Settings.u32LogFadeMask &= (1UL << NUM_BULBS) - 1;
+		vLC_WriteStringToUART("LogFade=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)sLC_Settings.u32LogFadeMask);
+		vLC_WriteStringToUART("\r\n");
+		break;
+
+	case 'x':
+		/* Select RGB or CIE xy colour fades */
+		/* Format of command is x <bulb mask> <0 or 1>. The new mode is used
+		 * from the next colour change of each bulb. */
+		u32Parameter = u32LC_StringToUnsignedInteger(&(pcCommand[1]), &pcCommandNext);
+		if (u32LC_StringToUnsignedInteger(pcCommandNext, NULL) != 0)
+		{
+			sLC_Settings.u32XYFadeMask |= u32Parameter;
+		}
+		else
+		{
+			sLC_Settings.u32XYFadeMask &= ~u32Parameter;
+		}
+		sLC_Settings.u32XYFadeMask &= (1UL << NUM_BULBS) - 1;
+		vLC_WriteStringToUART("XYFade=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)sLC_Settings.u32XYFadeMask);
+		vLC_WriteStringToUART("\r\n");
+		break;
+
+#ifndef VARIANT_MINI
+	case 'p':
+		/* Set power budget */
+		/* Format of command is p <total current in mA, 0 for no limit> */
+		sLC_Settings.u32PowerBudget = MIN(u32LC_StringToUnsignedInteger(&(pcCommand[1]), NULL), 0xffff);
+		vLC_WriteStringToUART("PowerBudget=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)sLC_Settings.u32PowerBudget);
+		vLC_WriteStringToUART("\r\n");
+		/* Refresh current PWM values in one frame, so that the new budget
+		 * is applied once, to all of them */
+		DriverBulb_vBeginFrame();
+		for (i = 0; i < NUM_BULBS; i++)
+		{
+			DriverBulb_vOutput((uint8)i);
+		}
+		DriverBulb_vCommitFrame();
+		break;
+#endif
+
 	case 's':
 		/* Save settings to non-volatile memory */
 		vLC_WriteStringToUART("saving\r\n");
@@ -509,6 +1598,35 @@ PRIVATE void vLC_ProcessCommand(char *pcCommand)
 		vLC_WriteStringToUART("\r\n");
 		break;
 
+	case 'u':
+		/* Set baud rate */
+		/* Format of command is u <baud rate>. The response is sent at the
+		 * old baud rate, then the UART changes to the new one. */
+		psBaudRate = psLC_FindBaudRate(u32LC_StringToUnsignedInteger(&(pcCommand[1]), NULL));
+		if (psBaudRate == NULL)
+		{
+			vLC_WriteStringToUART("Invalid baud rate\r\n");
+			break;
+		}
+		sLC_Settings.u32BaudRate = psBaudRate->u32BaudRate;
+		vLC_WriteStringToUART("Baud=");
+		vLC_WriteUnsignedIntegerToUART((unsigned int)psBaudRate->u32BaudRate);
+		vLC_WriteStringToUART("\r\n");
+		psLC_PendingBaudRate = psBaudRate;
+		/* APP_isrUart may have finished sending the response already, so
+		 * make sure it runs again to make the change */
+		vLC_StartTransmit(u16TxHead);
+		break;
+
+	case 'e':
+		/* Enter binary mode. Everything received after this line is
+		 * treated as binary frames, until a BIN_CMD_EXIT frame. */
+		vLC_WriteStringToUART("Binary\r\n");
+		bLC_BinaryMode = TRUE;
+		u16BinFrameSize = 0;
+		bBinFrameOverflow = FALSE;
+		break;
+
 	default:
 		vLC_WriteStringToUART("Unknown command\r\n");
 		break;
@@ -538,70 +1656,767 @@ PRIVATE void vLC_WriteChannelStatusToUART(uint8 u8Channel, teChannelSetting teSe
 		vLC_WriteStringToUART(":brightness=");
 		vLC_WriteUnsignedIntegerToUART(atsLC_Calibration[u8Channel].u16Brightness);
 	}
+	else if (teSetting == CHANNEL_KNOTS)
+	{
+		vLC_WriteStringToUART(":knots=");
+		vLC_WriteUnsignedIntegerToUART(atsLC_Curve[u8Channel].u8NumKnots);
+	}
+#ifndef VARIANT_MINI
+	else if (teSetting == CHANNEL_CURRENT)
+	{
+		vLC_WriteStringToUART(":current=");
+		vLC_WriteUnsignedIntegerToUART(au16LC_ChannelCurrent[u8Channel]);
+	}
+#endif
 }
 
 /****************************************************************************
- * NAME:	vLC_WriteStringToUART
+ * NAME:	vLC_WriteMatrixStatusToUART
  *
  * DESCRIPTION:
- *			Write string to UART
+ *			Write the colour correction matrix of an RGB bulb to UART, as
+ *			<bulb number>:matrix=<9 entries, row by row, separated by
+ *			spaces> e.g. "3:matrix=4096 0 0 0 4096 0 0 0 4096" for the
+ *			identity matrix.
  ****************************************************************************/
-PRIVATE void vLC_WriteStringToUART(const char *pcStr)
+PRIVATE void vLC_WriteMatrixStatusToUART(uint8 u8Bulb)
 {
-	unsigned int i;
+	int32 i32Entry;
+	uint8 i;
 
-	for (i = 0; i < strlen(pcStr); i++)
+	vLC_WriteUnsignedIntegerToUART(u8Bulb);
+	vLC_WriteStringToUART(":matrix=");
+	for (i = 0; i < 9; i++)
 	{
-		while (u16AHI_UartReadTxFifoLevel(E_AHI_UART_0) == TX_BUF_SIZE)
+		if (i != 0)
 		{
-			/* wait */
+			vLC_WriteStringToUART(" ");
 		}
-		vAHI_UartWriteData(E_AHI_UART_0, (uint8)pcStr[i]);
-	}
+		i32Entry = ai16LC_ColourMatrix[u8Bulb - NUM_MONO_LIGHTS][i / 3][i % 3];
+		if (i32Entry < 0)
+		{
+			vLC_WriteStringToUART("-");
+			i32Entry = -i32Entry;
+		}
+		vLC_WriteUnsignedIntegerToUART((unsigned int)i32Entry);
+	}
+}
+
+/****************************************************************************
+ * NAME:	vLC_WriteStringToUART
+ *
+ * DESCRIPTION:
+ *			Write string to UART. The string is queued in au8TxRing and
+ *			sent by APP_isrUart, so this never waits. Characters which
+ *			don't fit in the ring are dropped.
+ ****************************************************************************/
+PRIVATE void vLC_WriteStringToUART(const char *pcStr)
+{
+	uint16 u16Head = u16TxHead;
+
+	while ((*pcStr != '\0') && ((uint16)(u16Head - u16TxTail) < TX_RING_SIZE))
+	{
+		au8TxRing[u16Head & (TX_RING_SIZE - 1)] = (uint8)*pcStr++;
+		u16Head++;
+	}
+	vLC_StartTransmit(u16Head);
 }
 
 /****************************************************************************
  * NAME:	vLC_WriteUnsignedIntegerToUART
  *
  * DESCRIPTION:
- *			Convert number iValue into null-terminated string, then write
- *			that string to the UART. The number will be in base-10
- *			representation.
+ *			Write number uValue to the UART, in base-10 representation.
+ *			Like vLC_WriteStringToUART this never waits; the digits are
+ *			written straight into au8TxRing, or dropped if they don't fit.
  *
  *			This is used instead of printf to reduce RAM use.
  ****************************************************************************/
 PRIVATE void vLC_WriteUnsignedIntegerToUART(unsigned int uValue)
 {
-	unsigned int uIndex = 0;
+	uint16 u16Head = u16TxHead;
+	unsigned int uDigits = 1;
+	unsigned int uPower = 10;
 	unsigned int i;
-	unsigned int uRemainder;
-	char cTemp;
-	char acString[16];
 
-	if (uValue == 0)
+	/* Count digits. uPower stops growing once it would overflow. */
+	while ((uValue >= uPower) && (uDigits < 10))
+	{
+		uDigits++;
+		if (uDigits < 10)
+		{
+			uPower *= 10;
+		}
+	}
+	if ((unsigned int)(TX_RING_SIZE - (uint16)(u16Head - u16TxTail)) < uDigits)
 	{
-		acString[0] = '0';
-		acString[1] = '\0';
-		vLC_WriteStringToUART(acString);
+		/* Doesn't fit, drop it */
 		return;
 	}
-
-	while (uValue != 0)
+	/* Write digits straight into the ring, least significant first */
+	for (i = uDigits; i > 0; i--)
 	{
-		uRemainder = uValue % 10;
+		au8TxRing[(u16Head + i - 1) & (TX_RING_SIZE - 1)] = (uint8)('0' + (uValue % 10));
 		uValue = uValue / 10;
-		acString[uIndex++] = (char)('0' + uRemainder);
 	}
-	/* Reverse string */
-	for (i = 0; i < (uIndex >> 1); i++)
+	vLC_StartTransmit(u16Head + uDigits);
+}
+
+/****************************************************************************
+ * NAME:	vLC_StartTransmit
+ *
+ * DESCRIPTION:
+ *			Make the bytes written to au8TxRing up to u16Head visible to
+ *			APP_isrUart, and turn on the TX FIFO empty interrupt so that it
+ *			starts sending them.
+ ****************************************************************************/
+PRIVATE void vLC_StartTransmit(uint16 u16Head)
+{
+	if ((uint16)(u16Head - u16TxTail) > u16TxHighWater)
+	{
+		u16TxHighWater = (uint16)(u16Head - u16TxTail);
+	}
+	u16TxHead = u16Head;
+	vLC_SetUartInterrupts(TRUE);
+}
+
+/****************************************************************************
+ * NAME:	vLC_SetUartInterrupts
+ *
+ * DESCRIPTION:
+ *			Enable the RX data and RX line status (break) interrupts, and
+ *			the TX FIFO empty interrupt if bTransmit is TRUE.
+ ****************************************************************************/
+PRIVATE void vLC_SetUartInterrupts(bool_t bTransmit)
+{
+	vAHI_UartSetInterrupt(E_AHI_UART_0, FALSE, TRUE, bTransmit, TRUE, RX_FIFO_LEVEL);
+}
+
+/****************************************************************************
+ * NAME:	psLC_FindBaudRate
+ *
+ * DESCRIPTION:
+ *			Look up the clock settings for a baud rate. This returns NULL
+ *			if the baud rate isn't supported.
+ ****************************************************************************/
+PRIVATE const tsLC_BaudRate *psLC_FindBaudRate(uint32 u32BaudRate)
+{
+	uint8 i;
+
+	for (i = 0; i < sizeof(asLC_BaudRates) / sizeof(asLC_BaudRates[0]); i++)
+	{
+		if (asLC_BaudRates[i].u32BaudRate == u32BaudRate)
+		{
+			return &asLC_BaudRates[i];
+		}
+	}
+	return NULL;
+}
+
+/****************************************************************************
+ * NAME:	vLC_SetBaudRate
+ *
+ * DESCRIPTION:
+ *			Change the UART to a baud rate from asLC_BaudRates straight
+ *			away. Anything which is still being sent is garbled.
+ ****************************************************************************/
+PRIVATE void vLC_SetBaudRate(const tsLC_BaudRate *psBaudRate)
+{
+	vAHI_UartSetClocksPerBit(E_AHI_UART_0, psBaudRate->u8ClocksPerBit);
+	vAHI_UartSetBaudDivisor(E_AHI_UART_0, psBaudRate->u16Divisor);
+	psLC_BaudRate = psBaudRate;
+}
+
+/****************************************************************************
+ * NAME:	vLC_StreamFrame
+ *
+ * DESCRIPTION:
+ *			Show a BIN_CMD_STREAM_FRAME frame. pu8Data holds the sequence
+ *			number followed by the value of each raw channel. Frames which
+ *			are older than the last frame shown are dropped.
+ ****************************************************************************/
+PRIVATE void vLC_StreamFrame(uint8 *pu8Data)
+{
+	int8 i8Ahead = (int8)(pu8Data[0] - u8StreamSequence);
+	uint16 *pu16Back = au16StreamValue[u8StreamFront ^ 1];
+	uint8 i;
+
+	if (bStreamSynced)
+	{
+		if (i8Ahead <= 0)
+		{
+			u32LC_StreamLate++;
+			return;
+		}
+		u32LC_StreamDropped += (uint32)(i8Ahead - 1);
+	}
+	bStreamSynced = TRUE;
+	u8StreamSequence = pu8Data[0];
+
+	for (i = 0; i < NUM_CHANNELS; i++)
+	{
+		pu16Back[i] = (uint16)MIN(pu8Data[1 + 2 * i] | (pu8Data[2 + 2 * i] << 8), STREAM_VALUE_MAX);
+	}
+	u8StreamFront ^= 1;
+	DriverBulb_vRefresh();
+	u32LC_StreamShown++;
+}
+
+/****************************************************************************
+ * NAME:	vLC_StopStream
+ *
+ * DESCRIPTION:
+ *			Go back to driving the outputs from the bulb state
+ ****************************************************************************/
+PRIVATE void vLC_StopStream(void)
+{
+	uint8 i;
+
+	if (bLC_Streaming)
+	{
+		bLC_Streaming = FALSE;
+		for (i = 0; i < NUM_BULBS; i++)
+		{
+			DriverBulb_vOutput(i);
+		}
+	}
+}
+
+/****************************************************************************
+ * NAME:	vLC_SendTelemetry
+ *
+ * DESCRIPTION:
+ *			Send a telemetry record as a BIN_CMD_TELEMETRY response. Every
+ *			field is copied from a value which is already kept in RAM, so
+ *			this is cheap enough to run at any telemetry rate. The record
+ *			is dropped if au8TxRing is too full for it, which the host sees
+ *			as a gap in the sequence number. The record holds, in order:
+ *			- sequence number, 16 bits, up by 1 with each record
+ *			- board temperature in degrees Celsius, signed 16 bits
+ *			- flags, 8 bits: bit 0 is bOverheat
+ *			- Tick_Task runs which missed a 10ms step, 32 bits
+ *			- latest Tick_Task start, in 16MHz tick timer counts, 32 bits
+ *			- failed output transfers (I2C errors), 32 bits
+ *			- most bytes waiting in au8RxRing, 16 bits
+ *			- most bytes waiting in au8TxRing, 16 bits
+ *			- PWM value of each raw channel, 16 bits each, with
+ *			  LC_PWM_FRAC_BITS fractional bits
+ ****************************************************************************/
+PRIVATE void vLC_SendTelemetry(void)
+{
+	uint8 i;
+
+	vLC_BinaryBegin(BIN_CMD_TELEMETRY, BIN_STATUS_OK);
+	vLC_BinaryPutU16(u16TelemetrySequence);
+	vLC_BinaryPutU16((uint16)i16TS_GetTemperature());
+	vLC_BinaryPutByte(bOverheat ? 1 : 0);
+	vLC_BinaryPutU32(u32TickOverruns);
+	vLC_BinaryPutU32(u32TickMaxLate);
+	vLC_BinaryPutU32(DriverBulb_u32GetErrors());
+	vLC_BinaryPutU16(u16RxHighWater);
+	vLC_BinaryPutU16(u16TxHighWater);
+	for (i = 0; i < NUM_CHANNELS; i++)
 	{
-		cTemp = acString[i];
-		acString[i] = acString[uIndex - 1 - i];
-		acString[uIndex - 1 - i] = cTemp;
+		vLC_BinaryPutU16(DriverBulb_u16GetChannelPWM(i));
 	}
-	/* Null-terminate */
-	acString[uIndex++] = '\0';
-	vLC_WriteStringToUART(acString);
+	vLC_BinaryEnd();
+	u16TelemetrySequence++;
+}
+
+/****************************************************************************
+ * NAME:	vLC_ProcessFrame
+ *
+ * DESCRIPTION:
+ *			Process and execute a decoded binary mode frame. pu8Frame holds
+ *			the command ID followed by its data, u16Length is at least 1.
+ *			Every frame gets a response frame holding the command ID with
+ *			BIN_RESPONSE set and a status code, followed by data for
+ *			commands which return any. Multi-byte values are little
+ *			endian. Frames which fail a check change nothing.
+ ****************************************************************************/
+PRIVATE void vLC_ProcessFrame(uint8 *pu8Frame, uint16 u16Length)
+{
+	uint8 u8Command = pu8Frame[0];
+	uint8 *pu8Data = &pu8Frame[1];
+	uint16 u16DataLength = u16Length - 1;
+	uint8 u8Status = BIN_STATUS_OK;
+	uint32 u32ChannelMask = 0;
+	uint16 u16Value;
+	uint16 i;
+	uint8 j;
+	int16 i16Entry;
+	const char *pcVersion;
+
+	switch (u8Command)
+	{
+	case BIN_CMD_PING:
+		/* Response data is the board version string */
+		vLC_BinaryBegin(u8Command, BIN_STATUS_OK);
+		for (pcVersion = BOARD_VERSION; *pcVersion != '\0'; pcVersion++)
+		{
+			vLC_BinaryPutByte((uint8)*pcVersion);
+		}
+		vLC_BinaryEnd();
+		return;
+
+	case BIN_CMD_EXIT:
+		/* Go back to lines. The response is still a binary frame. */
+		vLC_StopStream();
+		u16TelemetryPeriod = 0;
+		bLC_BinaryMode = FALSE;
+		break;
+
+	case BIN_CMD_SAVE:
+		vLC_SaveCalibrationToNVM();
+		break;
+
+	case BIN_CMD_SET_CHANNEL:
+		/* Data is any number of <channel> <setting> <value> entries */
+		if ((u16DataLength == 0) || ((u16DataLength % BIN_CHANNEL_ENTRY_SIZE) != 0))
+		{
+			u8Status = BIN_STATUS_BAD_LENGTH;
+			break;
+		}
+		for (i = 0; i < u16DataLength; i += BIN_CHANNEL_ENTRY_SIZE)
+		{
+			if ((pu8Data[i] >= NUM_CHANNELS) || (pu8Data[i + 1] > BIN_SETTING_LAST))
+			{
+				u8Status = BIN_STATUS_BAD_VALUE;
+			}
+		}
+		if (u8Status != BIN_STATUS_OK)
+		{
+			break;
+		}
+		for (i = 0; i < u16DataLength; i += BIN_CHANNEL_ENTRY_SIZE)
+		{
+			j = pu8Data[i];
+			u16Value = (uint16)(pu8Data[i + 2] | (pu8Data[i + 3] << 8));
+			if (pu8Data[i + 1] == BIN_SETTING_GAMMA)
+			{
+				atsLC_Calibration[j].u16Gamma = u16Value;
+				u32ChannelMask |= 1UL << j;
+			}
+			else if (pu8Data[i + 1] == BIN_SETTING_BRIGHTNESS)
+			{
+				atsLC_Calibration[j].u16Brightness = u16Value;
+			}
+#ifndef VARIANT_MINI
+			else
+			{
+				au16LC_ChannelCurrent[j] = u16Value;
+			}
+#endif
+		}
+#ifndef VARIANT_MINI
+		/* Resample each changed gamma curve once, however many entries
+		 * there were for the channel */
+		for (j = 0; j < NUM_CHANNELS; j++)
+		{
+			if ((u32ChannelMask >> j) & 1)
+			{
+				vLC_UpdateIntensityTable(j);
+			}
+		}
+#endif
+		for (j = 0; j < NUM_BULBS; j++)
+		{
+			DriverBulb_vOutput(j);
+		}
+		break;
+
+	case BIN_CMD_GET_CHANNELS:
+		/* Response data is <gamma> <brightness> <number of knots>
+		 * <current> for each channel in turn. The current is always 0 on
+		 * the Mini variant. */
+		vLC_BinaryBegin(u8Command, BIN_STATUS_OK);
+		for (j = 0; j < NUM_CHANNELS; j++)
+		{
+			vLC_BinaryPutU16(atsLC_Calibration[j].u16Gamma);
+			vLC_BinaryPutU16(atsLC_Calibration[j].u16Brightness);
+			vLC_BinaryPutByte(atsLC_Curve[j].u8NumKnots);
+#ifdef VARIANT_MINI
+			vLC_BinaryPutU16(0);
+#else
+			vLC_BinaryPutU16(au16LC_ChannelCurrent[j]);
+#endif
+		}
+		vLC_BinaryEnd();
+		return;
+
+	case BIN_CMD_SET_CURVE:
+		/* Data is a 16 bit channel mask followed by <intensity> <PWM
+		 * value> for each knot. This replaces the staged knots, and then
+		 * works like the 'c' command. No knots removes the curve. */
+		if ((u16DataLength < 2)
+		 || (((u16DataLength - 2) % 4) != 0)
+		 || (((u16DataLength - 2) / 4) > MAX_CURVE_KNOTS))
+		{
+			u8Status = BIN_STATUS_BAD_LENGTH;
+			break;
+		}
+		u32ChannelMask = (uint32)(pu8Data[0] | (pu8Data[1] << 8));
+		for (i = 2, j = 0; i < u16DataLength; i += 4, j++)
+		{
+			sLC_StagedCurve.au16Intensity[j] = (uint16)(pu8Data[i] | (pu8Data[i + 1] << 8));
+			sLC_StagedCurve.au16PWM[j] = (uint16)(pu8Data[i + 2] | (pu8Data[i + 3] << 8));
+		}
+		if (!bLC_StagedCurveValid(j))
+		{
+			u8Status = BIN_STATUS_BAD_VALUE;
+			break;
+		}
+		sLC_StagedCurve.u8NumKnots = j;
+		for (j = 0; j < NUM_CHANNELS; j++)
+		{
+			if ((u32ChannelMask >> j) & 1)
+			{
+				atsLC_Curve[j] = sLC_StagedCurve;
+#ifndef VARIANT_MINI
+				vLC_UpdateIntensityTable(j);
+#endif
+			}
+		}
+		for (j = 0; j < NUM_BULBS; j++)
+		{
+			DriverBulb_vOutput(j);
+		}
+		break;
+
+	case BIN_CMD_SET_MATRIX:
+		/* Data is any number of <bulb> <9 signed matrix entries, row by
+		 * row> entries */
+		if ((u16DataLength == 0) || ((u16DataLength % BIN_MATRIX_ENTRY_SIZE) != 0))
+		{
+			u8Status = BIN_STATUS_BAD_LENGTH;
+			break;
+		}
+		for (i = 0; i < u16DataLength; i += BIN_MATRIX_ENTRY_SIZE)
+		{
+			if ((pu8Data[i] < NUM_MONO_LIGHTS) || (pu8Data[i] >= NUM_BULBS))
+			{
+				u8Status = BIN_STATUS_BAD_VALUE;
+			}
+			for (j = 0; j < 9; j++)
+			{
+				i16Entry = (int16)(pu8Data[i + 1 + 2 * j] | (pu8Data[i + 2 + 2 * j] << 8));
+				if ((i16Entry > MATRIX_ENTRY_MAX) || (i16Entry < -MATRIX_ENTRY_MAX))
+				{
+					u8Status = BIN_STATUS_BAD_VALUE;
+				}
+			}
+		}
+		if (u8Status != BIN_STATUS_OK)
+		{
+			break;
+		}
+		for (i = 0; i < u16DataLength; i += BIN_MATRIX_ENTRY_SIZE)
+		{
+			for (j = 0; j < 9; j++)
+			{
+				ai16LC_ColourMatrix[pu8Data[i] - NUM_MONO_LIGHTS][j / 3][j % 3] =
+					(int16)(pu8Data[i + 1 + 2 * j] | (pu8Data[i + 2 + 2 * j] << 8));
+			}
+			/* Refresh the bulb's colour */
+			vLI_UpdateDriver(pu8Data[i]);
+		}
+		break;
+
+	case BIN_CMD_STREAM_START:
+		/* Data is 1 byte, 0 if stream values are PWM values, or 1 if they
+		 * are intensities which are calibrated like bulb levels. All
+		 * outputs are off until the first stream frame. */
+		if (u16DataLength != 1)
+		{
+			u8Status = BIN_STATUS_BAD_LENGTH;
+			break;
+		}
+		if (pu8Data[0] > 1)
+		{
+			u8Status = BIN_STATUS_BAD_VALUE;
+			break;
+		}
+		bStreamCalibrated = (pu8Data[0] != 0);
+		memset(au16StreamValue[u8StreamFront], 0, sizeof(au16StreamValue[0]));
+		bStreamSynced = FALSE;
+		u32LC_StreamShown = 0;
+		u32LC_StreamDropped = 0;
+		u32LC_StreamLate = 0;
+		bLC_Streaming = TRUE;
+		for (j = 0; j < NUM_BULBS; j++)
+		{
+			DriverBulb_vOutput(j);
+		}
+		break;
+
+	case BIN_CMD_STREAM_FRAME:
+		/* Data is a sequence number, which goes up by 1 with each frame,
+		 * and then a 16 bit value for each raw channel. There is only a
+		 * response if the frame is rejected, so that the host can send
+		 * frames without waiting. */
+		if (u16DataLength != (1 + 2 * NUM_CHANNELS))
+		{
+			u8Status = BIN_STATUS_BAD_LENGTH;
+			break;
+		}
+		if (!bLC_Streaming)
+		{
+			u8Status = BIN_STATUS_BAD_VALUE;
+			break;
+		}
+		vLC_StreamFrame(pu8Data);
+		return;
+
+	case BIN_CMD_STREAM_STOP:
+		/* Response data is the number of frames shown, dropped and late,
+		 * 4 bytes each */
+		vLC_StopStream();
+		vLC_BinaryBegin(u8Command, BIN_STATUS_OK);
+		vLC_BinaryPutU32(u32LC_StreamShown);
+		vLC_BinaryPutU32(u32LC_StreamDropped);
+		vLC_BinaryPutU32(u32LC_StreamLate);
+		vLC_BinaryEnd();
+		return;
+
+	case BIN_CMD_SUBSCRIBE:
+		/* Data is the telemetry period in ms, 16 bits, or 0 to stop.
+		 * Response data is the period which will be used, rounded up to
+		 * a multiple of TELEMETRY_TICK_MS. Records are then sent as
+		 * unsolicited BIN_CMD_TELEMETRY responses until the next
+		 * BIN_CMD_SUBSCRIBE or BIN_CMD_EXIT. */
+		if (u16DataLength != 2)
+		{
+			u8Status = BIN_STATUS_BAD_LENGTH;
+			break;
+		}
+		u16Value = (uint16)(pu8Data[0] | (pu8Data[1] << 8));
+		if (u16Value > TELEMETRY_PERIOD_MAX)
+		{
+			u8Status = BIN_STATUS_BAD_VALUE;
+			break;
+		}
+		u16TelemetryPeriod = (uint16)((u16Value + TELEMETRY_TICK_MS - 1) / TELEMETRY_TICK_MS);
+		u16TelemetryCount = 0;
+		vLC_BinaryBegin(u8Command, BIN_STATUS_OK);
+		vLC_BinaryPutU16((uint16)(u16TelemetryPeriod * TELEMETRY_TICK_MS));
+		vLC_BinaryEnd();
+		return;
+
+	case BIN_CMD_TELEMETRY:
+		/* Response is a telemetry record, the same as a pushed one */
+		if (u16DataLength != 0)
+		{
+			u8Status = BIN_STATUS_BAD_LENGTH;
+			break;
+		}
+		vLC_SendTelemetry();
+		return;
+
+	default:
+		u8Status = BIN_STATUS_UNKNOWN;
+		break;
+	}
+
+	vLC_BinaryBegin(u8Command, u8Status);
+	vLC_BinaryEnd();
+}
+
+/****************************************************************************
+ * NAME:	u16LC_DecodeFrame
+ *
+ * DESCRIPTION:
+ *			Decode a COBS encoded frame in place, and check and remove its
+ *			CRC. The frame must not include the 0 delimiter. This returns
+ *			the length of the decoded frame without the CRC, or 0 if the
+ *			frame is malformed, too short or fails the CRC check.
+ *			The CRC is CRC-16/CCITT-FALSE of the rest of the frame, sent
+ *			most significant byte first, so the CRC of the whole frame is
+ *			0.
+ ****************************************************************************/
+PRIVATE uint16 u16LC_DecodeFrame(uint8 *pu8Frame, uint16 u16Length)
+{
+	uint16 u16In = 0;
+	uint16 u16Out = 0;
+	uint16 u16Crc = 0xffff;
+	uint8 u8Code;
+	uint8 i;
+
+	while (u16In < u16Length)
+	{
+		/* The code byte is never 0, because 0 ends the frame. Each code
+		 * byte is followed by u8Code - 1 bytes, and stands for a 0 after
+		 * them unless it is 0xff or the last one. */
+		u8Code = pu8Frame[u16In++];
+		for (i = 1; i < u8Code; i++)
+		{
+			if (u16In >= u16Length)
+			{
+				return 0;
+			}
+			pu8Frame[u16Out++] = pu8Frame[u16In++];
+		}
+		if ((u8Code != 0xff) && (u16In < u16Length))
+		{
+			pu8Frame[u16Out++] = 0;
+		}
+	}
+
+	/* Command ID and CRC at least */
+	if (u16Out < 3)
+	{
+		return 0;
+	}
+	for (u16In = 0; u16In < u16Out; u16In++)
+	{
+		u16Crc = u16LC_Crc16(u16Crc, pu8Frame[u16In]);
+	}
+	if (u16Crc != 0)
+	{
+		return 0;
+	}
+	return u16Out - 2;
+}
+
+/****************************************************************************
+ * NAME:	u16LC_Crc16
+ *
+ * DESCRIPTION:
+ *			Add one byte to a CRC-16/CCITT-FALSE (polynomial 0x1021, start
+ *			value 0xffff). This is done bit by bit instead of with a table,
+ *			because frames are short.
+ ****************************************************************************/
+PRIVATE uint16 u16LC_Crc16(uint16 u16Crc, uint8 u8Byte)
+{
+	uint8 i;
+
+	u16Crc ^= (uint16)u8Byte << 8;
+	for (i = 0; i < 8; i++)
+	{
+		if (u16Crc & 0x8000)
+		{
+			u16Crc = (uint16)((u16Crc << 1) ^ 0x1021);
+		}
+		else
+		{
+			u16Crc = (uint16)(u16Crc << 1);
+		}
+	}
+	return u16Crc;
+}
+
+/****************************************************************************
+ * NAME:	vLC_BinaryBegin
+ *
+ * DESCRIPTION:
+ *			Start a binary mode response frame. The frame is COBS encoded
+ *			straight into au8TxRing as bytes are added with
+ *			vLC_BinaryPutByte and vLC_BinaryPutU16, and only sent once
+ *			vLC_BinaryEnd is called.
+ ****************************************************************************/
+PRIVATE void vLC_BinaryBegin(uint8 u8Command, uint8 u8Status)
+{
+	/* Leave space for the first code byte */
+	u16BinTxCodePos = u16TxHead;
+	u16BinTxPos = u16BinTxCodePos + 1;
+	u8BinTxCode = 1;
+	u16BinTxCrc = 0xffff;
+	bBinTxOverflow = FALSE;
+	vLC_BinaryPutByte(u8Command | BIN_RESPONSE);
+	vLC_BinaryPutByte(u8Status);
+}
+
+/****************************************************************************
+ * NAME:	vLC_BinaryPutByte
+ *
+ * DESCRIPTION:
+ *			Add one byte to the response frame started by vLC_BinaryBegin.
+ ****************************************************************************/
+PRIVATE void vLC_BinaryPutByte(uint8 u8Byte)
+{
+	u16BinTxCrc = u16LC_Crc16(u16BinTxCrc, u8Byte);
+	vLC_BinaryEncodeByte(u8Byte);
+}
+
+/****************************************************************************
+ * NAME:	vLC_BinaryPutU16
+ *
+ * DESCRIPTION:
+ *			Add a 16 bit value, least significant byte first, to the
+ *			response frame started by vLC_BinaryBegin.
+ ****************************************************************************/
+PRIVATE void vLC_BinaryPutU16(uint16 u16Value)
+{
+	vLC_BinaryPutByte((uint8)u16Value);
+	vLC_BinaryPutByte((uint8)(u16Value >> 8));
+}
+
+/****************************************************************************
+ * NAME:	vLC_BinaryPutU32
+ *
+ * DESCRIPTION:
+ *			Add a 32 bit value, least significant byte first, to the
+ *			response frame started by vLC_BinaryBegin.
+ ****************************************************************************/
+PRIVATE void vLC_BinaryPutU32(uint32 u32Value)
+{
+	vLC_BinaryPutU16((uint16)u32Value);
+	vLC_BinaryPutU16((uint16)(u32Value >> 16));
+}
+
+/****************************************************************************
+ * NAME:	vLC_BinaryEncodeByte
+ *
+ * DESCRIPTION:
+ *			COBS encode one byte into au8TxRing. A 0 ends the current
+ *			block by filling in its code byte; so does the 254th non-zero
+ *			byte in a row. If the ring is too full for the byte, the whole
+ *			frame will be dropped by vLC_BinaryEnd.
+ ****************************************************************************/
+PRIVATE void vLC_BinaryEncodeByte(uint8 u8Byte)
+{
+	/* Each byte takes at most 2 bytes of space, and vLC_BinaryEnd needs 1
+	 * more for the delimiter */
+	if ((uint16)(u16BinTxPos - u16TxTail) > (TX_RING_SIZE - 3))
+	{
+		bBinTxOverflow = TRUE;
+		return;
+	}
+	if (u8Byte != 0)
+	{
+		au8TxRing[u16BinTxPos & (TX_RING_SIZE - 1)] = u8Byte;
+		u16BinTxPos++;
+		u8BinTxCode++;
+	}
+	if ((u8Byte == 0) || (u8BinTxCode == 0xff))
+	{
+		au8TxRing[u16BinTxCodePos & (TX_RING_SIZE - 1)] = u8BinTxCode;
+		u16BinTxCodePos = u16BinTxPos;
+		u16BinTxPos++;
+		u8BinTxCode = 1;
+	}
+}
+
+/****************************************************************************
+ * NAME:	vLC_BinaryEnd
+ *
+ * DESCRIPTION:
+ *			Finish the response frame started by vLC_BinaryBegin by adding
+ *			its CRC and delimiter, and send it. A frame which didn't fit in
+ *			au8TxRing is dropped instead.
+ ****************************************************************************/
+PRIVATE void vLC_BinaryEnd(void)
+{
+	uint16 u16Crc = u16BinTxCrc;
+
+	vLC_BinaryEncodeByte((uint8)(u16Crc >> 8));
+	vLC_BinaryEncodeByte((uint8)u16Crc);
+	if (bBinTxOverflow)
+	{
+		return;
+	}
+	au8TxRing[u16BinTxCodePos & (TX_RING_SIZE - 1)] = u8BinTxCode;
+	au8TxRing[u16BinTxPos & (TX_RING_SIZE - 1)] = 0;
+	vLC_StartTransmit(u16BinTxPos + 1);
 }
 
 /****************************************************************************
@@ -640,6 +2455,36 @@ PRIVATE uint32_t u32LC_StringToUnsignedInteger(const char *pcString, char **pcEn
 	return u32Value;
 }
 
+/****************************************************************************
+ * NAME:	i32LC_StringToSignedInteger
+ *
+ * DESCRIPTION:
+ *			Like u32LC_StringToUnsignedInteger, but the number may start
+ *			with a "-" sign.
+ ****************************************************************************/
+PRIVATE int32 i32LC_StringToSignedInteger(const char *pcString, char **pcEndPtr)
+{
+	bool_t bNegative = FALSE;
+
+	/* Skip whitespace */
+	while ((*pcString == ' ') || (*pcString == '\r') || (*pcString == '\n') || (*pcString == '\t'))
+	{
+		pcString++;
+	}
+
+	if (*pcString == '-')
+	{
+		bNegative = TRUE;
+		pcString++;
+	}
+
+	if (bNegative)
+	{
+		return -(int32)u32LC_StringToUnsignedInteger(pcString, pcEndPtr);
+	}
+	return (int32)u32LC_StringToUnsignedInteger(pcString, pcEndPtr);
+}
+
 /****************************************************************************/
 /***        END OF FILE                                                   ***/
 /****************************************************************************/
@@ -52,6 +52,20 @@
  * of color reproduction */
 #define COMPUTED_WHITE_BETTER_BRIGHTNESS	2
 
+/* Number of fractional bits in the PWM values returned by
+ * u32LC_AdjustIntensity */
+#define LC_PWM_FRAC_BITS					4
+/* Largest PWM value returned by u32LC_AdjustIntensity, which should be
+ * treated as fully on */
+#define LC_PWM_MAX							(4095 << LC_PWM_FRAC_BITS)
+
+#ifndef VARIANT_MINI
+/* u32LC_PowerBudgetScale returns a multiplier with this many fractional
+ * bits */
+#define LC_POWER_SCALE_FRAC_BITS			16
+#define LC_POWER_SCALE_ONE					(1UL << LC_POWER_SCALE_FRAC_BITS)
+#endif
+
 /****************************************************************************/
 /***        Type Definitions                                              ***/
 /****************************************************************************/
@@ -64,6 +78,18 @@ typedef enum
 	BULB_BLUE = 2
 } teColour;
 
+/* Output settings which are not specific to a channel */
+typedef struct
+{
+	bool_t bDither;		/* temporal dithering of fractional PWM values */
+	uint32 u32LogFadeMask;	/* bit n set means bulb n fades in the log domain */
+	uint32 u32XYFadeMask;	/* bit n set means bulb n fades colour in CIE xy */
+#ifndef VARIANT_MINI
+	uint32 u32PowerBudget;	/* limit on the total current of all channels, in mA, 0 = no limit */
+#endif
+	uint32 u32BaudRate;		/* baud rate of the configuration UART */
+} tsLC_Settings;
+
 /****************************************************************************/
 /***        Exported Functions                                            ***/
 /****************************************************************************/
@@ -72,12 +98,26 @@ PUBLIC void vLC_InitSerialInterface(void);
 PUBLIC uint8 u8LC_GetChannel(uint8 u8Bulb, teColour eColour);
 PUBLIC void vLC_LoadCalibrationFromNVM(void);
 PUBLIC void vLC_SaveCalibrationToNVM(void);
-PUBLIC uint32 u32LC_AdjustIntensity(uint8 u8Intensity, uint8 u8ChannelNum);
+PUBLIC uint32 u32LC_AdjustIntensity(uint16 u16Intensity, uint8 u8ChannelNum);
+PUBLIC uint32 u32LC_IntensityToLog(uint16 u16Intensity);
+PUBLIC uint16 u16LC_LogToIntensity(uint32 u32Log);
+PUBLIC void vLC_CorrectColour(uint8 u8Bulb, uint32 *pu32Red, uint32 *pu32Green, uint32 *pu32Blue);
+#ifndef VARIANT_MINI
+PUBLIC uint16 u16LC_GetChannelCurrent(uint8 u8Channel);
+PUBLIC uint32 u32LC_PowerBudgetScale(uint32 u32Load);
+#endif
+PUBLIC uint32 u32LC_GetStreamPWM(uint8 u8Channel);
+PUBLIC void vLC_TelemetryTick(void);
 
 /****************************************************************************/
 /***        External Variables                                            ***/
 /****************************************************************************/
 
+extern tsLC_Settings sLC_Settings;
+/* TRUE while the outputs are driven by binary mode stream frames instead of
+ * by the bulb state */
+extern bool_t bLC_Streaming;
+
 #endif /* APP_LC_H */
 
 /****************************************************************************/
@@ -0,0 +1,241 @@
+/*****************************************************************************
+ *
+ * MODULE:             JN-AN-1171
+ *
+ * COMPONENT:          app_light_colourspace.c
+ *
+ * DESCRIPTION:        Conversion between red/green/blue and CIE xy
+ *
+ *
+ ****************************************************************************
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+#include <stdint.h>
+#include <jendefs.h>
+#include "app_light_colourspace.h"
+#include "app_light_calibration.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/* Log table resolution is 1/4095, so linear values below about half of that
+ * are rounded down to 0 */
+#define CS_LINEAR_MIN		8
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+PRIVATE uint32 u32CS_ApplyGamma(uint32 u32Intensity, uint32 u32Gamma);
+
+/****************************************************************************/
+/*          Exported Variables                                              */
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+#include "colour_table.h"
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: vCS_RGBToXY
+ *
+ * DESCRIPTION:
+ * Converts 16 bit red/green/blue values into CIE xy chromaticity (in units
+ * of 1/65536, like the Colour Control cluster) and a peak value, which is
+ * the brightest of the three. Black gives the white point. This divides, so
+ * it is meant to be called once per transition rather than on every tick.
+ ****************************************************************************/
+PUBLIC void vCS_RGBToXY(uint32 u32Red, uint32 u32Green, uint32 u32Blue,
+                        uint32 *pu32X, uint32 *pu32Y, uint32 *pu32Peak)
+{
+	uint32 au32Linear[3];
+	uint32 au32XYZ[3];
+	uint32 u32Peak;
+	uint32 u32Total;
+	uint8 i;
+
+	u32Peak = MAX(u32Red, u32Green);
+	u32Peak = MAX(u32Peak, u32Blue);
+	*pu32Peak = u32Peak;
+	*pu32X = CS_WHITE_X;
+	*pu32Y = CS_WHITE_Y;
+	if (u32Peak == 0)
+	{
+		return;
+	}
+
+	/* Chromaticity only depends on the ratios, so scale the brightest
+	 * channel to full scale before linearising */
+	au32Linear[0] = u32CS_ApplyGamma((u32Red * 65535) / u32Peak, CS_GAMMA);
+	au32Linear[1] = u32CS_ApplyGamma((u32Green * 65535) / u32Peak, CS_GAMMA);
+	au32Linear[2] = u32CS_ApplyGamma((u32Blue * 65535) / u32Peak, CS_GAMMA);
+
+	/* All entries of cs_rgb_to_xyz are positive */
+	for (i = 0; i < 3; i++)
+	{
+		au32XYZ[i] = cs_rgb_to_xyz[i][0] * au32Linear[0]
+		           + cs_rgb_to_xyz[i][1] * au32Linear[1]
+		           + cs_rgb_to_xyz[i][2] * au32Linear[2];
+	}
+	u32Total = au32XYZ[0] + au32XYZ[1] + au32XYZ[2];
+	while (u32Total >= 0x10000)
+	{
+		au32XYZ[0] >>= 1;
+		au32XYZ[1] >>= 1;
+		u32Total >>= 1;
+	}
+	if (u32Total != 0)
+	{
+		*pu32X = MIN((au32XYZ[0] << 16) / u32Total, 0xffff);
+		*pu32Y = MIN((au32XYZ[1] << 16) / u32Total, 0xffff);
+	}
+}
+
+/****************************************************************************
+ * NAME: vCS_XYToRGB
+ *
+ * DESCRIPTION:
+ * Converts CIE xy chromaticity and a peak value from vCS_RGBToXY back into
+ * 16 bit red/green/blue values. This is called on every interpolation tick,
+ * so it only uses multiplies, shifts and table lookups:
+ * - linear RGB comes from a fixed point matrix,
+ * - it is normalised to its brightest channel using cs_recip_table,
+ * - gamma is reapplied using the log and exp tables, and
+ * - the result is scaled by the peak value.
+ ****************************************************************************/
+PUBLIC void vCS_XYToRGB(uint32 u32X, uint32 u32Y, uint32 u32Peak,
+                        uint32 *pu32Red, uint32 *pu32Green, uint32 *pu32Blue)
+{
+	int32 ai32XYZ[3];
+	uint32 au32Linear[3];
+	uint32 u32Max;
+	uint32 u32Recip;
+	uint32 u32Index;
+	uint32 u32Frac;
+	int32 i32Shift = 0;
+	int32 i32Value;
+	uint8 i;
+
+	/* Drop 2 bits so that a matrix row can't overflow */
+	ai32XYZ[0] = (int32)(u32X >> 2);
+	ai32XYZ[1] = (int32)(u32Y >> 2);
+	ai32XYZ[2] = (int32)(MAX((int32)0x10000 - (int32)u32X - (int32)u32Y, 0) >> 2);
+	for (i = 0; i < 3; i++)
+	{
+		i32Value = cs_xyz_to_rgb[i][0] * ai32XYZ[0]
+		         + cs_xyz_to_rgb[i][1] * ai32XYZ[1]
+		         + cs_xyz_to_rgb[i][2] * ai32XYZ[2];
+		au32Linear[i] = (uint32)MAX(i32Value, 0);
+	}
+	u32Max = MAX(au32Linear[0], au32Linear[1]);
+	u32Max = MAX(u32Max, au32Linear[2]);
+	if (u32Max == 0)
+	{
+		*pu32Red = *pu32Green = *pu32Blue = 0;
+		return;
+	}
+
+	/* Normalise the brightest channel into [2^15, 2^16) and look up its
+	 * reciprocal */
+	while (u32Max >= 0x10000)
+	{
+		u32Max >>= 1;
+		i32Shift++;
+	}
+	while (u32Max < 0x8000)
+	{
+		u32Max <<= 1;
+		i32Shift--;
+	}
+	u32Index = (u32Max >> CS_RECIP_SHIFT) - CS_RECIP_TABLE_SIZE;
+	u32Frac = u32Max & ((1 << CS_RECIP_SHIFT) - 1);
+	u32Recip = cs_recip_table[u32Index]
+	         - (((cs_recip_table[u32Index] - cs_recip_table[u32Index + 1]) * u32Frac) >> CS_RECIP_SHIFT);
+
+	for (i = 0; i < 3; i++)
+	{
+		if (i32Shift >= 0)
+		{
+			au32Linear[i] >>= i32Shift;
+		}
+		else
+		{
+			au32Linear[i] <<= -i32Shift;
+		}
+		au32Linear[i] = MIN((au32Linear[i] * u32Recip) >> 14, 0xffff);
+		if (au32Linear[i] < CS_LINEAR_MIN)
+		{
+			au32Linear[i] = 0;
+		}
+		au32Linear[i] = u32CS_ApplyGamma(au32Linear[i], CS_INV_GAMMA);
+		au32Linear[i] = (au32Linear[i] * u32Peak + 0x8000) >> 16;
+	}
+	*pu32Red = au32Linear[0];
+	*pu32Green = au32Linear[1];
+	*pu32Blue = au32Linear[2];
+}
+
+/****************************************************************************/
+/***        Local    Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME:	u32CS_ApplyGamma
+ *
+ * DESCRIPTION:
+ *			Raises a 16 bit intensity to the power u32Gamma (1024 = 1.0),
+ *			in the log domain
+ ****************************************************************************/
+PRIVATE uint32 u32CS_ApplyGamma(uint32 u32Intensity, uint32 u32Gamma)
+{
+	if (u32Intensity == 0)
+	{
+		return 0;
+	}
+	return u16LC_LogToIntensity((u32LC_IntensityToLog((uint16)u32Intensity) * u32Gamma) >> 10);
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
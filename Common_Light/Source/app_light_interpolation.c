@@ -40,39 +40,58 @@
 #include <jendefs.h>
 #include "app_light_interpolation.h"
 #include "DriverBulb.h"
+#include "app_light_calibration.h"
+#include "app_light_colourspace.h"
+#include "app_zcl_light_task.h"
+#include "cct_table.h"
 
 /****************************************************************************/
 /***        Macro Definitions                                             ***/
 /****************************************************************************/
-#define INTPOINTS	(10)
-#define SCALE 		(7)
+#define SCALE 		(8)
+
+/* Conversion of ZCL values into the 16 bit intensities used by the drivers.
+ * Maximum ZCL level and colour component both map to full scale. */
+#define LI_LEVEL_TO_16BIT(x)	(((x) >= CLD_LEVELCONTROL_MAX_LEVEL) ? 0xffff : ((x) * 258))
+#define LI_COLOUR_TO_16BIT(x)	(MIN((x), 255) * 257)
+
+/* Interpolated parameters of a bulb */
+#define LI_LEVEL		(0)
+#define LI_RED			(1)
+#define LI_GREEN		(2)
+#define LI_BLUE			(3)
+/* In xy mode the colour parameters hold x, y and the peak channel value */
+#define LI_X			LI_RED
+#define LI_Y			LI_GREEN
+#define LI_PEAK			LI_BLUE
+#define LI_COLTEMP		(4)
+#define LI_NUM_PARAMS	(5)
+
+#define LI_BULB_MASK(x)	(1UL << (x))
+
+/* Colour temperature is interpolated in mireds with SCALE fractional bits.
+ * Table entries are a power of two apart, so lookups need no division. */
+#define LI_CCT_FRAC_BITS	(CCT_MIRED_SHIFT + SCALE)
+#define LI_CCT_LERP(lo, hi, frac)	((uint32)((int32)(lo) + ((((int32)(hi) - (int32)(lo)) * (frac)) >> LI_CCT_FRAC_BITS)))
 
 /****************************************************************************/
 /***        Type Definitions                                              ***/
 /****************************************************************************/
-typedef struct
-{
-	uint32 u32Current;
-	uint32 u32Target;
-	int32  i32Delta;
-}tsLI_Params;
-
-typedef struct
-{
-	tsLI_Params sLevel;
-	tsLI_Params sRed;
-	tsLI_Params sGreen;
-	tsLI_Params sBlue;
-	tsLI_Params sColTemp;
-	uint32      u32PointsAdded;
-
-}tsLI_Vars;
 
 /****************************************************************************/
 /***        Local Function Prototypes                                     ***/
 /****************************************************************************/
 
-PRIVATE void vLI_InitVar(tsLI_Params *psLI_Params, uint32 u32NewTarget);
+PRIVATE void vLI_InitVar(uint8 u8Bulb, uint8 u8Param, uint32 u32NewTarget, uint32 u32Steps);
+PRIVATE void vLI_SetVar(uint8 u8Bulb, uint8 u8Param, uint32 u32Value);
+PRIVATE void vLI_StepBulb(uint8 u8Bulb);
+PRIVATE void vLI_ColTempToRGB(uint32 u32ColTemp, uint32 *pu32Red, uint32 *pu32Green, uint32 *pu32Blue);
+PRIVATE void vLI_SelectLevelDomain(uint8 u8Bulb);
+PRIVATE uint32 u32LI_LevelToParam(uint8 u8Bulb, uint32 u32Level);
+PRIVATE uint32 u32LI_GetLevel(uint8 u8Bulb);
+PRIVATE void vLI_SelectColourDomain(uint8 u8Bulb);
+PRIVATE void vLI_ColourToParams(uint8 u8Bulb, uint32 *pu32Red, uint32 *pu32Green, uint32 *pu32Blue);
+PRIVATE void vLI_GetColour(uint8 u8Bulb, uint32 *pu32Red, uint32 *pu32Green, uint32 *pu32Blue);
 PRIVATE uint32  u32divu10(uint32 n);
 
 /****************************************************************************/
@@ -83,7 +102,28 @@ PRIVATE uint32  u32divu10(uint32 n);
 /***        Local Variables                                               ***/
 /****************************************************************************/
 
-PRIVATE tsLI_Vars sLI_Vars[NUM_BULBS];
+/* Interpolation state is kept as one array per field, so the tick only
+ * touches the fields of bulbs which are actually in transition */
+PRIVATE uint32 au32Current[LI_NUM_PARAMS][NUM_BULBS];
+PRIVATE uint32 au32Target[LI_NUM_PARAMS][NUM_BULBS];
+PRIVATE int32  ai32Delta[LI_NUM_PARAMS][NUM_BULBS];
+PRIVATE uint32 au32StepsLeft[LI_NUM_PARAMS][NUM_BULBS];
+/* The distance of a transition is rarely a multiple of its number of steps.
+ * au32Remainder holds what is left over after dividing, au32Steps the number
+ * of steps, and au32ErrorAcc accumulates the remainder Bresenham style, so
+ * that the extra units are spread evenly over the transition. */
+PRIVATE uint32 au32Remainder[LI_NUM_PARAMS][NUM_BULBS];
+PRIVATE uint32 au32Steps[LI_NUM_PARAMS][NUM_BULBS];
+PRIVATE uint32 au32ErrorAcc[LI_NUM_PARAMS][NUM_BULBS];
+
+/* Bit n is set while bulb n has a transition in progress */
+PRIVATE uint32 u32ActiveMask;
+
+/* Bit n is set while the level of bulb n is held in the log domain */
+PRIVATE uint32 u32LogLevelMask;
+
+/* Bit n is set while the colour of bulb n is held as CIE xy */
+PRIVATE uint32 u32XYColourMask;
 
 /****************************************************************************/
 /***        Exported Functions                                            ***/
@@ -93,16 +133,22 @@ PRIVATE tsLI_Vars sLI_Vars[NUM_BULBS];
  * NAME: vLI_SetCurrentValues
  *
  * DESCRIPTION:
- * Sets the current interpolation values
+ * Sets the current interpolation values, cancelling any transition
  ****************************************************************************/
 PUBLIC void vLI_SetCurrentValues(uint8 u8Bulb, uint32 u32Level, uint32 u32Red, uint32 u32Green, uint32 u32Blue, uint32 u32ColTemp)
 {
-	sLI_Vars[u8Bulb].sLevel.u32Current   += u32Level   << SCALE;
-	sLI_Vars[u8Bulb].sRed.u32Current     += u32Red     << SCALE;
-	sLI_Vars[u8Bulb].sGreen.u32Current   += u32Blue    << SCALE;
-    sLI_Vars[u8Bulb].sBlue.u32Current    += u32Green   << SCALE;
-    sLI_Vars[u8Bulb].sColTemp.u32Current += u32ColTemp << SCALE;
-
+	vLI_SelectLevelDomain(u8Bulb);
+	vLI_SelectColourDomain(u8Bulb);
+	u32Red   = LI_COLOUR_TO_16BIT(u32Red);
+	u32Green = LI_COLOUR_TO_16BIT(u32Green);
+	u32Blue  = LI_COLOUR_TO_16BIT(u32Blue);
+	vLI_ColourToParams(u8Bulb, &u32Red, &u32Green, &u32Blue);
+	vLI_SetVar(u8Bulb, LI_LEVEL,   u32LI_LevelToParam(u8Bulb, LI_LEVEL_TO_16BIT(u32Level)));
+	vLI_SetVar(u8Bulb, LI_RED,     u32Red);
+	vLI_SetVar(u8Bulb, LI_GREEN,   u32Green);
+	vLI_SetVar(u8Bulb, LI_BLUE,    u32Blue);
+	vLI_SetVar(u8Bulb, LI_COLTEMP, u32ColTemp);
+	u32ActiveMask &= ~LI_BULB_MASK(u8Bulb);
 }
 
 /****************************************************************************
@@ -113,40 +159,152 @@ PUBLIC void vLI_SetCurrentValues(uint8 u8Bulb, uint32 u32Level, uint32 u32Red, u
  ****************************************************************************/
 PUBLIC void vLI_Start(uint8 u8Bulb, uint32 u32Level, uint32 u32Red, uint32 u32Green, uint32 u32Blue, uint32 u32ColTemp)
 {
-	vLI_InitVar(&(sLI_Vars[u8Bulb].sLevel),    u32Level);
-	vLI_InitVar(&(sLI_Vars[u8Bulb].sRed),      u32Red);
-	vLI_InitVar(&(sLI_Vars[u8Bulb].sGreen),    u32Green);
-    vLI_InitVar(&(sLI_Vars[u8Bulb].sBlue),     u32Blue);
-    vLI_InitVar(&(sLI_Vars[u8Bulb].sColTemp),  u32ColTemp);
-    vLI_UpdateDriver(u8Bulb);
-    sLI_Vars[u8Bulb].u32PointsAdded  = 1;
+	vLI_StartLevel(u8Bulb, u32Level, LI_TICKS_PER_100MS);
+	vLI_StartColour(u8Bulb, u32Red, u32Green, u32Blue, u32ColTemp, LI_TICKS_PER_100MS);
+}
+
+/****************************************************************************
+ * NAME: vLI_StartLevel
+ *
+ * DESCRIPTION:
+ * Starts a level transition that reaches u32Level after u32Steps ticks.
+ * Colour components are left untouched, so a long level fade can carry on
+ * while colour keeps following the ZCL updates. A step count of 0 jumps
+ * straight to the target.
+ *
+ * Bulbs selected in sLC_Settings.u32LogFadeMask ramp the log of the level
+ * instead, so that perceived brightness changes evenly. If the tick is
+ * idling until the next 100ms update, it is woken for the next 10ms tick.
+ ****************************************************************************/
+PUBLIC void vLI_StartLevel(uint8 u8Bulb, uint32 u32Level, uint32 u32Steps)
+{
+	vLI_SelectLevelDomain(u8Bulb);
+	vLI_InitVar(u8Bulb, LI_LEVEL, u32LI_LevelToParam(u8Bulb, LI_LEVEL_TO_16BIT(u32Level)), u32Steps);
+	if (u32Steps == 0)
+	{
+		vLI_UpdateDriver(u8Bulb);
+	}
+	APP_ZCL_vWakeTick();
+}
+
+/****************************************************************************
+ * NAME: vLI_StartColour
+ *
+ * DESCRIPTION:
+ * Starts a colour transition that reaches the given colour after u32Steps
+ * ticks. A step count of 0 jumps straight to the target.
+ *
+ * A non-zero u32ColTemp (in mireds) selects colour temperature mode: the
+ * colour temperature is interpolated and the red, green and blue values are
+ * ignored. There is no path along the black body locus from an arbitrary
+ * colour, so entering colour temperature mode jumps to the new colour
+ * temperature. Leaving it starts from the colour temperature's RGB values.
+ *
+ * Bulbs selected in sLC_Settings.u32XYFadeMask interpolate CIE xy
+ * chromaticity and peak channel value instead of red, green and blue, so
+ * that hue changes sweep through saturated colours. As with a level
+ * transition, an idle tick is woken.
+ ****************************************************************************/
+PUBLIC void vLI_StartColour(uint8 u8Bulb, uint32 u32Red, uint32 u32Green, uint32 u32Blue, uint32 u32ColTemp, uint32 u32Steps)
+{
+	uint32 u32CurrentColTemp = au32Current[LI_COLTEMP][u8Bulb];
+	uint32 au32Colour[3];
+
+	vLI_SelectColourDomain(u8Bulb);
+	if ((u32ColTemp != 0) && (u32CurrentColTemp == 0))
+	{
+		vLI_SetVar(u8Bulb, LI_COLTEMP, u32ColTemp);
+	}
+	else if ((u32ColTemp == 0) && (u32CurrentColTemp != 0))
+	{
+		vLI_GetColour(u8Bulb, &au32Colour[0], &au32Colour[1], &au32Colour[2]);
+		vLI_ColourToParams(u8Bulb, &au32Colour[0], &au32Colour[1], &au32Colour[2]);
+		vLI_SetVar(u8Bulb, LI_RED,     au32Colour[0]);
+		vLI_SetVar(u8Bulb, LI_GREEN,   au32Colour[1]);
+		vLI_SetVar(u8Bulb, LI_BLUE,    au32Colour[2]);
+		vLI_SetVar(u8Bulb, LI_COLTEMP, 0);
+	}
+	au32Colour[0] = LI_COLOUR_TO_16BIT(u32Red);
+	au32Colour[1] = LI_COLOUR_TO_16BIT(u32Green);
+	au32Colour[2] = LI_COLOUR_TO_16BIT(u32Blue);
+	vLI_ColourToParams(u8Bulb, &au32Colour[0], &au32Colour[1], &au32Colour[2]);
+	vLI_InitVar(u8Bulb, LI_RED,     au32Colour[0], u32Steps);
+	vLI_InitVar(u8Bulb, LI_GREEN,   au32Colour[1], u32Steps);
+	vLI_InitVar(u8Bulb, LI_BLUE,    au32Colour[2], u32Steps);
+	vLI_InitVar(u8Bulb, LI_COLTEMP, u32ColTemp, u32Steps);
+	if (u32Steps == 0)
+	{
+		vLI_UpdateDriver(u8Bulb);
+	}
+	APP_ZCL_vWakeTick();
 }
 
+/****************************************************************************
+ * NAME: vLI_Stop
+ *
+ * DESCRIPTION:
+ * Freezes all transitions of a bulb at their current values
+ ****************************************************************************/
 PUBLIC void vLI_Stop(uint8 u8Bulb)
 {
-    sLI_Vars[u8Bulb].u32PointsAdded = INTPOINTS;
+	uint8 u8Param;
+
+	for (u8Param = 0; u8Param < LI_NUM_PARAMS; u8Param++)
+	{
+		au32StepsLeft[u8Param][u8Bulb] = 0;
+	}
+	u32ActiveMask &= ~LI_BULB_MASK(u8Bulb);
 }
 
 /****************************************************************************
- * NAME: vLI_CreatePoints
+ * NAME: bLI_LevelTransitionActive
  *
  * DESCRIPTION:
- * Provides multiple LI points in time/value pairs between
- * successive  ZCL updates.  This provides smooth 100Hz updates
- * on colour and level transitions
+ * Returns TRUE while a level transition is still in progress
  ****************************************************************************/
-PUBLIC void vLI_CreatePoints(uint8 u8Bulb)
+PUBLIC bool_t bLI_LevelTransitionActive(uint8 u8Bulb)
 {
-    if (sLI_Vars[u8Bulb].u32PointsAdded < INTPOINTS)
-    {
-    	sLI_Vars[u8Bulb].u32PointsAdded++;
-        sLI_Vars[u8Bulb].sLevel.u32Current   += sLI_Vars[u8Bulb].sLevel.i32Delta;
-        sLI_Vars[u8Bulb].sRed.u32Current     += sLI_Vars[u8Bulb].sRed.i32Delta;
-        sLI_Vars[u8Bulb].sGreen.u32Current   += sLI_Vars[u8Bulb].sGreen.i32Delta;
-        sLI_Vars[u8Bulb].sBlue.u32Current    += sLI_Vars[u8Bulb].sBlue.i32Delta;
-        sLI_Vars[u8Bulb].sColTemp.u32Current += sLI_Vars[u8Bulb].sColTemp.i32Delta;
-        vLI_UpdateDriver(u8Bulb);
-    }
+	return (au32StepsLeft[LI_LEVEL][u8Bulb] != 0);
+}
+
+/****************************************************************************
+ * NAME: bLI_AnyTransitionActive
+ *
+ * DESCRIPTION:
+ * Returns TRUE while any bulb has a transition in progress, i.e. while
+ * vLI_Tick needs to be called every tick
+ ****************************************************************************/
+PUBLIC bool_t bLI_AnyTransitionActive(void)
+{
+	return (u32ActiveMask != 0);
+}
+
+/****************************************************************************
+ * NAME: vLI_Tick
+ *
+ * DESCRIPTION:
+ * Advances the transitions of all bulbs by one tick. This is called from
+ * the 100Hz tick, so transitions of any length are rendered as one
+ * continuous ramp which lands exactly on its target. Bulbs that are not in
+ * transition are skipped without touching their state.
+ ****************************************************************************/
+PUBLIC void vLI_Tick(void)
+{
+	uint32 u32Mask;
+	uint8 u8Bulb;
+
+	/* Collect the changes of all bulbs, so that the driver writes each
+	 * output once per tick */
+	DriverBulb_vBeginFrame();
+	u32Mask = u32ActiveMask;
+	for (u8Bulb = 0; u32Mask != 0; u8Bulb++, u32Mask >>= 1)
+	{
+		if (u32Mask & 1)
+		{
+			vLI_StepBulb(u8Bulb);
+		}
+	}
+	DriverBulb_vCommitFrame();
 }
 
 /****************************************************************************
@@ -154,16 +312,20 @@ PUBLIC void vLI_CreatePoints(uint8 u8Bulb)
  *
  * DESCRIPTION:
  *			passes the LI points between previous and current
- *			ZCL updates to the colour driver for smooth transitions
+ *			ZCL updates to the colour driver for smooth transitions.
+ *			Level and colour are passed with 16 bit resolution.
  ****************************************************************************/
 PUBLIC void vLI_UpdateDriver(uint8 u8Bulb)
 {
-	DriverBulb_vSetColour(u8Bulb,
-			              sLI_Vars[u8Bulb].sRed.u32Current   >> SCALE,
-			              sLI_Vars[u8Bulb].sGreen.u32Current >> SCALE,
-			              sLI_Vars[u8Bulb].sBlue.u32Current  >> SCALE);
+	uint32 u32Red, u32Green, u32Blue;
+
+	DriverBulb_vBeginFrame();
+	vLI_GetColour(u8Bulb, &u32Red, &u32Green, &u32Blue);
+	vLC_CorrectColour(u8Bulb, &u32Red, &u32Green, &u32Blue);
+	DriverBulb_vSetColour(u8Bulb, u32Red, u32Green, u32Blue);
 
-	DriverBulb_vSetLevel(u8Bulb, sLI_Vars[u8Bulb].sLevel.u32Current  >> SCALE);
+	DriverBulb_vSetLevel(u8Bulb, u32LI_GetLevel(u8Bulb));
+	DriverBulb_vCommitFrame();
 }
 
 /****************************************************************************/
@@ -176,21 +338,275 @@ PUBLIC void vLI_UpdateDriver(uint8 u8Bulb)
  * DESCRIPTION:
  *	 		Initialises a single LI variable to the output(s) from
  *	        ZCL cluster, converts to big integer and calculates the adjustment
- *	        needed on each of the successive LI points
+ *	        needed on each of the u32Steps successive LI points, as a
+ *	        quotient and a remainder which are added exactly u32Steps times
+ ****************************************************************************/
+PRIVATE void vLI_InitVar(uint8 u8Bulb, uint8 u8Param, uint32 u32NewTarget, uint32 u32Steps)
+{
+	uint32 u32Current = au32Current[u8Param][u8Bulb];
+	uint32 u32Target = u32NewTarget << SCALE;
+	uint32 u32Diff;
+	uint32 u32Quotient;
+
+	au32Target[u8Param][u8Bulb] = u32Target;
+
+	if ((u32Steps == 0) || (u32Target == u32Current))
+	{
+		au32Current[u8Param][u8Bulb] = u32Target;
+		au32StepsLeft[u8Param][u8Bulb] = 0;
+		return;
+	}
+
+	if (u32Target < u32Current)
+	{
+		u32Diff = u32Current - u32Target;
+	}
+	else
+	{
+		u32Diff = u32Target - u32Current;
+	}
+	/* Updates from the ZCL tick are by far the most common case, so avoid
+	 * the slow generic divide for those */
+	if (u32Steps == LI_TICKS_PER_100MS)
+	{
+		u32Quotient = u32divu10(u32Diff);
+	}
+	else
+	{
+		u32Quotient = u32Diff / u32Steps;
+	}
+	if (u32Target < u32Current)
+	{
+		ai32Delta[u8Param][u8Bulb] = -(int32)u32Quotient;
+	}
+	else
+	{
+		ai32Delta[u8Param][u8Bulb] = (int32)u32Quotient;
+	}
+	au32Remainder[u8Param][u8Bulb] = u32Diff - u32Quotient * u32Steps;
+	au32Steps[u8Param][u8Bulb]     = u32Steps;
+	au32ErrorAcc[u8Param][u8Bulb]  = 0;
+	au32StepsLeft[u8Param][u8Bulb] = u32Steps;
+	u32ActiveMask |= LI_BULB_MASK(u8Bulb);
+}
+
+/****************************************************************************
+ * NAME:	vLI_SetVar
+ *
+ * DESCRIPTION:
+ *	 		Sets a single LI variable without any transition
+ ****************************************************************************/
+PRIVATE void vLI_SetVar(uint8 u8Bulb, uint8 u8Param, uint32 u32Value)
+{
+	au32Current[u8Param][u8Bulb]   = u32Value << SCALE;
+	au32Target[u8Param][u8Bulb]    = au32Current[u8Param][u8Bulb];
+	ai32Delta[u8Param][u8Bulb]     = 0;
+	au32StepsLeft[u8Param][u8Bulb] = 0;
+}
+
+/****************************************************************************
+ * NAME:	vLI_StepBulb
+ *
+ * DESCRIPTION:
+ *	 		Advances every LI variable of a bulb by one point and passes
+ *	 		the result to the driver. Each point adds the quotient, plus one
+ *	 		whenever the accumulated remainder reaches the number of steps,
+ *	 		so the last point lands exactly on the target. The snap on the
+ *	 		last point only guards against the state being changed under
+ *	 		a running transition. The bulb leaves the active mask once all
+ *	 		of its variables have arrived.
+ ****************************************************************************/
+PRIVATE void vLI_StepBulb(uint8 u8Bulb)
+{
+	uint8 u8Param;
+	bool_t bActive = FALSE;
+
+	for (u8Param = 0; u8Param < LI_NUM_PARAMS; u8Param++)
+	{
+		if (au32StepsLeft[u8Param][u8Bulb] != 0)
+		{
+			if (--au32StepsLeft[u8Param][u8Bulb] == 0)
+			{
+				au32Current[u8Param][u8Bulb] = au32Target[u8Param][u8Bulb];
+			}
+			else
+			{
+				au32Current[u8Param][u8Bulb] += ai32Delta[u8Param][u8Bulb];
+				au32ErrorAcc[u8Param][u8Bulb] += au32Remainder[u8Param][u8Bulb];
+				if (au32ErrorAcc[u8Param][u8Bulb] >= au32Steps[u8Param][u8Bulb])
+				{
+					au32ErrorAcc[u8Param][u8Bulb] -= au32Steps[u8Param][u8Bulb];
+					if (au32Target[u8Param][u8Bulb] > au32Current[u8Param][u8Bulb])
+					{
+						au32Current[u8Param][u8Bulb]++;
+					}
+					else
+					{
+						au32Current[u8Param][u8Bulb]--;
+					}
+				}
+				bActive = TRUE;
+			}
+		}
+	}
+	if (!bActive)
+	{
+		u32ActiveMask &= ~LI_BULB_MASK(u8Bulb);
+	}
+	vLI_UpdateDriver(u8Bulb);
+}
+
+/****************************************************************************
+ * NAME:	vLI_ColTempToRGB
+ *
+ * DESCRIPTION:
+ *	 		Converts a colour temperature (mireds, with SCALE fractional
+ *	 		bits) into 16 bit red, green and blue values by interpolating
+ *	 		between the two nearest CCT table entries. Colour temperatures
+ *	 		outside the table are clamped to its ends.
  ****************************************************************************/
-PRIVATE void vLI_InitVar(tsLI_Params *psLI_Params, uint32 u32NewTarget)
+PRIVATE void vLI_ColTempToRGB(uint32 u32ColTemp, uint32 *pu32Red, uint32 *pu32Green, uint32 *pu32Blue)
 {
-	psLI_Params->u32Target = u32NewTarget << SCALE;
+	const uint16_t *pu16Lo;
+	const uint16_t *pu16Hi;
+	uint32 u32Offset;
+	uint32 u32Index;
+	int32 i32Frac;
+
+	u32ColTemp = MAX(u32ColTemp, (uint32)CCT_MIRED_MIN << SCALE);
+	u32ColTemp = MIN(u32ColTemp, (uint32)CCT_MIRED_MAX << SCALE);
+	u32Offset = u32ColTemp - ((uint32)CCT_MIRED_MIN << SCALE);
+	i32Frac = (int32)(u32Offset & ((1UL << LI_CCT_FRAC_BITS) - 1));
+	u32Index = u32Offset >> LI_CCT_FRAC_BITS;
+	pu16Lo = cct_table[u32Index];
+	pu16Hi = cct_table[u32Index + 1];
 
-	if (psLI_Params->u32Target < psLI_Params->u32Current)
+	*pu32Red   = LI_CCT_LERP(pu16Lo[0], pu16Hi[0], i32Frac);
+	*pu32Green = LI_CCT_LERP(pu16Lo[1], pu16Hi[1], i32Frac);
+	*pu32Blue  = LI_CCT_LERP(pu16Lo[2], pu16Hi[2], i32Frac);
+}
+
+/****************************************************************************
+ * NAME:	vLI_SelectLevelDomain
+ *
+ * DESCRIPTION:
+ *	 		Switches the level of a bulb between the linear and the log
+ *	 		domain when sLC_Settings.u32LogFadeMask has changed. The current
+ *	 		level is converted and any level transition is cancelled, which
+ *	 		is fine because a new one is about to be started.
+ ****************************************************************************/
+PRIVATE void vLI_SelectLevelDomain(uint8 u8Bulb)
+{
+	uint32 u32Level;
+
+	if (((sLC_Settings.u32LogFadeMask ^ u32LogLevelMask) & LI_BULB_MASK(u8Bulb)) == 0)
+	{
+		return;
+	}
+	u32Level = u32LI_GetLevel(u8Bulb);
+	u32LogLevelMask ^= LI_BULB_MASK(u8Bulb);
+	vLI_SetVar(u8Bulb, LI_LEVEL, u32LI_LevelToParam(u8Bulb, u32Level));
+}
+
+/****************************************************************************
+ * NAME:	u32LI_LevelToParam
+ *
+ * DESCRIPTION:
+ *	 		Converts a 16 bit level into the domain the bulb's level is
+ *	 		interpolated in
+ ****************************************************************************/
+PRIVATE uint32 u32LI_LevelToParam(uint8 u8Bulb, uint32 u32Level)
+{
+	if (u32LogLevelMask & LI_BULB_MASK(u8Bulb))
+	{
+		return u32LC_IntensityToLog((uint16)u32Level);
+	}
+	return u32Level;
+}
+
+/****************************************************************************
+ * NAME:	u32LI_GetLevel
+ *
+ * DESCRIPTION:
+ *	 		Gets the current 16 bit level of a bulb. For log domain bulbs
+ *	 		this is one exp_table lookup.
+ ****************************************************************************/
+PRIVATE uint32 u32LI_GetLevel(uint8 u8Bulb)
+{
+	if (u32LogLevelMask & LI_BULB_MASK(u8Bulb))
+	{
+		return u16LC_LogToIntensity(au32Current[LI_LEVEL][u8Bulb] >> SCALE);
+	}
+	return au32Current[LI_LEVEL][u8Bulb] >> SCALE;
+}
+
+/****************************************************************************
+ * NAME:	vLI_SelectColourDomain
+ *
+ * DESCRIPTION:
+ *	 		Switches the colour of a bulb between red/green/blue and CIE xy
+ *	 		when sLC_Settings.u32XYFadeMask has changed. The current colour
+ *	 		is converted and any colour transition is cancelled, which is
+ *	 		fine because a new one is about to be started.
+ ****************************************************************************/
+PRIVATE void vLI_SelectColourDomain(uint8 u8Bulb)
+{
+	uint32 au32Colour[3];
+
+	if (((sLC_Settings.u32XYFadeMask ^ u32XYColourMask) & LI_BULB_MASK(u8Bulb)) == 0)
+	{
+		return;
+	}
+	vLI_GetColour(u8Bulb, &au32Colour[0], &au32Colour[1], &au32Colour[2]);
+	u32XYColourMask ^= LI_BULB_MASK(u8Bulb);
+	vLI_ColourToParams(u8Bulb, &au32Colour[0], &au32Colour[1], &au32Colour[2]);
+	vLI_SetVar(u8Bulb, LI_RED,   au32Colour[0]);
+	vLI_SetVar(u8Bulb, LI_GREEN, au32Colour[1]);
+	vLI_SetVar(u8Bulb, LI_BLUE,  au32Colour[2]);
+}
+
+/****************************************************************************
+ * NAME:	vLI_ColourToParams
+ *
+ * DESCRIPTION:
+ *	 		Converts 16 bit red/green/blue values in place into the domain
+ *	 		the bulb's colour is interpolated in
+ ****************************************************************************/
+PRIVATE void vLI_ColourToParams(uint8 u8Bulb, uint32 *pu32Red, uint32 *pu32Green, uint32 *pu32Blue)
+{
+	if (u32XYColourMask & LI_BULB_MASK(u8Bulb))
+	{
+		vCS_RGBToXY(*pu32Red, *pu32Green, *pu32Blue, pu32Red, pu32Green, pu32Blue);
+	}
+}
+
+/****************************************************************************
+ * NAME:	vLI_GetColour
+ *
+ * DESCRIPTION:
+ *	 		Gets the current 16 bit red/green/blue values of a bulb. In
+ *	 		colour temperature mode these come from the CCT table, in xy
+ *	 		mode from a colour space conversion.
+ ****************************************************************************/
+PRIVATE void vLI_GetColour(uint8 u8Bulb, uint32 *pu32Red, uint32 *pu32Green, uint32 *pu32Blue)
+{
+	if (au32Current[LI_COLTEMP][u8Bulb] != 0)
+	{
+		vLI_ColTempToRGB(au32Current[LI_COLTEMP][u8Bulb], pu32Red, pu32Green, pu32Blue);
+	}
+	else if (u32XYColourMask & LI_BULB_MASK(u8Bulb))
 	{
-		psLI_Params->i32Delta = -(u32divu10(psLI_Params->u32Current - psLI_Params->u32Target));
+		vCS_XYToRGB(au32Current[LI_X][u8Bulb]    >> SCALE,
+		            au32Current[LI_Y][u8Bulb]    >> SCALE,
+		            au32Current[LI_PEAK][u8Bulb] >> SCALE,
+		            pu32Red, pu32Green, pu32Blue);
 	}
 	else
 	{
-		psLI_Params->i32Delta = u32divu10(psLI_Params->u32Target - psLI_Params->u32Current);;
+		*pu32Red   = au32Current[LI_RED][u8Bulb]   >> SCALE;
+		*pu32Green = au32Current[LI_GREEN][u8Bulb] >> SCALE;
+		*pu32Blue  = au32Current[LI_BLUE][u8Bulb]  >> SCALE;
 	}
-	psLI_Params->u32Current += psLI_Params->i32Delta;
 }
 
 /****************************************************************************
@@ -40,6 +40,10 @@
 /***        Macro Definitions                                             ***/
 /****************************************************************************/
 
+/* Number of interpolation ticks (10 ms each) per ZCL update and per unit of
+ * ZCL transition time (1/10 s) */
+#define LI_TICKS_PER_100MS	(10)
+
 /****************************************************************************/
 /***        Type Definitions                                              ***/
 /****************************************************************************/
@@ -50,8 +54,12 @@
 
 PUBLIC void vLI_SetCurrentValues(uint8 u8Bulb, uint32 u32Level, uint32 u32Red, uint32 u32Green, uint32 u32Blue, uint32 u32ColTemp);
 PUBLIC void vLI_Start(uint8 u8Bulb, uint32 u32Level,uint32 u32Red, uint32 u32Green, uint32 u32Blue, uint32 u32ColTemp);
+PUBLIC void vLI_StartLevel(uint8 u8Bulb, uint32 u32Level, uint32 u32Steps);
+PUBLIC void vLI_StartColour(uint8 u8Bulb, uint32 u32Red, uint32 u32Green, uint32 u32Blue, uint32 u32ColTemp, uint32 u32Steps);
 PUBLIC void vLI_Stop(uint8 u8Bulb);
-PUBLIC void vLI_CreatePoints(uint8 u8Bulb);
+PUBLIC bool_t bLI_LevelTransitionActive(uint8 u8Bulb);
+PUBLIC bool_t bLI_AnyTransitionActive(void);
+PUBLIC void vLI_Tick(void);
 PUBLIC void vLI_UpdateDriver(uint8 u8Bulb);
 
 /****************************************************************************/
@@ -205,12 +205,12 @@ PUBLIC void vAppMain(void)
 		bool bIsRGB = (i >= NUM_MONO_LIGHTS);
 		if (bIsRGB && (u32ComputedWhiteMode == COMPUTED_WHITE_BETTER_COLOR))
 		{
-			vLI_SetCurrentValues(i, 0, 0, 0, 0, 4000);
+			vLI_SetCurrentValues(i, 0, 0, 0, 0, 0);
 			DriverBulb_vOff(i);
 		}
 		else
 		{
-			vLI_SetCurrentValues(i, CLD_LEVELCONTROL_MAX_LEVEL, 255, 255, 255, 4000);
+			vLI_SetCurrentValues(i, CLD_LEVELCONTROL_MAX_LEVEL, 255, 255, 255, 0);
 			DriverBulb_vOn(i);
 		}
 		vLI_UpdateDriver(i);
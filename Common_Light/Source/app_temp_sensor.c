@@ -52,6 +52,12 @@
 /***        Macro Definitions                                             ***/
 /****************************************************************************/
 
+/* Number of fractional bits in i32TS_GetTemperatureFixed() */
+#define TEMPERATURE_FRAC_BITS				8
+/* The filtered temperature moves 1/2^TEMPERATURE_FILTER_SHIFT of the way
+ * towards the measured temperature every 100ms, a time constant of 6.4s */
+#define TEMPERATURE_FILTER_SHIFT			6
+
 /****************************************************************************/
 /***        Type Definitions                                              ***/
 /****************************************************************************/
@@ -59,6 +65,7 @@
 /****************************************************************************/
 /***        Local Function Prototypes                                     ***/
 /****************************************************************************/
+PRIVATE int32 i32TS_GetTemperatureFixed(void);
 
 /****************************************************************************/
 /*          Exported Variables                                              */
@@ -66,6 +73,8 @@
 
 /* This will be set to TRUE iff the board is overheating */
 volatile bool_t bOverheat;
+/* Multiplier for the output of all lights, TS_DERATING_ONE = full output */
+volatile uint32 u32TS_Derating = TS_DERATING_ONE;
 
 /****************************************************************************/
 /***        Local Variables                                               ***/
@@ -74,6 +83,9 @@ volatile bool_t bOverheat;
 #include "temperature_table.h"
 /* Most recent accumulated ADC reading */
 volatile uint16 u16AccumulatedADC;
+/* Filtered temperature, in degrees Celsius with 16 fractional bits */
+PRIVATE int32 i32FilteredTemperature;
+PRIVATE bool_t bFilterStarted = FALSE;
 
 /****************************************************************************/
 /***        Exported Functions                                            ***/
@@ -133,18 +145,90 @@ OS_ISR(APP_isrAdc)
  * Get board temperature, in degrees Celsius
  ****************************************************************************/
 PUBLIC int16 i16TS_GetTemperature(void)
+{
+	int32 i32Temperature;
+
+	i32Temperature = i32TS_GetTemperatureFixed();
+	return (int16)((i32Temperature + (1 << (TEMPERATURE_FRAC_BITS - 1))) >> TEMPERATURE_FRAC_BITS);
+}
+
+/****************************************************************************
+ * NAME: bTS_UpdateDerating
+ *
+ * DESCRIPTION:
+ * Filters the board temperature and works out u32TS_Derating from it. This
+ * should be called every 100ms. The drivers apply u32TS_Derating whenever
+ * they calculate a PWM value, so if this returns TRUE the caller should
+ * refresh the output of all bulbs.
+ *
+ * RETURNS:
+ * TRUE if u32TS_Derating has changed, FALSE if not
+ ****************************************************************************/
+PUBLIC bool_t bTS_UpdateDerating(void)
+{
+	int32 i32Temperature;
+	uint32 u32Derating;
+
+	i32Temperature = i32TS_GetTemperatureFixed() << (16 - TEMPERATURE_FRAC_BITS);
+	if (!bFilterStarted)
+	{
+		i32FilteredTemperature = i32Temperature;
+		bFilterStarted = TRUE;
+	}
+	else
+	{
+		i32FilteredTemperature += (i32Temperature - i32FilteredTemperature) >> TEMPERATURE_FILTER_SHIFT;
+	}
+
+	/* Compare in degrees Celsius with 8 fractional bits, so that the
+	 * division below can't overflow */
+	i32Temperature = i32FilteredTemperature >> 8;
+	if (i32Temperature <= (TEMPERATURE_DERATE_START << 8))
+	{
+		u32Derating = TS_DERATING_ONE;
+	}
+	else if (i32Temperature >= (TEMPERATURE_OVERHEAT_CUTOFF << 8))
+	{
+		u32Derating = 0;
+	}
+	else
+	{
+		u32Derating = ((uint32)((TEMPERATURE_OVERHEAT_CUTOFF << 8) - i32Temperature) << TS_DERATING_FRAC_BITS)
+				/ ((TEMPERATURE_OVERHEAT_CUTOFF - TEMPERATURE_DERATE_START) << 8);
+	}
+
+	if (u32Derating == u32TS_Derating)
+	{
+		return FALSE;
+	}
+	u32TS_Derating = u32Derating;
+	return TRUE;
+}
+
+/****************************************************************************/
+/***        Local    Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ * NAME: i32TS_GetTemperatureFixed
+ *
+ * DESCRIPTION:
+ * Get board temperature, in degrees Celsius with TEMPERATURE_FRAC_BITS
+ * fractional bits, interpolating between the entries of temperature_lookup
+ ****************************************************************************/
+PRIVATE int32 i32TS_GetTemperatureFixed(void)
 {
 	uint32 left_index;
 	uint32 right_index;
 	uint32 diff_left;
-	uint32 diff_right;
+	uint32 span;
 	uint32 adc;
 
 	adc = u16AccumulatedADC;
 	if (adc > temperature_lookup[0])
 		return 0;
 	if (adc < temperature_lookup[TEMPERATURE_LOOKUP_LENGTH - 1])
-		return TEMPERATURE_LOOKUP_LENGTH - 1;
+		return (TEMPERATURE_LOOKUP_LENGTH - 1) << TEMPERATURE_FRAC_BITS;
 	/* Binary search through temperature_lookup */
 	left_index = 0;
 	right_index = TEMPERATURE_LOOKUP_LENGTH - 1;
@@ -157,17 +241,10 @@ PUBLIC int16 i16TS_GetTemperature(void)
 			left_index = i;
 	}
 	diff_left = temperature_lookup[left_index] - adc;
-	diff_right = adc - temperature_lookup[right_index];
-	if (diff_left < diff_right)
-		return (int16)left_index;
-	else
-		return (int16)right_index;
+	span = temperature_lookup[left_index] - temperature_lookup[right_index];
+	return (int32)((left_index << TEMPERATURE_FRAC_BITS) + (diff_left << TEMPERATURE_FRAC_BITS) / span);
 }
 
-/****************************************************************************/
-/***        Local    Functions                                            ***/
-/****************************************************************************/
-
 /****************************************************************************/
 /***        END OF FILE                                                   ***/
 /****************************************************************************/
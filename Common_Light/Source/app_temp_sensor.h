@@ -55,6 +55,15 @@
 /* After the board overheats, once the temperature drops below this threshold,
  * normal light operation will resume. This number is in degrees Celsius. */
 #define TEMPERATURE_RESTORE_THRESHOLD		75
+/* Board temperature, in degrees Celsius, above which the output of all
+ * lights is scaled down. The scaling goes linearly from full output here to
+ * no output at TEMPERATURE_OVERHEAT_CUTOFF, so the board settles at the
+ * highest output it can sustain instead of cycling through the cutoff. */
+#define TEMPERATURE_DERATE_START			70
+
+/* u32TS_Derating is a multiplier with this many fractional bits */
+#define TS_DERATING_FRAC_BITS				16
+#define TS_DERATING_ONE						(1UL << TS_DERATING_FRAC_BITS)
 
 /****************************************************************************/
 /***        Type Definitions                                              ***/
@@ -67,12 +76,14 @@
 
 PUBLIC void vTS_InitTempSensor(void);
 PUBLIC int16 i16TS_GetTemperature(void);
+PUBLIC bool_t bTS_UpdateDerating(void);
 
 /****************************************************************************/
 /***        External Variables                                            ***/
 /****************************************************************************/
 
 extern volatile bool_t bOverheat;
+extern volatile uint32 u32TS_Derating;
 
 #endif /* APP_TEMP_SENSOR_H */
 
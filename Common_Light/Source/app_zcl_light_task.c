@@ -39,6 +39,7 @@
 
 #include <jendefs.h>
 #include <appapi.h>
+#include <AppHardwareApi.h>
 #include "os.h"
 #include "os_gen.h"
 #include "pdum_apl.h"
@@ -109,6 +110,8 @@
 /****************************************************************************/
 
 #define ZCL_TICK_TIME           APP_TIME_MS(100)
+/* Length of one Tick_Task tick in ms */
+#define TICK_PERIOD_MS          10
 
 
 /****************************************************************************/
@@ -117,6 +120,7 @@
 PRIVATE void APP_ZCL_cbGeneralCallback(tsZCL_CallBackEvent *psEvent);
 PRIVATE void APP_ZCL_cbEndpointCallback(tsZCL_CallBackEvent *psEvent);
 PRIVATE void APP_ZCL_cbZllCommissionCallback(tsZCL_CallBackEvent *psEvent);
+PRIVATE bool_t APP_ZCL_bTickWorkPending(void);
 
 
 
@@ -126,6 +130,11 @@ PRIVATE void APP_ZCL_cbZllCommissionCallback(tsZCL_CallBackEvent *psEvent);
 /****************************************************************************/
 //extern PDM_tsRecordDescriptor sScenesDataPDDesc;
 PUBLIC uint32 u32ComputedWhiteMode;
+/* Number of Tick_Task runs which started more than one tick late, so that
+ * a 10ms step was missed, and the latest start seen, in 16MHz tick timer
+ * counts. Both count from reset. */
+PUBLIC uint32 u32TickOverruns;
+PUBLIC uint32 u32TickMaxLate;
 
 /****************************************************************************/
 /***        Local Variables                                               ***/
@@ -133,6 +142,14 @@ PUBLIC uint32 u32ComputedWhiteMode;
 
 PRIVATE tsZLL_CommissionEndpoint sCommissionEndpoint;
 
+/* Tick_Task timing, shared with APP_ZCL_vWakeTick: the number of 10ms ticks
+ * covered by the timer last armed, and the tick timer value at which it is
+ * due. While Tick_Task runs these describe the timer that just expired. */
+PRIVATE uint32 u32TicksElapsed = 1;
+PRIVATE uint32 u32Deadline;
+PRIVATE bool_t bDeadlineKnown = FALSE;
+PRIVATE bool_t bTickRunning = FALSE;
+
 
 /****************************************************************************/
 /***        Exported Functions                                            ***/
@@ -292,7 +309,12 @@ PUBLIC void APP_ZCL_vSetIdentifyTime(bool_t bAllEndpoints, uint8 u8Endpoint, uin
  * NAME: Tick_Task
  *
  * DESCRIPTION:
- * Task kicked by the tick timer
+ * Task kicked by the tick timer. The timer only runs every 10ms while there
+ * is per-tick work (interpolator transitions or PWM dithering). Otherwise
+ * it is armed for the next 100ms ZCL update, which is also where the 1s ZCL
+ * timer and OTA events fall, so the device can idle in between. Work that
+ * is started from another task brings the next tick forward through
+ * APP_ZCL_vWakeTick.
  *
  * RETURNS:
  * void
@@ -305,12 +327,31 @@ OS_TASK(Tick_Task)
     static uint32 u32Tick1Sec = 99;
 
     tsZCL_CallBackEvent sCallBackEvent;
+    int32 i32Late;
     uint8 i;
 
-    OS_eContinueSWTimer(APP_TickTimer, /*TEN_HZ_TICK_TIME*/APP_TIME_MS(10), NULL);
+    bTickRunning = TRUE;
+    if (bDeadlineKnown)
+    {
+        i32Late = (int32)(u32AHI_TickTimerRead() - u32Deadline);
+        if (i32Late > (int32)APP_TIME_MS(TICK_PERIOD_MS))
+        {
+            u32TickOverruns++;
+        }
+        if ((i32Late > 0) && ((uint32)i32Late > u32TickMaxLate))
+        {
+            u32TickMaxLate = (uint32)i32Late;
+        }
+    }
+    else
+    {
+        /* First run, take it as on time */
+        u32Deadline = u32AHI_TickTimerRead();
+        bDeadlineKnown = TRUE;
+    }
 
-    u32Tick10ms++;
-    u32Tick1Sec++;
+    u32Tick10ms += u32TicksElapsed;
+    u32Tick1Sec += u32TicksElapsed;
 
     /* Wrap the Tick10ms counter and provide 100ms ticks to cluster */
     if (u32Tick10ms > 9)
@@ -336,19 +377,26 @@ OS_TASK(Tick_Task)
 				DriverBulb_vOutput(i);
 			}
         }
+        /* Scale output down as the board approaches the cutoff above */
+        if (bTS_UpdateDerating())
+        {
+        	DriverBulb_vBeginFrame();
+        	for (i = 0; i < NUM_BULBS; i++)
+        	{
+        		DriverBulb_vOutput(i);
+        	}
+        	DriverBulb_vCommitFrame();
+        }
+        /* Time the serial telemetry records, if a host has asked for them */
+        vLC_TelemetryTick();
     }
-#if ( defined CLD_LEVEL_CONTROL) && !(defined MONO_ON_OFF)  /* add in nine 10ms interpolation points */
-    else
-    {
-    	for (i = 0; i < NUM_BULBS; i++)
-    	{
-    		vLI_CreatePoints(i);
-    	}
-    }
+#if ( defined CLD_LEVEL_CONTROL) && !(defined MONO_ON_OFF)  /* advance transitions every 10ms */
+    vLI_Tick();
 #endif
+    DriverBulb_vDither();
 
 #ifdef CLD_OTA
-    if (u32Tick1Sec == 82)   /* offset this from the 1 second roll over */
+    if (u32Tick1Sec == 80)   /* offset this from the 1 second roll over */
     {
         vRunAppOTAStateMachine();
     }
@@ -363,13 +411,90 @@ OS_TASK(Tick_Task)
         vZCL_EventHandler(&sCallBackEvent);
     }
 
+    /* Arm the timer for the next deadline. Continuing from the previous
+     * expiry keeps the 100ms and 1s events from drifting. */
+    if (APP_ZCL_bTickWorkPending())
+    {
+        u32TicksElapsed = 1;
+    }
+    else
+    {
+        u32TicksElapsed = LI_TICKS_PER_100MS - u32Tick10ms;
+    }
+    u32Deadline += APP_TIME_MS(TICK_PERIOD_MS * u32TicksElapsed);
+    OS_eContinueSWTimer(APP_TickTimer, APP_TIME_MS(TICK_PERIOD_MS * u32TicksElapsed), NULL);
+    bTickRunning = FALSE;
+}
 
+/****************************************************************************
+ *
+ * NAME: APP_ZCL_vWakeTick
+ *
+ * DESCRIPTION:
+ * Called after starting a transition or dithering. If the tick timer is
+ * waiting for the next 100ms update with nothing to do in between, it is
+ * restarted for the next 10ms tick instead, so that the work starts
+ * straight away rather than up to 100ms later. The new deadline stays on
+ * the 10ms grid of the one it replaces, and u32TicksElapsed is cut to
+ * match, so the 100ms and 1s events keep their phase.
+ *
+ * Tick_Task re-arms the timer itself, so calls made while it runs are
+ * ignored.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+PUBLIC void APP_ZCL_vWakeTick(void)
+{
+    uint32 u32Now;
+    uint32 u32Ticks;
+
+    if (bTickRunning || !bDeadlineKnown || (u32TicksElapsed == 1) || !APP_ZCL_bTickWorkPending())
+    {
+        return;
+    }
 
+    /* Ticks from the last expiry to the first 10ms boundary after now */
+    u32Now = u32AHI_TickTimerRead();
+    u32Ticks = (u32Now - (u32Deadline - APP_TIME_MS(TICK_PERIOD_MS * u32TicksElapsed)))
+            / APP_TIME_MS(TICK_PERIOD_MS) + 1;
+    if (u32Ticks >= u32TicksElapsed)
+    {
+        /* The timer is due by then anyway */
+        return;
+    }
+
+    u32Deadline -= APP_TIME_MS(TICK_PERIOD_MS * (u32TicksElapsed - u32Ticks));
+    u32TicksElapsed = u32Ticks;
+    OS_eStopSWTimer(APP_TickTimer);
+    OS_eStartSWTimer(APP_TickTimer, u32Deadline - u32Now, NULL);
 }
 
 /****************************************************************************/
 /***        Local Functions                                               ***/
 /****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: APP_ZCL_bTickWorkPending
+ *
+ * DESCRIPTION:
+ * Checks whether Tick_Task has work every 10ms tick
+ *
+ * RETURNS:
+ * TRUE while an interpolator transition or PWM dithering is running
+ *
+ ****************************************************************************/
+PRIVATE bool_t APP_ZCL_bTickWorkPending(void)
+{
+#if ( defined CLD_LEVEL_CONTROL) && !(defined MONO_ON_OFF)
+    return (bLI_AnyTransitionActive() || DriverBulb_bDitherActive());
+#else
+    return DriverBulb_bDitherActive();
+#endif
+}
+
 /****************************************************************************
  *
  * NAME: ZCL_Task
@@ -604,7 +729,8 @@ PRIVATE void APP_ZCL_cbEndpointCallback(tsZCL_CallBackEvent *psEvent)
 										sLightRGB[u8Index].sLevelControlServerCluster.u8CurrentLevel,
 										u8Red,
 										u8Green,
-										u8Blue);
+										u8Blue,
+										u16App_GetColourTemperature(u8Index));
 				}
 				else if (u32ComputedWhiteMode == COMPUTED_WHITE_NONE)
 				{
@@ -614,6 +740,30 @@ PRIVATE void APP_ZCL_cbEndpointCallback(tsZCL_CallBackEvent *psEvent)
 				}
             }
             break;
+#if ( defined CLD_LEVEL_CONTROL) && !(defined MONO_ON_OFF)
+            case GENERAL_CLUSTER_ID_LEVEL_CONTROL:
+            {
+                tsCLD_LevelControlCallBackMessage *psCallBackMessage = (tsCLD_LevelControlCallBackMessage*)psEvent->uMessage.sClusterCustomMessage.pvCustomData;
+
+                DBG_vPrintf(TRACE_ZCL, " CmdId=%d", psCallBackMessage->u8CommandId);
+
+                switch(psCallBackMessage->u8CommandId)
+                {
+                    case E_CLD_LEVELCONTROL_CMD_MOVE_TO_LEVEL:
+                    case E_CLD_LEVELCONTROL_CMD_MOVE_TO_LEVEL_WITH_ON_OFF:
+                        vApp_StartLevelTransition(psEvent->u8EndPoint,
+                                                  psCallBackMessage->uMessage.psMoveToLevelCommandPayload->u8Level,
+                                                  psCallBackMessage->uMessage.psMoveToLevelCommandPayload->u16TransitionTime);
+                        break;
+
+                    default:
+                        /* Move, step and stop are followed through the cluster updates */
+                        vApp_CancelLevelTransition(psEvent->u8EndPoint);
+                        break;
+                }
+            }
+            break;
+#endif
             case GENERAL_CLUSTER_ID_IDENTIFY:
             {
                 tsCLD_IdentifyCallBackMessage *psCallBackMessage = (tsCLD_IdentifyCallBackMessage*)psEvent->uMessage.sClusterCustomMessage.pvCustomData;
@@ -713,7 +863,8 @@ PRIVATE void APP_ZCL_cbEndpointCallback(tsZCL_CallBackEvent *psEvent)
                     	                sLightRGB[u8Index].sLevelControlServerCluster.u8CurrentLevel,
                                         u8Red,
                                         u8Green,
-                                        u8Blue);
+                                        u8Blue,
+                                        u16App_GetColourTemperature(u8Index));
                 }
                 else if (u32ComputedWhiteMode == COMPUTED_WHITE_NONE)
                 {
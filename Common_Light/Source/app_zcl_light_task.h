@@ -69,12 +69,15 @@
 /****************************************************************************/
 PUBLIC void APP_ZCL_vInitialise(void);
 PUBLIC void APP_ZCL_vSetIdentifyTime(bool_t bAllEndpoints, uint8 u8Endpoint, uint16 u16Time);
+PUBLIC void APP_ZCL_vWakeTick(void);
 
 
 /****************************************************************************/
 /***        Exported Variables                                            ***/
 /****************************************************************************/
 PUBLIC uint32 u32ComputedWhiteMode;
+extern uint32 u32TickOverruns;
+extern uint32 u32TickMaxLate;
 
 #endif /* APP_ZCL_TASK_H_ */
 
@@ -0,0 +1,61 @@
+/* cct_table.h
+ *
+ * Colour temperature to red/green/blue lookup table.
+ * This file was generated by generate_cct_table.py.
+ */
+
+#include <stdint.h>
+
+#define CCT_MIRED_MIN 153
+#define CCT_MIRED_MAX 500
+#define CCT_MIRED_SHIFT 3
+#define CCT_TABLE_LENGTH 45
+
+/* Each entry is red, green, blue for CCT_MIRED_MIN + (index << CCT_MIRED_SHIFT) mireds */
+static const uint16_t cct_table[45][3] = {
+{61904, 64030, 65535},
+{63239, 65056, 65535},
+{64061, 65535, 64972},
+{64430, 65535, 63939},
+{64810, 65535, 62920},
+{65201, 65535, 61914},
+{65535, 65468, 60860},
+{65535, 65059, 59509},
+{65535, 64647, 58179},
+{65535, 64231, 56872},
+{65535, 63812, 55586},
+{65535, 63391, 54323},
+{65535, 62969, 53082},
+{65535, 62547, 51843},
+{65535, 62131, 50648},
+{65535, 61716, 49480},
+{65535, 61302, 48338},
+{65535, 60889, 47221},
+{65535, 60477, 46127},
+{65535, 60064, 45056},
+{65535, 59653, 44006},
+{65535, 59242, 42976},
+{65535, 58831, 41966},
+{65535, 58420, 40975},
+{65535, 58010, 40001},
+{65535, 57600, 39045},
+{65535, 57191, 38105},
+{65535, 56782, 37181},
+{65535, 56373, 36271},
+{65535, 55965, 35377},
+{65535, 55557, 34496},
+{65535, 55151, 33628},
+{65535, 54744, 32774},
+{65535, 54339, 31932},
+{65535, 53935, 31101},
+{65535, 53532, 30282},
+{65535, 53130, 29474},
+{65535, 52729, 28676},
+{65535, 52332, 27887},
+{65535, 51936, 27106},
+{65535, 51541, 26335},
+{65535, 51148, 25574},
+{65535, 50757, 24823},
+{65535, 50368, 24080},
+{65535, 49981, 23347}
+};
@@ -0,0 +1,47 @@
+/* colour_table.h
+ *
+ * Colour space conversion matrices and reciprocal lookup table.
+ * This file was generated by generate_colour_table.py.
+ */
+
+#include <stdint.h>
+
+#define CS_GAMMA 2867
+#define CS_INV_GAMMA 366
+#define CS_WHITE_X 21627
+#define CS_WHITE_Y 21627
+#define CS_MATRIX_FRAC_BITS 14
+#define CS_RECIP_SHIFT 7
+#define CS_RECIP_TABLE_SIZE 256
+
+static const int16_t cs_rgb_to_xyz[3][3] = {
+{12575, 1326, 2483},
+{5733, 9887, 764},
+{185, 844, 15852}
+};
+
+static const int16_t cs_xyz_to_rgb[3][3] = {
+{22649, -2747, -3415},
+{-13166, 28858, 671},
+{437, -1505, 16938}
+};
+
+static const uint16_t cs_recip_table[257] = {
+32768, 32640, 32514, 32388, 32264, 32140, 32018, 31896, 31775, 31655, 31536, 31418, 31301, 31184, 31069, 30954,
+30840, 30728, 30615, 30504, 30394, 30284, 30175, 30067, 29959, 29853, 29747, 29642, 29537, 29434, 29331, 29229,
+29127, 29026, 28926, 28827, 28728, 28630, 28533, 28436, 28340, 28244, 28150, 28056, 27962, 27869, 27777, 27685,
+27594, 27504, 27414, 27324, 27236, 27148, 27060, 26973, 26887, 26801, 26715, 26631, 26546, 26462, 26379, 26297,
+26214, 26133, 26052, 25971, 25891, 25811, 25732, 25653, 25575, 25497, 25420, 25343, 25267, 25191, 25116, 25041,
+24966, 24892, 24818, 24745, 24672, 24600, 24528, 24457, 24385, 24315, 24245, 24175, 24105, 24036, 23967, 23899,
+23831, 23764, 23697, 23630, 23564, 23498, 23432, 23367, 23302, 23237, 23173, 23109, 23046, 22982, 22920, 22857,
+22795, 22733, 22672, 22611, 22550, 22490, 22429, 22370, 22310, 22251, 22192, 22134, 22075, 22017, 21960, 21902,
+21845, 21789, 21732, 21676, 21620, 21565, 21509, 21454, 21400, 21345, 21291, 21237, 21183, 21130, 21077, 21024,
+20972, 20919, 20867, 20815, 20764, 20713, 20662, 20611, 20560, 20510, 20460, 20410, 20361, 20311, 20262, 20214,
+20165, 20117, 20068, 20021, 19973, 19925, 19878, 19831, 19784, 19738, 19692, 19645, 19600, 19554, 19508, 19463,
+19418, 19373, 19329, 19284, 19240, 19196, 19152, 19108, 19065, 19022, 18979, 18936, 18893, 18851, 18809, 18766,
+18725, 18683, 18641, 18600, 18559, 18518, 18477, 18437, 18396, 18356, 18316, 18276, 18236, 18197, 18157, 18118,
+18079, 18040, 18001, 17963, 17924, 17886, 17848, 17810, 17772, 17735, 17697, 17660, 17623, 17586, 17549, 17513,
+17476, 17440, 17404, 17368, 17332, 17296, 17261, 17225, 17190, 17155, 17120, 17085, 17050, 17015, 16981, 16947,
+16913, 16878, 16845, 16811, 16777, 16744, 16710, 16677, 16644, 16611, 16578, 16546, 16513, 16481, 16448, 16416,
+16384 
+};
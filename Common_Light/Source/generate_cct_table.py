@@ -0,0 +1,134 @@
+#!/usr/bin/env python
+#
+# generate_cct_table.py
+#
+# This will generate cct_table.h, which contains a definition of the lookup
+# table used to convert colour temperature (in mireds) into red/green/blue
+# channel ratios.
+
+from __future__ import print_function
+from __future__ import division
+import math
+
+# Constants are defined here. If you change the LEDs, check if these are
+# still correct.
+
+# Chromaticity of the red, green and blue LEDs, and of the white which equal
+# red, green and blue values mix to. These must match CLD_COLOURCONTROL_RED_X
+# etc. in zcl_options.h and the values in generate_colour_table.py.
+RED_X = 0.68
+RED_Y = 0.31
+GREEN_X = 0.11
+GREEN_Y = 0.82
+BLUE_X = 0.13
+BLUE_Y = 0.04
+WHITE_X = 0.33
+WHITE_Y = 0.33
+# Gamma applied by the firmware to each channel (DEFAULT_GAMMA in
+# app_light_calibration.c, divided by 1024). Table entries are encoded with
+# the inverse of this, so that after gamma correction the channels have the
+# right linear ratios.
+GAMMA = 2867 / 1024.0
+# Range of the table, in mireds. This should cover
+# CLD_COLOURCONTROL_COLOUR_TEMPERATURE_PHY_MIN/MAX in zcl_options.h.
+MIRED_MIN = 153
+MIRED_MAX = 500
+# Table entries are 2 ^ MIRED_SHIFT mireds apart, so that the firmware can
+# find and interpolate entries without dividing.
+MIRED_SHIFT = 3
+TABLE_LENGTH = ((MIRED_MAX - MIRED_MIN) >> MIRED_SHIFT) + 2
+
+# Chromaticity of a black body radiator at temperature t (in kelvin), using
+# the cubic spline approximation of Kim et al.
+def planckian_xy(t):
+    if t < 4000:
+        x = -0.2661239e9 / t ** 3 - 0.2343589e6 / t ** 2 + 0.8776956e3 / t + 0.179910
+    else:
+        x = -3.0258469e9 / t ** 3 + 2.1070379e6 / t ** 2 + 0.2226347e3 / t + 0.240390
+    if t < 2222:
+        y = -1.1063814 * x ** 3 - 1.34811020 * x ** 2 + 2.18555832 * x - 0.20219683
+    elif t < 4000:
+        y = -0.9549476 * x ** 3 - 1.37418593 * x ** 2 + 2.09137015 * x - 0.16748867
+    else:
+        y = 3.0817580 * x ** 3 - 5.87338670 * x ** 2 + 3.75112997 * x - 0.37001483
+    return (x, y)
+
+# Solve the 3x3 linear system m * v = b using Cramer's rule
+def solve3(m, b):
+    def det(a):
+        return (a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+              - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+              + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]))
+    d = det(m)
+    result = []
+    for col in range(3):
+        mc = [[(b[row] if c == col else m[row][c]) for c in range(3)] for row in range(3)]
+        result.append(det(mc) / d)
+    return result
+
+# Linear red/green/blue amounts which mix to chromaticity (x, y)
+def xy_to_rgb(x, y):
+    primaries = ((RED_X, RED_Y), (GREEN_X, GREEN_Y), (BLUE_X, BLUE_Y))
+    # Columns are the XYZ of each primary at Y = 1
+    m = [[px / py for (px, py) in primaries],
+         [1.0, 1.0, 1.0],
+         [(1.0 - px - py) / py for (px, py) in primaries]]
+    # Scale each primary so that equal red, green and blue give the white
+    # point
+    white = solve3(m, [WHITE_X / WHITE_Y, 1.0, (1.0 - WHITE_X - WHITE_Y) / WHITE_Y])
+    m = [[m[r][c] * white[c] for c in range(3)] for r in range(3)]
+    rgb = solve3(m, [x / y, 1.0, (1.0 - x - y) / y])
+    # Chromaticities outside the gamut are clipped
+    rgb = [max(c, 0.0) for c in rgb]
+    peak = max(rgb)
+    return [c / peak for c in rgb]
+
+table = []
+for i in range(TABLE_LENGTH):
+    mired = MIRED_MIN + (i << MIRED_SHIFT)
+    (x, y) = planckian_xy(1000000.0 / mired)
+    rgb = xy_to_rgb(x, y)
+    table.append([int(round(math.pow(c, 1.0 / GAMMA) * 65535.0)) for c in rgb])
+
+f = open("cct_table.h", "w")
+f.write("/* cct_table.h\n")
+f.write(" *\n")
+f.write(" * Colour temperature to red/green/blue lookup table.\n")
+f.write(" * This file was generated by generate_cct_table.py.\n")
+f.write(" */\n")
+f.write("\n")
+f.write("#include <stdint.h>\n")
+f.write("\n")
+f.write("#define CCT_MIRED_MIN {}\n".format(MIRED_MIN))
+f.write("#define CCT_MIRED_MAX {}\n".format(MIRED_MAX))
+f.write("#define CCT_MIRED_SHIFT {}\n".format(MIRED_SHIFT))
+f.write("#define CCT_TABLE_LENGTH {}\n".format(TABLE_LENGTH))
+f.write("\n")
+f.write("/* Each entry is red, green, blue for CCT_MIRED_MIN + (index << CCT_MIRED_SHIFT) mireds */\n")
+f.write("static const uint16_t cct_table[{}][3] = ".format(TABLE_LENGTH))
+f.write("{\n")
+for i in range(TABLE_LENGTH):
+    f.write("{{{0}, {1}, {2}}}".format(table[i][0], table[i][1], table[i][2]))
+    if i != (TABLE_LENGTH - 1):
+        f.write(",")
+    f.write("\n")
+f.write("};\n")
+f.close()
+
+# Everything from here on is for testing only
+
+# Compare interpolated table values with the exact values, in the same way
+# as the firmware interpolates
+biggest_error = 0.0
+for mired in range(MIRED_MIN, MIRED_MAX + 1):
+    offset = mired - MIRED_MIN
+    i = offset >> MIRED_SHIFT
+    frac = offset & ((1 << MIRED_SHIFT) - 1)
+    (x, y) = planckian_xy(1000000.0 / mired)
+    exact = xy_to_rgb(x, y)
+    for c in range(3):
+        value = table[i][c] + (((table[i + 1][c] - table[i][c]) * frac) >> MIRED_SHIFT)
+        err = abs(value - math.pow(exact[c], 1.0 / GAMMA) * 65535.0)
+        if err > biggest_error:
+            biggest_error = err
+print("Biggest interpolation error: " + str(biggest_error) + " / 65535")
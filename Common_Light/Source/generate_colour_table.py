@@ -0,0 +1,242 @@
+#!/usr/bin/env python
+#
+# generate_colour_table.py
+#
+# This will generate colour_table.h, which contains the matrices and lookup
+# table used to convert between red/green/blue values and CIE xy
+# chromaticity, for colour transitions which are interpolated in xy space.
+
+from __future__ import print_function
+from __future__ import division
+import math
+import random
+
+# Constants are defined here. If you change the LEDs, check if these are
+# still correct.
+
+# Chromaticity of the red, green and blue LEDs, and of the white which equal
+# red, green and blue values mix to. These must match CLD_COLOURCONTROL_RED_X
+# etc. in zcl_options.h.
+RED_X = 0.68
+RED_Y = 0.31
+GREEN_X = 0.11
+GREEN_Y = 0.82
+BLUE_X = 0.13
+BLUE_Y = 0.04
+WHITE_X = 0.33
+WHITE_Y = 0.33
+# Gamma applied by the firmware to each channel (DEFAULT_GAMMA in
+# app_light_calibration.c), 1024 = 1.0. Red/green/blue values are linearised
+# with this before conversion to xy.
+GAMMA_FP = 2867
+# Number of fractional bits in matrix entries
+MATRIX_FRAC_BITS = 14
+# Number of entries in the reciprocal table, which must be a power of two
+RECIP_TABLE_SIZE = 256
+
+def det3(a):
+    return (a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+          - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+          + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]))
+
+def inverse3(a):
+    d = det3(a)
+    inv = [[0.0] * 3 for i in range(3)]
+    for r in range(3):
+        for c in range(3):
+            minor = [[a[i][j] for j in range(3) if j != r] for i in range(3) if i != c]
+            cofactor = minor[0][0] * minor[1][1] - minor[0][1] * minor[1][0]
+            inv[r][c] = (-1) ** (r + c) * cofactor / d
+    return inv
+
+def multiply3(a, v):
+    return [sum(a[r][c] * v[c] for c in range(3)) for r in range(3)]
+
+# Matrix which converts linear red/green/blue into XYZ. Each primary is
+# scaled so that red = green = blue = 1 gives the white point at Y = 1.
+def rgb_to_xyz_matrix():
+    primaries = ((RED_X, RED_Y), (GREEN_X, GREEN_Y), (BLUE_X, BLUE_Y))
+    m = [[px / py for (px, py) in primaries],
+         [1.0, 1.0, 1.0],
+         [(1.0 - px - py) / py for (px, py) in primaries]]
+    white = [WHITE_X / WHITE_Y, 1.0, (1.0 - WHITE_X - WHITE_Y) / WHITE_Y]
+    scale = multiply3(inverse3(m), white)
+    return [[m[r][c] * scale[c] for c in range(3)] for r in range(3)]
+
+RGB_TO_XYZ = rgb_to_xyz_matrix()
+XYZ_TO_RGB = inverse3(RGB_TO_XYZ)
+
+def to_fixed(m):
+    return [[int(round(v * (1 << MATRIX_FRAC_BITS))) for v in row] for row in m]
+
+rgb_to_xyz_fp = to_fixed(RGB_TO_XYZ)
+xyz_to_rgb_fp = to_fixed(XYZ_TO_RGB)
+
+# Reciprocal table, indexed by the top bits of a value m which has been
+# normalised into [2^15, 2^16). Entry i is 2^30 / ((RECIP_TABLE_SIZE + i)
+# << RECIP_SHIFT), so (c * entry) >> 14 is close to c * 65536 / m.
+RECIP_SHIFT = 16 - int(math.log(RECIP_TABLE_SIZE, 2)) - 1
+recip_table = []
+for i in range(RECIP_TABLE_SIZE + 1):
+    recip_table.append(int(round(float(1 << 30) / ((RECIP_TABLE_SIZE + i) << RECIP_SHIFT))))
+
+f = open("colour_table.h", "w")
+f.write("/* colour_table.h\n")
+f.write(" *\n")
+f.write(" * Colour space conversion matrices and reciprocal lookup table.\n")
+f.write(" * This file was generated by generate_colour_table.py.\n")
+f.write(" */\n")
+f.write("\n")
+f.write("#include <stdint.h>\n")
+f.write("\n")
+f.write("#define CS_GAMMA {}\n".format(GAMMA_FP))
+f.write("#define CS_INV_GAMMA {}\n".format(int(round(1024.0 * 1024.0 / GAMMA_FP))))
+f.write("#define CS_WHITE_X {}\n".format(int(round(WHITE_X * 65536.0))))
+f.write("#define CS_WHITE_Y {}\n".format(int(round(WHITE_Y * 65536.0))))
+f.write("#define CS_MATRIX_FRAC_BITS {}\n".format(MATRIX_FRAC_BITS))
+f.write("#define CS_RECIP_SHIFT {}\n".format(RECIP_SHIFT))
+f.write("#define CS_RECIP_TABLE_SIZE {}\n".format(RECIP_TABLE_SIZE))
+f.write("\n")
+for (name, m) in (("cs_rgb_to_xyz", rgb_to_xyz_fp), ("cs_xyz_to_rgb", xyz_to_rgb_fp)):
+    f.write("static const int16_t {0}[3][3] = ".format(name))
+    f.write("{\n")
+    for r in range(3):
+        f.write("{{{0}, {1}, {2}}}".format(m[r][0], m[r][1], m[r][2]))
+        if r != 2:
+            f.write(",")
+        f.write("\n")
+    f.write("};\n")
+    f.write("\n")
+f.write("static const uint16_t cs_recip_table[{}] = ".format(RECIP_TABLE_SIZE + 1))
+f.write("{\n")
+for i in range(RECIP_TABLE_SIZE + 1):
+    f.write(str(recip_table[i]))
+    if i != RECIP_TABLE_SIZE:
+        f.write(",")
+    if (i % 16) == 15:
+        f.write("\n")
+    else:
+        f.write(" ")
+f.write("\n};\n")
+f.close()
+
+# Everything from here on is for testing only
+
+# Models of u32LC_IntensityToLog() and u16LC_LogToIntensity(), using the
+# tables from generate_log_table.py
+LOG_SCALING_FACTOR = 4096
+log_table_long = [0] + [int(round(-math.log(i / 4095.0) * LOG_SCALING_FACTOR)) for i in range(1, 4096)]
+EXP_TABLE_SHIFT = 6
+EXP_TABLE_LENGTH = (log_table_long[1] >> EXP_TABLE_SHIFT) + 2
+exp_table = [int(round(math.exp(-(i << EXP_TABLE_SHIFT) / float(LOG_SCALING_FACTOR)) * 65535.0))
+             for i in range(EXP_TABLE_LENGTH)]
+LOG_ZERO = (EXP_TABLE_LENGTH - 1) << EXP_TABLE_SHIFT
+
+def intensity_to_log(intensity):
+    if intensity == 0:
+        return LOG_ZERO
+    x = intensity * 4095
+    i = x >> 16
+    frac = x & 0xffff
+    if i == 0:
+        i = 1
+        frac = 0
+    return log_table_long[i] - (((log_table_long[i] - log_table_long[i + 1]) * frac) >> 16)
+
+def log_to_intensity(y):
+    if y >= LOG_ZERO:
+        return 0
+    i = y >> EXP_TABLE_SHIFT
+    frac = y & ((1 << EXP_TABLE_SHIFT) - 1)
+    return exp_table[i] - (((exp_table[i] - exp_table[i + 1]) * frac) >> EXP_TABLE_SHIFT)
+
+def apply_gamma(intensity, gamma_fp):
+    if intensity == 0:
+        return 0
+    return log_to_intensity((intensity_to_log(intensity) * gamma_fp) >> 10)
+
+# Model of vCS_RGBToXY() in app_light_colourspace.c
+def rgb_to_xy_fp(rgb):
+    peak = max(rgb)
+    if peak == 0:
+        return (int(round(WHITE_X * 65536.0)), int(round(WHITE_Y * 65536.0)), 0)
+    # Chromaticity only depends on the ratios, so scale the brightest
+    # channel to full scale before linearising
+    lin = [apply_gamma((c * 65535) // peak, GAMMA_FP) for c in rgb]
+    xyz = [sum(rgb_to_xyz_fp[r][c] * lin[c] for c in range(3)) for r in range(3)]
+    xyz = [max(v, 0) for v in xyz]
+    total = xyz[0] + xyz[1] + xyz[2]
+    while total >= (1 << 16):
+        xyz = [v >> 1 for v in xyz]
+        total >>= 1
+    if total == 0:
+        return (int(round(WHITE_X * 65536.0)), int(round(WHITE_Y * 65536.0)), peak)
+    return (min((xyz[0] << 16) // total, 65535), min((xyz[1] << 16) // total, 65535), peak)
+
+# Model of vCS_XYToRGB() in app_light_colourspace.c
+INV_GAMMA_FP = int(round(1024.0 * 1024.0 / GAMMA_FP))
+def xy_to_rgb_fp(x, y, peak):
+    z = 65536 - x - y
+    xyz = [x >> 2, y >> 2, max(z, 0) >> 2]
+    lin = [max(sum(xyz_to_rgb_fp[r][c] * xyz[c] for c in range(3)), 0) for r in range(3)]
+    m = max(lin)
+    if m == 0:
+        return [0, 0, 0]
+    shift = 0
+    while m >= (1 << 16):
+        m >>= 1
+        shift += 1
+    while m < (1 << 15):
+        m <<= 1
+        shift -= 1
+    i = (m >> RECIP_SHIFT) - RECIP_TABLE_SIZE
+    frac = m & ((1 << RECIP_SHIFT) - 1)
+    recip = recip_table[i] - (((recip_table[i] - recip_table[i + 1]) * frac) >> RECIP_SHIFT)
+    out = []
+    for c in lin:
+        c = (c >> shift) if shift >= 0 else (c << -shift)
+        c = min((c * recip) >> 14, 65535)
+        # log_table_long can't resolve less than 1/4095, so round tiny
+        # linear values to 0 rather than to the first table entry
+        if c < 8:
+            c = 0
+        c = apply_gamma(c, INV_GAMMA_FP)
+        out.append((c * peak + 32768) >> 16)
+    return out
+
+# Double precision reference
+def rgb_to_xy_ref(rgb):
+    lin = [math.pow(c / 65535.0, GAMMA_FP / 1024.0) for c in rgb]
+    xyz = multiply3(RGB_TO_XYZ, lin)
+    total = sum(xyz)
+    return (xyz[0] / total, xyz[1] / total, max(rgb))
+
+def xy_to_rgb_ref(x, y, peak):
+    lin = [max(v, 0.0) for v in multiply3(XYZ_TO_RGB, [x, y, 1.0 - x - y])]
+    m = max(lin)
+    return [math.pow(c / m, 1024.0 / GAMMA_FP) * peak for c in lin]
+
+random.seed(1)
+worst_xy = 0.0
+worst_rgb = 0.0
+total_rgb = 0.0
+count = 0
+for n in range(20000):
+    rgb = [random.randint(0, 65535) for c in range(3)]
+    rgb[random.randint(0, 2)] = random.choice((0, random.randint(0, 65535)))
+    if max(rgb) < 258:
+        continue
+    (x, y, peak) = rgb_to_xy_fp(rgb)
+    (xr, yr, peakr) = rgb_to_xy_ref(rgb)
+    worst_xy = max(worst_xy, abs(x / 65536.0 - xr), abs(y / 65536.0 - yr))
+    out = xy_to_rgb_fp(x, y, peak)
+    ref = xy_to_rgb_ref(xr, yr, peakr)
+    for c in range(3):
+        # Compare linear light output, which is what is actually seen
+        err = abs(math.pow(out[c] / 65535.0, GAMMA_FP / 1024.0) - math.pow(ref[c] / 65535.0, GAMMA_FP / 1024.0))
+        worst_rgb = max(worst_rgb, err)
+        total_rgb += err
+        count += 1
+print("Largest xy error: " + str(worst_xy))
+print("Largest RGB round trip error: " + str(worst_rgb * 100.0) + "% of full scale linear light")
+print("Average RGB round trip error: " + str(total_rgb / count * 100.0) + "% of full scale linear light")
@@ -19,7 +19,7 @@ f.write("\n")
 f.write("#include <stdint.h>\n")
 f.write("\n")
 
-# Scaling factor for log table values.
+# Scaling factor for log table values (and exp table inputs).
 # Increasing this will increase the precision of calculations, but this can't
 # be too large or values will overflow 16 bits.
 LOG_SCALING_FACTOR = 4096
@@ -55,6 +55,41 @@ log_table_long = generate_log_table(4096, "log_table_long")
 
 log_table_short = generate_log_table(255, "log_table_short")
 
+# Exp table entries are 2 ^ EXP_TABLE_SHIFT log units apart, so that the
+# firmware can find and interpolate entries using shifts.
+EXP_TABLE_SHIFT = 6
+# The table covers the whole range of log_table_long
+EXP_TABLE_LENGTH = (log_table_long[1] >> EXP_TABLE_SHIFT) + 2
+
+# Generate exp table, which converts log values back into 16 bit
+# intensities. Each entry is exp(-x / LOG_SCALING_FACTOR) * 65535.
+def generate_exp_table(n, name):
+    global LOG_SCALING_FACTOR
+    global EXP_TABLE_SHIFT
+    global f
+    table = []
+    for i in range(n):
+        x = i << EXP_TABLE_SHIFT
+        table.append(int(round(math.exp(-x / float(LOG_SCALING_FACTOR)) * 65535.0)))
+    f.write("#define EXP_TABLE_SHIFT {}\n".format(EXP_TABLE_SHIFT))
+    f.write("#define EXP_TABLE_LENGTH {}\n".format(n))
+    f.write("\n")
+    f.write("static const uint16_t {0}[{1}] = ".format(name, n))
+    f.write("{\n")
+    for i in range(n):
+        f.write(str(table[i]))
+        if i != (n - 1):
+            f.write(",")
+        if (i % 16) == 15:
+            f.write("\n")
+        else:
+            f.write(" ")
+    f.write("};\n")
+    f.write("\n")
+    return table
+
+exp_table = generate_exp_table(EXP_TABLE_LENGTH, "exp_table")
+
 f.close()
 
 # Everything from here on is for testing only
@@ -283,3 +283,42 @@ static const uint16_t log_table_short[255] = {
 515, 497, 478, 460, 442, 424, 407, 389, 371, 353, 336, 318, 301, 284, 267, 249,
 232, 215, 198, 181, 165, 148, 131, 114, 98, 81, 65, 49, 32, 16, 0 };
 
+#define EXP_TABLE_SHIFT 6
+#define EXP_TABLE_LENGTH 534
+
+static const uint16_t exp_table[534] = {
+65535, 64519, 63519, 62534, 61564, 60610, 59670, 58745, 57834, 56938, 56055, 55186, 54330, 53488, 52659, 51842,
+51039, 50247, 49468, 48701, 47946, 47203, 46471, 45751, 45042, 44343, 43656, 42979, 42313, 41657, 41011, 40375,
+39749, 39133, 38526, 37929, 37341, 36762, 36192, 35631, 35078, 34535, 33999, 33472, 32953, 32442, 31939, 31444,
+30957, 30477, 30004, 29539, 29081, 28630, 28186, 27749, 27319, 26896, 26479, 26068, 25664, 25266, 24874, 24489,
+24109, 23735, 23367, 23005, 22648, 22297, 21951, 21611, 21276, 20946, 20622, 20302, 19987, 19677, 19372, 19072,
+18776, 18485, 18198, 17916, 17639, 17365, 17096, 16831, 16570, 16313, 16060, 15811, 15566, 15325, 15087, 14853,
+14623, 14396, 14173, 13953, 13737, 13524, 13314, 13108, 12905, 12705, 12508, 12314, 12123, 11935, 11750, 11568,
+11388, 11212, 11038, 10867, 10698, 10532, 10369, 10208, 10050, 9894, 9741, 9590, 9441, 9295, 9151, 9009,
+8869, 8732, 8596, 8463, 8332, 8203, 8075, 7950, 7827, 7706, 7586, 7469, 7353, 7239, 7127, 7016,
+6907, 6800, 6695, 6591, 6489, 6388, 6289, 6192, 6096, 6001, 5908, 5817, 5726, 5638, 5550, 5464,
+5379, 5296, 5214, 5133, 5054, 4975, 4898, 4822, 4747, 4674, 4601, 4530, 4460, 4391, 4323, 4255,
+4190, 4125, 4061, 3998, 3936, 3875, 3815, 3755, 3697, 3640, 3583, 3528, 3473, 3419, 3366, 3314,
+3263, 3212, 3162, 3113, 3065, 3018, 2971, 2925, 2879, 2835, 2791, 2748, 2705, 2663, 2622, 2581,
+2541, 2502, 2463, 2425, 2387, 2350, 2314, 2278, 2242, 2208, 2173, 2140, 2107, 2074, 2042, 2010,
+1979, 1948, 1918, 1888, 1859, 1830, 1802, 1774, 1746, 1719, 1693, 1666, 1641, 1615, 1590, 1566,
+1541, 1517, 1494, 1471, 1448, 1425, 1403, 1382, 1360, 1339, 1318, 1298, 1278, 1258, 1238, 1219,
+1200, 1182, 1163, 1145, 1128, 1110, 1093, 1076, 1059, 1043, 1027, 1011, 995, 980, 964, 950,
+935, 920, 906, 892, 878, 865, 851, 838, 825, 812, 800, 787, 775, 763, 751, 739,
+728, 717, 706, 695, 684, 673, 663, 653, 642, 633, 623, 613, 604, 594, 585, 576,
+567, 558, 550, 541, 533, 524, 516, 508, 500, 493, 485, 477, 470, 463, 456, 449,
+442, 435, 428, 421, 415, 408, 402, 396, 390, 384, 378, 372, 366, 360, 355, 349,
+344, 339, 333, 328, 323, 318, 313, 308, 303, 299, 294, 290, 285, 281, 276, 272,
+268, 264, 260, 256, 252, 248, 244, 240, 236, 233, 229, 226, 222, 219, 215, 212,
+209, 205, 202, 199, 196, 193, 190, 187, 184, 181, 178, 176, 173, 170, 168, 165,
+162, 160, 157, 155, 153, 150, 148, 146, 143, 141, 139, 137, 135, 133, 131, 129,
+127, 125, 123, 121, 119, 117, 115, 113, 112, 110, 108, 107, 105, 103, 102, 100,
+99, 97, 95, 94, 93, 91, 90, 88, 87, 86, 84, 83, 82, 80, 79, 78,
+77, 76, 74, 73, 72, 71, 70, 69, 68, 67, 66, 65, 64, 63, 62, 61,
+60, 59, 58, 57, 56, 55, 54, 54, 53, 52, 51, 50, 50, 49, 48, 47,
+47, 46, 45, 44, 44, 43, 42, 42, 41, 40, 40, 39, 39, 38, 37, 37,
+36, 36, 35, 35, 34, 34, 33, 32, 32, 31, 31, 31, 30, 30, 29, 29,
+28, 28, 27, 27, 27, 26, 26, 25, 25, 25, 24, 24, 23, 23, 23, 22,
+22, 22, 21, 21, 21, 20, 20, 20, 19, 19, 19, 19, 18, 18, 18, 17,
+17, 17, 17, 16, 16, 16 };
+
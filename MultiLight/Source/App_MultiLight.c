@@ -74,6 +74,26 @@
 
 #define FAST_DIV_BY_255(x)			((((x) << 8) + (x) + 255) >> 16)
 
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/* Last state passed to the interpolator for each bulb. While
+ * bLevelTransition is set the level is being ramped by a timed transition
+ * (Move to Level command) and the intermediate levels reported by the level
+ * control cluster every 100ms are ignored. */
+typedef struct
+{
+	bool_t bValid;
+	bool_t bOn;
+	uint8  u8Level;
+	uint8  u8Red;
+	uint8  u8Green;
+	uint8  u8Blue;
+	uint16 u16ColTemp;
+	bool_t bLevelTransition;
+} tsLightState;
+
 /****************************************************************************/
 /***        Exported Variables                                            ***/
 /****************************************************************************/
@@ -88,6 +108,8 @@ tsIdentifyColour sIdEffectRGB[NUM_RGB_LIGHTS];
 /***        Local Variables                                               ***/
 /****************************************************************************/
 
+PRIVATE tsLightState asLightState[NUM_BULBS];
+
 #ifdef VARIANT_MINI
 PRIVATE tsCLD_ZllDeviceTable sDeviceTable =
 	{NUM_MONO_LIGHTS + NUM_RGB_LIGHTS,
@@ -169,6 +191,8 @@ PRIVATE tsCLD_ZllDeviceTable sDeviceTable =
 /****************************************************************************/
 
 PRIVATE void vOverideProfileId(uint16* pu16Profile, uint8 u8Ep);
+PRIVATE bool_t bLightStateChanged(uint8 u8Bulb, bool_t bOn, uint8 u8Level, uint8 u8Red,
+                                  uint8 u8Green, uint8 u8Blue, uint16 u16ColTemp, bool_t *pbKeepLevel);
 
 /****************************************************************************/
 /***        Exported Functions                                            ***/
@@ -494,7 +518,8 @@ PUBLIC void APP_vHandleIdentify(uint8 u8Endpoint) {
 					            sLightRGB[u8Index].sLevelControlServerCluster.u8CurrentLevel,
 			                    u8Red,
 			                    u8Green,
-			                    u8Blue);
+			                    u8Blue,
+			                    u16App_GetColourTemperature(u8Index));
         }
         else if (u32ComputedWhiteMode == COMPUTED_WHITE_NONE)
         {
@@ -509,7 +534,7 @@ PUBLIC void APP_vHandleIdentify(uint8 u8Endpoint) {
 		DBG_vPrintf(TRACE_PATH, "\nPath 4");
 		if (bIsRGB)
 		{
-			vRGBLight_SetLevels(BULB_NUM_RGB(u8Index), TRUE, 159, 250, 0, 0);
+			vRGBLight_SetLevels(BULB_NUM_RGB(u8Index), TRUE, 159, 250, 0, 0, 0);
 		}
 		else if (u32ComputedWhiteMode == COMPUTED_WHITE_NONE)
 		{
@@ -586,7 +611,8 @@ PUBLIC void vIdEffectTick(void) {
 						            sIdEffectRGB[i].u8Level,
 						            sIdEffectRGB[i].u8Red,
 						            sIdEffectRGB[i].u8Green,
-						            sIdEffectRGB[i].u8Blue);
+						            sIdEffectRGB[i].u8Blue,
+						            0);
 				/* Now adjust parameters ready for for next round */
 				switch (sIdEffectRGB[i].u8Effect) {
 					case E_CLD_IDENTIFY_EFFECT_BLINK:
@@ -645,7 +671,8 @@ PUBLIC void vIdEffectTick(void) {
 						            sLightRGB[i].sLevelControlServerCluster.u8CurrentLevel,
 				                    u8Red,
 				                    u8Green,
-				                    u8Blue);
+				                    u8Blue,
+				                    u16App_GetColourTemperature(i));
 			}
 		}
     }
@@ -900,23 +927,41 @@ PUBLIC void vStartEffect(uint8 u8Endpoint, uint8 u8Effect) {
  * NAME: vRGBLight_SetLevels
  *
  * DESCRIPTION:
- * Set the RGB and levels
+ * Set the RGB and levels. A non-zero u16ColTemp (in mireds) makes the
+ * colour come from the colour temperature instead of the RGB values.
+ * Computed white modes derive the white channel from the RGB values, so
+ * they always use those.
  *
  * RETURNS:
  * void
  *
  ****************************************************************************/
 
-PUBLIC void vRGBLight_SetLevels(uint8 u8Bulb, bool_t bOn, uint8 u8Level, uint8 u8Red, uint8 u8Green, uint8 u8Blue)
+PUBLIC void vRGBLight_SetLevels(uint8 u8Bulb, bool_t bOn, uint8 u8Level, uint8 u8Red, uint8 u8Green, uint8 u8Blue,
+                                uint16 u16ColTemp)
 {
 	uint32 v;
 	uint8 u8ComputedWhite;
+	bool_t bKeepLevel;
+
+	if (!bLightStateChanged(u8Bulb, bOn, u8Level, u8Red, u8Green, u8Blue, u16ColTemp, &bKeepLevel))
+	{
+		return;
+	}
 
     if (bOn == TRUE)
     {
     	if (u32ComputedWhiteMode == COMPUTED_WHITE_NONE)
     	{
-    		vLI_Start(u8Bulb, u8Level, u8Red, u8Green, u8Blue, 0);
+    		if (bKeepLevel)
+    		{
+    			/* Level belongs to a timed transition, only follow colour */
+    			vLI_StartColour(u8Bulb, u8Red, u8Green, u8Blue, u16ColTemp, LI_TICKS_PER_100MS);
+    		}
+    		else
+    		{
+    			vLI_Start(u8Bulb, u8Level, u8Red, u8Green, u8Blue, u16ColTemp);
+    		}
     	}
     	else if ((u32ComputedWhiteMode == COMPUTED_WHITE_BETTER_COLOR)
     			|| (u32ComputedWhiteMode == COMPUTED_WHITE_BETTER_BRIGHTNESS))
@@ -973,9 +1018,19 @@ PUBLIC void vRGBLight_SetLevels(uint8 u8Bulb, bool_t bOn, uint8 u8Level, uint8 u
  ****************************************************************************/
 PUBLIC void vSetBulbState(uint8 u8Bulb, bool bOn, uint8 u8Level)
 {
+	bool_t bKeepLevel;
+
+	if (!bLightStateChanged(u8Bulb, bOn, u8Level, 0, 0, 0, 0, &bKeepLevel))
+	{
+		return;
+	}
+
 	if (bOn)
 	{
-		vLI_Start(u8Bulb, u8Level, 0, 0, 0, 0);
+		if (!bKeepLevel)
+		{
+			vLI_Start(u8Bulb, u8Level, 0, 0, 0, 0);
+		}
 	}
 	else
     {
@@ -984,6 +1039,178 @@ PUBLIC void vSetBulbState(uint8 u8Bulb, bool bOn, uint8 u8Level)
 	DriverBulb_vSetOnOff(u8Bulb, bOn);
 }
 
+/****************************************************************************
+ *
+ * NAME: vApp_StartLevelTransition
+ *
+ * DESCRIPTION:
+ * Called when a Move to Level command is received. Rather than following
+ * the 100ms level updates from the cluster, the interpolator ramps the
+ * level over the whole transition time in one go.
+ *
+ * PARAMETERS:
+ * u8Endpoint: Endpoint the command was sent to
+ * u8Level: Target level
+ * u16TransitionTime: Transition time in 1/10 s
+ *
+ * RETURNS: void
+ *
+ ****************************************************************************/
+PUBLIC void vApp_StartLevelTransition(uint8 u8Endpoint, uint8 u8Level, uint16 u16TransitionTime)
+{
+	uint8 u8Index;
+	uint8 u8Bulb;
+	bool_t bIsRGB;
+
+	/* In computed white mode the white channel follows the RGB level,
+	 * so leave those lights to the regular updates */
+	if ((u32ComputedWhiteMode != COMPUTED_WHITE_NONE)
+	 || !bEndPointToNum(u8Endpoint, &bIsRGB, &u8Index))
+	{
+		return;
+	}
+	/* 0xFFFF means "use the on/off transition time", which the cluster
+	 * already handles through regular updates */
+	if ((u16TransitionTime == 0) || (u16TransitionTime == 0xFFFF))
+	{
+		vApp_CancelLevelTransition(u8Endpoint);
+		return;
+	}
+
+	u8Bulb = bIsRGB ? BULB_NUM_RGB(u8Index) : BULB_NUM_MONO(u8Index);
+	u8Level = MAX(u8Level, CLD_LEVELCONTROL_MIN_LEVEL);
+	u8Level = MIN(u8Level, CLD_LEVELCONTROL_MAX_LEVEL);
+
+	asLightState[u8Bulb].bLevelTransition = TRUE;
+	asLightState[u8Bulb].u8Level = u8Level;
+	vLI_StartLevel(u8Bulb, u8Level, (uint32)u16TransitionTime * LI_TICKS_PER_100MS);
+}
+
+/****************************************************************************
+ *
+ * NAME: vApp_CancelLevelTransition
+ *
+ * DESCRIPTION:
+ * Hands the level of a light back to the level control cluster, e.g. when
+ * a Move, Step or Stop command interrupts a timed transition.
+ *
+ * PARAMETERS:
+ * u8Endpoint: Endpoint the command was sent to
+ *
+ * RETURNS: void
+ *
+ ****************************************************************************/
+PUBLIC void vApp_CancelLevelTransition(uint8 u8Endpoint)
+{
+	uint8 u8Index;
+	uint8 u8Bulb;
+	bool_t bIsRGB;
+
+	if (!bEndPointToNum(u8Endpoint, &bIsRGB, &u8Index))
+	{
+		return;
+	}
+	u8Bulb = bIsRGB ? BULB_NUM_RGB(u8Index) : BULB_NUM_MONO(u8Index);
+	if (asLightState[u8Bulb].bLevelTransition)
+	{
+		asLightState[u8Bulb].bLevelTransition = FALSE;
+		/* Resynchronise with the cluster on its next update */
+		asLightState[u8Bulb].bValid = FALSE;
+		vLI_StartLevel(u8Bulb,
+				       bIsRGB ? sLightRGB[u8Index].sLevelControlServerCluster.u8CurrentLevel
+				              : sLightMono[u8Index].sLevelControlServerCluster.u8CurrentLevel,
+				       LI_TICKS_PER_100MS);
+	}
+}
+
+/****************************************************************************
+ *
+ * NAME: u16App_GetColourTemperature
+ *
+ * DESCRIPTION:
+ * Gets the colour temperature to pass to vRGBLight_SetLevels for a colour
+ * light.
+ *
+ * PARAMETERS:
+ * u8Index: Index of the colour light
+ *
+ * RETURNS:
+ * Colour temperature in mireds, or 0 if the light is not in colour
+ * temperature mode
+ *
+ ****************************************************************************/
+PUBLIC uint16 u16App_GetColourTemperature(uint8 u8Index)
+{
+	tsCLD_ColourControl *psCluster = &sLightRGB[u8Index].sColourControlServerCluster;
+
+	if (psCluster->u8ColourMode == E_CLD_COLOURCONTROL_COLOURMODE_COLOUR_TEMPERATURE)
+	{
+		return psCluster->u16ColourTemperatureMired;
+	}
+	return 0;
+}
+
+/****************************************************************************
+ *
+ * NAME: bLightStateChanged
+ *
+ * DESCRIPTION:
+ * Records the state requested for a bulb and checks it against the previous
+ * one, so that the 100ms cluster updates of an unchanged light don't restart
+ * the interpolator.
+ *
+ * PARAMETERS:
+ * pbKeepLevel: Set to TRUE if the level is owned by a timed transition and
+ * must be left alone
+ *
+ * RETURNS:
+ * TRUE if anything changed
+ *
+ ****************************************************************************/
+PRIVATE bool_t bLightStateChanged(uint8 u8Bulb, bool_t bOn, uint8 u8Level, uint8 u8Red,
+                                  uint8 u8Green, uint8 u8Blue, uint16 u16ColTemp, bool_t *pbKeepLevel)
+{
+	tsLightState *psState = &asLightState[u8Bulb];
+	bool_t bChanged;
+
+	*pbKeepLevel = FALSE;
+	if (psState->bLevelTransition)
+	{
+		if (bOn)
+		{
+			*pbKeepLevel = TRUE;
+			if (u8Level == psState->u8Level)
+			{
+				/* Cluster has caught up with the transition */
+				psState->bLevelTransition = FALSE;
+			}
+			u8Level = psState->u8Level;
+		}
+		else
+		{
+			psState->bLevelTransition = FALSE;
+		}
+	}
+
+	bChanged = !psState->bValid
+			|| (psState->bOn != bOn)
+			|| (psState->u8Level != u8Level)
+			|| (psState->u8Red != u8Red)
+			|| (psState->u8Green != u8Green)
+			|| (psState->u8Blue != u8Blue)
+			|| (psState->u16ColTemp != u16ColTemp);
+
+	psState->bValid = TRUE;
+	psState->bOn = bOn;
+	psState->u8Level = u8Level;
+	psState->u8Red = u8Red;
+	psState->u8Green = u8Green;
+	psState->u8Blue = u8Blue;
+	psState->u16ColTemp = u16ColTemp;
+
+	return bChanged;
+}
+
 /****************************************************************/
 /* OS Stub functions to allow single osconfig diagram (ZLL/ZHA) */
 /* to be used for all driver variants (just clear interrupt)    */
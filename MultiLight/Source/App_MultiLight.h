@@ -74,8 +74,11 @@ PUBLIC void vStartEffect(uint8 u8Endpoint, uint8 u8Effect);
 PUBLIC void vIdEffectTick(void);
 
 PUBLIC void vRGBLight_SetLevels(uint8 u8Bulb, bool_t bOn, uint8 u8Level, uint8 u8Red,
-                                uint8 u8Green, uint8 u8Blue);
+                                uint8 u8Green, uint8 u8Blue, uint16 u16ColTemp);
+PUBLIC uint16 u16App_GetColourTemperature(uint8 u8Index);
 PUBLIC void vSetBulbState(uint8 u8Bulb, bool bOn, uint8 u8Level);
+PUBLIC void vApp_StartLevelTransition(uint8 u8Endpoint, uint8 u8Level, uint16 u16TransitionTime);
+PUBLIC void vApp_CancelLevelTransition(uint8 u8Endpoint);
 PUBLIC void APP_vHandleIdentify(uint8 u8Endpoint);
 PUBLIC void APP_vHandleIdentifyAll(void);
 PUBLIC void vCreateInterpolationPoints( void);
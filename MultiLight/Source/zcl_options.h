@@ -237,7 +237,17 @@ PUBLIC void vLoadScenesNVM(void);
 #define CLD_COLOURCONTROL_COLOUR_CAPABILITIES           (COLOUR_CAPABILITY_HUE_SATURATION_SUPPORTED | \
                                                          COLOUR_CAPABILITY_ENHANCE_HUE_SUPPORTED    | \
                                                          COLOUR_CAPABILITY_COLOUR_LOOP_SUPPORTED    | \
-                                                         COLOUR_CAPABILITY_XY_SUPPORTED)
+                                                         COLOUR_CAPABILITY_XY_SUPPORTED             | \
+                                                         COLOUR_CAPABILITY_COLOUR_TEMPERATURE_SUPPORTED)
+
+/* Colour temperature attributes. The physical range must be covered by
+ * cct_table.h, see generate_cct_table.py */
+#define CLD_COLOURCONTROL_ATTR_COLOUR_TEMPERATURE
+#define CLD_COLOURCONTROL_ATTR_COLOUR_TEMPERATURE_PHY_MIN
+#define CLD_COLOURCONTROL_ATTR_COLOUR_TEMPERATURE_PHY_MAX
+
+#define CLD_COLOURCONTROL_COLOUR_TEMPERATURE_PHY_MIN    (153)
+#define CLD_COLOURCONTROL_COLOUR_TEMPERATURE_PHY_MAX    (500)
 
 
 /* Defined Primaries Information attribute attribute ID's set (5.2.2.2.2) */
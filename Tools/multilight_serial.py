@@ -0,0 +1,368 @@
+#!/usr/bin/env python
+#
+# multilight_serial.py
+#
+# Host side client for the MultiLight serial interface. It can send ASCII
+# commands (see Serial_Config.md) and binary mode frames, and has a
+# benchmark which compares the throughput of the two, and can stream a test
+# pattern straight to the outputs or print telemetry which the board pushes
+# on its own. Without --baud, it finds the baud rate
+# the board is running at by itself.
+#
+# Needs pyserial. Examples:
+#   python multilight_serial.py /dev/ttyUSB0 ping
+#   python multilight_serial.py /dev/ttyUSB0 baud --set 1000000
+#   python multilight_serial.py /dev/ttyUSB0 channels
+#   python multilight_serial.py /dev/ttyUSB0 bench
+#   python multilight_serial.py /dev/ttyUSB0 stream --fps 100 --calibrated
+#   python multilight_serial.py /dev/ttyUSB0 monitor --period 500
+
+from __future__ import print_function
+from __future__ import division
+import argparse
+import collections
+import math
+import struct
+import sys
+import time
+
+# Binary mode command IDs, from app_light_calibration.c
+CMD_PING = 0x01
+CMD_EXIT = 0x02
+CMD_SAVE = 0x03
+CMD_SET_CHANNEL = 0x10
+CMD_GET_CHANNELS = 0x11
+CMD_SET_CURVE = 0x12
+CMD_SET_MATRIX = 0x13
+CMD_STREAM_START = 0x20
+CMD_STREAM_FRAME = 0x21
+CMD_STREAM_STOP = 0x22
+CMD_SUBSCRIBE = 0x30
+CMD_TELEMETRY = 0x31
+RESPONSE = 0x80
+
+# Baud rates the board supports, fastest first. DEFAULT_BAUD is the rate
+# after a reset with nothing saved, or after a break.
+BAUD_RATES = (1000000, 500000, 230400, 115200, 38400)
+DEFAULT_BAUD = 38400
+
+SETTING_GAMMA = 0
+SETTING_BRIGHTNESS = 1
+SETTING_CURRENT = 2
+
+STATUS_NAMES = {0: "OK", 1: "Unknown command", 2: "Bad length", 3: "Bad value"}
+
+def crc16(data, crc=0xffff):
+    # CRC-16/CCITT-FALSE
+    for b in bytearray(data):
+        crc ^= b << 8
+        for i in range(8):
+            if crc & 0x8000:
+                crc = ((crc << 1) ^ 0x1021) & 0xffff
+            else:
+                crc = (crc << 1) & 0xffff
+    return crc
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for b in bytearray(data):
+        if b == 0:
+            out.append(len(block) + 1)
+            out += block
+            block = bytearray()
+        else:
+            block.append(b)
+            if len(block) == 254:
+                out.append(255)
+                out += block
+                block = bytearray()
+    out.append(len(block) + 1)
+    out += block
+    return bytes(out)
+
+def cobs_decode(data):
+    data = bytearray(data)
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            raise ValueError("Bad COBS frame")
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code != 255 and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+def make_frame(command, payload=b""):
+    body = bytearray([command]) + bytearray(payload)
+    return cobs_encode(bytes(body) + struct.pack(">H", crc16(body))) + b"\x00"
+
+class Error(Exception):
+    pass
+
+class MultiLight(object):
+    # port can be anything with pyserial's read(), write(),
+    # reset_input_buffer(), send_break() and baudrate
+    def __init__(self, port):
+        self.port = port
+        self.binary = False
+        # Telemetry records which arrived while waiting for a response
+        self.telemetry = collections.deque()
+
+    def sync(self):
+        # Leave binary mode if the board is in it. In ASCII mode the board
+        # sees one invalid line instead.
+        self.port.write(b"\x00" + make_frame(CMD_EXIT) + b"\r\n")
+        time.sleep(0.2)
+        self.port.reset_input_buffer()
+        self.binary = False
+
+    def command(self, line):
+        if self.binary:
+            self.exit_binary()
+        self.port.write(line.encode("ascii") + b"\r\n")
+        response = bytearray()
+        while not response.endswith(b"\r\n"):
+            c = self.port.read(1)
+            if len(c) == 0:
+                raise Error("Timeout waiting for response to " + line)
+            response += c
+        return response[:-2].decode("ascii")
+
+    def probe(self):
+        # True if the board answers a version request at the current rate
+        self.sync()
+        try:
+            return self.command("v").startswith("MultiLight")
+        except (Error, UnicodeDecodeError):
+            return False
+
+    def find_baud(self):
+        for baud in BAUD_RATES:
+            self.port.baudrate = baud
+            if self.probe():
+                return baud
+        # A break makes the board go back to the default rate
+        self.port.baudrate = DEFAULT_BAUD
+        self.port.send_break()
+        if self.probe():
+            return DEFAULT_BAUD
+        raise Error("Board doesn't respond at any baud rate")
+
+    def set_baud(self, baud):
+        # The board answers at the old rate, then changes
+        response = self.command("u {}".format(baud))
+        if response != "Baud={}".format(baud):
+            raise Error("Board didn't change baud rate: " + response)
+        self.port.baudrate = baud
+        if not self.probe():
+            raise Error("Board doesn't respond at {} baud".format(baud))
+
+    def enter_binary(self):
+        if not self.binary:
+            if self.command("e") != "Binary":
+                raise Error("Board didn't enter binary mode")
+            self.binary = True
+
+    def exit_binary(self):
+        self.binary = False
+        self.port.write(make_frame(CMD_EXIT))
+        self.read_frame(CMD_EXIT)
+
+    def read_frame(self, command):
+        while True:
+            data = bytearray()
+            while True:
+                c = self.port.read(1)
+                if len(c) == 0:
+                    raise Error("Timeout waiting for response frame")
+                if c == b"\x00":
+                    break
+                data += c
+            frame = bytearray(cobs_decode(data))
+            if len(frame) < 4 or crc16(frame) != 0:
+                raise Error("Bad response frame")
+            if frame[0] != (CMD_TELEMETRY | RESPONSE) or command == CMD_TELEMETRY:
+                break
+            self.telemetry.append(parse_telemetry(bytes(frame[2:-2])))
+        if frame[0] != (command | RESPONSE):
+            raise Error("Response to wrong command")
+        if frame[1] != 0:
+            raise Error(STATUS_NAMES.get(frame[1], "Status " + str(frame[1])))
+        return bytes(frame[2:-2])
+
+    def transact(self, command, payload=b""):
+        self.enter_binary()
+        self.port.write(make_frame(command, payload))
+        return self.read_frame(command)
+
+    def ping(self):
+        return self.transact(CMD_PING).decode("ascii")
+
+    def save(self):
+        self.transact(CMD_SAVE)
+
+    def set_channels(self, entries):
+        # entries is a list of (channel, setting, value)
+        payload = b"".join(struct.pack("<BBH", c, s, v) for (c, s, v) in entries)
+        self.transact(CMD_SET_CHANNEL, payload)
+
+    def get_channels(self):
+        # Returns a list of (gamma, brightness, knots, current) per channel
+        data = self.transact(CMD_GET_CHANNELS)
+        return [struct.unpack("<HHBH", data[i:i + 7]) for i in range(0, len(data), 7)]
+
+    def set_curve(self, channel_mask, knots):
+        # knots is a list of (intensity, PWM value * 16)
+        payload = struct.pack("<H", channel_mask)
+        payload += b"".join(struct.pack("<HH", i, p) for (i, p) in knots)
+        self.transact(CMD_SET_CURVE, payload)
+
+    def set_matrix(self, bulb, matrix):
+        # matrix is 9 entries, row by row, 4096 = 1.0
+        self.transact(CMD_SET_MATRIX, struct.pack("<B9h", bulb, *matrix))
+
+    def stream_start(self, calibrated):
+        # Outputs are off until the first frame
+        self.transact(CMD_STREAM_START, struct.pack("<B", 1 if calibrated else 0))
+        self.sequence = 0
+
+    def stream_frame(self, values):
+        # values is one 12 bit value per raw channel. There is no response
+        # unless the frame is rejected, which stream_stop will notice.
+        self.sequence = (self.sequence + 1) & 0xff
+        payload = struct.pack("<B", self.sequence) + struct.pack("<{}H".format(len(values)), *values)
+        self.port.write(make_frame(CMD_STREAM_FRAME, payload))
+
+    def stream_stop(self):
+        # Returns the number of frames shown, dropped and late
+        return struct.unpack("<III", self.transact(CMD_STREAM_STOP))
+
+    def subscribe(self, period_ms):
+        # Records are pushed every period_ms (rounded up to 100ms) until
+        # subscribe(0) or exit_binary(). Returns the period the board uses.
+        return struct.unpack("<H", self.transact(CMD_SUBSCRIBE, struct.pack("<H", period_ms)))[0]
+
+    def get_telemetry(self):
+        # One record, straight away
+        return parse_telemetry(self.transact(CMD_TELEMETRY))
+
+    def read_telemetry(self):
+        # The next pushed record
+        if self.telemetry:
+            return self.telemetry.popleft()
+        return parse_telemetry(self.read_frame(CMD_TELEMETRY))
+
+TELEMETRY_FORMAT = "<HhBIIIHH"
+TELEMETRY_FIELDS = ("sequence", "temperature", "flags", "tick_overruns", "tick_max_late",
+                    "output_errors", "rx_high_water", "tx_high_water")
+
+def parse_telemetry(data):
+    size = struct.calcsize(TELEMETRY_FORMAT)
+    record = dict(zip(TELEMETRY_FIELDS, struct.unpack(TELEMETRY_FORMAT, data[:size])))
+    record["overheat"] = (record["flags"] & 1) != 0
+    # One PWM value per raw channel, in 1/16 PWM steps
+    record["pwm"] = list(struct.unpack("<{}H".format((len(data) - size) // 2), data[size:]))
+    return record
+
+def benchmark(light, seconds):
+    channels = light.get_channels()
+    brightness = [c[1] for c in channels]
+    n = len(channels)
+
+    # ASCII: one 'b' command per channel
+    count = 0
+    start = time.time()
+    while time.time() - start < seconds:
+        for c in range(n):
+            light.command("b {} {}".format(1 << c, brightness[c] - (count & 1)))
+        count += 1
+    ascii_rate = count * n / (time.time() - start)
+
+    # Binary: every channel in one frame
+    count = 0
+    start = time.time()
+    while time.time() - start < seconds:
+        light.set_channels([(c, SETTING_BRIGHTNESS, brightness[c] - (count & 1)) for c in range(n)])
+        count += 1
+    binary_rate = count * n / (time.time() - start)
+    binary_frames = count / (time.time() - start)
+
+    light.set_channels([(c, SETTING_BRIGHTNESS, brightness[c]) for c in range(n)])
+    light.exit_binary()
+    print("ASCII:  {:.0f} channel settings per second".format(ascii_rate))
+    print("Binary: {:.0f} channel settings per second ({:.1f} frames per second)".format(binary_rate, binary_frames))
+
+def stream_pattern(light, seconds, fps, calibrated):
+    # A sine wave which runs across the channels, one cycle per second
+    n = len(light.get_channels())
+    light.stream_start(calibrated)
+    start = time.time()
+    frame = 0
+    while time.time() - start < seconds:
+        t = frame / fps
+        light.stream_frame([int(round(2047.5 + 2047.5 * math.sin(2 * math.pi * (t + c / n)))) for c in range(n)])
+        frame += 1
+        time.sleep(max(0.0, start + frame / fps - time.time()))
+    (shown, dropped, late) = light.stream_stop()
+    print("Sent {} frames, {} shown, {} dropped, {} late".format(frame, shown, dropped, late))
+
+def monitor(light, seconds, period):
+    print("Period {} ms".format(light.subscribe(period)))
+    start = time.time()
+    last = None
+    while time.time() - start < seconds:
+        r = light.read_telemetry()
+        if last is not None and r["sequence"] != (last + 1) & 0xffff:
+            print("{} records lost".format((r["sequence"] - last - 1) & 0xffff))
+        last = r["sequence"]
+        print("#{} {}C{} overruns={} late={:.1f}ms errors={} rx={} tx={} pwm={}".format(
+            r["sequence"], r["temperature"], " OVERHEAT" if r["overheat"] else "",
+            r["tick_overruns"], r["tick_max_late"] / 16000.0, r["output_errors"],
+            r["rx_high_water"], r["tx_high_water"], " ".join(str(p >> 4) for p in r["pwm"])))
+    light.subscribe(0)
+
+def main():
+    parser = argparse.ArgumentParser(description="MultiLight serial client")
+    parser.add_argument("port")
+    parser.add_argument("--baud", type=int, help="baud rate the board is running at; found automatically if not given")
+    parser.add_argument("--set", type=int, choices=BAUD_RATES, help="new baud rate for the baud action")
+    parser.add_argument("--seconds", type=float, default=5.0, help="how long bench, stream and monitor run for")
+    parser.add_argument("--fps", type=float, default=60.0, help="stream frame rate")
+    parser.add_argument("--calibrated", action="store_true", help="stream intensities instead of PWM values")
+    parser.add_argument("--period", type=int, default=1000, help="telemetry period in ms")
+    parser.add_argument("action", choices=("ping", "channels", "bench", "stream", "baud", "monitor"))
+    args = parser.parse_args()
+
+    import serial
+    light = MultiLight(serial.Serial(args.port, args.baud or DEFAULT_BAUD, timeout=1.0))
+    if args.baud:
+        light.sync()
+    else:
+        print("Found board at {} baud".format(light.find_baud()))
+    if args.action == "ping":
+        print(light.ping())
+    elif args.action == "channels":
+        for (c, (gamma, brightness, knots, current)) in enumerate(light.get_channels()):
+            print("{}: gamma={} brightness={} knots={} current={}".format(c, gamma, brightness, knots, current))
+    elif args.action == "bench":
+        benchmark(light, args.seconds)
+    elif args.action == "stream":
+        stream_pattern(light, args.seconds, args.fps, args.calibrated)
+    elif args.action == "monitor":
+        monitor(light, args.seconds, args.period)
+    elif args.action == "baud":
+        if args.set:
+            light.set_baud(args.set)
+            light.command("s")
+            print("Changed to {} baud and saved".format(args.set))
+        else:
+            print(light.port.baudrate)
+    if light.binary:
+        light.exit_binary()
+
+if __name__ == "__main__":
+    main()